@@ -74,6 +74,24 @@ int main(int argc, const char** argv) {
                 0.5,
                 "float"
         );
+        TCLAP::SwitchArg sharedDataset(
+                "",
+                "shared_dataset",
+                "Share the dataset with other processes training on the same file. The first process publishes it in shared memory, the following ones use it without reading the file again."
+        );
+        TCLAP::SwitchArg foldDuplicates(
+                "",
+                "fold_duplicates",
+                "Fold duplicate records of the dataset into weighted records, so that training and testing process each distinct record once."
+        );
+        TCLAP::SwitchArg noCache(
+                "",
+                "no_cache",
+                "Always parse the text dataset file. Without this flag a binary cache (training file name with .fcnnbin appended) is written next to it and used while the file does not change."
+        );
+        cmd.add(noCache);
+        cmd.add(foldDuplicates);
+        cmd.add(sharedDataset);
         cmd.add(learnRate);
         cmd.add(freq);
         cmd.add(epoches);
@@ -105,11 +123,23 @@ int main(int argc, const char** argv) {
 
         if(fexists(datasetPath))
         {
-            if(!dataset.load(datasetPath, true))
+            bool cache = !noCache.getValue();
+            bool loaded = sharedDataset.getValue()
+                          ? dataset.load_shared(datasetPath, true, cache)
+                          : dataset.load(datasetPath, true, cache);
+            if(!loaded)
             {
                 std::cerr << "Could not read dataset!" << std::endl;
                 exit(-1);
             }
+            if(foldDuplicates.getValue())
+            {
+                int folded = dataset.fold_duplicates();
+                if(!printInfo.getValue())
+                {
+                    std::printf("Folded %i duplicate records, %i left.\n", folded, dataset.no_records());
+                }
+            }
         }
         else
         {
@@ -0,0 +1,914 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file fcnn_tests.cpp
+ *  \brief Behaviour checks of the FCNN library.
+ *
+ *  Usage: fcnn_tests [directory for temporary files, default /tmp].
+ *  Prints each failed check and returns non-zero if any failed.
+ */
+
+
+#include <fcnn/fcnn.h>
+#include <fcnn/mlpnet_distill.h>
+#include <fcnn/mlpnet_lowrank.h>
+#include <fcnn/mlpnet_prune.h>
+#include <fcnn/mlpnet_snapshot.h>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using namespace fcnn;
+
+
+
+namespace {
+
+
+int no_checks = 0, no_failed = 0;
+
+
+void
+check(bool ok, const char *what)
+{
+    ++no_checks;
+    if (ok) return;
+    ++no_failed;
+    std::printf("FAILED: %s\n", what);
+}
+
+
+double
+max_diff(const Matrix<double> &a, const Matrix<double> &b)
+{
+    if ((a.rows() != b.rows()) || (a.cols() != b.cols())) return HUGE_VAL;
+    double m = 0.;
+    for (int i = 1; i <= a.rows(); ++i)
+        for (int j = 1; j <= a.cols(); ++j) m = std::max(m, std::fabs(a(i, j) - b(i, j)));
+    return m;
+}
+
+
+bool
+same_data(const Dataset<double> &a, const Dataset<double> &b)
+{
+    if ((a.no_records() != b.no_records()) || (a.get_info() != b.get_info())
+        || (a.get_record_weights() != b.get_record_weights())) return false;
+    for (int i = 1; i <= a.no_records(); ++i)
+        if (a.get_record_info(i) != b.get_record_info(i)) return false;
+    return !max_diff(a.get_input(), b.get_input())
+           && !max_diff(a.get_output(), b.get_output());
+}
+
+
+// Smooth target on random inputs, every third record repeated twice
+Dataset<double>
+mk_data(int n, bool dup)
+{
+    std::vector<double> x;
+    for (int i = 0; i < n; ++i) {
+        double a = 2. * std::rand() / RAND_MAX - 1., b = 2. * std::rand() / RAND_MAX - 1.;
+        for (int k = 0; k < ((dup && !(i % 3)) ? 3 : 1); ++k) {
+            x.push_back(a);
+            x.push_back(b);
+        }
+    }
+    int r = x.size() / 2;
+    Matrix<double> in(r, 2), out(r, 1);
+    std::vector<std::string> ri(r);
+    for (int i = 0; i < r; ++i) {
+        in(i + 1, 1) = x[2 * i];
+        in(i + 1, 2) = x[2 * i + 1];
+        out(i + 1, 1) = .5 * std::sin(2. * x[2 * i]) * x[2 * i + 1];
+        std::ostringstream os;
+        os << "record " << i + 1;
+        ri[i] = os.str();
+    }
+    Dataset<double> d;
+    d.set(in, out, "test data", ri);
+    return d;
+}
+
+
+MLPNet<double>
+mk_net(const std::vector<int> &layers, unsigned seed)
+{
+    MLPNet<double> net;
+    net.construct(layers);
+    std::srand(seed);
+    net.rnd_weights();
+    return net;
+}
+
+
+// Randomised tolerance check agrees with exact MSE when it is clearly
+// above or below tolerance and leaves rand() stream intact
+void
+test_mse_below(const std::string&)
+{
+    Dataset<double> d = mk_data(6000, false);
+    MLPNet<double> net = mk_net(std::vector<int>{ 2, 5, 1 }, 4);
+    double m = net.mse(d);
+    check(net.mse_below(d, 2. * m), "mse_below rejects MSE well below tolerance");
+    check(!net.mse_below(d, .5 * m), "mse_below accepts MSE well above tolerance");
+    std::srand(99);
+    int a = std::rand();
+    std::srand(99);
+    net.mse_below(d, m);
+    check(std::rand() == a, "mse_below advances rand() stream");
+}
+
+
+// Pruned networks meet tolerance level (by exact MSE). A few outlying
+// records make the randomised check prone to false acceptance.
+void
+test_prune_tol(const std::string&)
+{
+    Dataset<double> d = mk_data(300, false);
+    Matrix<double> in = d.get_input(), out = d.get_output();
+    for (int i = 1; i <= 300; i += 100) out(i, 1) += 3.;
+    MLPNet<double> net = mk_net(std::vector<int>{ 2, 8, 1 }, 5);
+    mlpnet_teach_rprop(net, in, out, 1e-4, 500);
+    double m = net.mse(in, out);
+    bool mag = true, neu = true;
+    for (int k = 1; k <= 4; ++k) {
+        double t = (1. + .02 * k) * m;
+        MLPNet<double> a = net, b = net;
+        mlpnet_prune_mag(a, in, out, t);
+        mag = mag && (a.mse(in, out) <= t);
+        mlpnet_prune_neurons(b, in, out, t);
+        neu = neu && (b.mse(in, out) <= t);
+    }
+    check(mag, "magnitude pruning exceeds tolerance level");
+    check(neu, "neuron pruning exceeds tolerance level");
+}
+
+
+// Teaching 20 epochs equals teaching 10 + 10 epochs with the same
+// MLPNetRprop object (state carried over)
+void
+test_rprop_warm_start(const std::string&)
+{
+    Dataset<double> d = mk_data(300, false);
+    MLPNet<double> a = mk_net(std::vector<int>{ 2, 6, 1 }, 1), b = a;
+    MLPNetRprop<double> r1, r2;
+    r1.teach(a, d, 1e-12, 20);
+    r2.teach(b, d, 1e-12, 10);
+    r2.teach(b, d, 1e-12, 10);
+    check(!max_diff(a.get_weights(), b.get_weights()),
+          "warm-started Rprop differs from uninterrupted run");
+}
+
+
+// Gradient of network with hashed layers (w.r.t. free parameters, i.e.
+// buckets in hashed layers) agrees with central finite differences
+void
+test_hashed_grad(const std::string&)
+{
+    Dataset<double> d = mk_data(100, false);
+    MLPNet<double> net = mk_net(std::vector<int>{ 2, 12, 8, 1 }, 6);
+    net.set_hashed(2, 10, 3);
+    net.set_hashed(3, 15, 9);
+    std::pair<Matrix<double>, double> g = net.grad(d);
+    Matrix<double> w = net.get_weights();
+    check(g.first.rows() == net.no_params(), "hashed gradient has wrong size");
+    double err = 0., h = 1e-6;
+    for (int k = 1; k <= w.rows(); ++k) {
+        Matrix<double> wp = w.copy(), wm = w.copy();
+        wp(k) += h;
+        wm(k) -= h;
+        net.set_weights(wp);
+        double fp = net.mse(d);
+        net.set_weights(wm);
+        double fm = net.mse(d);
+        err = std::max(err, std::fabs((fp - fm) / (2. * h) - g.first(k)));
+    }
+    check(err < 1e-7, "hashed gradient differs from finite differences");
+}
+
+
+// Saved and loaded network with hashed layers keeps buckets and seeds
+// (weights of connections are expanded in the same way, text format
+// may round the last bit)
+void
+test_hashed_save_load(const std::string &dir)
+{
+    std::string f = dir + "/hashed_net.txt";
+    MLPNet<double> net = mk_net(std::vector<int>{ 3, 9, 5, 2 }, 7), net2;
+    net.set_hashed(2, 7, 12345);
+    net.set_hashed(3, 4, 77);
+    check(net.save(f) && net2.load(f), "hashed network save/load");
+    check((net2.hashed(2) == 7) && (net2.hashed(3) == 4) && !net2.hashed(4)
+          && (net2.no_params() == net.no_params()), "buckets changed by save/load");
+    check(max_diff(net.get_weights(), net2.get_weights()) < 1e-15,
+          "free parameters changed by save/load");
+    bool same = true;
+    for (int l = 2; l <= 4; ++l)
+        for (int n = 1; n <= net.no_neurons(l); ++n)
+            for (int p = 0; p <= net.no_neurons(l - 1); ++p)
+                same = same && (std::fabs(net.get_w(l, n, p) - net2.get_w(l, n, p)) < 1e-15);
+    check(same, "hashed weights expanded differently after save/load");
+    std::remove(f.c_str());
+}
+
+
+// Pruned layer whose active weights form a rank one matrix is factorised
+// exactly (inactive weights enter as zeros whatever their stored value)
+void
+test_lowrank_pruned(const std::string&)
+{
+    MLPNet<double> net = mk_net(std::vector<int>{ 3, 6, 6, 1 }, 2);
+    const double u[] = { 1., .5, 0., -1., .25, 0. }, v[] = { .3, -.2, .7, .1, -.4, .6 };
+    for (int n = 1; n <= 6; ++n) {
+        for (int a = 1; a <= 6; ++a) {
+            if (u[n - 1] != 0.) {
+                net.set_w(3, n, a, u[n - 1] * v[a - 1]);
+            } else {
+                net.set_w(3, n, a, 1.);
+                net.set_active(3, n, a, false);
+            }
+        }
+    }
+    Matrix<double> in(200, 3);
+    for (int i = 1; i <= 200; ++i)
+        for (int j = 1; j <= 3; ++j) in(i, j) = 2. * std::rand() / RAND_MAX - 1.;
+    Matrix<double> out = net.eval(in);
+    MLPNet<double> lr = net;
+    int r = mlpnet_lowrank(lr, in, out, 3, 1e-20, false, 0);
+    check(r == 1, "pruned rank one layer not factorised with rank one");
+    check(max_diff(lr.eval(in), out) < 1e-12,
+          "low-rank factorisation of pruned layer changes outputs");
+}
+
+
+// Factorised network meets tolerance level (by exact MSE). A few outlying
+// records make the randomised check prone to false acceptance.
+void
+test_lowrank_tol(const std::string&)
+{
+    Dataset<double> d = mk_data(300, false);
+    Matrix<double> in = d.get_input(), out = d.get_output();
+    for (int i = 1; i <= 300; i += 100) out(i, 1) += 3.;
+    MLPNet<double> net = mk_net(std::vector<int>{ 2, 10, 10, 1 }, 8);
+    mlpnet_teach_rprop(net, in, out, 1e-4, 500);
+    double m = net.mse(in, out);
+    bool ok = true;
+    for (int k = 1; k <= 4; ++k) {
+        double t = (1. + .02 * k) * m;
+        MLPNet<double> lr = net;
+        if (mlpnet_lowrank(lr, in, out, 3, t, false, 0)) ok = ok && (lr.mse(in, out) < t);
+        lr = net;
+        if (mlpnet_lowrank(lr, in, out, 3, t, false, 20)) ok = ok && (lr.mse(in, out) < t);
+    }
+    check(ok, "low-rank factorisation exceeds tolerance level");
+}
+
+
+// Distillation with jittered copies (teacher outputs cached after the first
+// epoch) reports student's MSE w.r.t. the teacher, too many copies are
+// rejected
+void
+test_distill(const std::string&)
+{
+    Dataset<double> d = mk_data(200, false);
+    MLPNet<double> t = mk_net(std::vector<int>{ 2, 8, 1 }, 9),
+                   s = mk_net(std::vector<int>{ 2, 3, 1 }, 10);
+    std::pair<double, double> r = mlpnet_distill(t, s, d.get_input(), 1e-12, 20, 3, .05, 64);
+    check(std::fabs(r.first - s.mse(d.get_input(), t.eval(d.get_input()))) < 1e-14,
+          "distillation reports wrong MSE");
+    bool thrown = false;
+    try {
+        mlpnet_distill(t, s, d.get_input(), 1e-12, 1, 1 << 24);
+    } catch (exception&) {
+        thrown = true;
+    }
+    check(thrown, "no. of jittered records overflows");
+}
+
+
+// Copy of network with all weights set to v
+MLPNet<double>
+const_net(const MLPNet<double> &net, double v)
+{
+    MLPNet<double> res = net;
+    res.set_weights(Matrix<double>(net.active_w(), 1, v));
+    return res;
+}
+
+
+// Readers taking snapshots while the trainer publishes never see partially
+// updated weights (every published network has all weights equal) and see
+// versions in order; small ring makes slots reused often
+void
+test_snapshots(const std::string&)
+{
+    MLPNet<double> net = mk_net(std::vector<int>{ 4, 16, 8, 2 }, 11);
+    int W = net.active_w(), P = 3000;
+    MLPNetPublisher<double> pub(const_net(net, 0.), 3);
+    std::atomic<bool> done(false);
+    std::atomic<int> torn(0), reordered(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+        readers.push_back(std::thread([&]() {
+            double last = 0.;
+            while (!done.load()) {
+                MLPNetPublisher<double>::snapshot_type s = pub.snapshot();
+                Matrix<double> w = s->get_weights();
+                for (int k = 2; k <= W; ++k)
+                    if (w(k) != w(1)) { ++torn; break; }
+                if (w(1) < last) ++reordered;
+                last = w(1);
+            }
+        }));
+    }
+    for (int v = 1; v <= P; ++v) pub.publish(const_net(net, v));
+    done.store(true);
+    for (size_t t = 0; t < readers.size(); ++t) readers[t].join();
+    check(!torn.load(), "snapshot with partially updated weights");
+    check(!reordered.load(), "snapshots seen out of order");
+    check((pub.version() == (unsigned long) P + 1) && (pub.snapshot()->get_weights()(1) == P),
+          "last snapshot not current");
+}
+
+
+// Matrix pool serves released blocks of the same size class from the cache
+// and releases cached memory with the outermost pool
+void
+test_pool(const std::string&)
+{
+    {
+        MatrixPool pool;
+        { Matrix<double> a(100, 10); }
+        check((pool.hits() == 0) && (pool.misses() == 1), "pool: first allocation");
+        check(MatrixPool::cached() > 0, "pool: released block not cached");
+        { Matrix<double> b(100, 10); }
+        { Matrix<double> c(90, 11); }
+        check((pool.hits() == 2) && (pool.misses() == 1),
+              "pool: blocks of the same size class not reused");
+        {
+            MatrixPool inner;
+            Matrix<double> d(1000, 10), e(100, 10);
+            check((inner.hits() == 1) && (inner.misses() == 1),
+                  "pool: nested pool counters");
+        }
+        check((pool.hits() == 3) && (pool.misses() == 2), "pool: counters after nested pool");
+        check(MatrixPool::cached() > 0, "pool: memory released by nested pool");
+    }
+    check(MatrixPool::cached() == 0, "pool: memory not released by outermost pool");
+}
+
+
+// Evaluation, MSE and gradient over matrix views (row lists with repeats,
+// row and column strides) equal those over copies of the views
+void
+test_views(const std::string&)
+{
+    Matrix<double> in(40, 5), out(40, 3);
+    for (int i = 1; i <= 40; ++i) {
+        for (int j = 1; j <= 5; ++j) in(i, j) = 2. * std::rand() / RAND_MAX - 1.;
+        for (int j = 1; j <= 3; ++j) out(i, j) = std::rand() / (double) RAND_MAX - .5;
+    }
+    std::vector<int> rows = {3, 1, 3, 40, 7, 7, 22};
+    std::vector<int> cols = {2, 4}, col3(1, 3);
+    MatrixView<double> vi(in.get_cols(cols), rows), vo(out.get_cols(col3), rows);
+    MatrixView<double> si(in, 2, 10, 2, 2, 3, 2), so(out, 2, 10, 3, 1, 3);
+    // copied and assigned views outlive the originals
+    MatrixView<double> ci(si), co(out);
+    co = so;
+    check(max_diff(vi.copy(), in.get_rows(rows).get_cols(cols)) == 0.,
+          "views: copy of row list view");
+    std::vector<int> srows;
+    for (int i = 0; i < 10; ++i) srows.push_back(2 + 3 * i);
+    check(max_diff(ci.copy(), in.get_rows(srows).get_cols(cols)) == 0.,
+          "views: copy of strided view");
+    check(max_diff(co.copy(), out.get_rows(srows).get_cols(col3)) == 0.,
+          "views: copy of assigned view");
+
+    MLPNet<double> net = mk_net({2, 4, 1}, 17);
+    bool ok = true;
+    for (int k = 0; k < 2; ++k) {
+        const MatrixView<double> &a = k ? ci : vi;
+        const MatrixView<double> &b = k ? co : vo;
+        ok = ok && (max_diff(net.eval(a), net.eval(a.copy())) < 1e-14);
+        ok = ok && (std::fabs(net.mse(a, b) - net.mse(a.copy(), b.copy())) < 1e-14);
+        std::pair<Matrix<double>, double> g1 = net.grad(a, b), g2 = net.grad(a.copy(), b.copy());
+        ok = ok && (max_diff(g1.first, g2.first) < 1e-14) && (std::fabs(g1.second - g2.second) < 1e-14);
+    }
+    check(ok, "views: eval, mse and grad over views differ from copies");
+}
+
+
+// MSE, gradient and Rprop teaching over blocks read from data sources
+// (matrices and binary file, last block shorter) agree with in-memory data
+void
+test_sources(const std::string &dir)
+{
+    Dataset<double> dat = mk_data(103, false);
+    std::string fname = dir + "/fcnn_tests_source.bin";
+    check(dat.save_binary(fname), "sources: save_binary");
+    MLPNet<double> net = mk_net({2, 5, 1}, 23);
+    std::pair<Matrix<double>, double> g = net.grad(dat);
+    double e = net.mse(dat);
+    MatrixSource<double> ms(dat, 10);
+    BinaryFileSource<double> fs(fname, 10);
+    for (int k = 0; k < 2; ++k) {
+        DataSource<double> &src = k ? (DataSource<double>&) fs : (DataSource<double>&) ms;
+        std::pair<Matrix<double>, double> gs = net.grad(src);
+        check((max_diff(gs.first, g.first) < 1e-14) && (std::fabs(gs.second - g.second) < 1e-14),
+              k ? "sources: gradient over binary file" : "sources: gradient over matrices");
+        check(std::fabs(net.mse(src) - e) < 1e-14,
+              k ? "sources: MSE over binary file" : "sources: MSE over matrices");
+    }
+    MLPNet<double> a = net, b = net;
+    MLPNetRprop<double> ra, rb;
+    ra.teach(a, dat, 1e-12, 10);
+    rb.teach(b, fs, 1e-12, 10);
+    check(max_diff(a.get_weights(), b.get_weights()) < 1e-12,
+          "sources: Rprop over binary file");
+    std::remove(fname.c_str());
+}
+
+
+// Reference reader of text dataset files (formatted stream input)
+bool
+load_ref(const std::string &fname, Dataset<double> &d)
+{
+    std::ifstream is(fname.c_str());
+    std::string line, info;
+    while (std::getline(is, line) && !line.empty() && (line[0] == '#')) {
+        if (!info.empty()) info += '\n';
+        info += line.substr(line.find_first_not_of("# "));
+    }
+    std::istringstream hs(line);
+    int r, ci, co, cw = 0;
+    if (!(hs >> r >> ci >> co)) return false;
+    hs >> cw;
+    Matrix<double> in(r, ci), out(r, co);
+    std::vector<std::string> ri(r);
+    std::vector<double> w(cw ? r : 0);
+    for (int i = 0; i < r; ++i) {
+        if ((is >> std::ws).peek() == '#') {
+            std::getline(is, line);
+            ri[i] = line.substr(line.find_first_not_of("# "));
+        }
+        for (int j = 1; j <= ci; ++j) is >> in(i + 1, j);
+        for (int j = 1; j <= co; ++j) is >> out(i + 1, j);
+        if (cw) is >> w[i];
+    }
+    if (!is) return false;
+    d.set(in, out, info, ri);
+    if (cw) d.set_record_weights(w);
+    return true;
+}
+
+
+// Parallel text loader, reference reader, CRLF file and binary file agree
+void
+test_loaders(const std::string &dir)
+{
+    std::string f = dir + "/loader.txt", fcr = dir + "/loader_crlf.txt",
+                fb = dir + "/loader.bin";
+    Dataset<double> d = mk_data(5000, true);
+    d.fold_duplicates();
+    check(d.save(f), "saving text dataset");
+    {
+        std::ifstream is(f.c_str());
+        std::ofstream os(fcr.c_str(), std::ios::binary);
+        std::string line;
+        while (std::getline(is, line)) os << line << "\r\n";
+    }
+    Dataset<double> a, b, c, e;
+    check(a.load(f), "loading text dataset");
+    check(load_ref(f, b), "loading text dataset (reference)");
+    check(same_data(a, b), "text loader differs from reference reader");
+    check(c.load(fcr), "loading text dataset with CRLF");
+    check(same_data(a, c), "CRLF dataset differs");
+    check(a.save_binary(fb) && e.load(fb), "binary dataset round trip");
+    check(same_data(a, e), "binary dataset differs");
+    std::remove(f.c_str());
+    std::remove(fcr.c_str());
+    std::remove(fb.c_str());
+}
+
+
+// Dataset read through binary cache equals the parsed one; cache is not
+// used once the text file changes
+void
+test_cache(const std::string &dir)
+{
+    std::string f = dir + "/fcnn_tests_cached.txt", cf = f + ".fcnnbin";
+    Dataset<double> d = mk_data(1000, true);
+    d.fold_duplicates();
+    check(d.save(f), "cache: saving text dataset");
+    std::remove(cf.c_str());
+    Dataset<double> a, b, c;
+    check(a.load(f, true, false), "cache: loading text dataset");
+    check(b.load(f, true, true), "cache: loading dataset (writing cache)");
+    check(std::ifstream(cf.c_str()).good(), "cache: cache not written");
+    check(c.load(f, true, true), "cache: loading dataset (from cache)");
+    check(same_data(a, b) && same_data(a, c), "cache: cached dataset differs");
+    Dataset<double> e, g;
+    check(mk_data(700, false).save(f), "cache: saving changed text dataset");
+    check(e.load(f, true, true) && g.load(f, true, false), "cache: loading changed dataset");
+    check(same_data(e, g), "cache: stale cache used");
+    std::remove(f.c_str());
+    std::remove(cf.c_str());
+}
+
+
+// CSV import with quoted fields (delimiters and quotes inside), CRLF line
+// ends, blank lines, byte order mark and columns selected by index or name
+void
+test_csv(const std::string &dir)
+{
+    std::string f = dir + "/fcnn_tests.csv";
+    {
+        std::ofstream os(f.c_str(), std::ios::binary);
+        os << "\xEF\xBB\xBF" << "x,\"label, \"\"quoted\"\"\",y,z\r\n"
+           << "1.5,\"a,b\",2,-3\r\n"
+           << "\r\n"
+           << "-.25,\"\"\"\",1e-3,4\r\n"
+           << "2,plain,\"7\",0\r\n";
+    }
+    Matrix<double> in(3, 2), out(3, 1);
+    double x[] = {1.5, -.25, 2.}, y[] = {2., 1e-3, 7.}, z[] = {-3., 4., 0.};
+    for (int i = 0; i < 3; ++i) {
+        in(i + 1, 1) = z[i];
+        in(i + 1, 2) = x[i];
+        out(i + 1, 1) = y[i];
+    }
+    Dataset<double> a, b;
+    check(a.load_csv(f, std::vector<int>{4, 1}, std::vector<int>{3}), "csv: loading by index");
+    check(!max_diff(a.get_input(), in) && !max_diff(a.get_output(), out),
+          "csv: data loaded by index differs");
+    check(b.load_csv(f, std::vector<std::string>{"z", "x"}, std::vector<std::string>{"y"}),
+          "csv: loading by name (byte order mark, quoted names)");
+    check(!max_diff(b.get_input(), in) && !max_diff(b.get_output(), out),
+          "csv: data loaded by name differs");
+    check(!b.load_csv(f, std::vector<std::string>{"label, \"quoted\""},
+                      std::vector<std::string>{"y"}),
+          "csv: text column converted");
+    check(!b.load_csv(f, std::vector<std::string>{"w"}, std::vector<std::string>{"y"}),
+          "csv: unknown column name accepted");
+    std::remove(f.c_str());
+}
+
+
+// Datasets loaded through shared memory equal the parsed one, changes
+// of their matrices are private and the segment is removed with the last
+// dataset attached to it
+void
+test_shared(const std::string &dir)
+{
+    std::string f = dir + "/fcnn_tests_shared.txt";
+    Dataset<double> d = mk_data(1000, true), a;
+    d.fold_duplicates();
+    check(d.save(f), "shared: saving text dataset");
+    check(a.load(f), "shared: loading text dataset");
+    Dataset<double>::remove_shared(f);
+    {
+        Dataset<double> s1, s2;
+        check(s1.load_shared(f) && s2.load_shared(f), "shared: loading shared dataset");
+        check(same_data(a, s1) && same_data(a, s2), "shared: shared dataset differs");
+        Matrix<double> in = s1.get_input();
+        in(1, 1) += 1.;
+        check(same_data(a, s2), "shared: change of attached dataset visible");
+    }
+    check(!Dataset<double>::remove_shared(f), "shared: segment not removed with last dataset");
+    Dataset<double> s3;
+    check(s3.load_shared(f) && same_data(a, s3), "shared: loading dataset again");
+    std::remove(f.c_str());
+}
+
+
+// Sharded dataset: parts loaded by workers (single and several shards)
+// concatenate to the whole dataset, statistics merged from shards equal
+// the ones of the whole dataset, invalid no. of shards or workers throws
+void
+test_shards(const std::string &dir)
+{
+    std::string f = dir + "/fcnn_tests_shards";
+    Dataset<double> d = mk_data(101, false);
+    const int ns = 4;
+    check(d.save_shards(f, ns), "shards: saving shards");
+    ShardManifest man;
+    check(man.load(f), "shards: loading manifest");
+    check((man.no_shards() == ns) && (man.no_records() == d.no_records())
+          && (man.no_inputs() == 2) && (man.no_outputs() == 1), "shards: manifest");
+
+    Matrix<double> io(d.no_records(), 3);
+    for (int i = 1; i <= d.no_records(); ++i) {
+        io(i, 1) = d.get_input()(i, 1);
+        io(i, 2) = d.get_input()(i, 2);
+        io(i, 3) = d.get_output()(i, 1);
+    }
+    Matrix<double> st(3, 4);
+    for (int j = 1; j <= 3; ++j) {
+        double m = 0., v = 0., mn = io(1, j), mx = io(1, j);
+        for (int i = 1; i <= io.rows(); ++i) {
+            m += io(i, j);
+            mn = std::min(mn, io(i, j));
+            mx = std::max(mx, io(i, j));
+        }
+        m /= io.rows();
+        for (int i = 1; i <= io.rows(); ++i) v += (io(i, j) - m) * (io(i, j) - m);
+        st(j, 1) = m;
+        st(j, 2) = v / io.rows();
+        st(j, 3) = mn;
+        st(j, 4) = mx;
+    }
+    check(max_diff(man.stats(), st) < 1e-12, "shards: merged statistics");
+
+    bool ok = true;
+    for (int n = 1; n <= ns; ++n) {
+        int pos = 0;
+        for (int k = 1; k <= n; ++k) {
+            Dataset<double> part;
+            int s0, s1;
+            man.worker_shards(k, n, s0, s1);
+            ok = ok && part.load_shard(f, k, n) && (man.first_record(s0) == pos + 1);
+            std::vector<int> idx;
+            for (int i = 1; i <= part.no_records(); ++i) idx.push_back(pos + i);
+            ok = ok && !idx.empty()
+                 && !max_diff(part.get_input(), d.get_input().get_rows(idx))
+                 && !max_diff(part.get_output(), d.get_output().get_rows(idx))
+                 && (part.get_record_info(1) == d.get_record_info(pos + 1));
+            pos += part.no_records();
+        }
+        ok = ok && (pos == d.no_records());
+    }
+    check(ok, "shards: parts loaded by workers differ");
+
+    bool thrown = false;
+    try { d.save_shards(f, 0); } catch (exception&) { thrown = true; }
+    check(thrown, "shards: no. of shards 0 accepted");
+    thrown = false;
+    Dataset<double> part;
+    try { part.load_shard(f, 1, ns + 1); } catch (exception&) { thrown = true; }
+    check(thrown, "shards: more workers than shards accepted");
+    for (int k = 1; k <= ns; ++k) std::remove(man.shard_file(k).c_str());
+    std::remove(f.c_str());
+}
+
+
+// Compressed dataset: columns get the expected lossless encodings and are
+// restored exactly (whole data, ranges of records, after save and load,
+// through data source); requested quantization keeps values within half
+// a level; dictionary of too many values throws
+void
+test_compress(const std::string &dir)
+{
+    const int r = 5000;
+    Matrix<double> in(r, 5), out(r, 1);
+    double lev[] = {-1.5, .1, .3, 2.75, 1e6}, x = 0.;
+    for (int i = 1; i <= r; ++i) {
+        in(i, 1) = std::rand() % 201 - 100;
+        in(i, 2) = lev[std::rand() % 5];
+        in(i, 3) = std::rand() % 60001;
+        x += 1. + (std::rand() % 3);
+        in(i, 4) = 1e4 + 1e-9 * x;
+        in(i, 5) = std::rand() / (double) RAND_MAX;
+        out(i, 1) = std::rand() / (double) RAND_MAX - .5;
+    }
+    Dataset<double> d, e, g;
+    d.set(in, out, "compressed");
+    CompressedDataset<double> cd, cl;
+    cd.compress(d);
+    col_encoding exp[] = {col_quant8, col_dict, col_quant16, col_delta, col_raw, col_raw};
+    bool ok = true;
+    for (int j = 1; j <= 6; ++j) ok = ok && (cd.encoding(j) == exp[j - 1]);
+    check(ok, "compress: automatic encodings");
+    check(cd.size() < sizeof(double) * 6 * r, "compress: no compression");
+    cd.decompress(e);
+    check(!max_diff(e.get_input(), in) && !max_diff(e.get_output(), out)
+          && (e.get_info() == "compressed"), "compress: decompressed data differs");
+    std::vector<int> idx;
+    for (int i = 4000; i < 4000 + 250; ++i) idx.push_back(i);
+    Matrix<double> bi, bo;
+    cd.decompress(4000, 250, bi, bo);
+    check(!max_diff(bi, in.get_rows(idx)) && !max_diff(bo, out.get_rows(idx)),
+          "compress: decompressed range differs");
+    std::string f = dir + "/fcnn_tests.fcnnz";
+    check(cd.save(f) && cl.load(f), "compress: save and load");
+    cl.decompress(g);
+    check(!max_diff(g.get_input(), in) && !max_diff(g.get_output(), out),
+          "compress: loaded data differs");
+    std::remove(f.c_str());
+
+    MLPNet<double> net = mk_net({5, 3, 1}, 29);
+    CompressedSource<double> src(cd, 128);
+    std::pair<Matrix<double>, double> g1 = net.grad(d), g2 = net.grad(src);
+    check(max_diff(g1.first, g2.first) < 1e-14, "compress: gradient over source differs");
+
+    std::vector<col_encoding> enc(6, col_raw);
+    enc[4] = col_quant8;
+    enc[5] = col_quant16;
+    cd.compress(d, enc);
+    cd.decompress(e);
+    double e8 = 0., e16 = 0.;
+    for (int i = 1; i <= r; ++i) {
+        e8 = std::max(e8, std::fabs(e.get_input()(i, 5) - in(i, 5)));
+        e16 = std::max(e16, std::fabs(e.get_output()(i, 1) - out(i, 1)));
+    }
+    check((e8 <= .5 / 255 + 1e-12) && (e16 <= .5 / 65535 + 1e-12) && (e16 > 0.),
+          "compress: quantization error");
+    check(!max_diff(e.get_input().get_cols({1, 2, 3, 4}), in.get_cols({1, 2, 3, 4})),
+          "compress: raw columns differ");
+    bool thrown = false;
+    try { cd.compress(d, col_dict); } catch (exception&) { thrown = true; }
+    check(thrown, "compress: dictionary of too many values accepted");
+}
+
+
+// Evaluation, MSE, gradient and Rprop teaching given sparse inputs (some
+// rows empty) agree with dense ones; sparse dataset survives save and load
+void
+test_sparse(const std::string &dir)
+{
+    const int r = 200, c = 30;
+    Matrix<double> in(r, c), out(r, 2);
+    for (int i = 1; i <= r; ++i) {
+        for (int j = 1; j <= c; ++j)
+            in(i, j) = ((i % 7) && !(std::rand() % 8)) ? 2. * std::rand() / RAND_MAX - 1. : 0.;
+        out(i, 1) = std::rand() / (double) RAND_MAX - .5;
+        out(i, 2) = std::rand() / (double) RAND_MAX - .5;
+    }
+    Dataset<double> d;
+    d.set(in, out);
+    SparseDataset<double> sd(d), sl;
+    const SparseMatrix<double> &sp = sd.get_input();
+    check(!max_diff(sp.dense(), in), "sparse: dense matrix differs");
+    std::vector<int> rows = {7, 3, 3, 200};
+    check(!max_diff(sp.get_rows(rows).dense(), in.get_rows(rows)), "sparse: selected rows differ");
+
+    MLPNet<double> net = mk_net({c, 6, 2}, 31);
+    check(max_diff(net.eval(sp), net.eval(in)) < 1e-14, "sparse: evaluation differs");
+    check(std::fabs(net.mse(sd) - net.mse(d)) < 1e-14, "sparse: MSE differs");
+    std::pair<Matrix<double>, double> gs = net.grad(sd), gd = net.grad(d);
+    check((max_diff(gs.first, gd.first) < 1e-14) && (std::fabs(gs.second - gd.second) < 1e-14),
+          "sparse: gradient differs");
+    MLPNet<double> a = net, b = net;
+    mlpnet_teach_rprop(a, sd, 1e-12, 10);
+    mlpnet_teach_rprop(b, d, 1e-12, 10);
+    check(max_diff(a.get_weights(), b.get_weights()) < 1e-12, "sparse: Rprop differs");
+
+    std::string f = dir + "/fcnn_tests_sparse.txt";
+    check(sd.save(f) && sl.load(f), "sparse: save and load");
+    check((max_diff(sl.get_input().dense(), in) < 1e-15)
+          && (max_diff(sl.get_output(), out) < 1e-15)
+          && (sl.get_input().nnz() == sp.nnz()), "sparse: loaded dataset differs");
+    std::remove(f.c_str());
+}
+
+
+// Folding duplicate records into weights leaves MSE and gradient unchanged
+void
+test_fold_duplicates(const std::string&)
+{
+    Dataset<double> d = mk_data(400, true), w = d;
+    int n = w.fold_duplicates();
+    check((n == 2 * 134) && w.weighted(), "duplicates not folded");
+    MLPNet<double> net = mk_net(std::vector<int>{ 2, 5, 1 }, 3);
+    std::pair<Matrix<double>, double> g = net.grad(d), gw = net.grad(w);
+    check(std::fabs(net.mse(d) - net.mse(w)) < 1e-14, "MSE changed by folding");
+    check(std::fabs(g.second - gw.second) < 1e-14, "MSE of gradient changed by folding");
+    check(max_diff(g.first, gw.first) < 1e-14, "gradient changed by folding");
+}
+
+
+// Code which does not support record weights rejects weighted data;
+// a split leaving a shard with zero weights only is rejected, weighted
+// shards are loaded with their weights
+void
+test_weights_rejected(const std::string &dir)
+{
+    Dataset<double> d = mk_data(50, false);
+    std::vector<double> w(50, 1.);
+    for (int i = 0; i < 25; ++i) w[i] = 0.;
+    d.set_record_weights(w);
+    std::string fb = dir + "/fcnn_tests_weighted.bin", fs = dir + "/fcnn_tests_wshards";
+    check(d.save_binary(fb), "weights: saving binary dataset");
+    int thrown = 0;
+    try { MatrixSource<double> src(d, 10); } catch (exception&) { ++thrown; }
+    try { BinaryFileSource<double> src(fb, 10); } catch (exception&) { ++thrown; }
+    try { SparseDataset<double> sd(d); } catch (exception&) { ++thrown; }
+    try { CompressedDataset<double> cd; cd.compress(d); } catch (exception&) { ++thrown; }
+    try { d.save_shards(fs, 2); } catch (exception&) { ++thrown; }
+    check(thrown == 5, "weights: weighted data accepted");
+    std::remove(fb.c_str());
+
+    w[20] = 2.;
+    d.set_record_weights(w);
+    check(d.save_shards(fs, 2), "weights: saving weighted shards");
+    Dataset<double> a, b;
+    check(a.load_shard(fs, 1, 2) && b.load_shard(fs, 2, 2), "weights: loading weighted shards");
+    std::vector<double> w1(w.begin(), w.begin() + 25), w2(w.begin() + 25, w.end());
+    check((a.get_record_weights() == w1) && (b.get_record_weights() == w2),
+          "weights: weights of shards differ");
+    std::remove((fs + ".1").c_str());
+    std::remove((fs + ".2").c_str());
+    std::remove(fs.c_str());
+}
+
+
+// Gradient over views with row weights equals the one over weighted
+// dataset; SGD on weighted records ignores records of zero weight
+void
+test_weighted_sgd(const std::string&)
+{
+    Dataset<double> d = mk_data(600, false);
+    std::vector<double> w(600);
+    Matrix<double> out = d.get_output().copy();
+    for (int i = 0; i < 600; ++i) {
+        w[i] = (i % 4) ? .5 + std::rand() / (double) RAND_MAX : 0.;
+        if (!w[i]) out(i + 1, 1) = 10.;
+    }
+    d.set(d.get_input(), out);
+    d.set_record_weights(w);
+    MLPNet<double> net = mk_net({2, 6, 1}, 37);
+    std::pair<Matrix<double>, double> gv = net.grad(MatrixView<double>(d.get_input()),
+                                                    MatrixView<double>(out), w),
+                                      gd = net.grad(d);
+    check((max_diff(gv.first, gd.first) < 1e-14) && (std::fabs(gv.second - gd.second) < 1e-14),
+          "weighted SGD: gradient over weighted views differs");
+    std::pair<double, int> res = mlpnet_teach_sgd(net, d, 1e-3, 4000, .05, 0, 0., 20);
+    check((std::fabs(res.first - net.mse(d)) < 1e-14) && (res.first < 1e-2),
+          "weighted SGD: records of zero weight used");
+    bool thrown = false;
+    try { mlpnet_teach_sgd(net, d, 1e-3, 10, .05, 0, 0., 450); } catch (exception&) { thrown = true; }
+    check(thrown, "weighted SGD: minibatch larger than no. of records of positive weight");
+}
+
+
+// Run test, exceptions count as failures
+void
+run(const char *name, void (*test)(const std::string&), const std::string &dir)
+{
+    try {
+        test(dir);
+    } catch (exception &e) {
+        ++no_failed;
+        std::printf("FAILED: %s: %s\n", name, e.what());
+    }
+}
+
+
+} /* namespace */
+
+
+
+int
+main(int argc, char **argv)
+{
+    std::string dir = (argc > 1) ? argv[1] : "/tmp";
+    std::srand(12345);
+    run("mse_below", test_mse_below, dir);
+    run("pruning tolerance", test_prune_tol, dir);
+    run("Rprop warm start", test_rprop_warm_start, dir);
+    run("hashed gradient", test_hashed_grad, dir);
+    run("hashed save/load", test_hashed_save_load, dir);
+    run("low-rank factorisation", test_lowrank_pruned, dir);
+    run("low-rank tolerance", test_lowrank_tol, dir);
+    run("distillation", test_distill, dir);
+    run("snapshots", test_snapshots, dir);
+    run("matrix pool", test_pool, dir);
+    run("matrix views", test_views, dir);
+    run("data sources", test_sources, dir);
+    run("dataset loaders", test_loaders, dir);
+    run("binary cache", test_cache, dir);
+    run("CSV import", test_csv, dir);
+    run("shared memory", test_shared, dir);
+    run("shards", test_shards, dir);
+    run("compressed data", test_compress, dir);
+    run("sparse inputs", test_sparse, dir);
+    run("folding duplicates", test_fold_duplicates, dir);
+    run("record weights rejected", test_weights_rejected, dir);
+    run("weighted SGD", test_weighted_sgd, dir);
+    std::printf("%d checks, %d failed\n", no_checks, no_failed);
+    return no_failed ? 1 : 0;
+}
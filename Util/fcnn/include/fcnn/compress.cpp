@@ -0,0 +1,646 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file compress.cpp
+ *  \brief Compressed (columnar, quantized) datasets.
+ */
+
+
+#include <fcnn/compress.h>
+#include <fcnn/utils.h>
+#include <fcnn/error.h>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#if defined(HAVE_OPENMP)
+#include <omp.h>
+#endif /* defined(HAVE_OPENMP) */
+
+
+using namespace fcnn;
+using namespace fcnn::internal;
+
+
+
+namespace {
+
+
+// Compressed dataset format version
+const std::uint32_t comp_version = 1;
+// Byte order marker
+const std::uint32_t comp_endian = 0x01020304;
+const char comp_magic[8] = { 'F', 'C', 'N', 'N', 'C', 'O', 'M', 'P' };
+
+// No. of records in chunk of delta encoded column
+const int delta_chunk = 4096;
+// Min. no. of decoded values for decoding columns in parallel
+const idx_t par_min = 65536;
+
+
+// Header of compressed dataset file
+struct comp_hdr {
+    char magic[8];
+    std::uint32_t version, elem, endian, pad;
+    std::int64_t rows;
+    std::int32_t inputs, outputs;
+};
+
+
+// Header of encoded column (followed by dictionary, chunk offsets and data)
+struct col_hdr {
+    std::uint32_t enc, dict_len, chunks_len, pad;
+    double offset, scale;
+    std::uint64_t data_len;
+};
+
+
+// Bit patterns of floating point numbers
+template <typename T> struct bits_t;
+template <> struct bits_t<float> { typedef std::uint32_t type; };
+template <> struct bits_t<double> { typedef std::uint64_t type; };
+
+
+template <typename T>
+inline
+typename bits_t<T>::type
+to_bits(T x)
+{
+    typename bits_t<T>::type u;
+    memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+
+template <typename T>
+inline
+T
+from_bits(typename bits_t<T>::type u)
+{
+    T x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+
+// Are all values integers spanning at most m?
+template <typename T>
+bool
+int_range(const T *x, int n, T mn, T mx, double m)
+{
+    if (!((double) mx - (double) mn <= m)) return false;
+    for (int i = 0; i < n; ++i) {
+        if (x[i] != std::floor(x[i])) return false;
+    }
+    return true;
+}
+
+
+// Quantize values onto levels of Q, x = offset + scale * q
+template <typename T, typename Q>
+void
+quantize(const T *x, int n, T mn, T mx, T &offset, T &scale,
+         std::vector<unsigned char> &data)
+{
+    const double levels = std::numeric_limits<Q>::max();
+    offset = mn;
+    if (int_range(x, n, mn, mx, levels)) scale = 1;
+    else scale = (mx > mn) ? (T) (((double) mx - (double) mn) / levels) : T();
+    data.resize(sizeof(Q) * n);
+    Q *q = (Q*) &data[0];
+    for (int i = 0; i < n; ++i) {
+        double v = scale ? std::floor((x[i] - offset) / scale + .5) : 0.;
+        if (!(v >= 0)) v = 0;
+        if (v > levels) v = levels;
+        q[i] = (Q) v;
+    }
+}
+
+
+// Dictionary encoding, returns false if there are more than 256 distinct values
+template <typename T>
+bool
+dict_encode(const T *x, int n, std::vector<T> &dict, std::vector<unsigned char> &data)
+{
+    typedef typename bits_t<T>::type U;
+    std::unordered_map<U, unsigned char> codes;
+    dict.clear();
+    data.resize(n);
+    for (int i = 0; i < n; ++i) {
+        U u = to_bits(x[i]);
+        typename std::unordered_map<U, unsigned char>::const_iterator it = codes.find(u);
+        if (it == codes.end()) {
+            if (dict.size() == 256) {
+                dict.clear();
+                data.clear();
+                return false;
+            }
+            it = codes.insert(std::make_pair(u, (unsigned char) dict.size())).first;
+            dict.push_back(x[i]);
+        }
+        data[i] = it->second;
+    }
+    return true;
+}
+
+
+// Delta encoding: differences of bit patterns of consecutive values
+// (zigzag, 7 bits per byte), starting from zero in every chunk
+template <typename T>
+void
+delta_encode(const T *x, int n, std::vector<std::uint32_t> &chunks,
+             std::vector<unsigned char> &data)
+{
+    typedef typename bits_t<T>::type U;
+    const int w = 8 * sizeof(U);
+    chunks.clear();
+    data.clear();
+    data.reserve(sizeof(T) * n / 2);
+    U prev = 0;
+    for (int i = 0; i < n; ++i) {
+        if (!(i % delta_chunk)) {
+            chunks.push_back((std::uint32_t) data.size());
+            prev = 0;
+        }
+        U u = to_bits(x[i]), d = u - prev;
+        U z = (d << 1) ^ (U) (0 - (d >> (w - 1)));
+        prev = u;
+        while (z >= 0x80) {
+            data.push_back((unsigned char) (z | 0x80));
+            z >>= 7;
+        }
+        data.push_back((unsigned char) z);
+    }
+}
+
+
+// Decode n values of delta encoded column starting at 0-based record i
+template <typename T>
+void
+delta_decode(const unsigned char *data, const std::uint32_t *chunks,
+             int i, int n, T *x)
+{
+    typedef typename bits_t<T>::type U;
+    int row = i / delta_chunk * delta_chunk, end = i + n;
+    const unsigned char *p = data + chunks[i / delta_chunk];
+    U prev = 0;
+    for (; row < end; ++row) {
+        if (!(row % delta_chunk)) prev = 0;
+        U z = 0;
+        int s = 0;
+        unsigned char b;
+        do {
+            b = *p++;
+            z |= (U) (b & 0x7f) << s;
+            s += 7;
+        } while (b & 0x80);
+        prev += (z >> 1) ^ (U) (0 - (z & 1));
+        if (row >= i) x[row - i] = from_bits<T>(prev);
+    }
+}
+
+
+// Decode quantized values
+template <typename T, typename Q>
+void
+dequantize(const Q *q, int n, T offset, T scale, T *x)
+{
+    for (int i = 0; i < n; ++i) x[i] = offset + scale * (T) q[i];
+}
+
+
+// Decode dictionary codes
+template <typename T>
+void
+dict_decode(const unsigned char *q, int n, const T *dict, T *x)
+{
+    for (int i = 0; i < n; ++i) x[i] = dict[q[i]];
+}
+
+
+// Reuse memory of matrix if the size agrees and it is not shared
+template <typename T>
+void
+prepare(Matrix<T> &m, int r, int c)
+{
+    if ((m.rows() == r) && (m.cols() == c)) m.mkunique();
+    else m.reset(r, c);
+}
+
+
+bool
+write_str(std::ofstream &os, const std::string &str)
+{
+    std::uint32_t n = (std::uint32_t) str.size();
+    os.write((const char*) &n, sizeof(n));
+    os.write(str.data(), n);
+    return !os.fail();
+}
+
+
+bool
+read_str(std::ifstream &is, std::string &str)
+{
+    std::uint32_t n;
+    if (!is.read((char*) &n, sizeof(n))) return false;
+    str.resize(n);
+    if (n && !is.read(&str[0], n)) return false;
+    return true;
+}
+
+
+} /* namespace */
+
+
+
+template <typename T>
+void
+CompressedDataset<T>::compress(const Dataset<T> &dat, col_encoding enc)
+{
+    compress(dat, std::vector<col_encoding>(dat.no_inputs() + dat.no_outputs(), enc));
+}
+
+
+template <typename T>
+void
+CompressedDataset<T>::compress(const Dataset<T> &dat, const std::vector<col_encoding> &enc)
+{
+    int r = dat.no_records(), ci = dat.no_inputs(), co = dat.no_outputs();
+    if (!r) error("empty dataset");
+    if (dat.weighted()) error("compressed datasets do not support record weights");
+    if ((int) enc.size() != ci + co) {
+        message mes;
+        mes << "no. of encodings (" << (int) enc.size()
+            << ") and columns (" << ci + co << ") disagree";
+        error(mes);
+    }
+    std::vector<column> cols(ci + co);
+    for (int j = 0; j < ci + co; ++j) {
+        const T *x = (j < ci) ? dat.get_input().ptr() + (idx_t) j * r
+                              : dat.get_output().ptr() + (idx_t) (j - ci) * r;
+        encode(x, r, enc[j], cols[j]);
+    }
+    m_cols.swap(cols);
+    m_rows = r;
+    m_in = ci;
+    m_out = co;
+    m_info = dat.get_info();
+    m_rec_info.resize(r);
+    for (int i = 0; i < r; ++i) m_rec_info[i] = dat.get_record_info(i + 1);
+}
+
+
+
+template <typename T>
+void
+CompressedDataset<T>::encode(const T *x, int n, col_encoding enc, column &c)
+{
+    T mn = x[0], mx = x[0];
+    for (int i = 1; i < n; ++i) {
+        if (x[i] < mn) mn = x[i];
+        if (x[i] > mx) mx = x[i];
+    }
+    c.offset = T();
+    c.scale = T();
+    c.dict.clear();
+    c.chunks.clear();
+    c.data.clear();
+
+    if (enc == col_auto) {
+        if (int_range(x, n, mn, mx, 255.)) {
+            enc = col_quant8;
+        } else if (dict_encode(x, n, c.dict, c.data)) {
+            c.enc = col_dict;
+            return;
+        } else if (int_range(x, n, mn, mx, 65535.)) {
+            enc = col_quant16;
+        } else {
+            delta_encode(x, n, c.chunks, c.data);
+            if (c.data.size() <= sizeof(T) * n / 4 * 3) {
+                c.enc = col_delta;
+                return;
+            }
+            c.chunks.clear();
+            c.data.clear();
+            enc = col_raw;
+        }
+    }
+
+    c.enc = enc;
+    switch (enc) {
+        case col_raw:
+            c.data.resize(sizeof(T) * n);
+            memcpy(&c.data[0], x, sizeof(T) * n);
+            break;
+        case col_quant8:
+            quantize<T, std::uint8_t>(x, n, mn, mx, c.offset, c.scale, c.data);
+            break;
+        case col_quant16:
+            quantize<T, std::uint16_t>(x, n, mn, mx, c.offset, c.scale, c.data);
+            break;
+        case col_dict:
+            if (!dict_encode(x, n, c.dict, c.data))
+                error("dictionary encoding of column with more than 256 distinct values");
+            break;
+        case col_delta:
+            delta_encode(x, n, c.chunks, c.data);
+            break;
+        default:
+            error("invalid column encoding");
+    }
+}
+
+
+
+template <typename T>
+void
+CompressedDataset<T>::decode(const column &c, int i, int n, T *x) const
+{
+    const unsigned char *d = &c.data[0];
+    switch (c.enc) {
+        case col_raw:
+            memcpy(x, d + sizeof(T) * i, sizeof(T) * n);
+            break;
+        case col_quant8:
+            dequantize(d + i, n, c.offset, c.scale, x);
+            break;
+        case col_quant16:
+            dequantize((const std::uint16_t*) d + i, n, c.offset, c.scale, x);
+            break;
+        case col_dict:
+            dict_decode(d + i, n, &c.dict[0], x);
+            break;
+        case col_delta:
+            delta_decode(d, &c.chunks[0], i, n, x);
+            break;
+        default:
+            ;
+    }
+}
+
+
+
+template <typename T>
+void
+CompressedDataset<T>::decompress(int i, int n, Matrix<T> &in, Matrix<T> &out) const
+{
+    if ((i < 1) || (n < 1) || (n > m_rows - i + 1)) {
+        message mes;
+        mes << "invalid range of records: " << i << ", " << n;
+        error(mes);
+    }
+    prepare(in, n, m_in);
+    prepare(out, n, m_out);
+    T *pi = in.ptr(), *po = out.ptr();
+    int nc = m_in + m_out;
+#if defined(HAVE_OPENMP)
+    #pragma omp parallel for schedule(dynamic) if ((idx_t) n * nc >= par_min)
+#endif /* defined(HAVE_OPENMP) */
+    for (int j = 0; j < nc; ++j) {
+        T *x = (j < m_in) ? pi + (idx_t) j * n : po + (idx_t) (j - m_in) * n;
+        decode(m_cols[j], i - 1, n, x);
+    }
+}
+
+
+template <typename T>
+void
+CompressedDataset<T>::decompress(Dataset<T> &dat) const
+{
+    if (!m_rows) error("empty dataset");
+    Matrix<T> in, out;
+    decompress(1, m_rows, in, out);
+    dat.set(in, out, m_info, m_rec_info);
+}
+
+
+
+template <typename T>
+col_encoding
+CompressedDataset<T>::encoding(int j) const
+{
+    if ((j < 1) || (j > (int) m_cols.size())) {
+        message mes;
+        mes << "invalid column index: " << j;
+        error(mes);
+    }
+    return m_cols[j - 1].enc;
+}
+
+
+template <typename T>
+std::size_t
+CompressedDataset<T>::size() const
+{
+    std::size_t s = 0;
+    for (std::size_t j = 0; j < m_cols.size(); ++j) {
+        const column &c = m_cols[j];
+        s += c.data.size() + sizeof(T) * c.dict.size()
+             + sizeof(std::uint32_t) * c.chunks.size();
+    }
+    return s;
+}
+
+
+
+template <typename T>
+bool
+CompressedDataset<T>::save(const std::string &fname) const
+{
+    std::ofstream os;
+    os.open(fname.c_str(), std::ios::binary);
+    if (os.fail()) return false;
+
+    comp_hdr h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, comp_magic, sizeof(comp_magic));
+    h.version = comp_version;
+    h.elem = sizeof(T);
+    h.endian = comp_endian;
+    h.rows = m_rows;
+    h.inputs = m_in;
+    h.outputs = m_out;
+    os.write((const char*) &h, sizeof(h));
+
+    for (std::size_t j = 0; j < m_cols.size(); ++j) {
+        const column &c = m_cols[j];
+        col_hdr ch;
+        memset(&ch, 0, sizeof(ch));
+        ch.enc = c.enc;
+        ch.dict_len = c.dict.size();
+        ch.chunks_len = c.chunks.size();
+        ch.offset = c.offset;
+        ch.scale = c.scale;
+        ch.data_len = c.data.size();
+        os.write((const char*) &ch, sizeof(ch));
+        if (!c.dict.empty())
+            os.write((const char*) &c.dict[0], sizeof(T) * c.dict.size());
+        if (!c.chunks.empty())
+            os.write((const char*) &c.chunks[0], sizeof(std::uint32_t) * c.chunks.size());
+        os.write((const char*) &c.data[0], c.data.size());
+        if (os.fail()) return false;
+    }
+
+    if (!write_str(os, m_info)) return false;
+    for (int i = 0; i < m_rows; ++i) {
+        if (!write_str(os, m_rec_info[i])) return false;
+    }
+    os.close();
+    if (os.fail()) return false;
+    return true;
+}
+
+
+
+template <typename T>
+bool
+CompressedDataset<T>::valid(const column &c) const
+{
+    std::size_t n = m_rows;
+    switch (c.enc) {
+        case col_raw:
+            return c.data.size() == sizeof(T) * n;
+        case col_quant8:
+            return c.data.size() == n;
+        case col_quant16:
+            return c.data.size() == 2 * n;
+        case col_dict:
+            if ((c.data.size() != n) || c.dict.empty() || (c.dict.size() > 256))
+                return false;
+            return (std::size_t) *std::max_element(c.data.begin(), c.data.end())
+                   < c.dict.size();
+        case col_delta: {
+            // walk through all values (chunks are contiguous)
+            if (c.chunks.size() != (n + delta_chunk - 1) / delta_chunk) return false;
+            const int w = 8 * sizeof(T);
+            std::size_t p = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                if (!(i % delta_chunk) && (c.chunks[i / delta_chunk] != p)) return false;
+                int s = 0;
+                do {
+                    if ((p == c.data.size()) || (s >= w)) return false;
+                    s += 7;
+                } while (c.data[p++] & 0x80);
+            }
+            return p == c.data.size();
+        }
+        default:
+            return false;
+    }
+}
+
+
+template <typename T>
+bool
+CompressedDataset<T>::load(const std::string &fname)
+{
+    m_rows = m_in = m_out = 0;
+    m_cols.clear();
+    m_info.clear();
+    m_rec_info.clear();
+
+    std::ifstream is;
+    is.open(fname.c_str(), std::ios::binary);
+    if (is.fail()) return false;
+    is.seekg(0, std::ios::end);
+    std::int64_t len = (std::int64_t) is.tellg();
+    is.seekg(0);
+
+    comp_hdr h;
+    if (!is.read((char*) &h, sizeof(h))) return false;
+    if (memcmp(h.magic, comp_magic, sizeof(comp_magic)) || (h.version != comp_version)
+        || (h.elem != sizeof(T)) || (h.endian != comp_endian)) return false;
+    if ((h.rows < 1) || (h.rows > 0x7fffffff) || (h.inputs < 1) || (h.outputs < 1))
+        return false;
+    int r = (int) h.rows, nc = h.inputs + h.outputs;
+    std::vector<column> cols(nc);
+    for (int j = 0; j < nc; ++j) {
+        column &c = cols[j];
+        col_hdr ch;
+        if (!is.read((char*) &ch, sizeof(ch))) return false;
+        if ((ch.dict_len > 256) || (ch.chunks_len > (std::uint32_t) r)
+            || (ch.data_len > (std::uint64_t) len)) return false;
+        c.enc = (col_encoding) ch.enc;
+        c.offset = (T) ch.offset;
+        c.scale = (T) ch.scale;
+        c.dict.resize(ch.dict_len);
+        c.chunks.resize(ch.chunks_len);
+        c.data.resize(ch.data_len);
+        if (!c.dict.empty() && !is.read((char*) &c.dict[0], sizeof(T) * c.dict.size()))
+            return false;
+        if (!c.chunks.empty()
+            && !is.read((char*) &c.chunks[0], sizeof(std::uint32_t) * c.chunks.size()))
+            return false;
+        if (!is.read((char*) &c.data[0], c.data.size())) return false;
+    }
+    m_rows = r;
+    std::vector<std::string> ri(r);
+    std::string info;
+    for (int j = 0; j < nc; ++j) {
+        if (!valid(cols[j])) goto err;
+    }
+    if (!read_str(is, info)) goto err;
+    for (int i = 0; i < r; ++i) {
+        if (!read_str(is, ri[i])) goto err;
+    }
+
+    m_in = h.inputs;
+    m_out = h.outputs;
+    m_cols.swap(cols);
+    m_info.swap(info);
+    m_rec_info.swap(ri);
+    return true;
+
+err:
+    m_rows = 0;
+    return false;
+}
+
+
+
+template <typename T>
+CompressedSource<T>::CompressedSource(const CompressedDataset<T> &dat, int block_size)
+    : m_dat(dat), m_bs(block_size), m_pos(0)
+{
+    if (block_size < 1) error("block size should be positive");
+}
+
+
+template <typename T>
+bool
+CompressedSource<T>::next(Matrix<T> &in, Matrix<T> &out)
+{
+    if (m_pos >= m_dat.no_records()) return false;
+    int n = std::min(m_bs, m_dat.no_records() - m_pos);
+    m_dat.decompress(m_pos + 1, n, in, out);
+    m_pos += n;
+    return true;
+}
+
+
+
+// Instantiations
+template class fcnn::CompressedDataset<double>;
+template class fcnn::CompressedDataset<float>;
+template class fcnn::CompressedSource<double>;
+template class fcnn::CompressedSource<float>;
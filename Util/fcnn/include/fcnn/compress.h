@@ -0,0 +1,171 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file compress.h
+ *  \brief Compressed (columnar, quantized) datasets.
+ */
+
+
+#ifndef FCNN_COMPRESS_H
+
+#define FCNN_COMPRESS_H
+
+
+#include <fcnn/mat.h>
+#include <fcnn/dataset.h>
+#include <fcnn/datasource.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace fcnn {
+
+
+/// Encodings of columns of compressed dataset.
+enum col_encoding {
+
+    col_auto = 0, ///< Chosen automatically (lossless, see CompressedDataset::compress).
+    col_raw, ///< Uncompressed.
+    col_quant8, ///< 8-bit quantization \f$ x = a + s q \f$ (lossy unless values fit).
+    col_quant16, ///< 16-bit quantization \f$ x = a + s q \f$ (lossy unless values fit).
+    col_dict, ///< Dictionary of at most 256 distinct values, 8-bit codes.
+    col_delta ///< Lossless delta encoding of consecutive values (variable length).
+
+}; /* enum col_encoding */
+
+
+/// Dataset stored column by column, each column encoded separately
+/// (see col_encoding). Records are decompressed in blocks (see
+/// CompressedSource), so that teaching needs memory for the compressed
+/// data and two blocks only.
+template <typename T>
+class CompressedDataset
+{
+  public:
+    /// Default constructor
+    CompressedDataset() : m_rows(0), m_in(0), m_out(0) { ; }
+
+    /// Compress dataset with all columns encoded as given. With col_auto each
+    /// column gets the first of the following lossless encodings which
+    /// applies: 8-bit quantization (integers spanning at most 255),
+    /// dictionary (at most 256 distinct values), 16-bit quantization
+    /// (integers spanning at most 65535), delta encoding (if it saves at least
+    /// a quarter of the raw size), raw. Requested quantization maps the range
+    /// of a column onto 256 or 65536 levels unless its values are integers
+    /// which fit. Throws if dictionary encoding is requested for a column
+    /// with more than 256 distinct values or if records are weighted.
+    void compress(const Dataset<T> &dat, col_encoding enc = col_auto);
+    /// Compress dataset with encodings given for each column (inputs
+    /// followed by outputs).
+    void compress(const Dataset<T> &dat, const std::vector<col_encoding> &enc);
+
+    /// Decompress n records starting at record i (1-based) into in and out
+    /// (their memory is reused if possible). Throws on invalid range.
+    void decompress(int i, int n, Matrix<T> &in, Matrix<T> &out) const;
+    /// Decompress whole dataset.
+    void decompress(Dataset<T> &dat) const;
+
+    /// Save compressed data to file, returns true on success.
+    bool save(const std::string &fname) const;
+    /// Load compressed data from file saved with the same floating point
+    /// type, returns true on success.
+    bool load(const std::string &fname);
+
+    /// Get no. of records.
+    inline int no_records() const { return m_rows; }
+    /// Get no. of inputs.
+    inline int no_inputs() const { return m_in; }
+    /// Get no. of outputs.
+    inline int no_outputs() const { return m_out; }
+    /// Get encoding of column j (inputs followed by outputs).
+    col_encoding encoding(int j) const;
+    /// Get size of compressed data in bytes.
+    std::size_t size() const;
+
+    /// Retrieve data information.
+    inline std::string get_info() const { return m_info; }
+
+  private:
+    /// Encoded column.
+    struct column {
+        /// Encoding.
+        col_encoding enc;
+        /// Offset and scale (quantization).
+        T offset, scale;
+        /// Dictionary.
+        std::vector<T> dict;
+        /// Offsets of chunks of records (delta encoding).
+        std::vector<std::uint32_t> chunks;
+        /// Encoded values.
+        std::vector<unsigned char> data;
+    };
+
+    /// No. of records, inputs and outputs.
+    int m_rows, m_in, m_out;
+    /// Columns (inputs followed by outputs).
+    std::vector<column> m_cols;
+    /// Dataset description.
+    std::string m_info;
+    /// Record descriptions.
+    std::vector<std::string> m_rec_info;
+
+    /// Encode column.
+    static void encode(const T *x, int n, col_encoding enc, column &c);
+    /// Decode n values starting at 0-based record i.
+    void decode(const column &c, int i, int n, T *x) const;
+    /// Check encoded column read from file.
+    bool valid(const column &c) const;
+
+}; /* class template CompressedDataset */
+
+
+/// Data source decompressing blocks of records from compressed dataset
+/// (which must outlive the source).
+template <typename T>
+class CompressedSource : public DataSource<T>
+{
+  public:
+    /// Constructor (block size is given as no. of records).
+    CompressedSource(const CompressedDataset<T> &dat, int block_size);
+
+    int no_records() const { return m_dat.no_records(); }
+    int no_inputs() const { return m_dat.no_inputs(); }
+    int no_outputs() const { return m_dat.no_outputs(); }
+
+    void rewind() { m_pos = 0; }
+    bool next(Matrix<T> &in, Matrix<T> &out);
+
+  private:
+    /// Data.
+    const CompressedDataset<T> &m_dat;
+    /// Block size.
+    int m_bs;
+    /// First record of the next block (0-based).
+    int m_pos;
+
+}; /* class template CompressedSource */
+
+
+} /* namespace fcnn */
+
+
+#endif /* FCNN_COMPRESS_H */
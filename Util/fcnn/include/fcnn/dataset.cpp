@@ -26,13 +26,668 @@
 #include <fcnn/dataset.h>
 #include <fcnn/utils.h>
 #include <fcnn/error.h>
+#include <fcnn/pool.h>
+#include <fcnn/textio.h>
+#include <fcnn/shmem.h>
+#include <fcnn/shard.h>
 #include <iomanip>
+#include <cstring>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <cstddef>
+#include <cmath>
+#include <unordered_map>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+#if defined(HAVE_OPENMP)
+#include <omp.h>
+#endif /* defined(HAVE_OPENMP) */
 
 
 using namespace fcnn;
 using namespace fcnn::internal;
 
 
+
+namespace {
+
+
+// Binary dataset format version (version 1 files without record
+// weights are read as well)
+const std::uint32_t bin_version = 2;
+// Size of header of version 1 files
+const std::size_t bin_hdr_v1 = offsetof(bin_hdr, wgt_off);
+// Layout of matrices: column major
+const std::uint32_t bin_col_major = 0;
+// Byte order marker
+const std::uint32_t bin_endian = 0x01020304;
+
+
+const char bin_magic[8] = { 'F', 'C', 'N', 'N', 'D', 'A', 'T', 'A' };
+
+
+inline
+std::int64_t
+bin_align(std::int64_t off)
+{
+    std::int64_t a = (std::int64_t) mem_map_align;
+    return (off + a - 1) / a * a;
+}
+
+
+bool
+write_pad(std::ofstream &os, std::int64_t off)
+{
+    static const char zeros[256] = { 0 };
+    std::int64_t n = off - (std::int64_t) os.tellp();
+    while (n > 0) {
+        std::int64_t m = (n < 256) ? n : 256;
+        os.write(zeros, (std::streamsize) m);
+        n -= m;
+    }
+    return !os.fail();
+}
+
+
+bool
+write_str(std::ofstream &os, const std::string &str)
+{
+    std::uint32_t n = (std::uint32_t) str.size();
+    os.write((const char*) &n, sizeof(n));
+    os.write(str.data(), n);
+    return !os.fail();
+}
+
+
+bool
+read_str(std::ifstream &is, std::string &str)
+{
+    std::uint32_t n;
+    if (!is.read((char*) &n, sizeof(n))) return false;
+    str.resize(n);
+    if (n && !is.read(&str[0], n)) return false;
+    return true;
+}
+
+
+bool
+read_str(const char *&p, const char *e, std::string &str)
+{
+    std::uint32_t n;
+    if (e - p < (std::ptrdiff_t) sizeof(n)) return false;
+    memcpy(&n, p, sizeof(n));
+    p += sizeof(n);
+    if (e - p < (std::ptrdiff_t) n) return false;
+    str.assign(p, n);
+    p += n;
+    return true;
+}
+
+
+// Set matrix (shared)
+template <typename T>
+void
+set_matrix(Matrix<T> &m, const Matrix<T> &ms)
+{
+    m = ms;
+}
+
+
+// Set matrix (converted)
+template <typename T, typename S>
+void
+set_matrix(Matrix<T> &m, const Matrix<S> &ms)
+{
+    m.reset(ms.rows(), ms.cols());
+    for (idx_t i = 1; i <= ms.size(); ++i) m.elem(i) = (T) ms.elem(i);
+}
+
+
+// Map matrix stored in file as S, converting to T if necessary
+template <typename T, typename S>
+bool
+map_matrix(const std::string &fname, std::int64_t off, int r, int c,
+           Matrix<T> &m)
+{
+    idx_t n = (idx_t) r * c;
+    S *p = (S*) mem_map_file(fname.c_str(), off, sizeof(S) * n);
+    if (!p) return false;
+    rcarr<S> data;
+    data.adopt(p, n);
+    set_matrix(m, Matrix<S>(r, c, std::move(data)));
+    return true;
+}
+
+
+// Map matrix stored at given offset in shared memory segment
+template <typename T>
+bool
+map_shared(int fd, std::int64_t off, int r, int c, Matrix<T> &m)
+{
+    idx_t n = (idx_t) r * c;
+    T *p = (T*) mem_map_fd(fd, off, sizeof(T) * n);
+    if (!p) return false;
+    rcarr<T> data;
+    data.adopt(p, n);
+    m = Matrix<T>(r, c, std::move(data));
+    return true;
+}
+
+
+
+
+
+// Parse line [p, e) holding n numbers separated by blanks into x[0], x[ld], ...
+template <typename T>
+bool
+parse_line(const char *p, const char *e, int n, T *x, idx_t ld)
+{
+    if ((e > p) && (e[-1] == '\r')) --e;
+    for (int j = 0; j < n; ++j) {
+        p = skip_sp(p, e);
+        if (p == e) return false;
+        p = scan_num(p, e, x[j * ld]);
+        if (!p) return false;
+        if ((p < e) && (*p != ' ') && (*p != '\t')) return false;
+    }
+    return skip_sp(p, e) == e;
+}
+
+
+// Is line [p, e) blank or comment (allowed after the last record)?
+inline
+bool
+is_trailing(const char *p, const char *e)
+{
+    while ((p < e) && ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\0'))) ++p;
+    return (p == e) || (*p == '#');
+}
+
+
+// Append comment line [p, e) to record description (first line without
+// '#' and leading blanks, following lines verbatim, see read_comment)
+inline
+void
+add_comment(std::string &s, bool first, const char *p, const char *e)
+{
+    if ((e > p) && (e[-1] == '\r')) --e;
+    if (first) {
+        p = skip_sp(p + 1, e);
+        s.assign(p, e);
+    } else {
+        s += '\n';
+        s.append(p, e);
+    }
+}
+
+
+// Count data lines in chunk
+inline
+int
+count_lines(const char *p, const char *e)
+{
+    int n = 0;
+    while (p < e) {
+        if (*p != '#') ++n;
+        p = line_end(p, e) + 1;
+    }
+    return n;
+}
+
+
+// Parse chunk. Data line d is input, output or weight (if wgt is given)
+// of record d / n, where n is the no. of lines per record; comment lines
+// before input line describe record.
+template <typename T>
+bool
+parse_chunk(const text_chunk &ch, int r, int ci, int co, T *in, T *out, T *wgt,
+            std::string *info, const char *eof)
+{
+    int d = ch.first, n = wgt ? 3 : 2;
+    const char *p = ch.b, *cb = 0, *ce = 0;
+    while (p < ch.e) {
+        const char *q = line_end(p, ch.e);
+        if (*p == '#') {
+            if (!cb) cb = p;
+            ce = q;
+        } else if (d >= n * r) {
+            if (!is_trailing(p, q)) return false;
+            cb = 0;
+            ++d;
+        } else {
+            int i = d / n, l = d % n;
+            if (l) {
+                if (cb) return false;
+                // comment may follow the values of the last record
+                const char *le = q;
+                bool last = (i == r - 1) && (l == n - 1);
+                if (last) {
+                    const char *h = (const char*) memchr(p, '#', q - p);
+                    if (h && (h > p) && (h[-1] != ' ') && (h[-1] != '\t')) return false;
+                    if (h) le = h;
+                }
+                if (l == 1) {
+                    if (!parse_line(p, le, co, out + i, r)) return false;
+                } else {
+                    if (!parse_line(p, le, 1, wgt + i, 1)) return false;
+                }
+                if (!last && (q == eof)) return false;
+            } else {
+                if (cb && info) {
+                    std::string &s = info[i];
+                    bool first = true;
+                    for (const char *c = cb; c < ce; c = line_end(c, ce) + 1) {
+                        add_comment(s, first, c, line_end(c, ce));
+                        first = false;
+                    }
+                }
+                cb = 0;
+                if (!parse_line(p, q, ci, in + i, r)) return false;
+                if (q == eof) return false;
+            }
+            ++d;
+        }
+        p = q + 1;
+    }
+    return true;
+}
+
+
+// Skip blanks other than delimiter
+inline
+const char*
+skip_csv_sp(const char *p, const char *e, char delim)
+{
+    while ((p < e) && (((*p == ' ') || (*p == '\t')) && (*p != delim))) ++p;
+    return p;
+}
+
+
+// Scan field of delimited line starting at p; [fb, fe) is set to the field
+// without quotes and surrounding blanks. Returns pointer to the following
+// delimiter or line end, 0 if quotes are not closed.
+inline
+const char*
+csv_field(const char *p, const char *e, char delim, const char *&fb, const char *&fe)
+{
+    p = skip_csv_sp(p, e, delim);
+    if ((p < e) && (*p == '"')) {
+        fb = ++p;
+        for (;;) {
+            p = (const char*) memchr(p, '"', e - p);
+            if (!p) return 0;
+            if ((p + 1 < e) && (p[1] == '"')) { p += 2; continue; }
+            break;
+        }
+        fe = p;
+        p = skip_csv_sp(p + 1, e, delim);
+        if ((p < e) && (*p != delim)) return 0;
+        return p;
+    }
+    fb = p;
+    p = (const char*) memchr(p, delim, e - p);
+    if (!p) p = e;
+    fe = p;
+    while ((fe > fb) && ((fe[-1] == ' ') || (fe[-1] == '\t')) && (fe[-1] != delim)) --fe;
+    return p;
+}
+
+
+// Strip carriage return at line end
+inline
+const char*
+strip_cr(const char *p, const char *e)
+{
+    return ((e > p) && (e[-1] == '\r')) ? e - 1 : e;
+}
+
+
+// Skip UTF-8 byte order mark at the beginning of text [b, e)
+inline
+const char*
+skip_bom(const char *b, const char *e)
+{
+    return ((e - b >= 3) && !memcmp(b, "\xEF\xBB\xBF", 3)) ? b + 3 : b;
+}
+
+
+// Is line [p, e) blank?
+inline
+bool
+is_blank(const char *p, const char *e)
+{
+    e = strip_cr(p, e);
+    return skip_sp(p, e) == e;
+}
+
+
+// Selection of columns: targets of (0-based) column k are dst[start[k]] ...
+// dst[start[k + 1] - 1], where j >= 0 denotes input j, -j - 1 output j
+struct csv_cols {
+    std::vector<int> start, dst;
+
+    csv_cols(const std::vector<int> &in, const std::vector<int> &out) {
+        int nc = 0;
+        for (std::size_t j = 0; j < in.size(); ++j) nc = std::max(nc, in[j]);
+        for (std::size_t j = 0; j < out.size(); ++j) nc = std::max(nc, out[j]);
+        start.assign(nc + 1, 0);
+        for (std::size_t j = 0; j < in.size(); ++j) ++start[in[j]];
+        for (std::size_t j = 0; j < out.size(); ++j) ++start[out[j]];
+        for (int k = 1; k <= nc; ++k) start[k] += start[k - 1];
+        dst.resize(start[nc]);
+        std::vector<int> pos(start.begin(), start.end() - 1);
+        for (std::size_t j = 0; j < in.size(); ++j) dst[pos[in[j] - 1]++] = j;
+        for (std::size_t j = 0; j < out.size(); ++j) dst[pos[out[j] - 1]++] = -(int) j - 1;
+    }
+
+    int cols() const { return start.size() - 1; }
+};
+
+
+// Parse delimited line [p, e) into row of input and output matrices
+template <typename T>
+bool
+parse_csv_line(const char *p, const char *e, char delim, const csv_cols &sel,
+               T *in, T *out, idx_t ld)
+{
+    e = strip_cr(p, e);
+    for (int k = 0, nc = sel.cols(); k < nc; ++k) {
+        if (k) {
+            if ((p >= e) || (*p != delim)) return false;
+            ++p;
+        }
+        const char *fb, *fe;
+        p = csv_field(p, e, delim, fb, fe);
+        if (!p) return false;
+        int t0 = sel.start[k], t1 = sel.start[k + 1];
+        if (t0 == t1) continue;
+        T x;
+        if (scan_num(fb, fe, x) != fe) return false;
+        for (int t = t0; t < t1; ++t) {
+            int j = sel.dst[t];
+            if (j >= 0) in[j * ld] = x;
+            else out[(-j - 1) * ld] = x;
+        }
+    }
+    return true;
+}
+
+
+// Count non blank lines in chunk
+inline
+int
+count_csv_lines(const char *p, const char *e)
+{
+    int n = 0;
+    while (p < e) {
+        const char *q = line_end(p, e);
+        if (!is_blank(p, q)) ++n;
+        p = q + 1;
+    }
+    return n;
+}
+
+
+// Parse chunk of delimited file
+template <typename T>
+bool
+parse_csv_chunk(const text_chunk &ch, char delim, const csv_cols &sel,
+                int r, T *in, T *out)
+{
+    int i = ch.first;
+    for (const char *p = ch.b; p < ch.e; ) {
+        const char *q = line_end(p, ch.e);
+        if (!is_blank(p, q)) {
+            if (!parse_csv_line(p, q, delim, sel, in + i, out + i, r)) return false;
+            ++i;
+        }
+        p = q + 1;
+    }
+    return true;
+}
+
+
+// Suffix of binary cache file name
+const char cache_suffix[] = ".fcnnbin";
+const char key_magic[8] = { 'F', 'C', 'N', 'N', 'S', 'R', 'C', 'K' };
+
+
+// Size and modification time of file
+bool
+file_stat(const std::string &fname, src_key &k)
+{
+    struct stat st;
+    if (stat(fname.c_str(), &st)) return false;
+    k.size = (std::int64_t) st.st_size;
+    k.mtime = (std::int64_t) st.st_mtime;
+#if defined(__linux__)
+    k.mtime_ns = (std::int64_t) st.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    k.mtime_ns = (std::int64_t) st.st_mtimespec.tv_nsec;
+#else
+    k.mtime_ns = 0;
+#endif
+    return true;
+}
+
+
+// Hash (64-bit FNV-1a) of file contents
+bool
+file_hash(const std::string &fname, std::uint64_t &h)
+{
+    text_file tf;
+    if (!tf.open(fname)) return false;
+    h = 14695981039346656037ULL;
+    for (const char *p = tf.begin(); p < tf.end(); ++p) {
+        h ^= (unsigned char) *p;
+        h *= 1099511628211ULL;
+    }
+    return true;
+}
+
+
+// Unique name of new temporary file next to given one with permissions
+// of file src (empty on failure)
+std::string
+temp_name(const std::string &fname, const std::string &src)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    std::string t = fname + ".XXXXXX";
+    int fd = mkstemp(&t[0]);
+    if (fd < 0) return std::string();
+    struct stat st;
+    if (!stat(src.c_str(), &st)) fchmod(fd, st.st_mode & 0666);
+    close(fd);
+    return t;
+#else
+    char buf[64];
+    sprintf(buf, ".%lx.%x.tmp", (unsigned long) std::time(0), (unsigned) std::rand());
+    return fname + buf;
+#endif
+}
+
+
+// Read source key from binary file (false if there is none)
+bool
+read_src_key(std::istream &is, const bin_hdr &h, src_key &k, std::string &path)
+{
+    if (h.version != bin_version) return false;
+    if (h.in_off < (std::int64_t) (sizeof(bin_hdr) + sizeof(src_key))) return false;
+    is.clear();
+    is.seekg(sizeof(bin_hdr));
+    if (!is.read((char*) &k, sizeof(k))) return false;
+    if (memcmp(k.magic, key_magic, sizeof(key_magic))) return false;
+    if (h.in_off < (std::int64_t) (sizeof(bin_hdr) + sizeof(src_key) + k.path_len))
+        return false;
+    path.resize(k.path_len);
+    if (k.path_len && !is.read(&path[0], k.path_len)) return false;
+    return true;
+}
+
+
+// Means, variances, minima and maxima of columns of m (records r0 + 1, ...,
+// r0 + n) stored in rows j0 + 1, ... of st
+template <typename T>
+void
+col_stats(const Matrix<T> &m, int r0, int n, Matrix<double> &st, int j0)
+{
+    for (int j = 0, c = m.cols(); j < c; ++j) {
+        const T *x = m.ptr() + (idx_t) j * m.rows() + r0;
+        double sum = 0, mn = x[0], mx = x[0];
+        for (int i = 0; i < n; ++i) {
+            sum += x[i];
+            mn = std::min(mn, (double) x[i]);
+            mx = std::max(mx, (double) x[i]);
+        }
+        double mean = sum / n, var = 0;
+        for (int i = 0; i < n; ++i) {
+            double d = x[i] - mean;
+            var += d * d;
+        }
+        st.elem(j0 + j + 1, 1) = mean;
+        st.elem(j0 + j + 1, 2) = var / n;
+        st.elem(j0 + j + 1, 3) = mn;
+        st.elem(j0 + j + 1, 4) = mx;
+    }
+}
+
+
+// Copy all records of ms to m starting at record r0 + 1
+template <typename T>
+void
+copy_records(const Matrix<T> &ms, Matrix<T> &m, int r0)
+{
+    for (int j = 0, c = ms.cols(); j < c; ++j) {
+        const T *x = ms.ptr() + (idx_t) j * ms.rows();
+        std::copy(x, x + ms.rows(), m.ptr() + (idx_t) j * m.rows() + r0);
+    }
+}
+
+
+// Are record weights valid (nonnegative, finite and not all zero)?
+template <typename T>
+bool
+valid_weights(const std::vector<T> &w)
+{
+    T s = T();
+    for (std::size_t i = 0; i < w.size(); ++i) {
+        if (!(w[i] >= T()) || !std::isfinite(w[i])) return false;
+        s += w[i];
+    }
+    return s > T();
+}
+
+
+
+// Read r record weights stored as S at offset off
+template <typename T, typename S>
+bool
+read_weights(std::istream &is, std::int64_t off, int r, std::vector<T> &w)
+{
+    std::vector<S> ws(r);
+    is.clear();
+    is.seekg(off);
+    if (!is.read((char*) &ws[0], sizeof(S) * r)) return false;
+    w.assign(ws.begin(), ws.end());
+    return valid_weights(w);
+}
+
+
+
+// Update hash (64-bit FNV-1a) with row i (0-based) of m; zeros of either
+// sign are hashed alike, as rows are compared by value
+template <typename T>
+void
+hash_row(const Matrix<T> &m, int i, std::uint64_t &h)
+{
+    const T *p = m.ptr() + i;
+    for (int j = 0, r = m.rows(), c = m.cols(); j < c; ++j, p += r) {
+        T x = (*p == T()) ? T() : *p;
+        const unsigned char *b = (const unsigned char*) &x;
+        for (std::size_t k = 0; k < sizeof(T); ++k) {
+            h ^= b[k];
+            h *= 1099511628211ULL;
+        }
+    }
+}
+
+
+
+// Are rows i and k (0-based) of m equal?
+template <typename T>
+bool
+same_rows(const Matrix<T> &m, int i, int k)
+{
+    const T *p = m.ptr();
+    for (idx_t j = 0, r = m.rows(), c = m.cols(); j < c; ++j) {
+        if (p[j * r + i] != p[j * r + k]) return false;
+    }
+    return true;
+}
+
+
+
+// Name of shared memory segment holding data from file
+bool
+shm_name(const std::string &fname, std::size_t elem, std::string &name)
+{
+    struct stat st;
+    src_key k;
+    if (stat(fname.c_str(), &st) || !file_stat(fname, k)) return false;
+    std::uint64_t v[] = { (std::uint64_t) st.st_dev, (std::uint64_t) st.st_ino,
+                          (std::uint64_t) k.size, (std::uint64_t) k.mtime,
+                          (std::uint64_t) k.mtime_ns, elem, bin_version };
+    const unsigned char *p = (const unsigned char*) v;
+    std::uint64_t h = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < sizeof(v); ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "/fcnn.%016llx", (unsigned long long) h);
+    name = buf;
+    return true;
+}
+
+
+} /* namespace */
+
+
+
+bool
+fcnn::internal::read_bin_hdr(std::istream &is, bin_hdr &h)
+{
+    memset(&h, 0, sizeof(h));
+    is.seekg(0);
+    if (!is.read((char*) &h, bin_hdr_v1)) return false;
+    if (memcmp(h.magic, bin_magic, sizeof(bin_magic))) return false;
+    if ((h.version == bin_version)
+        && !is.read((char*) &h + bin_hdr_v1, sizeof(h) - bin_hdr_v1)) return false;
+    if (((h.version != 1) && (h.version != bin_version)) || (h.layout != bin_col_major)
+        || (h.endian != bin_endian)) return false;
+    if ((h.elem != sizeof(float)) && (h.elem != sizeof(double))) return false;
+    if ((h.rows < 1) || (h.rows > 0x7fffffff)
+        || (h.inputs < 1) || (h.outputs < 1)) return false;
+    // mapping beyond the end of file is not an error until accessed
+    is.seekg(0, std::ios::end);
+    std::int64_t len = (std::int64_t) is.tellg();
+    if ((h.in_off % (std::int64_t) mem_map_align)
+        || (h.out_off % (std::int64_t) mem_map_align)
+        || (h.in_off + 64 + (std::int64_t) h.elem * h.rows * h.inputs > h.out_off)
+        || (h.out_off + 64 + (std::int64_t) h.elem * h.rows * h.outputs > len)
+        || (h.info_off < 0) || (h.info_len < 0)
+        || (h.info_off + h.info_len > len)) return false;
+    if (h.wgt_off && ((h.wgt_off < h.out_off + 64 + (std::int64_t) h.elem * h.rows * h.outputs)
+                      || (h.wgt_off + (std::int64_t) h.elem * h.rows > len))) return false;
+    return true;
+}
+
+
 //namespace fcnn {
 
 template <typename T>
@@ -76,6 +731,8 @@ Dataset<T>::set(const Matrix<T> &in, const Matrix<T> &out,
     m_in = in;
     m_out = out;
     m_info = descr;
+    m_wgt.clear();
+    m_shm.reset();
 }
 
 
@@ -114,6 +771,123 @@ Dataset<T>::set_record_info(int i, const std::string &info)
 
 
 
+template <typename T>
+void
+Dataset<T>::set_record_weights(const std::vector<T> &w)
+{
+    int r = m_in.rows(), rw = w.size();
+    if (!rw) {
+        m_wgt.clear();
+        return;
+    }
+    if (rw != r) {
+        message mes;
+        mes << "no. of records (" << r
+            << ") and record weights ("
+            << rw << ") disagree";
+        error(mes);
+    }
+    if (!valid_weights(w)) {
+        error("record weights should be nonnegative and finite with positive sum");
+    }
+
+    m_wgt = w;
+}
+
+
+
+template <typename T>
+T
+Dataset<T>::get_record_weight(int i) const
+{
+    int r = m_in.rows();
+    if ((i < 1) || (i > r)) {
+        message mes;
+        mes << "invalid record index: index " << i << ", no. of records "
+            << "in dataset: " << r;
+        error(mes);
+    }
+
+    return m_wgt.empty() ? (T)1 : m_wgt[i - 1];
+}
+
+
+
+template <typename T>
+T
+Dataset<T>::total_weight() const
+{
+    if (m_wgt.empty()) return (T) m_in.rows();
+    T s = T();
+    for (std::size_t i = 0; i < m_wgt.size(); ++i) s += m_wgt[i];
+    return s;
+}
+
+
+
+template <typename T>
+int
+Dataset<T>::fold_duplicates()
+{
+    int r = m_in.rows();
+    std::vector<std::uint64_t> h(r);
+#if defined(HAVE_OPENMP)
+    #pragma omp parallel for schedule(static)
+#endif /* defined(HAVE_OPENMP) */
+    for (int i = 0; i < r; ++i) {
+        std::uint64_t x = 14695981039346656037ULL;
+        hash_row(m_in, i, x);
+        hash_row(m_out, i, x);
+        h[i] = x;
+    }
+
+    // first record with given inputs and outputs for each record
+    typedef std::unordered_multimap<std::uint64_t, int> first_map;
+    first_map first;
+    first.reserve(r);
+    std::vector<int> keep, rep(r);
+    for (int i = 0; i < r; ++i) {
+        rep[i] = i;
+        std::pair<first_map::iterator, first_map::iterator> rng = first.equal_range(h[i]);
+        for (first_map::iterator it = rng.first; it != rng.second; ++it) {
+            int k = it->second;
+            if (same_rows(m_in, i, k) && same_rows(m_out, i, k)) {
+                rep[i] = k;
+                break;
+            }
+        }
+        if (rep[i] == i) {
+            first.insert(std::make_pair(h[i], i));
+            keep.push_back(i);
+        }
+    }
+    int n = keep.size();
+    if (n == r) return 0;
+
+    std::vector<T> w(r, T());
+    for (int i = 0; i < r; ++i) w[rep[i]] += m_wgt.empty() ? (T)1 : m_wgt[i];
+    std::vector<int> idx(n);
+    std::vector<T> wgt(n);
+    std::vector<std::string> info(n);
+    for (int k = 0; k < n; ++k) {
+        idx[k] = keep[k] + 1;
+        wgt[k] = w[keep[k]];
+        info[k].swap(m_rec_info[keep[k]]);
+    }
+    {
+        // data is shared by teaching threads
+        MemoryPolicy pol(mem_interleave);
+        m_in = m_in.get_rows(idx);
+        m_out = m_out.get_rows(idx);
+    }
+    m_rec_info.swap(info);
+    m_wgt.swap(wgt);
+    m_shm.reset();
+    return r - n;
+}
+
+
+
 
 template <typename T>
 bool
@@ -129,7 +903,9 @@ Dataset<T>::save(const std::string &fname, bool write_info) const
         if (!write_comment(os, info)) return false;
     }
 
-    os << r << ' ' << ci << ' ' << co << '\n';
+    os << r << ' ' << ci << ' ' << co;
+    if (!m_wgt.empty()) os << ' ' << 1;
+    os << '\n';
 
     os << std::setprecision(precision<T>::val);
     for (i = 1; i <= r; ++i) {
@@ -143,6 +919,7 @@ Dataset<T>::save(const std::string &fname, bool write_info) const
         if (os.fail()) return false;
         for (j = 1; j < co; ++j) os << m_out.elem(i, j) << ' ';
         os << m_out.elem(i, j) << '\n';
+        if (!m_wgt.empty()) os << m_wgt[i - 1] << '\n';
         if (os.fail()) return false;
     }
     os << '\n';
@@ -156,18 +933,32 @@ Dataset<T>::save(const std::string &fname, bool write_info) const
 
 template <typename T>
 bool
-Dataset<T>::load(const std::string &fname, bool read_info)
+Dataset<T>::load(const std::string &fname, bool read_info, bool cache)
 {
     m_info.clear();
     m_rec_info.clear();
+    m_wgt.clear();
     m_in.reset();
     m_out.reset();
+    m_shm.reset();
 
     std::ifstream is;
     is.open(fname.c_str());
     if (is.fail()) return false;
 
-    int r, ci, co;
+    char magic[sizeof(bin_magic)];
+    if (is.read(magic, sizeof(magic)) && !memcmp(magic, bin_magic, sizeof(magic))) {
+        is.close();
+        return load_mmap(fname, read_info);
+    }
+    if (cache) {
+        is.close();
+        return load_cached(fname, read_info);
+    }
+    is.clear();
+    is.seekg(0);
+
+    int r, ci, co, cw = 0;
     std::string cm;
 
     skip_blank(is);
@@ -179,49 +970,592 @@ Dataset<T>::load(const std::string &fname, bool read_info)
     if (!read<int>(is, ci)) return false;
     if (is_eol(is)) return false;
     if (!read<int>(is, co)) return false;
-    if (!is_eol(is)) return false;
+    if (!is_eol(is)) {
+        if (!read<int>(is, cw)) return false;
+        if (!is_eol(is)) return false;
+    }
     skip_blank(is);
     if (is.fail()) return false;
-    if ((r < 1) || (ci < 1) || (co < 1)) return false;
+    if ((r < 1) || (ci < 1) || (co < 1) || (cw < 0) || (cw > 1)) return false;
+
+    std::streamoff pos = is.tellg();
+    is.close();
+    if (pos < 0) return false;
+
+    text_file tf;
+    if (!tf.open(fname)) return false;
+    const char *b = tf.begin() + pos, *e = tf.end();
+    if (b > e) return false;
 
     m_info = cm;
-    m_in.reset(r, ci);
-    m_out.reset(r, co);
+    {
+        // data is shared by teaching threads
+        MemoryPolicy pol(mem_interleave);
+        m_in.reset(r, ci);
+        m_out.reset(r, co);
+    }
     m_rec_info.assign(r, "");
+    if (cw) m_wgt.assign(r, T());
 
-    for  (int i = 1; i <= r; ++i) {
-        T d;
-        if (read_info) {
-            if (read_comment(is, cm)) m_rec_info[i - 1] = cm;
-        } else skip_comment(is);
-        for (int j = 1; j <= ci; ++j) {
-            if (is_eol(is)) goto err;
-            if (!read<T>(is, d)) goto err;
-            m_in(i, j) = d;
-        }
-        if (!is_eol(is)) goto err;
-        for (int j = 1; j <= co; ++j) {
-            if (is_eol(is)) goto err;
-            if (!read<T>(is, d)) goto err;
-            m_out(i, j) = d;
-        }
-        if (i < r) {
-            if (!is_eol(is)) goto err;
-        } else {
-            skip_all(is);
-            if (!is.eof()) goto err;
+    {
+        // split into chunks, count data lines in parallel, then parse
+        std::vector<text_chunk> chunks = split_text(b, e, true);
+        int nch = chunks.size(), ok = 1;
+#if defined(HAVE_OPENMP)
+        #pragma omp parallel for schedule(dynamic)
+#endif /* defined(HAVE_OPENMP) */
+        for (int k = 0; k < nch; ++k)
+            chunks[k].lines = count_lines(chunks[k].b, chunks[k].e);
+        long long tot = 0, n = (2 + cw) * (long long) r;
+        for (int k = 0; k < nch; ++k) {
+            chunks[k].first = (int) std::min(tot, n);
+            tot += chunks[k].lines;
+        }
+        if (tot < n) goto err;
+        std::string *info = read_info ? &m_rec_info[0] : 0;
+        T *wgt = cw ? &m_wgt[0] : 0;
+#if defined(HAVE_OPENMP)
+        #pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+#endif /* defined(HAVE_OPENMP) */
+        for (int k = 0; k < nch; ++k) {
+            ok = parse_chunk(chunks[k], r, ci, co, m_in.ptr(), m_out.ptr(), wgt, info, e) && ok;
         }
+        if (!ok) goto err;
+        if (cw && !valid_weights(m_wgt)) goto err;
     }
     return true;
 
 err:
     m_info.clear();
     m_rec_info.clear();
+    m_wgt.clear();
     m_in.reset();
     m_out.reset();
     return false;
 }
 
+template <typename T>
+bool
+Dataset<T>::load_csv(const std::string &fname, const std::vector<int> &inputs,
+                     const std::vector<int> &outputs, char delim, bool header)
+{
+    if ((delim == ' ') || (delim == '"') || (delim == '\n') || (delim == '\r'))
+        error("invalid delimiter");
+    if (inputs.empty()) error("empty input");
+    if (outputs.empty()) error("empty output");
+    for (std::size_t j = 0; j < inputs.size(); ++j)
+        if (inputs[j] < 1) error("invalid column index");
+    for (std::size_t j = 0; j < outputs.size(); ++j)
+        if (outputs[j] < 1) error("invalid column index");
+
+    m_info.clear();
+    m_rec_info.clear();
+    m_wgt.clear();
+    m_in.reset();
+    m_out.reset();
+    m_shm.reset();
+
+    text_file tf;
+    if (!tf.open(fname)) return false;
+    const char *e = tf.end(), *b = skip_bom(tf.begin(), e);
+    if (header && (b < e)) b = line_end(b, e) + 1;
+    if (b > e) b = e;
+
+    csv_cols sel(inputs, outputs);
+    std::vector<text_chunk> chunks = split_text(b, e, false);
+    int nch = chunks.size(), ok = 1;
+#if defined(HAVE_OPENMP)
+    #pragma omp parallel for schedule(dynamic)
+#endif /* defined(HAVE_OPENMP) */
+    for (int k = 0; k < nch; ++k)
+        chunks[k].lines = count_csv_lines(chunks[k].b, chunks[k].e);
+    long long tot = 0;
+    for (int k = 0; k < nch; ++k) {
+        chunks[k].first = (int) tot;
+        tot += chunks[k].lines;
+    }
+    if ((tot < 1) || (tot > 0x7fffffff)) return false;
+    int r = (int) tot;
+
+    {
+        // data is shared by teaching threads
+        MemoryPolicy pol(mem_interleave);
+        m_in.reset(r, inputs.size());
+        m_out.reset(r, outputs.size());
+    }
+#if defined(HAVE_OPENMP)
+    #pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+#endif /* defined(HAVE_OPENMP) */
+    for (int k = 0; k < nch; ++k) {
+        ok = parse_csv_chunk(chunks[k], delim, sel, r, m_in.ptr(), m_out.ptr()) && ok;
+    }
+    if (!ok) {
+        m_in.reset();
+        m_out.reset();
+        return false;
+    }
+    m_rec_info.assign(r, "");
+    return true;
+}
+
+
+
+template <typename T>
+bool
+Dataset<T>::load_csv(const std::string &fname, const std::vector<std::string> &inputs,
+                     const std::vector<std::string> &outputs, char delim)
+{
+    if ((delim == ' ') || (delim == '"') || (delim == '\n') || (delim == '\r'))
+        error("invalid delimiter");
+
+    // column names
+    std::vector<std::string> names;
+    {
+        std::ifstream is(fname.c_str(), std::ios::binary);
+        std::string line;
+        if (!std::getline(is, line)) return false;
+        const char *e = line.data() + line.size(), *p = skip_bom(line.data(), e);
+        e = strip_cr(p, e);
+        for (;;) {
+            const char *fb, *fe;
+            p = csv_field(p, e, delim, fb, fe);
+            if (!p) return false;
+            std::string n;
+            for (const char *c = fb; c < fe; ++c) {
+                n += *c;
+                if ((*c == '"') && (c + 1 < fe) && (c[1] == '"')) ++c;
+            }
+            names.push_back(n);
+            if (p == e) break;
+            ++p;
+        }
+    }
+
+    std::vector<int> in(inputs.size()), out(outputs.size());
+    for (std::size_t j = 0; j < inputs.size(); ++j) {
+        in[j] = std::find(names.begin(), names.end(), inputs[j]) - names.begin() + 1;
+        if (in[j] > (int) names.size()) return false;
+    }
+    for (std::size_t j = 0; j < outputs.size(); ++j) {
+        out[j] = std::find(names.begin(), names.end(), outputs[j]) - names.begin() + 1;
+        if (out[j] > (int) names.size()) return false;
+    }
+    return load_csv(fname, in, out, delim, true);
+}
+
+
+
+
+template <typename T>
+bool
+Dataset<T>::save_binary(const std::string &fname, bool write_info) const
+{
+    return write_binary(fname, write_info, std::string());
+}
+
+
+
+template <typename T>
+void
+Dataset<T>::bin_layout(bin_hdr &h, bool write_info, std::size_t key_len) const
+{
+    int r = m_in.rows(), ci = m_in.cols(), co = m_out.cols();
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, bin_magic, sizeof(bin_magic));
+    h.version = bin_version;
+    h.elem = sizeof(T);
+    h.layout = bin_col_major;
+    h.endian = bin_endian;
+    h.rows = r;
+    h.inputs = ci;
+    h.outputs = co;
+    h.in_off = bin_align(sizeof(h) + key_len);
+    h.out_off = bin_align(h.in_off + 64 + (std::int64_t) sizeof(T) * r * ci);
+    h.info_off = h.out_off + 64 + (std::int64_t) sizeof(T) * r * co;
+    if (!m_wgt.empty()) {
+        h.wgt_off = h.info_off;
+        h.info_off += (std::int64_t) sizeof(T) * r;
+    }
+    if (write_info) {
+        h.info_len = sizeof(std::uint32_t) + m_info.size();
+        for (int i = 0; i < r; ++i)
+            h.info_len += sizeof(std::uint32_t) + m_rec_info[i].size();
+    }
+}
+
+
+
+template <typename T>
+bool
+Dataset<T>::write_binary(const std::string &fname, bool write_info,
+                         const std::string &key) const
+{
+    std::ofstream os;
+    os.open(fname.c_str(), std::ios::binary);
+    if (os.fail()) return false;
+
+    bin_hdr h;
+    bin_layout(h, write_info, key.size());
+    os.write((const char*) &h, sizeof(h));
+    os.write(key.data(), key.size());
+
+    if (!write_pad(os, h.in_off + 64)) return false;
+    os.write((const char*) m_in.ptr(), sizeof(T) * m_in.size());
+    if (!write_pad(os, h.out_off + 64)) return false;
+    os.write((const char*) m_out.ptr(), sizeof(T) * m_out.size());
+    if (!m_wgt.empty()) os.write((const char*) &m_wgt[0], sizeof(T) * m_wgt.size());
+    if (os.fail()) return false;
+
+    if (write_info) {
+        if (!write_str(os, m_info)) return false;
+        for (int i = 0, r = m_in.rows(); i < r; ++i) {
+            if (!write_str(os, m_rec_info[i])) return false;
+        }
+    }
+
+    os.close();
+    if (os.fail()) return false;
+    return true;
+}
+
+
+
+template <typename T>
+void
+Dataset<T>::write_image(char *p, const bin_hdr &h) const
+{
+    memcpy(p, &h, sizeof(h));
+    memcpy(p + h.in_off + 64, m_in.ptr(), sizeof(T) * m_in.size());
+    memcpy(p + h.out_off + 64, m_out.ptr(), sizeof(T) * m_out.size());
+    if (h.wgt_off) memcpy(p + h.wgt_off, &m_wgt[0], sizeof(T) * m_wgt.size());
+    if (h.info_len) {
+        char *q = p + h.info_off;
+        for (int i = -1, r = m_in.rows(); i < r; ++i) {
+            const std::string &str = (i < 0) ? m_info : m_rec_info[i];
+            std::uint32_t n = (std::uint32_t) str.size();
+            memcpy(q, &n, sizeof(n));
+            memcpy(q + sizeof(n), str.data(), n);
+            q += sizeof(n) + n;
+        }
+    }
+}
+
+
+
+
+template <typename T>
+bool
+Dataset<T>::load_cached(const std::string &fname, bool read_info)
+{
+    src_key key;
+    memset(&key, 0, sizeof(key));
+    if (!file_stat(fname, key)) return false;
+    std::string cname = fname + cache_suffix;
+
+    // check cache
+    {
+        std::fstream cs(cname.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        if (!cs) cs.open(cname.c_str(), std::ios::in | std::ios::binary);
+        bin_hdr h;
+        src_key ck;
+        std::string path;
+        if (cs && read_bin_hdr(cs, h) && read_src_key(cs, h, ck, path)
+            && (path == fname) && (ck.size == key.size)) {
+            bool valid = (ck.mtime == key.mtime) && (ck.mtime_ns == key.mtime_ns);
+            if (!valid && file_hash(fname, key.hash) && (key.hash == ck.hash)) {
+                // contents did not change, record new modification time
+                ck.mtime = key.mtime;
+                ck.mtime_ns = key.mtime_ns;
+                cs.clear();
+                cs.seekp(sizeof(bin_hdr));
+                cs.write((const char*) &ck, sizeof(ck));
+                valid = true;
+            }
+            cs.close();
+            if (valid && load_mmap(cname, read_info)) return true;
+        }
+    }
+
+    // parse text and write cache (through temporary file unique to this
+    // writer, so that concurrent readers never see partial cache and
+    // concurrent writers do not overwrite each other's files)
+    if (!load(fname, true, false)) return false;
+    if (file_hash(fname, key.hash)) {
+        memcpy(key.magic, key_magic, sizeof(key_magic));
+        key.path_len = (std::uint32_t) fname.size();
+        std::string k((const char*) &key, sizeof(key));
+        k += fname;
+        std::string tname = temp_name(cname, fname);
+        if (!tname.empty()) {
+            if (write_binary(tname, true, k)) {
+                std::remove(cname.c_str());
+                if (std::rename(tname.c_str(), cname.c_str())) std::remove(tname.c_str());
+            } else {
+                std::remove(tname.c_str());
+            }
+        }
+    }
+    if (!read_info) {
+        m_info.clear();
+        m_rec_info.assign(m_in.rows(), "");
+    }
+    return true;
+}
+
+
+
+
+template <typename T>
+bool
+Dataset<T>::load_mmap(const std::string &fname, bool read_info)
+{
+    m_info.clear();
+    m_rec_info.clear();
+    m_wgt.clear();
+    m_in.reset();
+    m_out.reset();
+    m_shm.reset();
+
+    std::ifstream is;
+    is.open(fname.c_str(), std::ios::binary);
+    if (is.fail()) return false;
+    bin_hdr h;
+    if (!read_bin_hdr(is, h)) return false;
+    int r = (int) h.rows, ci = h.inputs, co = h.outputs;
+
+    bool ok;
+    if (h.elem == sizeof(float)) {
+        ok = map_matrix<T, float>(fname, h.in_off, r, ci, m_in)
+             && map_matrix<T, float>(fname, h.out_off, r, co, m_out)
+             && (!h.wgt_off || read_weights<T, float>(is, h.wgt_off, r, m_wgt));
+    } else {
+        ok = map_matrix<T, double>(fname, h.in_off, r, ci, m_in)
+             && map_matrix<T, double>(fname, h.out_off, r, co, m_out)
+             && (!h.wgt_off || read_weights<T, double>(is, h.wgt_off, r, m_wgt));
+    }
+    if (!ok) goto err;
+
+    m_rec_info.assign(r, "");
+    if (read_info && h.info_len) {
+        is.clear();
+        is.seekg(h.info_off);
+        if (!read_str(is, m_info)) goto err;
+        for (int i = 0; i < r; ++i) {
+            if (!read_str(is, m_rec_info[i])) goto err;
+        }
+    }
+    return true;
+
+err:
+    m_info.clear();
+    m_rec_info.clear();
+    m_wgt.clear();
+    m_in.reset();
+    m_out.reset();
+    return false;
+}
+
+
+
+template <typename T>
+bool
+Dataset<T>::load_shared(const std::string &fname, bool read_info, bool cache)
+{
+    std::string name;
+    if (!shm_segment::supported() || !shm_name(fname, sizeof(T), name))
+        return load(fname, read_info, cache);
+
+    std::shared_ptr<shm_segment> seg(new shm_segment);
+    if (!seg->attach(name)) {
+        // first process: parse and publish data
+        if (!load(fname, true, cache)) return false;
+        bin_hdr h;
+        bin_layout(h, true, 0);
+        std::size_t n = h.info_off + h.info_len;
+        bool created = seg->create(name, n);
+        // stale segment left by a process which died is removed by attach
+        if (!created && !seg->attach(name) && !(created = seg->create(name, n))) {
+            // keep private copy
+            if (!read_info) {
+                m_info.clear();
+                m_rec_info.assign(m_in.rows(), "");
+            }
+            return true;
+        }
+        if (created) {
+            write_image(seg->image(), h);
+            seg->ready();
+        }
+    }
+
+    m_info.clear();
+    m_rec_info.clear();
+    m_wgt.clear();
+    m_in.reset();
+    m_out.reset();
+    m_shm.reset();
+
+    bin_hdr h;
+    const char *img = seg->image(), *e = img + seg->size();
+    if (seg->size() < sizeof(h)) return load(fname, read_info, cache);
+    memcpy(&h, img, sizeof(h));
+    if (memcmp(h.magic, bin_magic, sizeof(bin_magic)) || (h.version != bin_version)
+        || (h.elem != sizeof(T)) || (h.rows < 1) || (h.inputs < 1) || (h.outputs < 1)
+        || (h.info_off + h.info_len > (std::int64_t) seg->size())
+        || (h.wgt_off && (h.wgt_off + (std::int64_t) sizeof(T) * h.rows > h.info_off)))
+        return load(fname, read_info, cache);
+    int r = (int) h.rows, ci = h.inputs, co = h.outputs;
+    std::int64_t base = shm_segment::base();
+    if (!map_shared(seg->fd(), base + h.in_off, r, ci, m_in)
+        || !map_shared(seg->fd(), base + h.out_off, r, co, m_out)) goto err;
+    if (h.wgt_off) {
+        m_wgt.resize(r);
+        memcpy(&m_wgt[0], img + h.wgt_off, sizeof(T) * r);
+        if (!valid_weights(m_wgt)) goto err;
+    }
+
+    m_rec_info.assign(r, "");
+    if (read_info && h.info_len) {
+        const char *p = img + h.info_off;
+        if (!read_str(p, e, m_info)) goto err;
+        for (int i = 0; i < r; ++i) {
+            if (!read_str(p, e, m_rec_info[i])) goto err;
+        }
+    }
+    m_shm = seg;
+    return true;
+
+err:
+    // segment cannot be used, load private copy
+    return load(fname, read_info, cache);
+}
+
+
+
+template <typename T>
+bool
+Dataset<T>::remove_shared(const std::string &fname)
+{
+    std::string name;
+    if (!shm_name(fname, sizeof(T), name)) return false;
+    return shm_segment::remove(name);
+}
+
+
+
+template <typename T>
+bool
+Dataset<T>::save_shards(const std::string &fname, int n, bool write_info) const
+{
+    int r = m_in.rows(), ci = m_in.cols(), co = m_out.cols();
+    if ((n < 1) || (n > r)) {
+        message mes;
+        mes << "no. of shards (" << n << ") must be between 1 and no. of records ("
+            << r << ")";
+        error(mes);
+    }
+
+    ShardManifest man;
+    man.m_rows = r;
+    man.m_in = ci;
+    man.m_out = co;
+    if (write_info) man.m_info = m_info;
+    std::size_t sep = fname.find_last_of("/\\");
+    std::string base = (sep == std::string::npos) ? fname : fname.substr(sep + 1);
+    man.m_shards.resize(n);
+    for (int k = 0; k < n; ++k) {
+        ShardManifest::shard &sh = man.m_shards[k];
+        sh.first = (int) ((long long) k * r / n);
+        sh.rows = (int) ((long long) (k + 1) * r / n) - sh.first;
+        sh.file = base + "." + num2str(k + 1);
+        sh.stats = Matrix<double>(ci + co, 4);
+        col_stats(m_in, sh.first, sh.rows, sh.stats, 0);
+        col_stats(m_out, sh.first, sh.rows, sh.stats, ci);
+
+        std::vector<int> idx(sh.rows);
+        for (int i = 0; i < sh.rows; ++i) idx[i] = sh.first + i + 1;
+        Dataset<T> dat;
+        dat.m_in = m_in.get_rows(idx);
+        dat.m_out = m_out.get_rows(idx);
+        dat.m_info = m_info;
+        dat.m_rec_info.assign(m_rec_info.begin() + sh.first,
+                              m_rec_info.begin() + sh.first + sh.rows);
+        if (!m_wgt.empty()) {
+            dat.m_wgt.assign(m_wgt.begin() + sh.first,
+                             m_wgt.begin() + sh.first + sh.rows);
+            if (!valid_weights(dat.m_wgt)) {
+                message mes;
+                mes << "all records of shard " << k + 1 << " of " << n
+                    << " have zero weights";
+                error(mes);
+            }
+        }
+        if (!dat.save_binary(fname + "." + num2str(k + 1), write_info)) return false;
+    }
+    return man.save(fname);
+}
+
+
+
+template <typename T>
+bool
+Dataset<T>::load_shard(const std::string &fname, int k, int n, bool read_info)
+{
+    m_info.clear();
+    m_rec_info.clear();
+    m_wgt.clear();
+    m_in.reset();
+    m_out.reset();
+    m_shm.reset();
+
+    ShardManifest man;
+    if (!man.load(fname)) return false;
+    int s0, s1;
+    man.worker_shards(k, n, s0, s1);
+    int r = 0, ci = man.no_inputs(), co = man.no_outputs();
+    for (int s = s0; s <= s1; ++s) r += man.no_records(s);
+
+    if (s0 == s1) {
+        if (!load_mmap(man.shard_file(s0), read_info)) return false;
+        if ((m_in.rows() == r) && (m_in.cols() == ci) && (m_out.cols() == co))
+            return true;
+        goto err;
+    }
+
+    m_in = Matrix<T>(r, ci);
+    m_out = Matrix<T>(r, co);
+    m_rec_info.reserve(r);
+    for (int s = s0, pos = 0; s <= s1; ++s) {
+        Dataset<T> dat;
+        if (!dat.load_mmap(man.shard_file(s), read_info)) goto err;
+        if ((dat.m_in.rows() != man.no_records(s)) || (dat.m_in.cols() != ci)
+            || (dat.m_out.cols() != co)) goto err;
+        copy_records(dat.m_in, m_in, pos);
+        copy_records(dat.m_out, m_out, pos);
+        if (s == s0) m_info = dat.m_info;
+        m_rec_info.insert(m_rec_info.end(), dat.m_rec_info.begin(),
+                          dat.m_rec_info.end());
+        if (dat.weighted()) {
+            // records of preceding unweighted shards have unit weights
+            m_wgt.resize(pos, (T)1);
+            m_wgt.insert(m_wgt.end(), dat.m_wgt.begin(), dat.m_wgt.end());
+        }
+        pos += dat.m_in.rows();
+    }
+    if (!m_wgt.empty()) m_wgt.resize(r, (T)1);
+    return true;
+
+err:
+    m_info.clear();
+    m_rec_info.clear();
+    m_wgt.clear();
+    m_in.reset();
+    m_out.reset();
+    return false;
+}
+
+
+
 // Instantiations
 template class fcnn::Dataset<double>;
 template class fcnn::Dataset<float>;
@@ -31,11 +31,19 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <memory>
+#include <cstdint>
 
 
 namespace fcnn {
 
 
+namespace internal {
+struct bin_hdr;
+class shm_segment;
+} /* namespace internal */
+
+
 /// Class for storing teaching and testing data.
 template <typename T>
 class Dataset
@@ -45,16 +53,89 @@ class Dataset
     Dataset() { ; }
 
     /// Set new matrices and optionally descriptions (throws on error).
+    /// Record weights are removed.
     void set(const Matrix<T> &in, const Matrix<T> &out,
              const std::string &descr = "",
              const std::vector<std::string> &record_descr =
              std::vector<std::string>());
 
-    /// Load data from file, returns true on success.
-    bool load(const std::string &fname, bool read_info = true);
-    /// Save data to file, returns true on success.
+    /// Load data from file, returns true on success. The header line
+    /// holds no. of records, inputs and outputs, optionally followed by 1
+    /// if records are weighted (weight line follows output line of each
+    /// record then). Binary files
+    /// (see save_binary) are recognised and loaded with load_mmap.
+    /// If cache is true, text data is saved in binary cache file
+    /// (file name with ".fcnnbin" appended) which is loaded instead
+    /// of the text file as long as the latter does not change (its path,
+    /// size and modification time or, if these differ, its contents hash
+    /// are compared with the ones recorded in the cache). Failure to write
+    /// the cache is not an error.
+    bool load(const std::string &fname, bool read_info = true, bool cache = false);
+    /// Save data to file, returns true on success. Record weights
+    /// (if any) are saved.
     bool save(const std::string &fname, bool write_info = true) const;
 
+    /// Import data from delimited text file (CSV, TSV), returns true
+    /// on success. Inputs and outputs are selected by (1-based) column
+    /// indices (the same column may be used more than once). If header
+    /// is true, the first line (column names) is skipped. Fields may be
+    /// quoted but cannot span lines. Unused columns are skipped without
+    /// conversion, blank lines and UTF-8 byte order mark are ignored.
+    /// Throws on invalid arguments.
+    bool load_csv(const std::string &fname, const std::vector<int> &inputs,
+                  const std::vector<int> &outputs, char delim = ',',
+                  bool header = true);
+    /// Import data from delimited text file (CSV, TSV) with columns
+    /// selected by names given in the first line, returns true on success
+    /// (false also if names are not found).
+    bool load_csv(const std::string &fname, const std::vector<std::string> &inputs,
+                  const std::vector<std::string> &outputs, char delim = ',');
+
+    /// Save data to binary file, returns true on success. The file holds
+    /// a versioned header (no. of records, inputs and outputs, element type,
+    /// layout, location of weights and descriptions) followed by input
+    /// and output matrices (column major), record weights (if any)
+    /// and descriptions.
+    bool save_binary(const std::string &fname, bool write_info = true) const;
+    /// Load data from binary file written by save_binary, returns true
+    /// on success. Where supported the file is memory mapped, so matrix
+    /// data is neither parsed nor copied and pages are read on first access.
+    /// Changes of the matrices are private (never written to the file).
+    /// Data saved with the other floating point type is converted.
+    bool load_mmap(const std::string &fname, bool read_info = true);
+
+    /// Load data from file (as load) through named shared memory segment,
+    /// returns true on success. The first process loading given file
+    /// (identified by its device, inode, size and modification time)
+    /// publishes the data in the segment, the following ones attach to it
+    /// (waiting until it is complete) instead of parsing the file, so that
+    /// all processes share one copy of the data. The segment is removed
+    /// when the last process releases it (see remove_shared for segments
+    /// left by processes which crashed). A segment whose creator died before
+    /// completing it is removed and published again. Changes of the matrices
+    /// are private.
+    /// Where shared memory is not supported, data is loaded with load.
+    /// Cache is used as in load by the process which publishes data.
+    bool load_shared(const std::string &fname, bool read_info = true,
+                     bool cache = false);
+    /// Remove shared memory segment holding data from given file
+    /// (see load_shared), returns true if there was one.
+    static bool remove_shared(const std::string &fname);
+
+    /// Split data into n shards of consecutive records (sizes differing
+    /// by at most one record) saved as binary files (see save_binary)
+    /// named fname.1, ..., fname.n and write their manifest (see
+    /// ShardManifest) to fname. Returns true on success, throws if n
+    /// is not between 1 and no. of records or if all records of a shard
+    /// would have zero weights.
+    bool save_shards(const std::string &fname, int n, bool write_info = true) const;
+    /// Load part of sharded dataset (see save_shards) assigned to worker
+    /// k of n (k = 1, ..., n), i.e. consecutive shards as in
+    /// ShardManifest::worker_shards, returns true on success. Only these
+    /// shards are read (a single shard is memory mapped as in load_mmap).
+    /// Throws if n is larger than the no. of shards or k is invalid.
+    bool load_shard(const std::string &fname, int k, int n, bool read_info = true);
+
     /// Retrieve input matrix.
     const Matrix<T>& get_input() const { return m_in; }
     /// Retrieve output matrix.
@@ -76,6 +157,29 @@ class Dataset
     /// Set record information.
     void set_record_info(int i, const std::string &info);
 
+    /// Are records weighted? Weighted records contribute to MSE
+    /// and gradient (see MLPNet::mse and MLPNet::grad) in proportion
+    /// to their weights.
+    inline bool weighted() const { return !m_wgt.empty(); }
+    /// Retrieve record weights (empty if records are not weighted).
+    const std::vector<T>& get_record_weights() const { return m_wgt; }
+    /// Set record weights (throws if their no. differs from the no.
+    /// of records, any of them is negative or not finite, or all are zero).
+    /// Empty vector removes weights.
+    void set_record_weights(const std::vector<T> &w);
+    /// Get weight of record i (1 if records are not weighted).
+    T get_record_weight(int i) const;
+    /// Sum of record weights (no. of records if records are not weighted).
+    T total_weight() const;
+
+    /// Fold duplicate records (with the same inputs and outputs) into
+    /// the first one of them adding their weights (1 for unweighted
+    /// records), so that MSE and gradient remain the same while they
+    /// are computed for unique records only. Records are found by hashing
+    /// and compared exactly, their order and descriptions of the first
+    /// ones are kept. Returns the no. of removed records.
+    int fold_duplicates();
+
   private:
     /// Data.
     Matrix<T> m_in, m_out;
@@ -83,10 +187,60 @@ class Dataset
     std::string m_info;
     /// Record descriptions.
     std::vector<std::string> m_rec_info;
+    /// Record weights (empty if records are not weighted).
+    std::vector<T> m_wgt;
+    /// Shared memory segment holding data (see load_shared).
+    std::shared_ptr<internal::shm_segment> m_shm;
+
+    /// Layout of binary file with source key of given length.
+    void bin_layout(internal::bin_hdr &h, bool write_info,
+                    std::size_t key_len) const;
+    /// Write binary file with key of the source (empty if none).
+    bool write_binary(const std::string &fname, bool write_info,
+                      const std::string &key) const;
+    /// Write image of binary file (without key) to memory.
+    void write_image(char *p, const internal::bin_hdr &h) const;
+    /// Load text data through binary cache.
+    bool load_cached(const std::string &fname, bool read_info);
 
 }; /* Dataset class template */
 
 
+namespace internal {
+
+
+/// Header of binary dataset file (see Dataset::save_binary). Input
+/// and output matrices are stored at offsets aligned to mem_map_align,
+/// each preceded by 64 bytes reserved for the reference count
+/// (see mem_map_file). Record weights are stored at wgt_off (0 if records
+/// are not weighted); version 1 files end the header before wgt_off.
+struct bin_hdr {
+    char magic[8];
+    std::uint32_t version, elem, layout, endian;
+    std::int64_t rows;
+    std::int32_t inputs, outputs;
+    std::int64_t in_off, out_off, info_off, info_len;
+    std::int64_t wgt_off;
+};
+
+/// Read and validate header of binary dataset file (also against the length
+/// of the file), returns true on success.
+bool read_bin_hdr(std::istream &is, bin_hdr &h);
+
+/// Key of the source of binary cache (path, size, modification time
+/// and contents hash of text file) stored between the header and input
+/// matrix of binary dataset file.
+struct src_key {
+    char magic[8];
+    std::int64_t size, mtime, mtime_ns;
+    std::uint64_t hash;
+    std::uint32_t path_len;
+};
+
+
+} /* namespace internal */
+
+
 } /* namespace fcnn */
 
 #endif /* FCNN_DATASET_H */
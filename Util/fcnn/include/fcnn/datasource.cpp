@@ -0,0 +1,277 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file datasource.cpp
+ *  \brief Sources of data read in blocks of records (out-of-core teaching).
+ */
+
+
+#include <fcnn/datasource.h>
+#include <fcnn/error.h>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+
+using namespace fcnn;
+using namespace fcnn::internal;
+
+
+
+namespace {
+
+
+// Reuse memory of matrix if the size agrees and it is not shared
+template <typename T>
+void
+prepare(Matrix<T> &m, int r, int c)
+{
+    if ((m.rows() == r) && (m.cols() == c)) m.mkunique();
+    else m.reset(r, c);
+}
+
+
+// Copy rows [i, i + n) of matrix
+template <typename T>
+void
+copy_rows(const Matrix<T> &src, int i, int n, Matrix<T> &dst)
+{
+    prepare(dst, n, src.cols());
+    for (int j = 0, r = src.rows(); j < src.cols(); ++j) {
+        memcpy(dst.ptr() + (idx_t) j * n, src.ptr() + (idx_t) j * r + i,
+               sizeof(T) * n);
+    }
+}
+
+
+// Thread reading blocks from source into one of two buffers on request
+template <typename T>
+class block_reader {
+  public:
+    block_reader(DataSource<T> &src, Matrix<T> *in, Matrix<T> *out)
+        : m_src(src), m_in(in), m_out(out), m_req(-1), m_done(false),
+          m_more(false), m_stop(false)
+    {
+        m_thr = std::thread(&block_reader::run, this);
+    }
+
+    ~block_reader()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_mtx);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thr.join();
+    }
+
+    // Start reading next block into buffer n
+    void request(int n)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_mtx);
+            m_req = n;
+            m_done = false;
+        }
+        m_cv.notify_all();
+    }
+
+    // Wait for the requested block, returns false if there are no more blocks
+    bool wait()
+    {
+        std::unique_lock<std::mutex> lk(m_mtx);
+        m_cv.wait(lk, [this]() { return m_done; });
+        if (m_err) {
+            std::exception_ptr e = m_err;
+            m_err = std::exception_ptr();
+            std::rethrow_exception(e);
+        }
+        return m_more;
+    }
+
+  private:
+    DataSource<T> &m_src;
+    Matrix<T> *m_in, *m_out;
+    std::thread m_thr;
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+    int m_req;
+    bool m_done, m_more, m_stop;
+    std::exception_ptr m_err;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lk(m_mtx);
+        for (;;) {
+            m_cv.wait(lk, [this]() { return m_stop || (m_req >= 0); });
+            if (m_stop) return;
+            int n = m_req;
+            m_req = -1;
+            lk.unlock();
+            bool more = false;
+            std::exception_ptr err;
+            try {
+                more = m_src.next(m_in[n], m_out[n]);
+            } catch (...) {
+                err = std::current_exception();
+            }
+            lk.lock();
+            m_more = more;
+            m_err = err;
+            m_done = true;
+            m_cv.notify_all();
+        }
+    }
+
+    block_reader(const block_reader&);
+    block_reader& operator=(const block_reader&);
+};
+
+
+} /* namespace */
+
+
+
+template <typename T>
+MatrixSource<T>::MatrixSource(const Matrix<T> &in, const Matrix<T> &out,
+                              int block_size)
+    : m_in(in), m_out(out), m_bs(block_size), m_pos(0)
+{
+    if (in.rows() != out.rows())
+        error("no. of rows in input and in output matrix disagree");
+    if (block_size < 1) error("block size should be positive");
+}
+
+
+template <typename T>
+MatrixSource<T>::MatrixSource(const Dataset<T> &dat, int block_size)
+    : m_in(dat.get_input()), m_out(dat.get_output()), m_bs(block_size), m_pos(0)
+{
+    if (block_size < 1) error("block size should be positive");
+    if (dat.weighted()) error("data sources do not support record weights");
+}
+
+
+template <typename T>
+bool
+MatrixSource<T>::next(Matrix<T> &in, Matrix<T> &out)
+{
+    if (m_pos >= m_in.rows()) return false;
+    int n = std::min(m_bs, m_in.rows() - m_pos);
+    copy_rows(m_in, m_pos, n, in);
+    copy_rows(m_out, m_pos, n, out);
+    m_pos += n;
+    return true;
+}
+
+
+
+template <typename T>
+BinaryFileSource<T>::BinaryFileSource(const std::string &fname, int block_size)
+    : m_bs(block_size), m_pos(0)
+{
+    if (block_size < 1) error("block size should be positive");
+    m_is.open(fname.c_str(), std::ios::binary);
+    if (m_is.fail()) error("failed to open file " + fname);
+    if (!read_bin_hdr(m_is, m_hdr)) error(fname + " is not a binary dataset file");
+    if (m_hdr.wgt_off) error("data sources do not support record weights");
+}
+
+
+template <typename T>
+void
+BinaryFileSource<T>::read(Matrix<T> &m, std::int64_t off, int n, int c)
+{
+    prepare(m, n, c);
+    std::size_t e = m_hdr.elem;
+    if (e != sizeof(T)) m_buf.resize(e * n);
+    for (int j = 0; j < c; ++j) {
+        m_is.seekg(off + 64 + (std::int64_t) e * ((std::int64_t) j * m_hdr.rows + m_pos));
+        char *p = (e == sizeof(T)) ? (char*) (m.ptr() + (idx_t) j * n) : &m_buf[0];
+        if (!m_is.read(p, (std::streamsize) (e * n)))
+            error("failed to read binary dataset file");
+        if (e == sizeof(T)) continue;
+        T *q = m.ptr() + (idx_t) j * n;
+        if (e == sizeof(float)) {
+            for (int i = 0; i < n; ++i) q[i] = (T) ((const float*) p)[i];
+        } else {
+            for (int i = 0; i < n; ++i) q[i] = (T) ((const double*) p)[i];
+        }
+    }
+}
+
+
+template <typename T>
+bool
+BinaryFileSource<T>::next(Matrix<T> &in, Matrix<T> &out)
+{
+    int r = (int) m_hdr.rows;
+    if (m_pos >= r) return false;
+    int n = std::min(m_bs, r - m_pos);
+    read(in, m_hdr.in_off, n, m_hdr.inputs);
+    read(out, m_hdr.out_off, n, m_hdr.outputs);
+    m_pos += n;
+    return true;
+}
+
+
+
+template <typename T>
+void
+fcnn::internal::stream_blocks(DataSource<T> &src,
+                              const std::function<bool(const Matrix<T>&,
+                                                       const Matrix<T>&)> &f)
+{
+    Matrix<T> in[2], out[2];
+    int c = 0;
+    src.rewind();
+    bool more = src.next(in[c], out[c]);
+    if (!more) return;
+    // one thread reads ahead into the other buffer for the whole pass
+    block_reader<T> reader(src, in, out);
+    while (more) {
+        int n = 1 - c;
+        reader.request(n);
+        // if f throws, the reader finishes the block before it is joined
+        bool cont = f(in[c], out[c]);
+        more = reader.wait() && cont;
+        c = n;
+    }
+}
+
+
+
+template class fcnn::MatrixSource<float>;
+template class fcnn::MatrixSource<double>;
+template class fcnn::BinaryFileSource<float>;
+template class fcnn::BinaryFileSource<double>;
+
+template void
+fcnn::internal::stream_blocks(DataSource<float>&,
+                              const std::function<bool(const Matrix<float>&,
+                                                       const Matrix<float>&)>&);
+template void
+fcnn::internal::stream_blocks(DataSource<double>&,
+                              const std::function<bool(const Matrix<double>&,
+                                                       const Matrix<double>&)>&);
@@ -0,0 +1,156 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file datasource.h
+ *  \brief Sources of data read in blocks of records (out-of-core teaching).
+ */
+
+
+#ifndef FCNN_DATASOURCE_H
+
+#define FCNN_DATASOURCE_H
+
+
+#include <fcnn/mat.h>
+#include <fcnn/dataset.h>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+namespace fcnn {
+
+
+/// Abstract source of data delivered in blocks of records. Streaming
+/// versions of MLPNet::grad, MLPNet::mse and of the batch teaching
+/// algorithms accumulate over all blocks, reading the next block
+/// in a separate thread while the current one is processed, so only two
+/// blocks are held in memory at a time. Member functions are never called
+/// concurrently.
+template <typename T>
+class DataSource
+{
+  public:
+    /// Destructor.
+    virtual ~DataSource() { ; }
+
+    /// Get no. of records (all blocks).
+    virtual int no_records() const = 0;
+    /// Get no. of inputs.
+    virtual int no_inputs() const = 0;
+    /// Get no. of outputs.
+    virtual int no_outputs() const = 0;
+
+    /// Start again from the first block.
+    virtual void rewind() = 0;
+    /// Read next block of records into in and out (their memory is reused
+    /// if possible). Returns false if there are no more blocks.
+    virtual bool next(Matrix<T> &in, Matrix<T> &out) = 0;
+
+}; /* class template DataSource */
+
+
+/// Data source reading blocks of records from matrices (e.g. dataset
+/// loaded with Dataset::load_mmap, so that pages are read from disk
+/// as blocks are copied).
+template <typename T>
+class MatrixSource : public DataSource<T>
+{
+  public:
+    /// Constructor (block size is given as no. of records).
+    MatrixSource(const Matrix<T> &in, const Matrix<T> &out, int block_size);
+    /// Constructor (block size is given as no. of records). Throws
+    /// if records are weighted.
+    MatrixSource(const Dataset<T> &dat, int block_size);
+
+    int no_records() const { return m_in.rows(); }
+    int no_inputs() const { return m_in.cols(); }
+    int no_outputs() const { return m_out.cols(); }
+
+    void rewind() { m_pos = 0; }
+    bool next(Matrix<T> &in, Matrix<T> &out);
+
+  private:
+    /// Data.
+    Matrix<T> m_in, m_out;
+    /// Block size.
+    int m_bs;
+    /// First record of the next block (0-based).
+    int m_pos;
+
+}; /* class template MatrixSource */
+
+
+/// Data source reading blocks of records from binary dataset file
+/// (see Dataset::save_binary) with ordinary file reads, so that data
+/// need not fit in memory (nor in address space). Data saved
+/// with the other floating point type is converted.
+template <typename T>
+class BinaryFileSource : public DataSource<T>
+{
+  public:
+    /// Constructor (block size is given as no. of records);
+    /// throws if file cannot be opened, is not a binary dataset
+    /// or records are weighted.
+    BinaryFileSource(const std::string &fname, int block_size);
+
+    int no_records() const { return (int) m_hdr.rows; }
+    int no_inputs() const { return m_hdr.inputs; }
+    int no_outputs() const { return m_hdr.outputs; }
+
+    void rewind() { m_pos = 0; }
+    bool next(Matrix<T> &in, Matrix<T> &out);
+
+  private:
+    /// File.
+    std::ifstream m_is;
+    /// Header.
+    internal::bin_hdr m_hdr;
+    /// Block size.
+    int m_bs;
+    /// First record of the next block (0-based).
+    int m_pos;
+    /// Buffer for conversion.
+    std::vector<char> m_buf;
+
+    /// Read n records starting at m_pos of c columns stored at offset.
+    void read(Matrix<T> &m, std::int64_t off, int n, int c);
+
+}; /* class template BinaryFileSource */
+
+
+namespace internal {
+
+
+/// Pass over all blocks of data calling f for each block (until it returns
+/// false). The next block is read while f runs by a single reader thread
+/// started for the pass.
+template <typename T>
+void stream_blocks(DataSource<T> &src,
+                   const std::function<bool(const Matrix<T>&, const Matrix<T>&)> &f);
+
+
+} /* namespace internal */
+} /* namespace fcnn */
+
+
+#endif /* FCNN_DATASOURCE_H */
@@ -27,11 +27,20 @@
 #define FCNN_FCNN_H
 
 #include <fcnn/mat.h>
+#include <fcnn/matview.h>
 #include <fcnn/matops.h>
+#include <fcnn/pool.h>
 #include <fcnn/dataset.h>
+#include <fcnn/datasource.h>
+#include <fcnn/shard.h>
+#include <fcnn/compress.h>
+#include <fcnn/sparse.h>
 #include <fcnn/mlpnet.h>
 #include <fcnn/mlpnet_teach.h>
 #include <fcnn/mlpnet_prune.h>
+#include <fcnn/mlpnet_lowrank.h>
+#include <fcnn/mlpnet_distill.h>
+#include <fcnn/mlpnet_snapshot.h>
 #include <fcnn/timing.h>
 
 #endif /* FCNN_FCNN_H */
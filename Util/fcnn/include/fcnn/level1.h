@@ -70,7 +70,7 @@ F77_FUNC(daxpy,DAXPY)(const int *n, const double *da,
 /// BLAS1 dot product
 inline
 float
-dot(int n, const float* x, int incx, const float* y, int incy)
+dot(int n, const float* x, idx_t incx, const float* y, idx_t incy)
 {
 #if 0 // defined(HAVE_BLAS)
     return F77_FUNC(sdot,SDOT)(&n, x, &incx, y, &incy);
@@ -83,7 +83,7 @@ dot(int n, const float* x, int incx, const float* y, int incy)
 /// BLAS1 dot product
 inline
 double
-dot(int n, const double* x, int incx, const double* y, int incy)
+dot(int n, const double* x, idx_t incx, const double* y, idx_t incy)
 {
 #if 0 // defined(HAVE_BLAS)
     return F77_FUNC(ddot,DDOT)(&n, x, &incx, y, &incy);
@@ -94,11 +94,30 @@ dot(int n, const double* x, int incx, const double* y, int incy)
 
 
 
+/// Dot product of padded vectors (n is a multiple of 8, unit increments)
+inline
+float
+dotp(int n, const float* x, const float* y)
+{
+    return DOTP<float, 8>::dot(n, x, y);
+}
+
+
+/// Dot product of padded vectors (n is a multiple of 4, unit increments)
+inline
+double
+dotp(int n, const double* x, const double* y)
+{
+    return DOTP<double, 4>::dot(n, x, y);
+}
+
+
+
 
 /// BLAS1 copy
 inline
 void
-copy(int n, const float* x, int incx, float* y, int incy)
+copy(int n, const float* x, idx_t incx, float* y, idx_t incy)
 {
 #if 0 // defined(HAVE_BLAS)
     F77_FUNC(scopy,SCOPY)(&n, x, &incx, y, &incy);
@@ -111,7 +130,7 @@ copy(int n, const float* x, int incx, float* y, int incy)
 /// BLAS1 copy
 inline
 void
-copy(int n, const double* x, int incx, double* y, int incy)
+copy(int n, const double* x, idx_t incx, double* y, idx_t incy)
 {
 #if 0 // defined(HAVE_BLAS)
     F77_FUNC(dcopy,DCOPY)(&n, x, &incx, y, &incy);
@@ -127,7 +146,7 @@ copy(int n, const double* x, int incx, double* y, int incy)
 /// BLAS1 axpy
 inline
 void
-axpy(int n, const float &a, const float* x, int incx, float* y, int incy)
+axpy(int n, const float &a, const float* x, idx_t incx, float* y, idx_t incy)
 {
 #if 0 // defined(HAVE_BLAS)
     F77_FUNC(saxpy,SAXPY)(&n, &a, x, &incx, y, &incy);
@@ -140,7 +159,7 @@ axpy(int n, const float &a, const float* x, int incx, float* y, int incy)
 /// BLAS1 axpy
 inline
 void
-axpy(int n, const double &a, const double* x, int incx, double* y, int incy)
+axpy(int n, const double &a, const double* x, idx_t incx, double* y, idx_t incy)
 {
 #if 0 // defined(HAVE_BLAS)
     F77_FUNC(daxpy,DAXPY)(&n, &a, x, &incx, y, &incy);
@@ -151,11 +170,30 @@ axpy(int n, const double &a, const double* x, int incx, double* y, int incy)
 
 
 
+/// Axpy on padded vectors (n is a multiple of 8, unit increments)
+inline
+void
+axpyp(int n, const float &a, const float* x, float* y)
+{
+    AXPYP<float, 8>::axpy(n, a, x, y);
+}
+
+
+/// Axpy on padded vectors (n is a multiple of 4, unit increments)
+inline
+void
+axpyp(int n, const double &a, const double* x, double* y)
+{
+    AXPYP<double, 4>::axpy(n, a, x, y);
+}
+
+
+
 
 /// Vector difference, x - y -> z
 inline
 void
-diff(int n, const float* x, int incx, const float* y, int incy, float* z, int incz)
+diff(int n, const float* x, idx_t incx, const float* y, idx_t incy, float* z, idx_t incz)
 {
     return DIFF<float, 4>::diff(n, x, incx, y, incy, z, incz);
 }
@@ -164,7 +202,7 @@ diff(int n, const float* x, int incx, const float* y, int incy, float* z, int in
 /// Vector difference, x - y -> z
 inline
 void
-diff(int n, const double* x, int incx, const double* y, int incy, double* z, int incz)
+diff(int n, const double* x, idx_t incx, const double* y, idx_t incy, double* z, idx_t incz)
 {
     return DIFF<double, 4>::diff(n, x, incx, y, incy, z, incz);
 }
@@ -175,7 +213,7 @@ diff(int n, const double* x, int incx, const double* y, int incy, double* z, int
 /// Sum of squared differences
 inline
 float
-sumsqdiff(int n, const float* x, int incx, const float* y, int incy)
+sumsqdiff(int n, const float* x, idx_t incx, const float* y, idx_t incy)
 {
     return SUMSQDIFF<float, 4>::sumsqdiff(n, x, incx, y, incy);
 }
@@ -184,7 +222,7 @@ sumsqdiff(int n, const float* x, int incx, const float* y, int incy)
 /// Sum of squared differences
 inline
 double
-sumsqdiff(int n, const double* x, int incx, const double* y, int incy)
+sumsqdiff(int n, const double* x, idx_t incx, const double* y, idx_t incy)
 {
     return SUMSQDIFF<double, 4>::sumsqdiff(n, x, incx, y, incy);
 }
@@ -195,7 +233,7 @@ sumsqdiff(int n, const double* x, int incx, const double* y, int incy)
 /// Sum of squares
 inline
 float
-sumsq(int n, const float* x, int incx)
+sumsq(int n, const float* x, idx_t incx)
 {
     return SUMSQ<float, 4>::sumsq(n, x, incx);
 }
@@ -204,7 +242,7 @@ sumsq(int n, const float* x, int incx)
 /// Sum of squares
 inline
 double
-sumsq(int n, const double* x, int incx)
+sumsq(int n, const double* x, idx_t incx)
 {
     return SUMSQ<double, 4>::sumsq(n, x, incx);
 }
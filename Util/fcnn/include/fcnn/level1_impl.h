@@ -27,6 +27,9 @@
 #define FCNN_LEVEL1_IMPL_H
 
 
+#include <fcnn/rcarr.h>
+
+
 namespace fcnn {
 namespace internal {
 
@@ -35,7 +38,7 @@ namespace internal {
 
 template <typename T, int N>
 struct DOT_BLOCK {
-    static inline T dot(const T* x, int incx, const T* y, int incy) {
+    static inline T dot(const T* x, idx_t incx, const T* y, idx_t incy) {
         return *x * *y + DOT_BLOCK<T, N - 1>::dot(x + incx, incx, y + incy, incy);
     }
 };
@@ -43,14 +46,14 @@ struct DOT_BLOCK {
 
 template <typename T>
 struct DOT_BLOCK<T, 1> {
-    static inline T dot(const T* x, int incx, const T* y, int incy) {
+    static inline T dot(const T* x, idx_t incx, const T* y, idx_t incy) {
         return *x * *y;
     }
 };
 
 template <typename T, int N>
 struct DOT_SWITCH {
-    static inline T dot(int n, const T* x, int incx, const T* y, int incy) {
+    static inline T dot(int n, const T* x, idx_t incx, const T* y, idx_t incy) {
         if (n == N) return DOT_BLOCK<T, N>::dot(x, incx, y, incy);
         else return DOT_SWITCH<T, N - 1>::dot(n, x, incx, y, incy);
     }
@@ -58,16 +61,16 @@ struct DOT_SWITCH {
 
 template <typename T>
 struct DOT_SWITCH<T, 0> {
-    static inline T dot(int n, const T* x, int incx, const T* y, int incy) {
+    static inline T dot(int n, const T* x, idx_t incx, const T* y, idx_t incy) {
         return T();
     }
 };
 
 template <typename T, int N>
 struct DOT_UNROLL {
-    static inline T dot(int k, const T* x, int incx, const T* y, int incy) {
+    static inline T dot(int k, const T* x, idx_t incx, const T* y, idx_t incy) {
         T s = T();
-        int incxN = incx * N, incyN = incy * N;
+        idx_t incxN = incx * N, incyN = incy * N;
         for (int i = 0; i < k; ++i, x += incxN, y += incyN)
             s += DOT_BLOCK<T, N>::dot(x, incx, y, incy);
         return s;
@@ -76,7 +79,7 @@ struct DOT_UNROLL {
 
 template <typename T, int N>
 struct DOT {
-    static inline T dot(int n, const T* x, int incx, const T* y, int incy) {
+    static inline T dot(int n, const T* x, idx_t incx, const T* y, idx_t incy) {
         if (n >= N)  {
             int k = n / N, kr = n % N;
             return DOT_UNROLL<T, N>::dot(k, x, incx, y, incy)
@@ -87,12 +90,29 @@ struct DOT {
 
 
 
+// Dot product of padded vectors (n is a multiple of N, unit increments),
+// N independent partial sums allow vectorisation.
+template <typename T, int N>
+struct DOTP {
+    static inline T dot(int n, const T* x, const T* y) {
+        T s[N];
+        for (int j = 0; j < N; ++j) s[j] = T();
+        for (int i = 0; i < n; i += N, x += N, y += N)
+            for (int j = 0; j < N; ++j) s[j] += x[j] * y[j];
+        T r = T();
+        for (int j = 0; j < N; ++j) r += s[j];
+        return r;
+    }
+};
+
+
+
 
 
 
 template <typename T, int N>
 struct COPY_BLOCK {
-    static inline void copy(const T* x, int incx, T* y, int incy) {
+    static inline void copy(const T* x, idx_t incx, T* y, idx_t incy) {
         *y = *x;
         COPY_BLOCK<T, N - 1>::copy(x + incx, incx, y + incy, incy);
     }
@@ -100,14 +120,14 @@ struct COPY_BLOCK {
 
 template <typename T>
 struct COPY_BLOCK<T, 1> {
-    static inline void copy(const T* x, int incx, T* y, int incy) {
+    static inline void copy(const T* x, idx_t incx, T* y, idx_t incy) {
         *y = *x;
     }
 };
 
 template <typename T, int N>
 struct COPY_SWITCH {
-    static inline void copy(int n, const T* x, int incx, T* y, int incy) {
+    static inline void copy(int n, const T* x, idx_t incx, T* y, idx_t incy) {
         if (n == N) COPY_BLOCK<T, N>::copy(x, incx, y, incy); else
         COPY_SWITCH<T, N - 1>::copy(n, x, incx, y, incy);
     }
@@ -115,15 +135,15 @@ struct COPY_SWITCH {
 
 template <typename T>
 struct COPY_SWITCH<T, 0> {
-    static inline void copy(int n, const T* x, int incx, T* y, int incy) {
+    static inline void copy(int n, const T* x, idx_t incx, T* y, idx_t incy) {
         ;
     }
 };
 
 template <typename T, int N>
 struct COPY_UNROLL {
-    static inline void copy(int k, const T* x, int incx, T* y, int incy) {
-        int incxN = incx * N, incyN = incy * N;
+    static inline void copy(int k, const T* x, idx_t incx, T* y, idx_t incy) {
+        idx_t incxN = incx * N, incyN = incy * N;
         for (int i = 0; i < k; ++i, x += incxN, y += incyN)
             COPY_BLOCK<T, N>::copy(x, incx, y, incy);
     }
@@ -131,7 +151,7 @@ struct COPY_UNROLL {
 
 template <typename T, int N>
 struct COPY {
-    static inline void copy(int n, const T* x, int incx, T* y, int incy) {
+    static inline void copy(int n, const T* x, idx_t incx, T* y, idx_t incy) {
         if (n >= N)  {
             int k = n / N, kr = n % N;
             COPY_UNROLL<T, N>::copy(k, x, incx, y, incy);
@@ -147,7 +167,7 @@ struct COPY {
 
 template <typename T, int N>
 struct AXPY_BLOCK {
-    static inline void axpy(const T &a, const T* x, int incx, T* y, int incy) {
+    static inline void axpy(const T &a, const T* x, idx_t incx, T* y, idx_t incy) {
         *y += a * *x;
         AXPY_BLOCK<T, N - 1>::axpy(a, x + incx, incx, y + incy, incy);
     }
@@ -155,14 +175,14 @@ struct AXPY_BLOCK {
 
 template <typename T>
 struct AXPY_BLOCK<T, 1> {
-    static inline void axpy(const T &a, const T* x, int incx, T* y, int incy) {
+    static inline void axpy(const T &a, const T* x, idx_t incx, T* y, idx_t incy) {
         *y += a * *x;
     }
 };
 
 template <typename T, int N>
 struct AXPY_SWITCH {
-    static inline void axpy(int n, const T &a, const T* x, int incx, T* y, int incy) {
+    static inline void axpy(int n, const T &a, const T* x, idx_t incx, T* y, idx_t incy) {
         if (n == N) AXPY_BLOCK<T, N>::axpy(a, x, incx, y, incy); else
         AXPY_SWITCH<T, N - 1>::axpy(n, a, x, incx, y, incy);
     }
@@ -170,15 +190,15 @@ struct AXPY_SWITCH {
 
 template <typename T>
 struct AXPY_SWITCH<T, 0> {
-    static inline void axpy(int n, const T &a, const T* x, int incx, T* y, int incy) {
+    static inline void axpy(int n, const T &a, const T* x, idx_t incx, T* y, idx_t incy) {
         ;
     }
 };
 
 template <typename T, int N>
 struct AXPY_UNROLL {
-    static inline void axpy(int k, const T &a, const T* x, int incx, T* y, int incy) {
-        int incxN = incx * N, incyN = incy * N;
+    static inline void axpy(int k, const T &a, const T* x, idx_t incx, T* y, idx_t incy) {
+        idx_t incxN = incx * N, incyN = incy * N;
         for (int i = 0; i < k; ++i, x += incxN, y += incyN)
             AXPY_BLOCK<T, N>::axpy(a, x, incx, y, incy);
     }
@@ -186,7 +206,7 @@ struct AXPY_UNROLL {
 
 template <typename T, int N>
 struct AXPY {
-    static inline void axpy(int n, const T &a, const T* x, int incx, T* y, int incy) {
+    static inline void axpy(int n, const T &a, const T* x, idx_t incx, T* y, idx_t incy) {
         if (n >= N) {
             int k = n / N, kr = n % N;
             AXPY_UNROLL<T, N>::axpy(k, a, x, incx, y, incy);
@@ -198,13 +218,24 @@ struct AXPY {
 
 
 
+// Axpy on padded vectors (n is a multiple of N, unit increments).
+template <typename T, int N>
+struct AXPYP {
+    static inline void axpy(int n, const T &a, const T* x, T* y) {
+        for (int i = 0; i < n; i += N, x += N, y += N)
+            for (int j = 0; j < N; ++j) y[j] += a * x[j];
+    }
+};
+
+
+
 
 
 
 template <typename T, int N>
 struct DIFF_BLOCK {
-    static inline void diff(const T* x, int incx, const T* y, int incy,
-                            T* z, int incz) {
+    static inline void diff(const T* x, idx_t incx, const T* y, idx_t incy,
+                            T* z, idx_t incz) {
         *z = *x - *y;
         DIFF_BLOCK<T, N - 1>::diff(x + incx, incx, y + incy, incy, z + incz, incz);
     }
@@ -212,16 +243,16 @@ struct DIFF_BLOCK {
 
 template <typename T>
 struct DIFF_BLOCK<T, 1> {
-    static inline void diff(const T* x, int incx, const T* y, int incy,
-                            T* z, int incz) {
+    static inline void diff(const T* x, idx_t incx, const T* y, idx_t incy,
+                            T* z, idx_t incz) {
         *z = *x - *y;
     }
 };
 
 template <typename T, int N>
 struct DIFF_SWITCH {
-    static inline void diff(int n, const T* x, int incx, const T* y, int incy,
-                            T* z, int incz) {
+    static inline void diff(int n, const T* x, idx_t incx, const T* y, idx_t incy,
+                            T* z, idx_t incz) {
         if (n == N) DIFF_BLOCK<T, N>::diff(x, incx, y, incy, z, incz); else
         DIFF_SWITCH<T, N - 1>::diff(n, x, incx, y, incy, z, incz);
     }
@@ -229,16 +260,16 @@ struct DIFF_SWITCH {
 
 template <typename T>
 struct DIFF_SWITCH<T, 0> {
-    static inline void diff(int n, const T* x, int incx, const T* y, int incy, T* z, int incz) {
+    static inline void diff(int n, const T* x, idx_t incx, const T* y, idx_t incy, T* z, idx_t incz) {
         ;
     }
 };
 
 template <typename T, int N>
 struct DIFF_UNROLL {
-    static inline void diff(int k, const T* x, int incx, const T* y, int incy,
-                            T* z, int incz) {
-        int incxN = incx * N, incyN = incy * N, inczN = incz * N;
+    static inline void diff(int k, const T* x, idx_t incx, const T* y, idx_t incy,
+                            T* z, idx_t incz) {
+        idx_t incxN = incx * N, incyN = incy * N, inczN = incz * N;
         for (int i = 0; i < k; ++i, x += incxN, y += incyN, z += inczN)
             DIFF_BLOCK<T, N>::diff(x, incx, y, incy, z, incz);
     }
@@ -246,8 +277,8 @@ struct DIFF_UNROLL {
 
 template <typename T, int N>
 struct DIFF {
-    static inline void diff(int n, const T* x, int incx, const T* y, int incy,
-                            T* z, int incz) {
+    static inline void diff(int n, const T* x, idx_t incx, const T* y, idx_t incy,
+                            T* z, idx_t incz) {
         if (n >= N)  {
             int k = n / N, kr = n % N;
             DIFF_UNROLL<T, N>::diff(k, x, incx, y, incy, z, incz);
@@ -266,7 +297,7 @@ struct DIFF {
 
 template <typename T, int N>
 struct SMSQDIFF {
-    static inline T sumsqdiff(const T* x, int incx, const T* y, int incy) {
+    static inline T sumsqdiff(const T* x, idx_t incx, const T* y, idx_t incy) {
         T d = *x - *y;
         return d * d + SMSQDIFF<T, N - 1>::sumsqdiff(x + incx, incx, y + incy, incy);
     }
@@ -274,7 +305,7 @@ struct SMSQDIFF {
 
 template <typename T>
 struct SMSQDIFF<T, 1> {
-    static inline T sumsqdiff(const T* x, int incx, const T* y, int incy) {
+    static inline T sumsqdiff(const T* x, idx_t incx, const T* y, idx_t incy) {
         T d = *x - *y;
         return d * d;
     }
@@ -282,7 +313,7 @@ struct SMSQDIFF<T, 1> {
 
 template <typename T, int N>
 struct SUMSQDIFF_SWITCH {
-    static inline T sumsqdiff(int n, const T* x, int incx, const T* y, int incy) {
+    static inline T sumsqdiff(int n, const T* x, idx_t incx, const T* y, idx_t incy) {
         if (n == N) return SMSQDIFF<T, N>::sumsqdiff(x, incx, y, incy);
         else return SUMSQDIFF_SWITCH<T, N - 1>::sumsqdiff(n, x, incx, y, incy);
     }
@@ -290,16 +321,16 @@ struct SUMSQDIFF_SWITCH {
 
 template <typename T>
 struct SUMSQDIFF_SWITCH<T, 0> {
-    static inline T sumsqdiff(int n, const T* x, int incx, const T* y, int incy) {
+    static inline T sumsqdiff(int n, const T* x, idx_t incx, const T* y, idx_t incy) {
         return T();
     }
 };
 
 template <typename T, int N>
 struct SUMSQDIFF_UNROLL {
-    static inline T sumsqdiff(int k, const T* x, int incx, const T* y, int incy) {
+    static inline T sumsqdiff(int k, const T* x, idx_t incx, const T* y, idx_t incy) {
         T s = T();
-        int incxN = incx * N, incyN = incy * N;
+        idx_t incxN = incx * N, incyN = incy * N;
         for (int i = 0; i < k; ++i, x += incxN, y += incyN)
             s += SMSQDIFF<T, N>::sumsqdiff(x, incx, y, incy);
         return s;
@@ -308,7 +339,7 @@ struct SUMSQDIFF_UNROLL {
 
 template <typename T, int N>
 struct SUMSQDIFF {
-    static inline T sumsqdiff(int n, const T* x, int incx, const T* y, int incy) {
+    static inline T sumsqdiff(int n, const T* x, idx_t incx, const T* y, idx_t incy) {
         if (n >= N)  {
             int k = n / N, kr = n % N;
             return SUMSQDIFF_UNROLL<T, N>::sumsqdiff(k, x, incx, y, incy)
@@ -323,7 +354,7 @@ struct SUMSQDIFF {
 
 template <typename T, int N>
 struct SUMSQ_BLOCK {
-    static inline T sumsq(const T* x, int incx) {
+    static inline T sumsq(const T* x, idx_t incx) {
         return *x * *x + SUMSQ_BLOCK<T, N - 1>::sumsq(x + incx, incx);
     }
 };
@@ -331,14 +362,14 @@ struct SUMSQ_BLOCK {
 
 template <typename T>
 struct SUMSQ_BLOCK<T, 1> {
-    static inline T sumsq(const T* x, int incx) {
+    static inline T sumsq(const T* x, idx_t incx) {
         return *x * *x;
     }
 };
 
 template <typename T, int N>
 struct SUMSQ_SWITCH {
-    static inline T sumsq(int n, const T* x, int incx) {
+    static inline T sumsq(int n, const T* x, idx_t incx) {
         if (n == N) return SUMSQ_BLOCK<T, N>::sumsq(x, incx);
         else return SUMSQ_SWITCH<T, N - 1>::sumsq(n, x, incx);
     }
@@ -346,16 +377,16 @@ struct SUMSQ_SWITCH {
 
 template <typename T>
 struct SUMSQ_SWITCH<T, 0> {
-    static inline T sumsq(int n, const T* x, int incx) {
+    static inline T sumsq(int n, const T* x, idx_t incx) {
         return T();
     }
 };
 
 template <typename T, int N>
 struct SUMSQ_UNROLL {
-    static inline T sumsq(int k, const T* x, int incx) {
+    static inline T sumsq(int k, const T* x, idx_t incx) {
         T s = T();
-        int incxN = incx * N;
+        idx_t incxN = incx * N;
         for (int i = 0; i < k; ++i, x += incxN)
             s += SUMSQ_BLOCK<T, N>::sumsq(x, incx);
         return s;
@@ -364,7 +395,7 @@ struct SUMSQ_UNROLL {
 
 template <typename T, int N>
 struct SUMSQ {
-    static inline T sumsq(int n, const T* x, int incx) {
+    static inline T sumsq(int n, const T* x, idx_t incx) {
         if (n >= N)  {
             int k = n / N, kr = n % N;
             return SUMSQ_UNROLL<T, N>::sumsq(k, x, incx)
@@ -31,6 +31,41 @@
 using namespace fcnn::internal;
 
 
+
+namespace {
+
+
+// Backpropagate deltas of neurons n0, ..., n1 - 1 of (0-based) layer l
+// (packed weights, padded states and deltas): derivatives w.r.t. their
+// weights are accumulated in grad (packed layout) unless grad is null,
+// deltas of layer l - 1 are updated if prop is set.
+template <typename T>
+void
+backprop_layer(const mlp_packed<T> &w, int l, int n0, int n1,
+               const int *af, const T *af_p,
+               const T *n_st, T *delta, T *grad, bool prop)
+{
+    int ld = w.ld(l - 1);
+    const T *W = w.w(l) + n0 * ld, *nst = n_st + w.st_off(l),
+            *nplptr = n_st + w.st_off(l - 1);
+    T *dl = delta + w.st_off(l), *dpl = delta + w.st_off(l - 1);
+    T *gW = grad ? grad + w.w_off(l) + n0 * ld : 0,
+      *gB = grad ? grad + w.b_off(l) : 0;
+    int actf = af[l]; T actfp = af_p[l];
+    for (int n = n0; n < n1; ++n, W += ld) {
+        T d = dl[n] * mlp_act_f_der(actf, actfp, nst[n]);
+        if (prop) axpyp(ld, d, W, dpl);
+        if (!grad) continue;
+        axpyp(ld, d, nplptr, gW);
+        gW += ld;
+        gB[n] += d;
+    }
+}
+
+
+} /* namespace */
+
+
 template <typename T>
 void
 fcnn::internal::feedf(const int *lays, int no_lays, const int *n_pts,
@@ -72,35 +107,41 @@ fcnn::internal::feedf(const int *lays, int no_lays, const int *n_pts,
 
 template <typename T>
 void
-fcnn::internal::backprop(const int *lays, int no_lays, const int *n_pts,
-                         int no_weights, const T *w_val,
-                         const int *af, const T *af_p,
-                         const T *n_st, T *delta, T *grad)
+fcnn::internal::feedf(const mlp_packed<T> &w, const int *af, const T *af_p,
+                      T *n_st, int l0)
 {
-    // initialisation
-    int l = no_lays - 1, ni = n_pts[no_lays] - 1, wi = no_weights, nlpl;
-    register T d;
-    int actf; T actfp;
-    // output and hidden layers except for the 1st
-    for (; l > 1; --l) {
-        nlpl = lays[l - 1];
-        actf = af[l]; actfp = af_p[l];
-        for (int nl = lays[l]; nl; --nl, --ni) {
-            d = delta[ni] * mlp_act_f_der(actf, actfp, n_st[ni]);
-            wi -= nlpl;
-            axpy(nlpl, d, w_val + wi, 1, delta + n_pts[l - 1], 1);
-            axpy(nlpl, d, n_st + n_pts[l - 1], 1, grad + wi, 1);
-            grad[--wi] += d;
+    for (int l = l0, L = w.no_layers(); l < L; ++l) {
+        int ld = w.ld(l - 1), nn = w.no_neurons(l);
+        const T *W = w.w(l), *B = w.b(l), *nplptr = n_st + w.st_off(l - 1);
+        T *nptr = n_st + w.st_off(l);
+        int actf = af[l]; T actfp = af_p[l];
+        for (int n = 0; n < nn; ++n, W += ld) {
+            // bias + dot product, activation
+            nptr[n] = mlp_act_f(actf, actfp, B[n] + dotp(ld, nplptr, W));
         }
     }
-    // first hidden layer
-    nlpl = lays[0];
-    actf = af[l]; actfp = af_p[l];
-    for (int nl = lays[l]; nl; --nl, --ni) {
-        d = delta[ni] * mlp_act_f_der(actf, actfp, n_st[ni]);
-        wi -= nlpl;
-        axpy(nlpl, d, n_st + n_pts[l - 1], 1, grad + wi, 1);
-        grad[--wi] += d;
+}
+
+
+
+template <typename T>
+void
+fcnn::internal::hash_expand(const int *lays, int no_lays, const int *w_pts,
+                            const int *hb, const unsigned *hs, const T *hval,
+                            T *w_val)
+{
+    for (int l = 1; l < no_lays; hval += hb[l++]) {
+        if (!hb[l]) continue;
+        int npl = lays[l - 1];
+        T *w = w_val + w_pts[l];
+        for (int n = 0; n < lays[l]; ++n) {
+            ++w; // bias
+            for (int p = 0; p < npl; ++p, ++w) {
+                unsigned h = mlp_hash(hs[l], n, p, npl);
+                T v = hval[(h & 0x7fffffffu) % (unsigned) hb[l]];
+                *w = (h >> 31) ? -v : v;
+            }
+        }
     }
 }
 
@@ -108,45 +149,69 @@ fcnn::internal::backprop(const int *lays, int no_lays, const int *n_pts,
 
 template <typename T>
 void
-fcnn::internal::backpropj(const int *lays, int no_lays, const int *n_pts, int j,
-                          const int *w_pts, const T *w_val,
-                          const int *af, const T *af_p,
-                          const T *n_st, T *delta, T *grad)
+fcnn::internal::hash_reduce(const int *lays, int no_lays, const int *w_pts,
+                            const int *w_fl, const int *hb, const unsigned *hs,
+                            const T *x, T *y)
 {
-    // initialisation
-    int l = no_lays - 1, ni = n_pts[l] + j,
-        wi = w_pts[l] + j * (1 + lays[l - 1]) + 1, nlpl;
-    register T d;
-    int actf; T actfp;
-    // jth output neuron delta
-    actf = af[l]; actfp = af_p[l];
-    d = delta[ni] * mlp_act_f_der(actf, actfp, n_st[ni]);
-    nlpl = lays[l - 1];
-    axpy(nlpl, d, w_val + wi, 1, delta + n_pts[l - 1], 1);
-    axpy(nlpl, d, n_st + n_pts[l - 1], 1, grad + wi, 1);
-    grad[--wi] += d;
-    // hidden layers except for the 1st
-    wi = w_pts[l];
-    ni = n_pts[l] - 1;
-    for (--l; l > 1; --l) {
-        nlpl = lays[l - 1];
-        actf = af[l]; actfp = af_p[l];
-        for (int nl = lays[l]; nl; --nl, --ni) {
-            d = delta[ni] * mlp_act_f_der(actf, actfp, n_st[ni]);
-            wi -= nlpl;
-            axpy(nlpl, d, w_val + wi, 1, delta + n_pts[l - 1], 1);
-            axpy(nlpl, d, n_st + n_pts[l - 1], 1, grad + wi, 1);
-            grad[--wi] += d;
+    // no. of free parameters preceding buckets
+    int nf = 0, nb = 0;
+    for (int l = 1; l < no_lays; ++l) {
+        for (int i = w_pts[l], n = w_pts[l + 1]; i < n; ++i) nf += w_fl[i];
+        if (hb[l]) nf -= lays[l] * lays[l - 1];
+        nb += hb[l];
+    }
+    T *hval = y + nf;
+    for (int k = 0; k < nb; ++k) hval[k] = T();
+    for (int l = 1; l < no_lays; hval += hb[l++]) {
+        int npl = lays[l - 1];
+        const int *fl = w_fl + w_pts[l];
+        for (int n = 0; n < lays[l]; ++n) {
+            if (*fl++) *y++ = *x++; // bias
+            for (int p = 0; p < npl; ++p) {
+                if (!*fl++) continue;
+                if (hb[l]) {
+                    unsigned h = mlp_hash(hs[l], n, p, npl);
+                    T &v = hval[(h & 0x7fffffffu) % (unsigned) hb[l]];
+                    if (h >> 31) v -= *x++; else v += *x++;
+                } else *y++ = *x++;
+            }
         }
     }
-    // first hidden layer
-    nlpl = lays[0];
-    actf = af[l]; actfp = af_p[l];
-    for (int nl = lays[l]; nl; --nl, --ni) {
-        d = delta[ni] * mlp_act_f_der(actf, actfp, n_st[ni]);
-        wi -= nlpl;
-        axpy(nlpl, d, n_st + n_pts[l - 1], 1, grad + wi, 1);
-        grad[--wi] += d;
+}
+
+
+
+template <typename T>
+void
+fcnn::internal::backprop(const mlp_packed<T> &w, const int *af, const T *af_p,
+                         const T *n_st, T *delta, T *grad)
+{
+    for (int l = w.no_layers() - 1; l > 0; --l)
+        backprop_layer(w, l, 0, w.no_neurons(l), af, af_p,
+                       n_st, delta, grad, l > 1);
+}
+
+
+
+template <typename T>
+void
+fcnn::internal::backprop_sp(const mlp_packed<T> &w, const int *af, const T *af_p,
+                            int nnz, const int *idx, const T *val,
+                            const T *n_st, T *delta, T *grad)
+{
+    // output and hidden layers except for the 1st
+    for (int l = w.no_layers() - 1; l > 1; --l)
+        backprop_layer(w, l, 0, w.no_neurons(l), af, af_p,
+                       n_st, delta, grad, true);
+    // first hidden layer (non-zero inputs only)
+    int ld = w.ld(0), nn = w.no_neurons(1);
+    const T *nst = n_st + w.st_off(1), *dl = delta + w.st_off(1);
+    T *gW = grad + w.w_off(1), *gB = grad + w.b_off(1);
+    int actf = af[1]; T actfp = af_p[1];
+    for (int n = 0; n < nn; ++n, gW += ld) {
+        T d = dl[n] * mlp_act_f_der(actf, actfp, nst[n]);
+        for (int k = 0; k < nnz; ++k) gW[idx[k]] += d * val[k];
+        gB[n] += d;
     }
 }
 
@@ -154,34 +219,32 @@ fcnn::internal::backpropj(const int *lays, int no_lays, const int *n_pts, int j,
 
 template <typename T>
 void
-fcnn::internal::backpropjd(const int *lays, int no_lays, const int *n_pts, int j,
-                           const int *w_pts, const T *w_val,
-                           const int *af, const T *af_p,
+fcnn::internal::backpropj(const mlp_packed<T> &w, int j, const int *af, const T *af_p,
+                          const T *n_st, T *delta, T *grad)
+{
+    int L = w.no_layers() - 1;
+    // jth output neuron
+    backprop_layer(w, L, j, j + 1, af, af_p, n_st, delta, grad, L > 1);
+    // hidden layers
+    for (int l = L - 1; l > 0; --l)
+        backprop_layer(w, l, 0, w.no_neurons(l), af, af_p,
+                       n_st, delta, grad, l > 1);
+}
+
+
+
+template <typename T>
+void
+fcnn::internal::backpropjd(const mlp_packed<T> &w, int j, const int *af, const T *af_p,
                            const T *n_st, T *delta)
 {
-    // initialisation
-    int l = no_lays - 1, ni = n_pts[l] + j,
-        wi = w_pts[l] + j * (1 + lays[l - 1]) + 1, nlpl;
-    register T d;
-    int actf; T actfp;
-    // jth output neuron delta
-    actf = af[l]; actfp = af_p[l];
-    d = delta[ni] * mlp_act_f_der(actf, actfp, n_st[ni]);
-    nlpl = lays[l - 1];
-    axpy(nlpl, d, w_val + wi, 1, delta + n_pts[l - 1], 1);
+    int L = w.no_layers() - 1;
+    // jth output neuron
+    backprop_layer(w, L, j, j + 1, af, af_p, n_st, delta, (T*) 0, true);
     // hidden layers
-    wi = w_pts[l];
-    ni = n_pts[l] - 1;
-    for (--l; l; --l) {
-        nlpl = lays[l - 1];
-        actf = af[l]; actfp = af_p[l];
-        for (int nl = lays[l]; nl; --nl, --ni) {
-            d = delta[ni] * mlp_act_f_der(actf, actfp, n_st[ni]);
-            wi -= nlpl;
-            axpy(nlpl, d, w_val + wi, 1, delta + n_pts[l - 1], 1);
-            --wi;
-        }
-    }
+    for (int l = L - 1; l > 0; --l)
+        backprop_layer(w, l, 0, w.no_neurons(l), af, af_p,
+                       n_st, delta, (T*) 0, true);
 }
 
 
@@ -191,26 +254,50 @@ fcnn::internal::backpropjd(const int *lays, int no_lays, const int *n_pts, int j
 template void fcnn::internal::feedf(const int*, int, const int*,
                                     const float*, const int*, const float*,
                                     float*);
-template void fcnn::internal::backprop(const int*, int, const int*,
-                                       int, const float*, const int*, const float*,
+template void fcnn::internal::feedf(const mlp_packed<float>&,
+                                    const int*, const float*, float*, int);
+template void fcnn::internal::hash_expand(const int*, int, const int*,
+                                          const int*, const unsigned*,
+                                          const float*, float*);
+template void fcnn::internal::hash_reduce(const int*, int, const int*,
+                                          const int*, const int*,
+                                          const unsigned*, const float*, float*);
+template void fcnn::internal::backprop(const mlp_packed<float>&,
+                                       const int*, const float*,
                                        const float*, float*, float*);
-template void fcnn::internal::backpropj(const int*, int, const int*, int,
-                                        const int*, const float*, const int*, const float*,
+template void fcnn::internal::backprop_sp(const mlp_packed<float>&,
+                                          const int*, const float*,
+                                          int, const int*, const float*,
+                                          const float*, float*, float*);
+template void fcnn::internal::backpropj(const mlp_packed<float>&, int,
+                                        const int*, const float*,
                                         const float*, float*, float*);
-template void fcnn::internal::backpropjd(const int*, int, const int*, int,
-                                         const int*, const float*, const int*, const float*,
+template void fcnn::internal::backpropjd(const mlp_packed<float>&, int,
+                                         const int*, const float*,
                                          const float*, float*);
 #endif /* FCNN_DOUBLE_ONLY */
 template void fcnn::internal::feedf(const int*, int, const int*,
                                     const double*, const int*, const double*,
                                     double*);
-template void fcnn::internal::backprop(const int*, int, const int*,
-                                       int, const double*, const int*, const double*,
+template void fcnn::internal::feedf(const mlp_packed<double>&,
+                                    const int*, const double*, double*, int);
+template void fcnn::internal::hash_expand(const int*, int, const int*,
+                                          const int*, const unsigned*,
+                                          const double*, double*);
+template void fcnn::internal::hash_reduce(const int*, int, const int*,
+                                          const int*, const int*,
+                                          const unsigned*, const double*, double*);
+template void fcnn::internal::backprop(const mlp_packed<double>&,
+                                       const int*, const double*,
                                        const double*, double*, double*);
-template void fcnn::internal::backpropj(const int*, int, const int*, int,
-                                        const int*, const double*, const int*, const double*,
+template void fcnn::internal::backprop_sp(const mlp_packed<double>&,
+                                          const int*, const double*,
+                                          int, const int*, const double*,
+                                          const double*, double*, double*);
+template void fcnn::internal::backpropj(const mlp_packed<double>&, int,
+                                        const int*, const double*,
                                         const double*, double*, double*);
-template void fcnn::internal::backpropjd(const int*, int, const int*, int,
-                                         const int*, const double*, const int*, const double*,
+template void fcnn::internal::backpropjd(const mlp_packed<double>&, int,
+                                         const int*, const double*,
                                          const double*, double*);
 
@@ -27,6 +27,9 @@
 #define FCNN_LEVEL2_H
 
 
+#include <fcnn/packed.h>
+
+
 namespace fcnn {
 namespace internal {
 
@@ -40,30 +43,82 @@ feedf(const int *lays, int no_lays, const int *n_pts,
       T *n_st);
 
 
-/// Backpropagation - backpropagate errors in the output layer and determine
-/// the MSE gradient (derivatives w.r.t weights).
+/// Feed forward using packed weights - compute all neuron states (padded
+/// vector, see mlp_packed) based on states of neurons in the input layer
+/// (or in layer l0 - 1 if l0 > 1).
+template <typename T>
+void
+feedf(const mlp_packed<T> &w, const int *af, const T *af_p, T *n_st, int l0 = 1);
+
+
+/// Hash of connection between neuron n and neuron npl in the previous layer
+/// (0-based indices, nprev neurons in the previous layer) in a hashed layer
+/// with given seed. Lower 31 bits select the bucket, the highest bit
+/// the sign of the shared weight.
+inline
+unsigned
+mlp_hash(unsigned seed, int n, int npl, int nprev)
+{
+    unsigned h = seed ^ (((unsigned) n * (unsigned) nprev + (unsigned) npl)
+                         * 0x9e3779b1u);
+    h ^= h >> 16; h *= 0x85ebca6bu;
+    h ^= h >> 13; h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+
+/// Hashed weight sharing - set weights of connections (not biases) in hashed
+/// layers given values of buckets (hb - no. of buckets in each layer, 0 for
+/// ordinary layers, hs - seeds, hval - buckets of subsequent hashed layers).
+template <typename T>
+void
+hash_expand(const int *lays, int no_lays, const int *w_pts,
+            const int *hb, const unsigned *hs, const T *hval, T *w_val);
+
+
+/// Hashed weight sharing - map vector defined on active weights (e.g. MSE
+/// gradient) to vector defined on free parameters, i.e. active weights
+/// which are not connections in hashed layers, followed by buckets. Values
+/// of connections sharing a bucket are summed (with hash signs).
 template <typename T>
 void
-backprop(const int *lays, int no_lays, const int *n_pts,
-         int no_weights, const T *w_val, const int *af, const T *af_p,
+hash_reduce(const int *lays, int no_lays, const int *w_pts, const int *w_fl,
+            const int *hb, const unsigned *hs, const T *x, T *y);
+
+
+/// Backpropagation using packed weights - backpropagate errors in the output
+/// layer and accumulate the MSE gradient in packed layout (grad, see
+/// mlp_packed). Neuron states and deltas are padded vectors (see feedf).
+template <typename T>
+void
+backprop(const mlp_packed<T> &w, const int *af, const T *af_p,
          const T *n_st, T *delta, T *grad);
 
+/// Backpropagation using packed weights with sparse input - as backprop,
+/// but derivatives w.r.t. weights of the first hidden layer are accumulated
+/// for non-zero inputs only (nnz 0-based indices idx and values val), states
+/// of input neurons are not used.
+template <typename T>
+void
+backprop_sp(const mlp_packed<T> &w, const int *af, const T *af_p,
+            int nnz, const int *idx, const T *val,
+            const T *n_st, T *delta, T *grad);
 
-/// Backpropagation - backpropagate error at the jth neuron the output layer
-/// and determine the derivatives of jth output w.r.t weights (gradient).
+/// Backpropagation using packed weights - backpropagate error at the jth
+/// neuron of the output layer and accumulate the derivatives of jth output
+/// w.r.t weights in packed layout.
 template <typename T>
 void
-backpropj(const int *lays, int no_lays, const int *n_pts, int j,
-          const int *w_pts, const T *w_val, const int *af, const T *af_p,
+backpropj(const mlp_packed<T> &w, int j, const int *af, const T *af_p,
           const T *n_st, T *delta, T *grad);
 
-
-/// Backpropagation - backpropagate error (delta) at the jth neuron the output layer
-/// to input layers without computing derivatives w.r.t. weights.
+/// Backpropagation using packed weights - backpropagate error (delta) at
+/// the jth neuron of the output layer to the input layer without computing
+/// derivatives w.r.t. weights.
 template <typename T>
 void
-backpropjd(const int *lays, int no_lays, const int *n_pts, int j,
-           const int *w_pts, const T *w_val, const int *af, const T *af_p,
+backpropjd(const mlp_packed<T> &w, int j, const int *af, const T *af_p,
            const T *n_st, T *delta);
 
 
@@ -25,6 +25,7 @@
 
 
 #include <vector>
+#include <fcnn/activation.h>
 #include <fcnn/level1.h>
 #include <fcnn/level2.h>
 #include <fcnn/level3.h>
@@ -35,19 +36,74 @@
 #endif /* defined(HAVE_OPENMP) */
 
 
+using namespace fcnn;
 using namespace fcnn::internal;
 
 
 
+namespace {
+
+
+// Transposed weights (no. of inputs x no. of neurons) of the first hidden
+// layer given packed weights
 template <typename T>
 void
-fcnn::internal::eval(const int *lays, int no_lays, const int *n_pts,
-                     const T *w_val, const int *af, const T *af_p,
-                     int no_datarows, const T *in, T *out)
+packed_first_t(const mlp_packed<T> &w, std::vector<T> &wt)
 {
-    int no_neurons = n_pts[no_lays],
-        no_inputs = lays[0],
-        no_outputs = lays[no_lays - 1];
+    int ni = w.no_neurons(0), nn = w.no_neurons(1), ld = w.ld(0);
+    const T *W = w.w(1);
+    wt.resize((idx_t) ni * nn);
+    for (int n = 0; n < nn; ++n, W += ld) {
+        for (int j = 0; j < ni; ++j) wt[(idx_t) j * nn + n] = W[j];
+    }
+}
+
+
+// States of the first hidden layer (packed states vector) given sparse input
+// (row i) and transposed weights
+template <typename T>
+void
+packed_first_sp(const mlp_packed<T> &w, const T *wt, const int *af, const T *af_p,
+                const csr_rows<T> &in, int i, T *work)
+{
+    int nn = w.no_neurons(1);
+    const T *B = w.b(1);
+    T *nptr = work + w.st_off(1);
+    for (int n = 0; n < nn; ++n) nptr[n] = B[n];
+    for (idx_t k = in.ptr[i]; k < in.ptr[i + 1]; ++k)
+        axpy(nn, in.val[k], wt + (idx_t) in.idx[k] * nn, 1, nptr, 1);
+    int actf = af[1]; T actfp = af_p[1];
+    for (int n = 0; n < nn; ++n) nptr[n] = mlp_act_f(actf, actfp, nptr[n]);
+}
+
+
+// Sum of record weights (no. of records if there are no weights)
+template <typename T>
+T
+record_weight_sum(int no_datarows, const T *rw)
+{
+    if (!rw) return (T)no_datarows;
+    T s = T();
+    for (int i = 0; i < no_datarows; ++i) s += rw[i];
+    return s;
+}
+
+
+} /* namespace */
+
+
+
+template <typename T>
+void
+fcnn::internal::eval(const mlp_packed<T> &w, const int *af, const T *af_p,
+                     int no_datarows, const mat_rows<T> &in, T *out)
+{
+    int no_lays = w.no_layers(),
+        st_size = w.st_size() + mlp_packed<T>::pad,
+        no_inputs = w.no_neurons(0),
+        no_outputs = w.no_neurons(no_lays - 1),
+        in_off = w.st_off(0),
+        out_off = w.st_off(no_lays - 1);
 
 #if defined(HAVE_OPENMP)
     std::vector<std::vector<T> > workv;
@@ -65,13 +121,15 @@ fcnn::internal::eval(const int *lays, int no_lays, const int *n_pts,
             chsz = no_datarows / nth;
             if (no_datarows % nth) ++chsz;
         }
-        for (int i = 0; i < nth; ++i) {
-            workv.push_back(std::vector<T>(no_neurons));
-        }
+        workv.resize(nth);
+    }
+    // workspaces are allocated (and first touched) by threads using them
+    if (omp_get_thread_num() < nth) {
+        workv[omp_get_thread_num()].assign(st_size, T());
     }
 #else /* defined(HAVE_OPENMP) */
-    std::vector<T> workv(no_neurons);
-    T *work = &workv[0];
+    std::vector<T> workv(st_size);
+    T *work = mlp_pk_aligned(&workv[0]);
 #endif /* defined(HAVE_OPENMP) */
 #if defined(HAVE_OPENMP)
     int i, ith;
@@ -82,16 +140,14 @@ fcnn::internal::eval(const int *lays, int no_lays, const int *n_pts,
 #endif /* defined(HAVE_OPENMP) */
 #if defined(HAVE_OPENMP)
         ith = omp_get_thread_num();
-        work = &workv[ith][0];
+        work = mlp_pk_aligned(&workv[ith][0]);
 #endif /* defined(HAVE_OPENMP) */
         // copy input
-        copy(no_inputs, in + i, no_datarows, work, 1);
+        copy(no_inputs, in.row(i), in.ld, work + in_off, 1);
         // feed forward
-        feedf(lays, no_lays, n_pts,
-              w_val, af, af_p,
-              work);
+        feedf(w, af, af_p, work);
         // copy output
-        copy(no_outputs, work + n_pts[no_lays - 1], 1, out + i, no_datarows);
+        copy(no_outputs, work + out_off, 1, out + i, no_datarows);
     }
 #if defined(HAVE_OPENMP)
     } /* #pragma omp parallel */
@@ -102,15 +158,18 @@ fcnn::internal::eval(const int *lays, int no_lays, const int *n_pts,
 
 template <typename T>
 T
-fcnn::internal::mse(const int *lays, int no_lays, const int *n_pts,
-                    const T *w_val, const int *af, const T *af_p,
-                    int no_datarows, const T *in, const T *out)
+fcnn::internal::mse(const mlp_packed<T> &w, const int *af, const T *af_p,
+                    int no_datarows, const mat_rows<T> &in, const mat_rows<T> &out,
+                    const T *rw)
 {
-    int no_neurons = n_pts[no_lays],
-        no_inputs = lays[0],
-        no_outputs = lays[no_lays - 1];
+    int no_lays = w.no_layers(),
+        st_size = w.st_size() + mlp_packed<T>::pad,
+        no_inputs = w.no_neurons(0),
+        no_outputs = w.no_neurons(no_lays - 1),
+        in_off = w.st_off(0),
+        out_off = w.st_off(no_lays - 1);
 
-    T se = T();
+    T se = T(), sw = record_weight_sum(no_datarows, rw);
 
 #if defined(HAVE_OPENMP)
     std::vector<std::vector<T> > workv;
@@ -128,13 +187,148 @@ fcnn::internal::mse(const int *lays, int no_lays, const int *n_pts,
             chsz = no_datarows / nth;
             if (no_datarows % nth) ++chsz;
         }
-        for (int i = 0; i < nth; ++i) {
-            workv.push_back(std::vector<T>(no_neurons));
+        workv.resize(nth);
+    }
+    // workspaces are allocated (and first touched) by threads using them
+    if (omp_get_thread_num() < nth) {
+        workv[omp_get_thread_num()].assign(st_size, T());
+    }
+#else /* defined(HAVE_OPENMP) */
+    std::vector<T> workv(st_size);
+    T *work = mlp_pk_aligned(&workv[0]);
+#endif /* defined(HAVE_OPENMP) */
+#if defined(HAVE_OPENMP)
+    int i, ith;
+    #pragma omp for schedule(static, chsz) \
+        private(i, ith, work) \
+        reduction(+:se)
+    for (i = 0; i < no_datarows; ++i) {
+#else /* defined(HAVE_OPENMP) */
+    for (int i = 0; i < no_datarows; ++i) {
+#endif /* defined(HAVE_OPENMP) */
+#if defined(HAVE_OPENMP)
+        ith = omp_get_thread_num();
+        work = mlp_pk_aligned(&workv[ith][0]);
+#endif /* defined(HAVE_OPENMP) */
+        // copy input
+        copy(no_inputs, in.row(i), in.ld, work + in_off, 1);
+        // feed forward
+        feedf(w, af, af_p, work);
+        // update se
+        T e = sumsqdiff(no_outputs, work + out_off, 1, out.row(i), out.ld);
+        se += rw ? rw[i] * e : e;
+    }
+#if defined(HAVE_OPENMP)
+    } /* #pragma omp parallel */
+#endif /* defined(HAVE_OPENMP) */
+
+    return (T).5 * se / (sw * (T)no_outputs);
+}
+
+
+
+template <typename T>
+void
+fcnn::internal::eval_sp(const mlp_packed<T> &w, const int *af, const T *af_p,
+                        int no_datarows, const csr_rows<T> &in, T *out)
+{
+    int no_lays = w.no_layers(),
+        st_size = w.st_size() + mlp_packed<T>::pad,
+        no_outputs = w.no_neurons(no_lays - 1),
+        out_off = w.st_off(no_lays - 1);
+    std::vector<T> wt;
+    packed_first_t(w, wt);
+
+#if defined(HAVE_OPENMP)
+    std::vector<std::vector<T> > workv;
+    T *work;
+    int nth = 1, chsz = 1;
+    #pragma omp parallel default(shared)
+    {
+    #pragma omp single
+    {
+        nth = omp_get_num_threads();
+        if (nth > no_datarows) {
+            nth = no_datarows;
+            omp_set_num_threads(nth);
+        } else {
+            chsz = no_datarows / nth;
+            if (no_datarows % nth) ++chsz;
         }
+        workv.resize(nth);
+    }
+    // workspaces are allocated (and first touched) by threads using them
+    if (omp_get_thread_num() < nth) {
+        workv[omp_get_thread_num()].assign(st_size, T());
     }
 #else /* defined(HAVE_OPENMP) */
-    std::vector<T> workv(no_neurons);
-    T *work = &workv[0];
+    std::vector<T> workv(st_size);
+    T *work = mlp_pk_aligned(&workv[0]);
+#endif /* defined(HAVE_OPENMP) */
+#if defined(HAVE_OPENMP)
+    int i, ith;
+    #pragma omp for schedule(static, chsz) private(i, ith, work)
+    for (i = 0; i < no_datarows; ++i) {
+#else /* defined(HAVE_OPENMP) */
+    for (int i = 0; i < no_datarows; ++i) {
+#endif /* defined(HAVE_OPENMP) */
+#if defined(HAVE_OPENMP)
+        ith = omp_get_thread_num();
+        work = mlp_pk_aligned(&workv[ith][0]);
+#endif /* defined(HAVE_OPENMP) */
+        // first hidden layer from non-zero inputs
+        packed_first_sp(w, &wt[0], af, af_p, in, i, work);
+        // feed forward
+        feedf(w, af, af_p, work, 2);
+        // copy output
+        copy(no_outputs, work + out_off, 1, out + i, no_datarows);
+    }
+#if defined(HAVE_OPENMP)
+    } /* #pragma omp parallel */
+#endif /* defined(HAVE_OPENMP) */
+}
+
+
+
+template <typename T>
+T
+fcnn::internal::mse_sp(const mlp_packed<T> &w, const int *af, const T *af_p,
+                       int no_datarows, const csr_rows<T> &in, const mat_rows<T> &out)
+{
+    int no_lays = w.no_layers(),
+        st_size = w.st_size() + mlp_packed<T>::pad,
+        no_outputs = w.no_neurons(no_lays - 1),
+        out_off = w.st_off(no_lays - 1);
+    std::vector<T> wt;
+    packed_first_t(w, wt);
+
+    T se = T();
+
+#if defined(HAVE_OPENMP)
+    std::vector<std::vector<T> > workv;
+    T *work;
+    int nth = 1, chsz = 1;
+    #pragma omp parallel default(shared)
+    {
+    #pragma omp single
+    {
+        nth = omp_get_num_threads();
+        if (nth > no_datarows) {
+            nth = no_datarows;
+            omp_set_num_threads(nth);
+        } else {
+            chsz = no_datarows / nth;
+            if (no_datarows % nth) ++chsz;
+        }
+        workv.resize(nth);
+    }
+    // workspaces are allocated (and first touched) by threads using them
+    if (omp_get_thread_num() < nth) {
+        workv[omp_get_thread_num()].assign(st_size, T());
+    }
+#else /* defined(HAVE_OPENMP) */
+    std::vector<T> workv(st_size);
+    T *work = mlp_pk_aligned(&workv[0]);
 #endif /* defined(HAVE_OPENMP) */
 #if defined(HAVE_OPENMP)
     int i, ith;
@@ -145,9 +339,143 @@ fcnn::internal::mse(const int *lays, int no_lays, const int *n_pts,
 #else /* defined(HAVE_OPENMP) */
     for (int i = 0; i < no_datarows; ++i) {
 #endif /* defined(HAVE_OPENMP) */
+#if defined(HAVE_OPENMP)
+        ith = omp_get_thread_num();
+        work = mlp_pk_aligned(&workv[ith][0]);
+#endif /* defined(HAVE_OPENMP) */
+        // first hidden layer from non-zero inputs
+        packed_first_sp(w, &wt[0], af, af_p, in, i, work);
+        // feed forward
+        feedf(w, af, af_p, work, 2);
+        // update se
+        se += sumsqdiff(no_outputs, work + out_off, 1, out.row(i), out.ld);
+    }
+#if defined(HAVE_OPENMP)
+    } /* #pragma omp parallel */
+#endif /* defined(HAVE_OPENMP) */
+
+    return (T).5 * se / ((T)no_datarows * (T)no_outputs);
+}
+
+
+
+template <typename T>
+void
+fcnn::internal::sqerr(const mlp_packed<T> &w, const int *af, const T *af_p,
+                      int no_datarows, int no_idx, const int *idx,
+                      const T *in, const T *out, T *se)
+{
+    int no_lays = w.no_layers(),
+        st_size = w.st_size() + mlp_packed<T>::pad,
+        no_inputs = w.no_neurons(0),
+        no_outputs = w.no_neurons(no_lays - 1),
+        in_off = w.st_off(0),
+        out_off = w.st_off(no_lays - 1);
+
+#if defined(HAVE_OPENMP)
+    std::vector<std::vector<T> > workv;
+    T *work;
+    int nth = 1, chsz = 1;
+    #pragma omp parallel default(shared)
+    {
+    #pragma omp single
+    {
+        nth = omp_get_num_threads();
+        if (nth > no_idx) {
+            nth = no_idx;
+            omp_set_num_threads(nth);
+        } else {
+            chsz = no_idx / nth;
+            if (no_idx % nth) ++chsz;
+        }
+        workv.resize(nth);
+    }
+    // workspaces are allocated (and first touched) by threads using them
+    if (omp_get_thread_num() < nth) {
+        workv[omp_get_thread_num()].assign(st_size, T());
+    }
+#else /* defined(HAVE_OPENMP) */
+    std::vector<T> workv(st_size);
+    T *work = mlp_pk_aligned(&workv[0]);
+#endif /* defined(HAVE_OPENMP) */
+#if defined(HAVE_OPENMP)
+    int k, ith;
+    #pragma omp for schedule(static, chsz) private(k, ith, work)
+    for (k = 0; k < no_idx; ++k) {
+#else /* defined(HAVE_OPENMP) */
+    for (int k = 0; k < no_idx; ++k) {
+#endif /* defined(HAVE_OPENMP) */
+#if defined(HAVE_OPENMP)
+        ith = omp_get_thread_num();
+        work = mlp_pk_aligned(&workv[ith][0]);
+#endif /* defined(HAVE_OPENMP) */
+        int i = idx[k];
+        // copy input
+        copy(no_inputs, in + i, no_datarows, work + in_off, 1);
+        // feed forward
+        feedf(w, af, af_p, work);
+        // squared error
+        se[k] = sumsqdiff(no_outputs, work + out_off, 1, out + i, no_datarows);
+    }
+#if defined(HAVE_OPENMP)
+    } /* #pragma omp parallel */
+#endif /* defined(HAVE_OPENMP) */
+}
+
+
+
+template <typename T>
+void
+fcnn::internal::nstat(const int *lays, int no_lays, const int *n_pts,
+                      const T *w_val, const int *af, const T *af_p,
+                      int no_datarows, const T *in, T *sum, T *sumsq)
+{
+    int no_neurons = n_pts[no_lays],
+        no_inputs = lays[0];
+
+#if defined(HAVE_OPENMP)
+    std::vector<std::vector<T> > workv, sumv, sumsqv;
+    T *work, *s, *ss;
+    int nth = 1, chsz = 1;
+    #pragma omp parallel default(shared)
+    {
+    #pragma omp single
+    {
+        nth = omp_get_num_threads();
+        if (nth > no_datarows) {
+            nth = no_datarows;
+            omp_set_num_threads(nth);
+        } else {
+            chsz = no_datarows / nth;
+            if (no_datarows % nth) ++chsz;
+        }
+        workv.resize(nth);
+        sumv.resize(nth);
+        sumsqv.resize(nth);
+    }
+    // workspaces are allocated (and first touched) by threads using them
+    if (omp_get_thread_num() < nth) {
+        workv[omp_get_thread_num()].assign(no_neurons, T());
+        sumv[omp_get_thread_num()].assign(no_neurons, T());
+        sumsqv[omp_get_thread_num()].assign(no_neurons, T());
+    }
+#else /* defined(HAVE_OPENMP) */
+    std::vector<T> workv(no_neurons), sumv(no_neurons, T()),
+                   sumsqv(no_neurons, T());
+    T *work = &workv[0], *s = &sumv[0], *ss = &sumsqv[0];
+#endif /* defined(HAVE_OPENMP) */
+#if defined(HAVE_OPENMP)
+    int i, ith;
+    #pragma omp for schedule(static, chsz) private(i, ith, work, s, ss)
+    for (i = 0; i < no_datarows; ++i) {
+#else /* defined(HAVE_OPENMP) */
+    for (int i = 0; i < no_datarows; ++i) {
+#endif /* defined(HAVE_OPENMP) */
 #if defined(HAVE_OPENMP)
         ith = omp_get_thread_num();
         work = &workv[ith][0];
+        s = &sumv[ith][0];
+        ss = &sumsqv[ith][0];
 #endif /* defined(HAVE_OPENMP) */
         // copy input
         copy(no_inputs, in + i, no_datarows, work, 1);
@@ -155,29 +483,142 @@ fcnn::internal::mse(const int *lays, int no_lays, const int *n_pts,
         feedf(lays, no_lays, n_pts,
               w_val, af, af_p,
               work);
+        // update sums
+        for (int n = 0; n < no_neurons; ++n) {
+            s[n] += work[n];
+            ss[n] += work[n] * work[n];
+        }
+    }
+#if defined(HAVE_OPENMP)
+    } /* #pragma omp parallel */
+    for (int th = 1; th < nth; ++th) {
+        axpy(no_neurons, 1., &sumv[th][0], 1, &sumv[0][0], 1);
+        axpy(no_neurons, 1., &sumsqv[th][0], 1, &sumsqv[0][0], 1);
+    }
+    copy(no_neurons, &sumv[0][0], 1, sum, 1);
+    copy(no_neurons, &sumsqv[0][0], 1, sumsq, 1);
+#else /* defined(HAVE_OPENMP) */
+    copy(no_neurons, s, 1, sum, 1);
+    copy(no_neurons, ss, 1, sumsq, 1);
+#endif /* defined(HAVE_OPENMP) */
+}
+
+
+
+template <typename T>
+T
+fcnn::internal::grad(const mlp_packed<T> &w, const int *w_fl,
+                     const int *af, const T *af_p,
+                     int no_datarows, const mat_rows<T> &in, const mat_rows<T> &out,
+                     T *gr, const T *rw)
+{
+    int no_lays = w.no_layers(),
+        st_size = w.st_size() + mlp_packed<T>::pad,
+        gr_size = w.size() + mlp_packed<T>::pad,
+        no_inputs = w.no_neurons(0),
+        no_outputs = w.no_neurons(no_lays - 1),
+        in_off = w.st_off(0),
+        out_off = w.st_off(no_lays - 1);
+    T se = T(), sw = record_weight_sum(no_datarows, rw);
+#if defined(HAVE_OPENMP)
+    std::vector<std::vector<T> > workv, deltav, gradv;
+    T *work, *delta, *grad;
+    int nth = 1, chsz = 1;
+    #pragma omp parallel default(shared)
+    {
+    #pragma omp single
+    {
+        nth = omp_get_num_threads();
+        if (nth > no_datarows) {
+            nth = no_datarows;
+            omp_set_num_threads(nth);
+        } else {
+            chsz = no_datarows / nth;
+            if (no_datarows % nth) ++chsz;
+        }
+        workv.resize(nth);
+        deltav.resize(nth);
+        gradv.resize(nth);
+    }
+    // workspaces are allocated (and first touched) by threads using them
+    if (omp_get_thread_num() < nth) {
+        workv[omp_get_thread_num()].assign(st_size, T());
+        deltav[omp_get_thread_num()].assign(st_size, T());
+        gradv[omp_get_thread_num()].assign(gr_size, T());
+    }
+#else /* defined(HAVE_OPENMP) */
+    std::vector<T> workv(st_size), deltav(st_size), gradv(gr_size);
+    T *work = mlp_pk_aligned(&workv[0]), *delta = mlp_pk_aligned(&deltav[0]),
+      *grad = mlp_pk_aligned(&gradv[0]);
+#endif /* defined(HAVE_OPENMP) */
+    // loop over records
+#if defined(HAVE_OPENMP)
+    int i, ith;
+    #pragma omp for schedule(static, chsz) \
+        private(i, ith, work, delta, grad) \
+        reduction(+:se)
+    for (i = 0; i < no_datarows; ++i) {
+#else /* defined(HAVE_OPENMP) */
+    for (int i = 0; i < no_datarows; ++i) {
+#endif /* defined(HAVE_OPENMP) */
+#if defined(HAVE_OPENMP)
+        ith = omp_get_thread_num();
+        work = mlp_pk_aligned(&workv[ith][0]);
+        delta = mlp_pk_aligned(&deltav[ith][0]);
+        grad = mlp_pk_aligned(&gradv[ith][0]);
+#endif /* defined(HAVE_OPENMP) */
+        // copy input
+        copy(no_inputs, in.row(i), in.ld, work + in_off, 1);
+        // feed forward
+        feedf(w, af, af_p, work);
+        // set deltas of hidden layers to zero, init output deltas
+        for (int k = w.st_off(1); k < out_off; ++k) delta[k] = T();
+        diff(no_outputs, work + out_off, 1, out.row(i), out.ld,
+             delta + out_off, 1);
         // update se
-        se += sumsqdiff(no_outputs, work + n_pts[no_lays - 1], 1, out + i, no_datarows);
+        T e = sumsq(no_outputs, delta + out_off, 1);
+        if (rw) {
+            // weighted record: deltas (hence derivatives) scale with weight
+            se += rw[i] * e;
+            for (int o = 0; o < no_outputs; ++o) delta[out_off + o] *= rw[i];
+        } else {
+            se += e;
+        }
+        // backpropagation
+        backprop(w, af, af_p, work, delta, grad);
     }
 #if defined(HAVE_OPENMP)
     } /* #pragma omp parallel */
+    for (int th = 1; th < nth; ++th) {
+        axpy(w.size(), 1., mlp_pk_aligned(&gradv[th][0]), 1,
+             mlp_pk_aligned(&gradv[0][0]), 1);
+    }
+    grad = mlp_pk_aligned(&gradv[0][0]);
 #endif /* defined(HAVE_OPENMP) */
 
-    return (T).5 * se / ((T)no_datarows * (T)no_outputs);
+    // get derivatives for active weights
+    w.unpack(grad, w_fl, (T)1. / (sw * (T)no_outputs), gr);
+    // scale mse and return
+    return (T).5 * se / (sw * (T)no_outputs);
 }
 
 
 
+
 template <typename T>
 T
-fcnn::internal::grad(const int *lays, int no_lays, const int *n_pts,
-                     const int *w_pts, const int *w_fl, const T *w_val,
-                     const int *af, const T *af_p,
-                     int no_datarows, const T *in, const T *out, T *gr)
+fcnn::internal::grad_sp(const mlp_packed<T> &w, const int *w_fl,
+                        const int *af, const T *af_p,
+                        int no_datarows, const csr_rows<T> &in, const mat_rows<T> &out,
+                        T *gr)
 {
-    int no_neurons = n_pts[no_lays],
-        no_inputs = lays[0],
-        no_outputs = lays[no_lays - 1],
-        no_weights = w_pts[no_lays];
+    int no_lays = w.no_layers(),
+        st_size = w.st_size() + mlp_packed<T>::pad,
+        gr_size = w.size() + mlp_packed<T>::pad,
+        no_outputs = w.no_neurons(no_lays - 1),
+        out_off = w.st_off(no_lays - 1);
+    std::vector<T> wt;
+    packed_first_t(w, wt);
     T se = T();
 #if defined(HAVE_OPENMP)
     std::vector<std::vector<T> > workv, deltav, gradv;
@@ -195,16 +636,20 @@ fcnn::internal::grad(const int *lays, int no_lays, const int *n_pts,
             chsz = no_datarows / nth;
             if (no_datarows % nth) ++chsz;
         }
-        for (int i = 0; i < nth; ++i) {
-            workv.push_back(std::vector<T>(no_neurons));
-            deltav.push_back(std::vector<T>(no_neurons));
-            gradv.push_back(std::vector<T>(no_weights));
-        }
+        workv.resize(nth);
+        deltav.resize(nth);
+        gradv.resize(nth);
+    }
+    // workspaces are allocated (and first touched) by threads using them
+    if (omp_get_thread_num() < nth) {
+        workv[omp_get_thread_num()].assign(st_size, T());
+        deltav[omp_get_thread_num()].assign(st_size, T());
+        gradv[omp_get_thread_num()].assign(gr_size, T());
     }
 #else /* defined(HAVE_OPENMP) */
-    std::vector<T> workv(no_neurons), deltav(no_neurons),
-                   gradv(no_weights);
-    T *work = &workv[0], *delta = &deltav[0], *grad = &gradv[0];
+    std::vector<T> workv(st_size), deltav(st_size), gradv(gr_size);
+    T *work = mlp_pk_aligned(&workv[0]), *delta = mlp_pk_aligned(&deltav[0]),
+      *grad = mlp_pk_aligned(&gradv[0]);
 #endif /* defined(HAVE_OPENMP) */
     // loop over records
 #if defined(HAVE_OPENMP)
@@ -218,42 +663,37 @@ fcnn::internal::grad(const int *lays, int no_lays, const int *n_pts,
 #endif /* defined(HAVE_OPENMP) */
 #if defined(HAVE_OPENMP)
         ith = omp_get_thread_num();
-        // set deltas to zero
-        deltav[ith].assign(no_neurons, T());
-        work = &workv[ith][0];
-        delta = &deltav[ith][0];
-        grad = &gradv[ith][0];
-#else /* defined(HAVE_OPENMP) */
-        // set deltas to zero
-        deltav.assign(no_neurons, T());
+        work = mlp_pk_aligned(&workv[ith][0]);
+        delta = mlp_pk_aligned(&deltav[ith][0]);
+        grad = mlp_pk_aligned(&gradv[ith][0]);
 #endif /* defined(HAVE_OPENMP) */
-        // copy input
-        copy(no_inputs, in + i, no_datarows, work, 1);
+        int nnz = (int) (in.ptr[i + 1] - in.ptr[i]);
+        const int *idx = in.idx + in.ptr[i];
+        const T *val = in.val + in.ptr[i];
+        // first hidden layer from non-zero inputs
+        packed_first_sp(w, &wt[0], af, af_p, in, i, work);
         // feed forward
-        feedf(lays, no_lays, n_pts,
-              w_val, af, af_p,
-              work);
-        // init deltas
-        diff(no_outputs, work + n_pts[no_lays - 1], 1, out + i, no_datarows,
-             delta + n_pts[no_lays - 1], 1);
+        feedf(w, af, af_p, work, 2);
+        // set deltas of hidden layers to zero, init output deltas
+        for (int k = w.st_off(1); k < out_off; ++k) delta[k] = T();
+        diff(no_outputs, work + out_off, 1, out.row(i), out.ld,
+             delta + out_off, 1);
         // update se
-        se += sumsq(no_outputs, delta + n_pts[no_lays - 1], 1);
+        se += sumsq(no_outputs, delta + out_off, 1);
         // backpropagation
-        backprop(lays, no_lays, n_pts,
-                 no_weights, w_val, af, af_p,
-                 work, delta, grad);
+        backprop_sp(w, af, af_p, nnz, idx, val, work, delta, grad);
     }
 #if defined(HAVE_OPENMP)
     } /* #pragma omp parallel */
     for (int th = 1; th < nth; ++th) {
-        axpy(no_weights, 1., &gradv[th][0], 1, &gradv[0][0], 1);
+        axpy(w.size(), 1., mlp_pk_aligned(&gradv[th][0]), 1,
+             mlp_pk_aligned(&gradv[0][0]), 1);
     }
-    grad = &gradv[0][0];
+    grad = mlp_pk_aligned(&gradv[0][0]);
 #endif /* defined(HAVE_OPENMP) */
 
     // get derivatives for active weights
-    for (int i = 0, j = 0, n = no_weights; i < n; ++i)
-        if (w_fl[i]) gr[j++] = grad[i] / ((T)no_datarows * (T)no_outputs);
+    w.unpack(grad, w_fl, (T)1. / ((T)no_datarows * (T)no_outputs), gr);
     // scale mse and return
     return (T).5 * se / ((T)no_datarows * (T)no_outputs);
 }
@@ -263,36 +703,33 @@ fcnn::internal::grad(const int *lays, int no_lays, const int *n_pts,
 
 template <typename T>
 void
-fcnn::internal::gradi(const int *lays, int no_lays, const int *n_pts,
-                      const int *w_pts, const int *w_fl, const T *w_val,
+fcnn::internal::gradi(const mlp_packed<T> &w, const int *w_fl,
                       const int *af, const T *af_p,
                       int no_datarows, int i, const T *in, const T *out, T *gr)
 {
-    int no_neurons = n_pts[no_lays],
-        no_inputs = lays[0],
-        no_outputs = lays[no_lays - 1],
-        no_weights = w_pts[no_lays];
-
-    std::vector<T> workv(no_neurons), deltav(no_neurons, T()),
-                   gradv(no_weights, T());
-    T *work = &workv[0], *delta = &deltav[0], *grad = &gradv[0];
+    int no_lays = w.no_layers(),
+        st_size = w.st_size() + mlp_packed<T>::pad,
+        no_inputs = w.no_neurons(0),
+        no_outputs = w.no_neurons(no_lays - 1),
+        in_off = w.st_off(0),
+        out_off = w.st_off(no_lays - 1);
+
+    std::vector<T> workv(st_size), deltav(st_size, T()),
+                   gradv(w.size() + mlp_packed<T>::pad, T());
+    T *work = mlp_pk_aligned(&workv[0]), *delta = mlp_pk_aligned(&deltav[0]),
+      *grad = mlp_pk_aligned(&gradv[0]);
     // copy input
-    copy(no_inputs, in + i, no_datarows, work, 1);
+    copy(no_inputs, in + i, no_datarows, work + in_off, 1);
     // feed forward
-    feedf(lays, no_lays, n_pts,
-          w_val, af, af_p,
-          work);
+    feedf(w, af, af_p, work);
     // init deltas
-    diff(no_outputs, work + n_pts[no_lays - 1], 1, out + i, no_datarows,
-            delta + n_pts[no_lays - 1], 1);
+    diff(no_outputs, work + out_off, 1, out + i, no_datarows,
+         delta + out_off, 1);
     // backpropagation
-    backprop(lays, no_lays, n_pts,
-             no_weights, w_val, af, af_p,
-             work, delta, grad);
+    backprop(w, af, af_p, work, delta, grad);
 
     // get derivatives for active weights
-    for (int ii = 0, j = 0, n = no_weights; ii < n; ++ii)
-        if (w_fl[ii]) gr[j++] = grad[ii] / (T)no_outputs;
+    w.unpack(grad, w_fl, (T)1. / (T)no_outputs, gr);
 }
 
 
@@ -300,40 +737,37 @@ fcnn::internal::gradi(const int *lays, int no_lays, const int *n_pts,
 
 template <typename T>
 void
-fcnn::internal::gradij(const int *lays, int no_lays, const int *n_pts,
-                       const int *w_pts, const int *w_fl, const T *w_val, int no_w_on,
+fcnn::internal::gradij(const mlp_packed<T> &w, const int *w_fl, int no_w_on,
                        const int *af, const T *af_p,
                        int no_datarows, int i, const T *in, T *gr)
 {
-    int no_neurons = n_pts[no_lays],
-        no_inputs = lays[0],
-        no_outputs = lays[no_lays - 1],
-        no_weights = w_pts[no_lays];
-
-    std::vector<T> workv(no_neurons), deltav(no_neurons, T()),
-                   gradv(no_weights, T());
-    T *work = &workv[0], *delta = &deltav[0], *grad = &gradv[0];
+    int no_lays = w.no_layers(),
+        st_size = w.st_size() + mlp_packed<T>::pad,
+        gr_size = w.size() + mlp_packed<T>::pad,
+        no_inputs = w.no_neurons(0),
+        no_outputs = w.no_neurons(no_lays - 1),
+        in_off = w.st_off(0),
+        out_off = w.st_off(no_lays - 1);
+
+    std::vector<T> workv(st_size), deltav(st_size, T()), gradv(gr_size, T());
+    T *work = mlp_pk_aligned(&workv[0]), *delta = mlp_pk_aligned(&deltav[0]),
+      *grad = mlp_pk_aligned(&gradv[0]);
+    // copy input
+    copy(no_inputs, in + i, no_datarows, work + in_off, 1);
+    // feed forward
+    feedf(w, af, af_p, work);
     // loop over output neurons
     for (int j = 0; j < no_outputs; ++j) {
-        // copy input
-        copy(no_inputs, in + i, no_datarows, work, 1);
-        // feed forward
-        feedf(lays, no_lays, n_pts,
-              w_val, af, af_p,
-              work);
         // init jth output neuron's delta
-        delta[n_pts[no_lays - 1] + j] = 1;
+        delta[out_off + j] = 1;
         // backpropagation
-        backpropj(lays, no_lays, n_pts, j,
-                  w_pts, w_val, af, af_p,
-                  work, delta, grad);
+        backpropj(w, j, af, af_p, work, delta, grad);
         // copy gradient
-        for (int ii = 0, k = 0, n = no_weights; ii < n; ++ii)
-            if (w_fl[ii]) gr[j * no_w_on + k++] = grad[ii];
+        w.unpack(grad, w_fl, (T)1., gr + j * no_w_on);
         // set deltas and gradients to zero
         if (j < no_outputs - 1) {
-            deltav.assign(no_neurons, T());
-            gradv.assign(no_weights, T());
+            deltav.assign(st_size, T());
+            gradv.assign(gr_size, T());
         }
     }
 }
@@ -343,37 +777,33 @@ fcnn::internal::gradij(const int *lays, int no_lays, const int *n_pts,
 
 template <typename T>
 void
-fcnn::internal::jacob(const int *lays, int no_lays, const int *n_pts,
-                      const int *w_pts, const int *w_fl, const T *w_val, int no_w_on,
-                      const int *af, const T *af_p,
+fcnn::internal::jacob(const mlp_packed<T> &w, const int *af, const T *af_p,
                       int no_datarows, int i, const T *in, T *jac)
 {
-    int no_neurons = n_pts[no_lays],
-        no_inputs = lays[0],
-        no_outputs = lays[no_lays - 1];
-
-    std::vector<T> workv(no_neurons), deltav(no_neurons, T());
-    T *work = &workv[0], *delta = &deltav[0];
+    int no_lays = w.no_layers(),
+        st_size = w.st_size() + mlp_packed<T>::pad,
+        no_inputs = w.no_neurons(0),
+        no_outputs = w.no_neurons(no_lays - 1),
+        in_off = w.st_off(0),
+        out_off = w.st_off(no_lays - 1);
+
+    std::vector<T> workv(st_size), deltav(st_size, T());
+    T *work = mlp_pk_aligned(&workv[0]), *delta = mlp_pk_aligned(&deltav[0]);
+    // copy input
+    copy(no_inputs, in + i, no_datarows, work + in_off, 1);
+    // feed forward
+    feedf(w, af, af_p, work);
     // loop over output neurons
     for (int j = 0; j < no_outputs; ++j) {
-        // copy input
-        copy(no_inputs, in + i, no_datarows, work, 1);
-        // feed forward
-        feedf(lays, no_lays, n_pts,
-              w_val, af, af_p,
-              work);
         // init jth output neuron's delta
-        delta[n_pts[no_lays - 1] + j] = 1;
+        delta[out_off + j] = 1;
         // backpropagation
-        backpropjd(lays, no_lays, n_pts, j,
-                   w_pts, w_val, af, af_p,
-                   work, delta);
-        // copy gradient
-        for (int ii = 0; ii < no_inputs; ++ii)
-             jac[j * no_inputs + ii] = delta[ii];
+        backpropjd(w, j, af, af_p, work, delta);
+        // copy derivatives w.r.t. inputs
+        copy(no_inputs, delta + in_off, 1, jac + j * no_inputs, 1);
         // set deltas to zero
         if (j < no_outputs - 1) {
-            deltav.assign(no_neurons, T());
+            deltav.assign(st_size, T());
         }
     }
 }
@@ -475,52 +905,84 @@ fcnn::internal::ihessupdate(int nw, int no, T a, const T *g, T *H)
 
 // Explicit instantiations
 #if !defined(FCNN_DOUBLE_ONLY)
-template void fcnn::internal::eval(const int*, int, const int*,
-                                   const float*, const int*, const float*,
-                                   int, const float*, float*);
-template float fcnn::internal::mse(const int*, int, const int*,
-                                   const float*, const int*, const float*,
-                                   int, const float*, const float*);
-template float fcnn::internal::grad(const int*, int, const int*,
-                                    const int*, const int*, const float*,
+template void fcnn::internal::eval(const mlp_packed<float>&,
+                                   const int*, const float*,
+                                   int, const mat_rows<float>&, float*);
+template float fcnn::internal::mse(const mlp_packed<float>&,
+                                   const int*, const float*,
+                                   int, const mat_rows<float>&,
+                                   const mat_rows<float>&, const float*);
+template void fcnn::internal::eval_sp(const mlp_packed<float>&,
+                                      const int*, const float*,
+                                      int, const csr_rows<float>&, float*);
+template float fcnn::internal::mse_sp(const mlp_packed<float>&,
+                                      const int*, const float*,
+                                      int, const csr_rows<float>&,
+                                      const mat_rows<float>&);
+template void fcnn::internal::sqerr(const mlp_packed<float>&,
                                     const int*, const float*,
-                                    int, const float*, const float*, float*);
-template void fcnn::internal::gradi(const int*, int, const int*,
-                                    const int*, const int*, const float*,
+                                    int, int, const int*,
+                                    const float*, const float*, float*);
+template void fcnn::internal::nstat(const int*, int, const int*,
+                                    const float*, const int*, const float*,
+                                    int, const float*, float*, float*);
+template float fcnn::internal::grad(const mlp_packed<float>&, const int*,
+                                    const int*, const float*,
+                                    int, const mat_rows<float>&,
+                                    const mat_rows<float>&, float*, const float*);
+template float fcnn::internal::grad_sp(const mlp_packed<float>&, const int*,
+                                       const int*, const float*,
+                                       int, const csr_rows<float>&,
+                                       const mat_rows<float>&, float*);
+template void fcnn::internal::gradi(const mlp_packed<float>&, const int*,
                                     const int*, const float*,
                                     int, int, const float*, const float*, float*);
-template void fcnn::internal::gradij(const int*, int, const int*,
-                                     const int*, const int*, const float*, int,
+template void fcnn::internal::gradij(const mlp_packed<float>&, const int*, int,
                                      const int*, const float*,
                                      int, int, const float*, float*);
-template void fcnn::internal::jacob(const int*, int, const int*,
-                                    const int*, const int*, const float*, int,
+template void fcnn::internal::jacob(const mlp_packed<float>&,
                                     const int*, const float*,
                                     int, int, const float*, float*);
 #if defined(HAVE_BLAS)
 template void fcnn::internal::ihessupdate(int, int, float, const float*, float*);
 #endif /* defined(HAVE_BLAS) */
 #endif /* !defined(FCNN_DOUBLE_ONLY) */
-template void fcnn::internal::eval(const int*, int, const int*,
-                                   const double*, const int*, const double*,
-                                   int, const double*, double*);
-template double fcnn::internal::mse(const int*, int, const int*,
+template void fcnn::internal::eval(const mlp_packed<double>&,
+                                   const int*, const double*,
+                                   int, const mat_rows<double>&, double*);
+template double fcnn::internal::mse(const mlp_packed<double>&,
+                                   const int*, const double*,
+                                   int, const mat_rows<double>&,
+                                   const mat_rows<double>&, const double*);
+template void fcnn::internal::eval_sp(const mlp_packed<double>&,
+                                      const int*, const double*,
+                                      int, const csr_rows<double>&, double*);
+template double fcnn::internal::mse_sp(const mlp_packed<double>&,
+                                      const int*, const double*,
+                                      int, const csr_rows<double>&,
+                                      const mat_rows<double>&);
+template void fcnn::internal::sqerr(const mlp_packed<double>&,
+                                    const int*, const double*,
+                                    int, int, const int*,
+                                    const double*, const double*, double*);
+template void fcnn::internal::nstat(const int*, int, const int*,
                                     const double*, const int*, const double*,
-                                    int, const double*, const double*);
-template double fcnn::internal::grad(const int*, int, const int*,
-                                     const int*, const int*, const double*,
-                                     const int*, const double*,
-                                     int, const double*, const double*, double*);
-template void fcnn::internal::gradi(const int*, int, const int*,
-                                    const int*, const int*, const double*,
+                                    int, const double*, double*, double*);
+template double fcnn::internal::grad(const mlp_packed<double>&, const int*,
+                                    const int*, const double*,
+                                    int, const mat_rows<double>&,
+                                    const mat_rows<double>&, double*, const double*);
+template double fcnn::internal::grad_sp(const mlp_packed<double>&, const int*,
+                                       const int*, const double*,
+                                       int, const csr_rows<double>&,
+                                       const mat_rows<double>&, double*);
+template void fcnn::internal::gradi(const mlp_packed<double>&, const int*,
                                     const int*, const double*,
                                     int, int, const double*, const double*, double*);
-template void fcnn::internal::gradij(const int*, int, const int*,
-                                     const int*, const int*, const double*, int,
+template void fcnn::internal::gradij(const mlp_packed<double>&, const int*, int,
                                      const int*, const double*,
                                      int, int, const double*, double*);
-template void fcnn::internal::jacob(const int*, int, const int*,
-                                    const int*, const int*, const double*, int,
+template void fcnn::internal::jacob(const mlp_packed<double>&,
                                     const int*, const double*,
                                     int, int, const double*, double*);
 #if defined(HAVE_BLAS)
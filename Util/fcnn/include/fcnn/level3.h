@@ -28,6 +28,11 @@
 #define FCNN_LEVEL3_H
 
 
+#include <fcnn/packed.h>
+#include <fcnn/matview.h>
+#include <fcnn/sparse.h>
+
+
 namespace fcnn {
 namespace internal {
 
@@ -35,44 +40,81 @@ namespace internal {
 /// Evaluate network output given input
 template <typename T>
 void
-eval(const int *lays, int no_lays, const int *n_pts,
-     const T *w_val, const int *af, const T *af_p,
-     int no_datarows, const T *in, T *out);
+eval(const mlp_packed<T> &w, const int *af, const T *af_p,
+     int no_datarows, const mat_rows<T> &in, T *out);
 
 
-/// Determine network's MSE given input and expected output.
+/// Determine network's MSE given input and expected output. If record
+/// weights rw are given, squared errors are weighted and normalised
+/// by the sum of weights instead of the no. of records.
 template <typename T>
 T
-mse(const int *lays, int no_lays, const int *n_pts,
-    const T *w_val, const int *af, const T *af_p,
-    int no_datarows, const T *in, const T *out);
+mse(const mlp_packed<T> &w, const int *af, const T *af_p,
+    int no_datarows, const mat_rows<T> &in, const mat_rows<T> &out,
+    const T *rw = 0);
+
+
+/// Evaluate network output given sparse input.
+template <typename T>
+void
+eval_sp(const mlp_packed<T> &w, const int *af, const T *af_p,
+        int no_datarows, const csr_rows<T> &in, T *out);
+
+
+/// Determine network's MSE given sparse input and expected output.
+template <typename T>
+T
+mse_sp(const mlp_packed<T> &w, const int *af, const T *af_p,
+       int no_datarows, const csr_rows<T> &in, const mat_rows<T> &out);
+
 
+/// Determine squared errors (summed over outputs) at selected data rows
+/// (0-based indices) given input and expected output.
+template <typename T>
+void
+sqerr(const mlp_packed<T> &w, const int *af, const T *af_p,
+      int no_datarows, int no_idx, const int *idx,
+      const T *in, const T *out, T *se);
+
+
+/// Compute sums and sums of squares of all neurons' states given input.
+template <typename T>
+void
+nstat(const int *lays, int no_lays, const int *n_pts,
+      const T *w_val, const int *af, const T *af_p,
+      int no_datarows, const T *in, T *sum, T *sumsq);
+
+
+/// Compute gradient of MSE (derivatives w.r.t. active weights, i.e. weights
+/// with nonzero flags w_fl) given input and expected output and optionally
+/// record weights (weighted MSE as in mse).
+template <typename T>
+T
+grad(const mlp_packed<T> &w, const int *w_fl, const int *af, const T *af_p,
+     int no_datarows, const mat_rows<T> &in, const mat_rows<T> &out, T *gr,
+     const T *rw = 0);
 
 /// Compute gradient of MSE (derivatives w.r.t. active weights)
-/// given input and expected output.
+/// given sparse input and expected output. Only weights of the first
+/// hidden layer connected to non-zero inputs are updated for each record.
 template <typename T>
 T
-grad(const int *lays, int no_lays, const int *n_pts,
-     const int *w_pts, const int *w_fl, const T *w_val,
-     const int *af, const T *af_p,
-     int no_datarows, const T *in, const T *out, T *gr);
+grad_sp(const mlp_packed<T> &w, const int *w_fl, const int *af, const T *af_p,
+        int no_datarows, const csr_rows<T> &in, const mat_rows<T> &out, T *gr);
 
 /// Compute gradient of MSE (derivatives w.r.t. active weights)
 /// given input and expected output using ith row of data only. This is
 /// normalised by the number of outputs only.
 template <typename T>
 void
-gradi(const int *lays, int no_lays, const int *n_pts,
-      const int *w_pts, const int *w_fl, const T *w_val,
-      const int *af, const T *af_p,
+gradi(const mlp_packed<T> &w, const int *w_fl, const int *af, const T *af_p,
       int no_datarows, int i, const T *in, const T *out, T *gr);
 
 /// Compute gradients of networks outputs, i.e the derivatives of outputs
-/// w.r.t. active weights, at given data row.
+/// w.r.t. active weights (no_w_on of them), at given data row.
 template <typename T>
 void
-gradij(const int *lays, int no_lays, const int *n_pts,
-       const int *w_pts, const int *w_fl, const T *w_val, int no_w_on,
+gradij(const mlp_packed<T> &w, const int *w_fl, int no_w_on,
        const int *af, const T *af_p,
        int no_datarows, int i, const T *in, T *gr);
 
@@ -80,9 +122,7 @@ gradij(const int *lays, int no_lays, const int *n_pts,
 /// of outputs w.r.t. network inputs, at given data row.
 template <typename T>
 void
-jacob(const int *lays, int no_lays, const int *n_pts,
-      const int *w_pts, const int *w_fl, const T *w_val, int no_w_on,
-      const int *af, const T *af_p,
+jacob(const mlp_packed<T> &w, const int *af, const T *af_p,
       int no_datarows, int i, const T *in, T *jac);
 
 /// Update Hessian inverse approximation given result from gradij.
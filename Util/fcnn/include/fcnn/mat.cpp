@@ -50,7 +50,7 @@ Matrix<T>::Matrix(int r, int c)
     if ((r < 0) || (c < 0)) error("negative size");
     m_rows = r;
     m_cols = c;
-    m_data.reset(m_rows * m_cols);
+    m_data.reset((idx_t)m_rows * m_cols);
 }
 
 
@@ -60,7 +60,7 @@ Matrix<T>::Matrix(int r, int c, const T& n)
     if ((r < 0) || (c < 0)) error("negative size");
     m_rows = r;
     m_cols = c;
-    m_data.reset(m_rows * m_cols);
+    m_data.reset((idx_t)m_rows * m_cols);
     m_data.set_all_to(n);
 }
 
@@ -71,11 +71,21 @@ Matrix<T>::Matrix(int r, int c, const T *arr)
     if ((r < 0) || (c < 0)) error("negative size");
     m_rows = r;
     m_cols = c;
-    m_data.reset(m_rows * m_cols);
+    m_data.reset((idx_t)m_rows * m_cols);
     m_data.read_from(arr);
 }
 
 
+template <typename T>
+Matrix<T>::Matrix(int r, int c, rcarr<T> &&data) : m_data(std::move(data))
+{
+    if ((r < 0) || (c < 0)) error("negative size");
+    if ((idx_t) r * c != m_data.size()) error("size of data and matrix disagree");
+    m_rows = r;
+    m_cols = c;
+}
+
+
 template <typename T>
 Matrix<T>::Matrix(const Matrix<T> &mat) : m_data(mat.m_data)
 {
@@ -103,7 +113,7 @@ Matrix<T>::reset(int r, int c)
     if ((r < 0) || (c < 0)) error("negative size");
     m_rows = r;
     m_cols = c;
-    m_data.reset(m_rows * m_cols);
+    m_data.reset((idx_t)m_rows * m_cols);
 
     return *this;
 }
@@ -166,7 +176,7 @@ Matrix<T>::get_col(int j) const
 {
     if ((j < 1) || (j > m_cols)) error_c_idx(j);
     Matrix<T> res(m_rows, 1);
-    internal::copy(m_rows, ptr() + (j - 1) * m_rows, 1, res.ptr(), 1);
+    internal::copy(m_rows, ptr() + (idx_t)(j - 1) * m_rows, 1, res.ptr(), 1);
     return res;
 }
 
@@ -180,7 +190,8 @@ Matrix<T>::get_cols(std::vector<int> js) const
     for (int j = 0; j < nc; ++j) {
         int jj = js[j];
         if ((jj < 1) || (jj > m_cols)) error_c_idx(jj);
-        internal::copy(m_rows, ptr() + (jj - 1) * m_rows, 1, res.ptr() + j * m_rows, 1);
+        internal::copy(m_rows, ptr() + (idx_t)(jj - 1) * m_rows, 1,
+                       res.ptr() + (idx_t)j * m_rows, 1);
     }
     return res;
 }
@@ -202,7 +213,7 @@ Matrix<T>::get_diag() const
 // Indexing erros
 template <typename T>
 void
-Matrix<T>::error_idx(int i) const
+Matrix<T>::error_idx(idx_t i) const
 {
     message mes;
     mes << "invalid single index " << i << "; matrix size: " << m_data.size();
@@ -255,7 +266,8 @@ Matrix<T>
 fcnn::eye(int n)
 {
     Matrix<T> res(n, n, T());
-    int i, np1 = n + 1, ii;
+    int i;
+    idx_t np1 = n + 1, ii;
     T *p = res.ptr();
     for (i = 1, ii = 0; i <= n; ++i, ii += np1) p[ii] = (T)1.;
     return res;
@@ -271,7 +283,7 @@ Matrix<T>
 fcnn::rand(int m, int n)
 {
     Matrix<T> res(m, n);
-    int i, mn = m * n;
+    idx_t i, mn = res.size();
     T *p = res.ptr();
     for (i = 0; i < mn; ++i) p[i] = (T) ::rand() / (T) RAND_MAX;
     return res;
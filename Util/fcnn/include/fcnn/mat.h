@@ -29,12 +29,18 @@
 
 
 #include <vector>
+#include <utility>
 #include <fcnn/rcarr.h>
 
 
 namespace fcnn {
 
 
+namespace internal {
+template <typename T, typename E> struct mexpr;
+} /* namespace internal */
+
+
 /// Matrix class is used for storing input data as well as for computations
 /// involving gradients and (approximate) Hessian.
 template <typename T>
@@ -49,8 +55,18 @@ class Matrix
     Matrix(int, int, const T&);
     /// Constructor (allocates memory and copies values from array).
     Matrix(int, int, const T*);
+    /// Constructor taking over data (rows * columns elements).
+    Matrix(int, int, internal::rcarr<T>&&);
     /// Copy constructor.
     Matrix(const Matrix&);
+    /// Constructor from element by element expression (see matops.h).
+    template <typename E>
+    Matrix(const internal::mexpr<T, E>&);
+    /// Move constructor.
+    Matrix(Matrix &&mat) noexcept
+        : m_data(std::move(mat.m_data)), m_rows(mat.m_rows), m_cols(mat.m_cols) {
+        mat.m_rows = mat.m_cols = 0;
+    }
 
     /// Reset member function.
     Matrix& reset();
@@ -66,23 +82,23 @@ class Matrix
     inline T const* ptr() const { return m_data.ptr(); }
 
     /// Element access, no index checking.
-    inline T& elem(int i, int j) { return m_data[(j - 1) * m_rows + i]; }
+    inline T& elem(int i, int j) { return m_data[(idx_t)(j - 1) * m_rows + i]; }
     /// Element access, no index checking (const version).
     inline T const& elem(int i, int j) const  {
-        return m_data[(j - 1) * m_rows + i];
+        return m_data[(idx_t)(j - 1) * m_rows + i];
     }
     /// Element access with single index, no index checking.
-    inline T& elem(int i)  { return m_data[i]; }
+    inline T& elem(idx_t i)  { return m_data[i]; }
     /// Element access with single index, no index checking (const version).
-    inline T const& elem(int i) const  { return m_data[i]; }
+    inline T const& elem(idx_t i) const  { return m_data[i]; }
 
     /// Element access.
-    inline T& operator()(int i) {
+    inline T& operator()(idx_t i) {
         if ((i < 1) || (i > m_data.size())) error_idx(i);
         return m_data[i];
     }
     /// Element access (const version).
-    inline T const& operator()(int i) const {
+    inline T const& operator()(idx_t i) const {
         if ((i < 1) || (i > m_data.size())) error_idx(i);
         return m_data[i];
     }
@@ -90,13 +106,13 @@ class Matrix
     inline T& operator()(int i, int j) {
         if ((i < 1) || (i > m_rows) || (j < 1) || (j > m_cols))
             error_idx(i, j);
-        return m_data[(j - 1) * m_rows + i];
+        return m_data[(idx_t)(j - 1) * m_rows + i];
     }
     /// Element access (const version).
     inline T const& operator()(int i, int j) const {
         if ((i < 1) || (i > m_rows) || (j < 1) || (j > m_cols))
             error_idx(i, j);
-        return m_data[(j - 1) * m_rows + i];
+        return m_data[(idx_t)(j - 1) * m_rows + i];
     }
 
     /// Return row.
@@ -116,10 +132,23 @@ class Matrix
     inline int cols() const { return m_cols; }
     /// Returns size (number of elements held in memory,
     /// equal to rows * columns).
-    inline int size() const { return m_data.size(); }
+    inline idx_t size() const { return m_data.size(); }
 
     /// Assignment (shallow).
     Matrix<T>& operator=(const Matrix<T>&);
+    /// Move assignment.
+    Matrix<T>& operator=(Matrix<T> &&mat) noexcept {
+        m_data = std::move(mat.m_data);
+        m_rows = mat.m_rows;
+        m_cols = mat.m_cols;
+        if (this != &mat) mat.m_rows = mat.m_cols = 0;
+        return *this;
+    }
+    /// Assignment from element by element expression (see matops.h);
+    /// evaluated in place if memory is not shared with other objects
+    /// and the size does not change.
+    template <typename E>
+    Matrix<T>& operator=(const internal::mexpr<T, E>&);
 
     /// Return a copy of and object.
     Matrix<T> copy() const;
@@ -136,7 +165,7 @@ class Matrix
     int m_cols;
 
     /// Report index error.
-    void error_idx(int i) const;
+    void error_idx(idx_t i) const;
     /// Report index error.
     void error_idx(int i, int j) const;
     /// Report row index error.
@@ -0,0 +1,339 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file matexpr.h
+ *  \brief Lazy element by element matrix expressions.
+ */
+
+
+#ifndef FCNN_MATEXPR_H
+
+#define FCNN_MATEXPR_H
+
+
+#include <cmath>
+#include <fcnn/mat.h>
+#include <fcnn/matops_enable.h>
+
+
+namespace fcnn {
+namespace internal {
+
+
+/// Base class of element by element matrix expressions. Expressions keep
+/// pointers to data of matrices they refer to, and are evaluated in a single
+/// loop when assigned to a matrix, so they must not outlive the full
+/// expression in which they were created.
+template <typename T, typename E>
+struct mexpr {
+    /// Cast to the actual expression type.
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+
+/// Matrix in an expression. 1x1 matrices are broadcast.
+template <typename T>
+class mx_mat : public mexpr<T, mx_mat<T> > {
+  public:
+    explicit mx_mat(const Matrix<T> &m)
+        : m_p(m.ptr() - 1), m_r(m.rows()), m_c(m.cols()), m_s(m.size()) { ; }
+    inline int rows() const { return m_r; }
+    inline int cols() const { return m_c; }
+    /// True if no broadcasting is needed to evaluate s elements.
+    inline bool full(idx_t s) const { return m_s == s; }
+    /// Element (no broadcasting).
+    inline T at(idx_t i) const { return m_p[i]; }
+    /// Element (with broadcasting).
+    inline T at_b(idx_t i) const { return m_p[(m_s == 1) ? 1 : i]; }
+  private:
+    const T *m_p;
+    int m_r, m_c;
+    idx_t m_s;
+};
+
+
+/// Scalar in an expression.
+template <typename T>
+class mx_scal : public mexpr<T, mx_scal<T> > {
+  public:
+    explicit mx_scal(const T &v) : m_v(v) { ; }
+    inline int rows() const { return 1; }
+    inline int cols() const { return 1; }
+    inline bool full(idx_t) const { return true; }
+    inline T at(idx_t) const { return m_v; }
+    inline T at_b(idx_t) const { return m_v; }
+  private:
+    T m_v;
+};
+
+
+/// Unary element by element operation.
+template <typename T, template <typename> class OP, typename A>
+class mx_un : public mexpr<T, mx_un<T, OP, A> > {
+  public:
+    explicit mx_un(const A &a) : m_a(a) { ; }
+    inline int rows() const { return m_a.rows(); }
+    inline int cols() const { return m_a.cols(); }
+    inline bool full(idx_t s) const { return m_a.full(s); }
+    inline T at(idx_t i) const { return OP<T>::eval(m_a.at(i)); }
+    inline T at_b(idx_t i) const { return OP<T>::eval(m_a.at_b(i)); }
+  private:
+    A m_a;
+};
+
+
+/// Report nonconformant sizes in element by element operation.
+void mx_error_size(int Ar, int Ac, int Br, int Bc);
+
+
+/// Binary element by element operation. 1x1 operands are broadcast.
+template <typename T, template <typename> class OP, typename A, typename B>
+class mx_bin : public mexpr<T, mx_bin<T, OP, A, B> > {
+  public:
+    mx_bin(const A &a, const B &b) : m_a(a), m_b(b) {
+        int Ar = a.rows(), Ac = a.cols(), Br = b.rows(), Bc = b.cols();
+        if ((Ar == 1) && (Ac == 1)) {
+            m_r = Br;
+            m_c = Bc;
+        } else if (((Br == 1) && (Bc == 1)) || ((Ar == Br) && (Ac == Bc))) {
+            m_r = Ar;
+            m_c = Ac;
+        } else {
+            mx_error_size(Ar, Ac, Br, Bc);
+        }
+    }
+    inline int rows() const { return m_r; }
+    inline int cols() const { return m_c; }
+    inline bool full(idx_t s) const { return m_a.full(s) && m_b.full(s); }
+    inline T at(idx_t i) const { return OP<T>::eval(m_a.at(i), m_b.at(i)); }
+    inline T at_b(idx_t i) const { return OP<T>::eval(m_a.at_b(i), m_b.at_b(i)); }
+  private:
+    A m_a;
+    B m_b;
+    int m_r, m_c;
+};
+
+
+/// Evaluate expression into (1-based) array of s elements.
+template <typename T, typename E>
+inline
+void
+mx_eval(T *d, const E &e, idx_t s)
+{
+    if (e.full(s)) {
+        for (idx_t i = 1; i <= s; ++i) d[i] = e.at(i);
+    } else {
+        for (idx_t i = 1; i <= s; ++i) d[i] = e.at_b(i);
+    }
+}
+
+
+
+// Operations
+template <typename T>
+struct mx_neg {
+    static inline T eval(const T &a) { return -a; }
+};
+
+template <typename T>
+struct mx_add {
+    static inline T eval(const T &a, const T &b) { return a + b; }
+};
+
+template <typename T>
+struct mx_sub {
+    static inline T eval(const T &a, const T &b) { return a - b; }
+};
+
+template <typename T>
+struct mx_mul {
+    static inline T eval(const T &a, const T &b) { return a * b; }
+};
+
+template <typename T>
+struct mx_div {
+    static inline T eval(const T &a, const T &b) { return a / b; }
+};
+
+template <typename T>
+struct mx_pow {
+    static inline T eval(const T &a, const T &b) { return std::pow(a, b); }
+};
+
+
+
+/// Operands of expressions: matrices, scalars and expressions.
+template <typename X>
+struct mx_of {
+    typedef X scalar;
+    static const bool ok = false;
+    static const bool is_scal = false;
+};
+template <typename T>
+struct mx_of<Matrix<T> > {
+    typedef T scalar;
+    typedef mx_mat<T> type;
+    static const bool ok = allow_scalar<T>::val;
+    static const bool is_scal = false;
+    static type make(const Matrix<T> &m) { return type(m); }
+};
+template <>
+struct mx_of<float> {
+    typedef float scalar;
+    typedef mx_scal<float> type;
+    static const bool ok = true;
+    static const bool is_scal = true;
+    static type make(const float &v) { return type(v); }
+};
+template <>
+struct mx_of<double> {
+    typedef double scalar;
+    typedef mx_scal<double> type;
+    static const bool ok = true;
+    static const bool is_scal = true;
+    static type make(const double &v) { return type(v); }
+};
+template <typename T, template <typename> class OP, typename A>
+struct mx_of<mx_un<T, OP, A> > {
+    typedef T scalar;
+    typedef mx_un<T, OP, A> type;
+    static const bool ok = true;
+    static const bool is_scal = false;
+    static const type& make(const type &e) { return e; }
+};
+template <typename T, template <typename> class OP, typename A, typename B>
+struct mx_of<mx_bin<T, OP, A, B> > {
+    typedef T scalar;
+    typedef mx_bin<T, OP, A, B> type;
+    static const bool ok = true;
+    static const bool is_scal = false;
+    static const type& make(const type &e) { return e; }
+};
+
+
+template <typename X>
+struct is_mx {
+    static const bool val = mx_of<X>::ok && !mx_of<X>::is_scal
+                            && !is_matrix<X>::val;
+};
+
+
+
+template <typename TA, template <typename> class OP, bool> struct enable_mx_un_ { };
+template <typename TA, template <typename> class OP>
+struct enable_mx_un_<TA, OP, true> {
+    typedef typename mx_of<TA>::scalar T;
+    typedef mx_un<T, OP, typename mx_of<TA>::type> type;
+};
+
+/// Unary element by element operation on a matrix or an expression.
+template <typename TA, template <typename> class OP>
+struct enable_mx_un : enable_mx_un_<TA, OP,
+        (mx_of<TA>::ok && !mx_of<TA>::is_scal)> {
+};
+
+
+template <typename TA, typename TB, template <typename> class OP, bool>
+struct enable_mx_bin_ { };
+template <typename TA, typename TB, template <typename> class OP>
+struct enable_mx_bin_<TA, TB, OP, true> {
+    typedef typename mx_of<TA>::scalar T;
+    typedef mx_bin<T, OP, typename mx_of<TA>::type, typename mx_of<TB>::type> type;
+};
+
+/// Binary element by element operation on matrices, expressions
+/// and scalars (at least one operand has to be a matrix or an expression).
+template <typename TA, typename TB, template <typename> class OP>
+struct enable_mx_bin : enable_mx_bin_<TA, TB, OP,
+        (mx_of<TA>::ok && mx_of<TB>::ok
+         && is_equal<typename mx_of<TA>::scalar, typename mx_of<TB>::scalar>::val
+         && !(mx_of<TA>::is_scal && mx_of<TB>::is_scal))> {
+};
+
+/// Element by element operation of a matrix or an expression and a scalar.
+template <typename TA, typename TB, template <typename> class OP>
+struct enable_mx_scal : enable_mx_bin_<TA, TB, OP,
+        (mx_of<TA>::ok && !mx_of<TA>::is_scal && mx_of<TB>::is_scal
+         && is_equal<typename mx_of<TA>::scalar, typename mx_of<TB>::scalar>::val)> {
+};
+
+/// Multiplication: element by element if one of the operands is a scalar.
+template <typename TA, typename TB>
+struct enable_mx_mul : enable_mx_bin_<TA, TB, mx_mul,
+        (mx_of<TA>::ok && mx_of<TB>::ok
+         && is_equal<typename mx_of<TA>::scalar, typename mx_of<TB>::scalar>::val
+         && (mx_of<TA>::is_scal != mx_of<TB>::is_scal))> {
+};
+
+
+template <typename TA, typename TB, bool> struct enable_mx_matmul_ { };
+template <typename TA, typename TB>
+struct enable_mx_matmul_<TA, TB, true> {
+    typedef Matrix<typename mx_of<TA>::scalar> type;
+};
+
+/// Matrix multiplication with (at least one) expression operand.
+template <typename TA, typename TB>
+struct enable_mx_matmul : enable_mx_matmul_<TA, TB,
+        (mx_of<TA>::ok && mx_of<TB>::ok
+         && !mx_of<TA>::is_scal && !mx_of<TB>::is_scal
+         && is_equal<typename mx_of<TA>::scalar, typename mx_of<TB>::scalar>::val
+         && (is_mx<TA>::val || is_mx<TB>::val))> {
+};
+
+
+} /* namespace internal */
+
+
+
+// Matrix members
+template <typename T>
+template <typename E>
+Matrix<T>::Matrix(const internal::mexpr<T, E> &e)
+    : m_data((idx_t) e.self().rows() * e.self().cols()),
+      m_rows(e.self().rows()), m_cols(e.self().cols())
+{
+    internal::mx_eval(m_data.ptr() - 1, e.self(), m_data.size());
+}
+
+
+template <typename T>
+template <typename E>
+Matrix<T>&
+Matrix<T>::operator=(const internal::mexpr<T, E> &e)
+{
+    int r = e.self().rows(), c = e.self().cols();
+    idx_t s = (idx_t) r * c;
+    if ((s != m_data.size()) || !m_data.unique()) {
+        Matrix<T> res(e);
+        return *this = std::move(res);
+    }
+    // in place, elements are read and written at the same index
+    m_rows = r;
+    m_cols = c;
+    internal::mx_eval(m_data.ptr() - 1, e.self(), s);
+    return *this;
+}
+
+
+} /* namespace fcnn */
+
+
+#endif /* FCNN_MATEXPR_H */
@@ -39,54 +39,6 @@ using namespace fcnn;
 using namespace fcnn::internal;
 
 
-// ==================================================================
-// Unary minus
-// ==================================================================
-namespace {
-
-
-template <typename T>
-struct uminus {
-};
-
-
-template <typename T>
-struct uminus<Matrix<T> > {
-    static Matrix<T>
-    eval(const Matrix<T> &m) {
-        int r = m.rows(), c = m.cols(), s = m.size();
-        if (!s) return m;
-        Matrix<T> res(r, c);
-        for (int i = 1; i <= s; ++i)
-            res.elem(i) = -m.elem(i);
-        return res;
-    }
-};
-
-
-} /* namespace */
-
-
-
-// Definition
-// ==================================================================
-template <typename T>
-typename fcnn::internal::enable_unary<T>::type
-fcnn::operator-(const T &m)
-{
-    return uminus<T>::eval(m);
-}
-
-// Instantiations
-// ==================================================================
-template typename fcnn::internal::enable_unary<Matrix<float> >::type
-fcnn::operator-(const Matrix<float>&);
-template typename fcnn::internal::enable_unary<Matrix<double> >::type
-fcnn::operator-(const Matrix<double>&);
-
-
-
-
 // ==================================================================
 // Transposition
 // ==================================================================
@@ -102,7 +54,8 @@ template <typename T>
 struct trans<Matrix<T> > {
     static Matrix<T>
     eval(const Matrix<T> &m) {
-        int r = m.rows(), c = m.cols(), s = m.size();
+        int r = m.rows(), c = m.cols();
+        idx_t s = m.size();
         Matrix<T> res(c, r);
         if (!s) return res;
 
@@ -155,8 +108,9 @@ template <typename T>
 struct reshap<Matrix<T> > {
     static Matrix<T>
     eval(const Matrix<T> &mat, int m, int n) {
-        int r = mat.rows(), c = mat.cols(), s = mat.size();
-        if (m * n != s) {
+        int r = mat.rows(), c = mat.cols();
+        idx_t s = mat.size();
+        if ((idx_t)m * n != s) {
             message mes;
             mes << "nonconformant sizes in reshape; original size is "
                 << r << 'x' << c << ", requested " << m << 'x' << n;
@@ -191,146 +145,18 @@ fcnn::reshape(const Matrix<double>&, int, int);
 
 
 // ==================================================================
-// +, -, mul, div (element by element ops)
+// +, -, mul, div, pow (element by element ops, see matexpr.h)
 // ==================================================================
-namespace {
-
-template <typename T>
-struct op_add {
-    static inline T eval(const T &a, const T &b) { return a + b; }
-};
-
-template <typename T>
-struct op_sub {
-    static inline T eval(const T &a, const T &b) { return a - b; }
-};
-
-template <typename T>
-struct op_mul {
-    static inline T eval(const T &a, const T &b) { return a * b; }
-};
-
-template <typename T>
-struct op_div {
-    static inline T eval(const T &a, const T &b) { return a / b; }
-};
-
-
-
-
-template <typename TA, typename TB, template <typename> class OP>
-struct elbyel {
-};
-
-template <typename T, template <typename> class OP>
-struct elbyel<Matrix<T>, Matrix<T>, OP> {
-    static Matrix<T> eval(const Matrix<T> &A, const Matrix<T> &B) {
-        int Ar = A.rows(), Ac = A.cols(), Br = B.rows(), Bc = B.cols(),
-                 s = A.size();
-        if ((Ar == 1) && (Ac == 1))
-            return elbyel<T, Matrix<T>, OP>::eval(A.elem(1), B);
-        if ((Br == 1) && (Bc == 1))
-            return elbyel<Matrix<T>, T, OP>::eval(A, B.elem(1));
-        if ((Ar != Br) || (Ac != Bc)) {
-            message mes;
-            mes << "nonconformant sizes in +,- or element by element "
-                << "(mul, div) operation; 1st operand is "
-                << Ar << 'x' << Ac << ", 2nd " << Br << 'x' << Bc;
-            error(mes);
-        }
-        if (!s) return A;
-        Matrix<T> res(Ar, Ac);
-        for (int i = 1; i <= s; ++i)
-            res.elem(i) = OP<T>::eval(A.elem(i), B.elem(i));
-        return res;
-    }
-};
-
-template <typename T, template <typename> class OP>
-struct elbyel<T, Matrix<T>, OP> {
-    static Matrix<T> eval(const T &A, const Matrix<T> &B) {
-        int s = B.size();
-        if (!s) return B;
-        Matrix<T> res(B.rows(), B.cols());
-        for (int i = 1; i <= s; ++i)
-            res.elem(i) = OP<T>::eval(A, B.elem(i));
-        return res;
-    }
-};
-
-template <typename T, template <typename> class OP>
-struct elbyel<Matrix<T>, T, OP> {
-    static Matrix<T> eval(const Matrix<T> &A, const T &B) {
-        int s = A.size();
-        if (!s) return A;
-        Matrix<T> res(A.rows(), A.cols());
-        for (int i = 1; i <= s; ++i)
-            res.elem(i) = OP<T>::eval(A.elem(i), B);
-        return res;
-    }
-};
-
-} /* namespace */
-
-
-
-// Definitions
-// ==================================================================
-template <typename TA, typename TB>
-typename fcnn::internal::enable_binary<TA, TB>::type
-fcnn::operator+(const TA &A, const TB &B)
-{
-    return elbyel<TA, TB, op_add>::eval(A, B);
-}
-
-template <typename TA, typename TB>
-typename fcnn::internal::enable_binary<TA, TB>::type
-fcnn::operator-(const TA &A, const TB &B)
-{
-    return elbyel<TA, TB, op_sub>::eval(A, B);
-}
-
-template <typename TA, typename TB>
-typename fcnn::internal::enable_binary<TA, TB>::type
-fcnn::mul(const TA &A, const TB &B)
-{
-    return elbyel<TA, TB, op_mul>::eval(A, B);
-}
-
-template <typename TA, typename TB>
-typename fcnn::internal::enable_binary<TA, TB>::type
-fcnn::div(const TA &A, const TB &B)
+void
+fcnn::internal::mx_error_size(int Ar, int Ac, int Br, int Bc)
 {
-    return elbyel<TA, TB, op_div>::eval(A, B);
+    message mes;
+    mes << "nonconformant sizes in +,- or element by element "
+        << "(mul, div) operation; 1st operand is "
+        << Ar << 'x' << Ac << ", 2nd " << Br << 'x' << Bc;
+    error(mes);
 }
 
-// Instantiations
-// ==================================================================
-#define INSTANTIATE_BIN(WHAT) \
-template \
-typename fcnn::internal::enable_binary<Matrix<float>, Matrix<float> >::type \
-fcnn::WHAT(const Matrix<float>&, const Matrix<float>&); \
-template \
-typename fcnn::internal::enable_binary<float, Matrix<float> >::type \
-fcnn::WHAT(const float&, const Matrix<float>&); \
-template \
-typename fcnn::internal::enable_binary<Matrix<float>, float>::type \
-fcnn::WHAT(const Matrix<float>&, const float&); \
-template \
-typename fcnn::internal::enable_binary<Matrix<double>, Matrix<double> >::type \
-fcnn::WHAT(const Matrix<double>&, const Matrix<double>&); \
-template \
-typename fcnn::internal::enable_binary<double, Matrix<double> >::type \
-fcnn::WHAT(const double&, const Matrix<double>&); \
-template \
-typename fcnn::internal::enable_binary<Matrix<double>, double>::type \
-fcnn::WHAT(const Matrix<double>&, const double&);
-
-INSTANTIATE_BIN(operator+)
-INSTANTIATE_BIN(operator-)
-INSTANTIATE_BIN(mul)
-INSTANTIATE_BIN(div)
-
 
 
 
@@ -346,31 +172,6 @@ struct mat_mul {
 };
 
 
-template <typename T>
-struct mat_mul<T, Matrix<T> > {
-    static Matrix<T> eval(const T &A, const Matrix<T> &B) {
-        int s = B.size();
-        if (!s) return B;
-        Matrix<T> res(B.rows(), B.cols());
-        for (int i = 1; i <= s; ++i)
-            res.elem(i) = A * B.elem(i);
-        return res;
-    }
-};
-
-template <typename T>
-struct mat_mul<Matrix<T>, T> {
-    static Matrix<T> eval(const Matrix<T> &A, const T &B) {
-        int s = A.size();
-        if (!s) return A;
-        Matrix<T> res(A.rows(), A.cols());
-        for (int i = 1; i <= s; ++i)
-            res.elem(i) = A.elem(i) * B;
-        return res;
-    }
-};
-
-
 #if defined(HAVE_BLAS)
 extern "C" {
 float
@@ -556,122 +357,21 @@ struct mat_mul<Matrix<T>, Matrix<T> > {
 // Definition
 // ==================================================================
 template <typename TA, typename TB>
-typename fcnn::internal::enable_binary<TA, TB>::type
+typename fcnn::internal::enable_matmul<TA, TB>::type
 fcnn::operator*(const TA &A, const TB &B)
 {
     return mat_mul<TA, TB>::eval(A, B);
 }
 
 
-// Instantiations
-// ==================================================================
-INSTANTIATE_BIN(operator*)
-
-
-
-
-
-
-// ==================================================================
-// / (division by scalar)
-// ==================================================================
-namespace {
-
-template <typename TA, typename TB>
-struct div_scal {
-};
-
-
-template <typename T>
-struct div_scal<Matrix<T>, T> {
-    static Matrix<T> eval(const Matrix<T> &A, const T &B) {
-        int s = A.size();
-        if (!s) return A;
-        Matrix<T> res(A.rows(), A.cols());
-        for (int i = 1; i <= s; ++i)
-            res.elem(i) = A.elem(i) / B;
-        return res;
-    }
-};
-
-
-
-} /* namespace */
-
-
-// Definition
-// ==================================================================
-template <typename TA, typename TB>
-typename fcnn::internal::enable_opdivpow<TA, TB>::type
-fcnn::operator/(const TA &A, const TB &B)
-{
-    return div_scal<TA, TB>::eval(A, B);
-}
-
-
-// Instantiations
-// ==================================================================
-template
-typename fcnn::internal::enable_opdivpow<Matrix<float>, float>::type
-fcnn::operator/(const Matrix<float>&, const float&);
-template
-typename fcnn::internal::enable_opdivpow<Matrix<double>, double>::type
-fcnn::operator/(const Matrix<double>&, const double&);
-
-
-
-
-
-
-
-
-// ==================================================================
-// pow (powers)
-// ==================================================================
-namespace {
-
-template <typename TA, typename TB>
-struct pow_scal {
-};
-
-
-template <typename T>
-struct pow_scal<Matrix<T>, T> {
-    static Matrix<T> eval(const Matrix<T> &A, const T &B) {
-        int s = A.size();
-        if (!s) return A;
-        Matrix<T> res(A.rows(), A.cols());
-        for (int i = 1; i <= s; ++i)
-            res.elem(i) = std::pow(A.elem(i), B);
-        return res;
-    }
-};
-
-
-
-} /* namespace */
-
-
-// Definition
-// ==================================================================
-template <typename TA, typename TB>
-typename fcnn::internal::enable_opdivpow<TA, TB>::type
-fcnn::pow(const TA &A, const TB &B)
-{
-    return pow_scal<TA, TB>::eval(A, B);
-}
-
-
 // Instantiations
 // ==================================================================
 template
-typename fcnn::internal::enable_opdivpow<Matrix<float>, float>::type
-fcnn::pow(const Matrix<float>&, const float&);
+typename fcnn::internal::enable_matmul<Matrix<float>, Matrix<float> >::type
+fcnn::operator*(const Matrix<float>&, const Matrix<float>&);
 template
-typename fcnn::internal::enable_opdivpow<Matrix<double>, double>::type
-fcnn::pow(const Matrix<double>&, const double&);
-
-
+typename fcnn::internal::enable_matmul<Matrix<double>, Matrix<double> >::type
+fcnn::operator*(const Matrix<double>&, const Matrix<double>&);
 
 
 
@@ -926,7 +626,8 @@ struct in<Matrix<T> > {
     {
         std::vector<T> data;
         T buf;
-        int ii, i, j, r = 0, c = 0, prevc = 0;
+        int i, j, r = 0, c = 0, prevc = 0;
+        idx_t ii;
 
         m.reset();
         skip_all(is);
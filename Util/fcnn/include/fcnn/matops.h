@@ -20,6 +20,11 @@
 
 /** \file matops.h
  *  \brief Matrix operations.
+ *
+ *  Element by element operations (unary minus, +, -, mul, div, pow and
+ *  multiplication and division by scalar) are lazy: they return expressions
+ *  which are evaluated in a single loop, without temporaries, when assigned
+ *  to a Matrix (in place if its memory is not shared).
  */
 
 
@@ -31,15 +36,22 @@
 #include <iostream>
 #include <fcnn/mat.h>
 #include <fcnn/matops_enable.h>
+#include <fcnn/matexpr.h>
 
 
 namespace fcnn {
 
 
-/// Unary minus.
+/// Unary minus (lazy).
 template <typename T>
-typename fcnn::internal::enable_unary<T>::type
-operator-(const T&);
+inline
+typename fcnn::internal::enable_mx_un<T, fcnn::internal::mx_neg>::type
+operator-(const T &A)
+{
+    typedef fcnn::internal::mx_of<T> X;
+    return typename fcnn::internal::enable_mx_un<T, fcnn::internal::mx_neg>::type
+        (X::make(A));
+}
 
 /// Transposition.
 template <typename T>
@@ -51,40 +63,90 @@ template <typename T>
 typename fcnn::internal::enable_unary<T>::type
 reshape(const T&, int m, int n);
 
-/// Addition.
+/// Addition (lazy).
 template <typename TA, typename TB>
-typename fcnn::internal::enable_binary<TA, TB>::type
-operator+(const TA&, const TB&);
-
-/// Subtraction.
+inline
+typename fcnn::internal::enable_mx_bin<TA, TB, fcnn::internal::mx_add>::type
+operator+(const TA &A, const TB &B)
+{
+    return typename fcnn::internal::enable_mx_bin<TA, TB, fcnn::internal::mx_add>::type
+        (fcnn::internal::mx_of<TA>::make(A), fcnn::internal::mx_of<TB>::make(B));
+}
+
+/// Subtraction (lazy).
 template <typename TA, typename TB>
-typename fcnn::internal::enable_binary<TA, TB>::type
-operator-(const TA&, const TB&);
-
-/// Multiplication.
+inline
+typename fcnn::internal::enable_mx_bin<TA, TB, fcnn::internal::mx_sub>::type
+operator-(const TA &A, const TB &B)
+{
+    return typename fcnn::internal::enable_mx_bin<TA, TB, fcnn::internal::mx_sub>::type
+        (fcnn::internal::mx_of<TA>::make(A), fcnn::internal::mx_of<TB>::make(B));
+}
+
+/// Matrix multiplication.
 template <typename TA, typename TB>
-typename fcnn::internal::enable_binary<TA, TB>::type
+typename fcnn::internal::enable_matmul<TA, TB>::type
 operator*(const TA&, const TB&);
 
-/// Division (by scalar).
+/// Matrix multiplication (expressions are evaluated first).
 template <typename TA, typename TB>
-typename fcnn::internal::enable_opdivpow<TA, TB>::type
-operator/(const TA&, const TB&);
-
-/// Element by element power.
+inline
+typename fcnn::internal::enable_mx_matmul<TA, TB>::type
+operator*(const TA &A, const TB &B)
+{
+    typedef typename fcnn::internal::enable_mx_matmul<TA, TB>::type M;
+    return M(A) * M(B);
+}
+
+/// Multiplication by scalar (lazy).
 template <typename TA, typename TB>
-typename fcnn::internal::enable_opdivpow<TA, TB>::type
-pow(const TA&, const TB&);
-
-/// Element by element multiplication.
+inline
+typename fcnn::internal::enable_mx_mul<TA, TB>::type
+operator*(const TA &A, const TB &B)
+{
+    return typename fcnn::internal::enable_mx_mul<TA, TB>::type
+        (fcnn::internal::mx_of<TA>::make(A), fcnn::internal::mx_of<TB>::make(B));
+}
+
+/// Division by scalar (lazy).
 template <typename TA, typename TB>
-typename fcnn::internal::enable_binary<TA, TB>::type
-mul(const TA&, const TB&);
-
-/// Element by element division.
+inline
+typename fcnn::internal::enable_mx_scal<TA, TB, fcnn::internal::mx_div>::type
+operator/(const TA &A, const TB &B)
+{
+    return typename fcnn::internal::enable_mx_scal<TA, TB, fcnn::internal::mx_div>::type
+        (fcnn::internal::mx_of<TA>::make(A), fcnn::internal::mx_of<TB>::make(B));
+}
+
+/// Element by element power (lazy).
+template <typename TA, typename TB>
+inline
+typename fcnn::internal::enable_mx_scal<TA, TB, fcnn::internal::mx_pow>::type
+pow(const TA &A, const TB &B)
+{
+    return typename fcnn::internal::enable_mx_scal<TA, TB, fcnn::internal::mx_pow>::type
+        (fcnn::internal::mx_of<TA>::make(A), fcnn::internal::mx_of<TB>::make(B));
+}
+
+/// Element by element multiplication (lazy).
+template <typename TA, typename TB>
+inline
+typename fcnn::internal::enable_mx_bin<TA, TB, fcnn::internal::mx_mul>::type
+mul(const TA &A, const TB &B)
+{
+    return typename fcnn::internal::enable_mx_bin<TA, TB, fcnn::internal::mx_mul>::type
+        (fcnn::internal::mx_of<TA>::make(A), fcnn::internal::mx_of<TB>::make(B));
+}
+
+/// Element by element division (lazy).
 template <typename TA, typename TB>
-typename fcnn::internal::enable_binary<TA, TB>::type
-div(const TA&, const TB&);
+inline
+typename fcnn::internal::enable_mx_bin<TA, TB, fcnn::internal::mx_div>::type
+div(const TA &A, const TB &B)
+{
+    return typename fcnn::internal::enable_mx_bin<TA, TB, fcnn::internal::mx_div>::type
+        (fcnn::internal::mx_of<TA>::make(A), fcnn::internal::mx_of<TB>::make(B));
+}
 
 /// Matrix inverse.
 template <typename T>
@@ -107,6 +169,34 @@ typename fcnn::internal::enable_io<std::istream, T>::type&
 operator>>(std::istream&, T&);
 
 
+/// Transposition of an expression.
+template <typename T, typename E>
+inline
+Matrix<T>
+t(const fcnn::internal::mexpr<T, E> &e)
+{
+    return t(Matrix<T>(e));
+}
+
+/// Reshape of an expression.
+template <typename T, typename E>
+inline
+Matrix<T>
+reshape(const fcnn::internal::mexpr<T, E> &e, int m, int n)
+{
+    return reshape(Matrix<T>(e), m, n);
+}
+
+/// Stream output of an expression.
+template <typename T, typename E>
+inline
+std::ostream&
+operator<<(std::ostream &os, const fcnn::internal::mexpr<T, E> &e)
+{
+    return os << Matrix<T>(e);
+}
+
+
 } /* namespace fcnn */
 
 
@@ -92,21 +92,6 @@ struct enable_unary : enable_unary_<T,
 };
 
 
-template <typename TA, typename TB, bool> struct enable_binary_ { };
-template <typename TA, typename TB>
-struct enable_binary_<TA, TB, true> {
-    typedef Matrix<typename get_scalar<TA>::type> type;
-};
-
-template <typename TA, typename TB>
-struct enable_binary : enable_binary_<TA, TB,
-        ((allow_scalar<typename get_scalar<TA>::type>::val)
-        && (is_equal<typename get_scalar<TA>::type,
-                    typename get_scalar<TB>::type>::val)
-        && (is_matrix<TA>::val || is_matrix<TB>::val))> {
-};
-
-
 template <typename TA, typename TB, bool> struct enable_solve_ { };
 template <typename TA, typename TB>
 struct enable_solve_<TA, TB, true> {
@@ -122,19 +107,8 @@ struct enable_solve : enable_solve_<TA, TB,
 };
 
 
-template <typename TA, typename TB, bool> struct enable_opdivpow_ { };
-template <typename TA, typename TB>
-struct enable_opdivpow_<TA, TB, true> {
-    typedef TA type;
-};
-
 template <typename TA, typename TB>
-struct enable_opdivpow : enable_opdivpow_<TA, TB,
-        ((is_matrix<TA>::val)
-        && (!is_matrix<TB>::val)
-        && (allow_scalar<typename get_scalar<TA>::type>::val)
-        && (is_equal<typename get_scalar<TA>::type,
-                    typename get_scalar<TB>::type >::val))> {
+struct enable_matmul : enable_solve<TA, TB> {
 };
 
 
@@ -0,0 +1,145 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file matview.cpp
+ *  \brief Views of matrices (selected rows and columns without copying).
+ */
+
+
+#include <fcnn/matview.h>
+#include <fcnn/error.h>
+#include <fcnn/utils.h>
+#include <fcnn/level1.h>
+
+
+
+using namespace fcnn;
+using namespace fcnn::internal;
+
+
+
+// Constructors
+template <typename T>
+MatrixView<T>::MatrixView(const Matrix<T> &m)
+    : m_mat(m), m_rows(m.rows()), m_cols(m.cols())
+{
+    m_r.p = m_mat.ptr();
+    m_r.ld = m.rows();
+    m_r.rs = 1;
+    m_r.idx = 0;
+}
+
+
+template <typename T>
+MatrixView<T>::MatrixView(const Matrix<T> &m, const std::vector<int> &rows)
+    : m_mat(m), m_idx(rows), m_rows(rows.size()), m_cols(m.cols())
+{
+    for (int i = 0; i < m_rows; ++i) {
+        if ((m_idx[i] < 1) || (m_idx[i] > m.rows())) {
+            message mes;
+            mes << "invalid row index " << m_idx[i] << " in matrix view; matrix size: "
+                << m.rows() << 'x' << m.cols();
+            error(mes);
+        }
+        --m_idx[i];
+    }
+    m_r.p = m_mat.ptr();
+    m_r.ld = m.rows();
+    m_r.rs = 1;
+    m_r.idx = m_rows ? &m_idx[0] : 0;
+}
+
+
+template <typename T>
+MatrixView<T>::MatrixView(const Matrix<T> &m, int i, int n, int j, int c,
+                          int si, int sj)
+    : m_mat(m), m_rows(n), m_cols(c)
+{
+    if ((n < 0) || (c < 0) || (si < 1) || (sj < 1)
+        || (n && ((i < 1) || ((idx_t) i + (idx_t)(n - 1) * si > m.rows())))
+        || (c && ((j < 1) || ((idx_t) j + (idx_t)(c - 1) * sj > m.cols())))) {
+        message mes;
+        mes << "invalid matrix view (rows " << i << ", " << n << ", " << si
+            << "; columns " << j << ", " << c << ", " << sj << "); matrix size: "
+            << m.rows() << 'x' << m.cols();
+        error(mes);
+    }
+    m_r.p = (n && c) ? m_mat.ptr() + (i - 1) + (idx_t)(j - 1) * m.rows() : 0;
+    m_r.ld = (idx_t) m.rows() * sj;
+    m_r.rs = si;
+    m_r.idx = 0;
+}
+
+
+template <typename T>
+MatrixView<T>::MatrixView(const MatrixView &v)
+    : m_mat(v.m_mat), m_idx(v.m_idx), m_r(v.m_r),
+      m_rows(v.m_rows), m_cols(v.m_cols)
+{
+    if (m_r.idx) m_r.idx = &m_idx[0];
+}
+
+
+template <typename T>
+MatrixView<T>&
+MatrixView<T>::operator=(const MatrixView &v)
+{
+    m_mat = v.m_mat;
+    m_idx = v.m_idx;
+    m_r = v.m_r;
+    m_rows = v.m_rows;
+    m_cols = v.m_cols;
+    if (m_r.idx) m_r.idx = &m_idx[0];
+    return *this;
+}
+
+
+// Element access
+template <typename T>
+T const&
+MatrixView<T>::operator()(int i, int j) const
+{
+    if ((i < 1) || (i > m_rows) || (j < 1) || (j > m_cols)) {
+        message mes;
+        mes << "invalid double index (" << i << ", " << j << "); view size: "
+            << m_rows << 'x' << m_cols;
+        error(mes);
+    }
+    return elem(i, j);
+}
+
+
+// Copy
+template <typename T>
+Matrix<T>
+MatrixView<T>::copy() const
+{
+    Matrix<T> res(m_rows, m_cols);
+    for (int i = 0; i < m_rows; ++i)
+        internal::copy(m_cols, m_r.row(i), m_r.ld, res.ptr() + i, m_rows);
+    return res;
+}
+
+
+
+// Instantiations
+// ===================================================================
+template class fcnn::MatrixView<double>;
+template class fcnn::MatrixView<float>;
@@ -0,0 +1,113 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file matview.h
+ *  \brief Views of matrices (selected rows and columns without copying).
+ */
+
+
+#ifndef FCNN_MATVIEW_H
+
+#define FCNN_MATVIEW_H
+
+
+#include <vector>
+#include <fcnn/mat.h>
+
+
+namespace fcnn {
+
+
+namespace internal {
+
+/// Access to rows of a column major matrix used by level 3 routines:
+/// element (i, j) (0-based) is p[row(i) + j * ld] where row(i) is
+/// idx[i] if idx is given, i * rs otherwise.
+template <typename T>
+struct mat_rows {
+    const T *p;
+    idx_t ld, rs;
+    const int *idx;
+    /// Pointer to the first element of row i.
+    inline const T* row(int i) const { return p + (idx ? (idx_t) idx[i] : i * rs); }
+};
+
+} /* namespace internal */
+
+
+/// View of selected rows and columns of a matrix. No data is copied;
+/// the view shares memory with the matrix (and keeps it alive), so changes
+/// of the matrix elements are visible through the view. Rows are selected
+/// by index list or by offset and stride, columns by offset and stride.
+template <typename T>
+class MatrixView
+{
+ public:
+    /// View of the whole matrix.
+    MatrixView(const Matrix<T> &m);
+    /// View of selected rows (1-based indices, may repeat).
+    MatrixView(const Matrix<T> &m, const std::vector<int> &rows);
+    /// View of n rows starting at row i, every si-th row, and c columns
+    /// starting at column j, every sj-th column.
+    MatrixView(const Matrix<T> &m, int i, int n, int j, int c,
+               int si = 1, int sj = 1);
+
+    /// Returns number of rows.
+    inline int rows() const { return m_rows; }
+    /// Returns number of columns.
+    inline int cols() const { return m_cols; }
+
+    /// Element access, no index checking.
+    inline T const& elem(int i, int j) const {
+        return m_r.row(i - 1)[(idx_t)(j - 1) * m_r.ld];
+    }
+    /// Element access.
+    T const& operator()(int i, int j) const;
+
+    /// Return a matrix with the elements of the view.
+    Matrix<T> copy() const;
+
+    /// Row access for level 3 routines.
+    inline const internal::mat_rows<T>& ref() const { return m_r; }
+
+    /// Copy constructor.
+    MatrixView(const MatrixView &v);
+    /// Assignment.
+    MatrixView& operator=(const MatrixView &v);
+
+ private:
+    /// Matrix (keeps data alive).
+    Matrix<T> m_mat;
+    /// Row offsets (if rows are selected by indices).
+    std::vector<int> m_idx;
+    /// Row access.
+    internal::mat_rows<T> m_r;
+    /// No. of rows.
+    int m_rows;
+    /// No. of columns.
+    int m_cols;
+
+}; /* class template MatrixView */
+
+
+} /* namespace fcnn */
+
+
+#endif /* FCNN_MATVIEW_H */
@@ -27,12 +27,15 @@
 #include <fcnn/mlpnet.h>
 #include <fcnn/struct.h>
 #include <fcnn/export.h>
+#include <fcnn/level2.h>
 #include <fcnn/level3.h>
 #include <fcnn/activation.h>
 #include <fcnn/matops.h>
 #include <iostream>
 #include <cstdlib>
 #include <cstdarg>
+#include <cmath>
+#include <algorithm>
 
 
 using namespace fcnn;
@@ -128,6 +131,10 @@ MLPNet<T>::construct(const std::vector<int> &layers)
     }
     m_af.assign(m_nol, sym_sigmoid); m_af[0] = 0;
     m_af_p.assign(m_nol, mlp_act_f_pdefault<T>(sym_sigmoid)); m_af_p[0] = (T)0;
+    m_hb.assign(m_nol, 0);
+    m_hs.assign(m_nol, 0);
+    m_hval.clear();
+    pack();
 }
 
 
@@ -149,6 +156,10 @@ MLPNet<T>::construct(const std::vector<int> &layers,
     }
     m_af.assign(m_nol, sym_sigmoid); m_af[0] = 0;
     m_af_p.assign(m_nol, mlp_act_f_pdefault<T>(sym_sigmoid)); m_af_p[0] = (T)0;
+    m_hb.assign(m_nol, 0);
+    m_hs.assign(m_nol, 0);
+    m_hval.clear();
+    pack();
 }
 
 
@@ -156,6 +167,7 @@ template <typename T>
 void
 MLPNet<T>::expand_reorder_inputs(int newnoinp, const std::map<int, int> &m)
 {
+    check_not_hashed();
     try {
         mlp_expand_reorder_inputs(m_l, m_n_p, m_n_prev, m_n_next,
                                   m_w_p, m_w_val, m_w_fl,
@@ -163,6 +175,7 @@ MLPNet<T>::expand_reorder_inputs(int newnoinp, const std::map<int, int> &m)
     } catch (exception &e) {
         error(e.what());
     }
+    pack();
 }
 
 
@@ -171,12 +184,33 @@ template <typename T>
 std::pair<int, int>
 MLPNet<T>::rm_neurons(bool report)
 {
+    check_not_hashed();
     int w = m_w_on, n;
     n = mlp_rm_neurons(m_l, m_n_p, m_n_prev, m_n_next,
                        m_w_p, m_w_val, m_w_fl, m_w_on,
                        m_af, m_af_p,
                        report);
     w -= m_w_on;
+    pack();
+    return std::pair<int, int>(n, w);
+}
+
+
+
+template <typename T>
+std::pair<int, int>
+MLPNet<T>::rm_neurons(std::vector<int> &w_idx, bool report)
+{
+    check_not_hashed();
+    int w = m_w_on, n;
+    w_idx.resize(m_w_p[m_nol]);
+    for (int i = 0, nw = w_idx.size(); i < nw; ++i) w_idx[i] = i + 1;
+    n = mlp_rm_neurons(m_l, m_n_p, m_n_prev, m_n_next,
+                       m_w_p, m_w_val, m_w_fl, m_w_on,
+                       m_af, m_af_p,
+                       report, &w_idx);
+    w -= m_w_on;
+    pack();
     return std::pair<int, int>(n, w);
 }
 
@@ -186,6 +220,7 @@ template <typename T>
 std::vector<int>
 MLPNet<T>::rm_input_neurons(bool report)
 {
+    check_not_hashed();
     std::vector<int> ind;
     ind.reserve(m_l[0]);
     for (int i = 0; i < m_l[0]; ++i)
@@ -193,6 +228,7 @@ MLPNet<T>::rm_input_neurons(bool report)
     mlp_rm_input_neurons(m_l, m_n_p, m_n_prev, m_n_next,
                          m_w_p, m_w_val, m_w_fl,
                          report);
+    pack();
     return ind;
 }
 
@@ -214,6 +250,8 @@ fcnn::merge(const MLPNet<T> &A, const MLPNet<T> &B, bool same_inputs)
 {
     MLPNet<T> res;
 
+    if (A.hashed() || B.hashed())
+        error("merging networks with hashed layers is not supported");
     try {
         mlp_merge(A.m_l, A.m_w_p, A.m_w_val, A.m_w_fl,
                 B.m_l, B.m_w_p, B.m_w_val, B.m_w_fl,
@@ -232,6 +270,9 @@ fcnn::merge(const MLPNet<T> &A, const MLPNet<T> &B, bool same_inputs)
     }
     res.m_af = A.m_af;
     res.m_af_p = A.m_af_p;
+    res.m_hb.assign(res.m_nol, 0);
+    res.m_hs.assign(res.m_nol, 0);
+    res.pack();
     return res;
 }
 
@@ -247,6 +288,8 @@ fcnn::stack(const MLPNet<T> &A, const MLPNet<T> &B)
 {
     MLPNet<T> res;
 
+    if (A.hashed() || B.hashed())
+        error("stacking networks with hashed layers is not supported");
     try {
         mlp_stack(A.m_l, A.m_w_p, A.m_w_val, A.m_w_fl,
                 B.m_l, B.m_w_p, B.m_w_val, B.m_w_fl,
@@ -262,6 +305,9 @@ fcnn::stack(const MLPNet<T> &A, const MLPNet<T> &B)
     res.m_af.insert(res.m_af.end(), B.m_af.begin() + 1, B.m_af.end());
     res.m_af_p = A.m_af_p;
     res.m_af_p.insert(res.m_af_p.end(), B.m_af_p.begin() + 1, B.m_af_p.end());
+    res.m_hb.assign(res.m_nol, 0);
+    res.m_hs.assign(res.m_nol, 0);
+    res.pack();
     return res;
 }
 
@@ -289,6 +335,28 @@ MLPNet<T>::set_act_f(int l, int af, T param)
 }
 
 
+template <typename T>
+int
+MLPNet<T>::get_act_f(int l) const
+{
+    if ((l < 2) || (l > m_nol)) {
+        error("invalid layer index");
+    }
+    return m_af[l - 1];
+}
+
+
+template <typename T>
+T
+MLPNet<T>::get_act_f_param(int l) const
+{
+    if ((l < 2) || (l > m_nol)) {
+        error("invalid layer index");
+    }
+    return m_af_p[l - 1];
+}
+
+
 
 
 // ==================================================================
@@ -433,7 +501,15 @@ MLPNet<T>::set_w(int l, int n, int npl, T w)
         }
         error(mes);
     }
+    if (hashed_w(ind)) {
+        message mes;
+        mes << "connection between neuron " << n << " in layer " << l
+            << " and neuron " << npl << " in layer " << (l - 1)
+            << " is shared (hashed layer)";
+        error(mes);
+    }
     m_w_val[ind] = w;
+    m_pk.set_w(ind, w);
 }
 
 
@@ -448,7 +524,13 @@ MLPNet<T>::set_w(int i, T w)
         mes << "weigth " << i << " is off";
         error(mes);
     }
+    if (hashed_w(ind)) {
+        message mes;
+        mes << "weight " << i << " is shared (hashed layer)";
+        error(mes);
+    }
     m_w_val[ind] = w;
+    m_pk.set_w(ind, w);
 }
 
 
@@ -476,9 +558,18 @@ void
 MLPNet<T>::set_active(int l, int n, int npl, bool on)
 {
     check_w(l, n, npl);
+    if (hashed_w(weight_ind(l, n, npl))) {
+        message mes;
+        mes << "connection between neuron " << n << " in layer " << l
+            << " and neuron " << npl << " in layer " << (l - 1)
+            << " is in hashed layer and cannot be switched on/off";
+        error(mes);
+    }
     mlp_set_active(&m_l[0], &m_n_p[0], &m_n_prev[0], &m_n_next[0],
                    &m_w_p[0], &m_w_val[0], &m_w_fl[0], &m_w_on,
                    l, n, npl, on);
+    int ind = weight_ind(l, n, npl);
+    m_pk.set_w(ind, m_w_val[ind]);
 }
 
 
@@ -488,9 +579,15 @@ void
 MLPNet<T>::set_active(int i, bool on)
 {
     check_w(i);
+    if (hashed_w(i - 1)) {
+        message mes;
+        mes << "weight " << i << " is in hashed layer and cannot be switched on/off";
+        error(mes);
+    }
     mlp_set_active(&m_l[0], &m_n_p[0], &m_n_prev[0], &m_n_next[0],
                    &m_w_p[0], &m_w_val[0], &m_w_fl[0], &m_w_on,
                    i, on);
+    m_pk.set_w(i - 1, m_w_val[i - 1]);
 }
 
 
@@ -521,6 +618,119 @@ MLPNet<T>::get_ln_idx(int i, int &l, int &n, int &npl) const
 
 
 
+// ==================================================================
+// Hashed weight sharing
+// ==================================================================
+template <typename T>
+void
+MLPNet<T>::set_hashed(int l, int buckets, unsigned seed)
+{
+    if ((l < 2) || (l > m_nol)) {
+        error("invalid layer index");
+    }
+    --l;
+    int npl = m_l[l - 1], nc = m_l[l] * npl;
+    if ((buckets < 0) || (buckets > nc)) {
+        message mes;
+        mes << "invalid no. of buckets (" << buckets << "), layer " << (l + 1)
+            << " has " << nc << " connections";
+        error(mes);
+    }
+    if (buckets) {
+        for (int i = m_w_p[l], n = m_w_p[l + 1]; i < n; ++i) {
+            if (!m_w_fl[i]) {
+                message mes;
+                mes << "all connections in hashed layer have to be active; layer "
+                    << (l + 1) << " has inactive ones";
+                error(mes);
+            }
+        }
+    }
+
+    // remove existing buckets
+    int off = 0;
+    for (int k = 1; k < l; ++k) off += m_hb[k];
+    m_hval.erase(m_hval.begin() + off, m_hval.begin() + off + m_hb[l]);
+    m_hb[l] = buckets;
+    m_hs[l] = seed;
+    if (!buckets) return;
+
+    // initial buckets: averages of (signed) weights
+    std::vector<T> val(buckets, T());
+    std::vector<int> cnt(buckets, 0);
+    for (int n = 0, i = m_w_p[l]; n < m_l[l]; ++n) {
+        ++i; // bias
+        for (int p = 0; p < npl; ++p, ++i) {
+            unsigned h = mlp_hash(seed, n, p, npl);
+            int b = (h & 0x7fffffffu) % (unsigned) buckets;
+            val[b] += (h >> 31) ? -m_w_val[i] : m_w_val[i];
+            ++cnt[b];
+        }
+    }
+    for (int b = 0; b < buckets; ++b)
+        if (cnt[b]) val[b] /= (T) cnt[b];
+    m_hval.insert(m_hval.begin() + off, val.begin(), val.end());
+    hash_expand();
+    pack();
+}
+
+
+template <typename T>
+int
+MLPNet<T>::hashed(int l) const
+{
+    if ((l < 1) || (l > m_nol)) {
+        error("invalid layer index");
+    }
+    return m_hb[l - 1];
+}
+
+
+template <typename T>
+int
+MLPNet<T>::no_params() const
+{
+    int n = m_w_on + m_hval.size();
+    for (int l = 1; l < m_nol; ++l)
+        if (m_hb[l]) n -= m_l[l] * m_l[l - 1];
+    return n;
+}
+
+
+template <typename T>
+void
+MLPNet<T>::hash_expand()
+{
+    fcnn::internal::hash_expand(&m_l[0], m_nol, &m_w_p[0],
+                                &m_hb[0], &m_hs[0], &m_hval[0], &m_w_val[0]);
+}
+
+
+template <typename T>
+Matrix<T>
+MLPNet<T>::hash_reduce(const Matrix<T> &g) const
+{
+    int c = g.cols();
+    Matrix<T> res(no_params(), c);
+    for (int j = 1; j <= c; ++j) {
+        fcnn::internal::hash_reduce(&m_l[0], m_nol, &m_w_p[0], &m_w_fl[0],
+                                    &m_hb[0], &m_hs[0],
+                                    &g.elem(1, j), &res.elem(1, j));
+    }
+    return res;
+}
+
+
+template <typename T>
+void
+MLPNet<T>::check_not_hashed() const
+{
+    if (hashed())
+        error("operation is not supported for networks with hashed layers");
+}
+
+
+
 // ==================================================================
 // Weights - randomising, retrieving and setting
 // ==================================================================
@@ -529,8 +739,14 @@ void
 MLPNet<T>::rnd_weights(T a)
 {
     for (int i = 0, n = m_w_p[m_nol]; i < n; ++i)
-        if (m_w_fl[i])
+        if (m_w_fl[i] && !hashed_w(i))
             m_w_val[i] = (T)2 * a * ((T) ::rand() / (T) RAND_MAX - (T)0.5);
+    if (hashed()) {
+        for (int k = 0, n = m_hval.size(); k < n; ++k)
+            m_hval[k] = (T)2 * a * ((T) ::rand() / (T) RAND_MAX - (T)0.5);
+        hash_expand();
+    }
+    pack();
 }
 
 
@@ -538,9 +754,12 @@ template <typename T>
 Matrix<T>
 MLPNet<T>::get_weights() const
 {
-    Matrix<T> ret(m_w_on, 1);
-    for (int i = 0, j = 1, n = m_w_p[m_nol]; i < n; ++i)
-        if (m_w_fl[i]) ret.elem(j++) = m_w_val[i];
+    Matrix<T> ret(no_params(), 1);
+    int j = 1;
+    for (int i = 0, n = m_w_p[m_nol]; i < n; ++i)
+        if (m_w_fl[i] && !hashed_w(i)) ret.elem(j++) = m_w_val[i];
+    for (int k = 0, n = m_hval.size(); k < n; ++k)
+        ret.elem(j++) = m_hval[k];
 
     return ret;
 }
@@ -556,16 +775,17 @@ MLPNet<T>::set_weights(const Matrix<T> &w, bool mk_zeros_inactive)
             << w.rows() << "x" << w.cols() << ")";
         error(mes);
     }
-    if (m_w_on != w.size()) {
+    int np = no_params(), j = 1;
+    if (np != w.size()) {
         message mes;
-        mes << "no. of active weights (" << m_w_on
+        mes << "no. of free parameters (" << np
             << ") and weights provided (" << w.size() << ") disagree";
         error(mes);
     }
 
     if (mk_zeros_inactive) {
-        for (int i = 0, j = 1, n = m_w_p[m_nol]; i < n; ++i) {
-            if (m_w_fl[i]) {
+        for (int i = 0, n = m_w_p[m_nol]; i < n; ++i) {
+            if (m_w_fl[i] && !hashed_w(i)) {
                 m_w_val[i] = w.elem(j++);
                 if (m_w_val[i] == T()) {
                     --m_w_on;
@@ -579,9 +799,15 @@ MLPNet<T>::set_weights(const Matrix<T> &w, bool mk_zeros_inactive)
             }
         }
     } else {
-        for (int i = 0, j = 1, n = m_w_p[m_nol]; i < n; ++i)
-            if (m_w_fl[i]) m_w_val[i] = w.elem(j++);
+        for (int i = 0, n = m_w_p[m_nol]; i < n; ++i)
+            if (m_w_fl[i] && !hashed_w(i)) m_w_val[i] = w.elem(j++);
+    }
+    if (hashed()) {
+        for (int k = 0, n = m_hval.size(); k < n; ++k)
+            m_hval[k] = w.elem(j++);
+        hash_expand();
     }
+    pack();
 }
 
 
@@ -594,7 +820,7 @@ MLPNet<T>::save(const std::string &fname) const
 {
     if (!m_nol) error("trying to save uninitialised (empty) network");
     return mlp_save_txt(fname, m_name, m_l, m_w_val, m_w_fl,
-                        m_af, m_af_p);
+                        m_af, m_af_p, m_hb, m_hs, m_hval);
 
 }
 
@@ -607,11 +833,12 @@ MLPNet<T>::load(const std::string &fname)
     clear();
     bool ok = mlp_load_txt(fname, m_name, m_l, m_n_p, m_n_prev, m_n_next,
                            m_w_p, m_w_val, m_w_fl, m_w_on,
-                           m_af, m_af_p);
+                           m_af, m_af_p, m_hb, m_hs, m_hval);
     if (!ok) {
         clear();
     } else {
         m_nol = m_l.size();
+        pack();
     }
     return ok;
 }
@@ -724,14 +951,22 @@ MLPNet<T>::check_inout(int ri, int ci, int ro, int co) const
 template <typename T>
 Matrix<T>
 MLPNet<T>::eval(const Matrix<T> &input) const
+{
+    return eval(MatrixView<T>(input));
+}
+
+
+
+template <typename T>
+Matrix<T>
+MLPNet<T>::eval(const MatrixView<T> &input) const
 {
     check_in(input.rows(), input.cols());
 
     int r = input.rows();
     Matrix<T> res(input.rows(), m_l[m_nol - 1]);
-    fcnn::internal::eval(&m_l[0], m_l.size(), &m_n_p[0],
-                         &m_w_val[0], &m_af[0], &m_af_p[0],
-                         r, input.ptr(), res.ptr());
+    fcnn::internal::eval(m_pk, &m_af[0], &m_af_p[0],
+                         r, input.ref(), res.ptr());
 
     return res;
 }
@@ -741,16 +976,173 @@ MLPNet<T>::eval(const Matrix<T> &input) const
 
 
 
+template <typename T>
+Matrix<T>
+MLPNet<T>::eval(const SparseMatrix<T> &input) const
+{
+    check_in(input.rows(), input.cols());
+
+    int r = input.rows();
+    Matrix<T> res(input.rows(), m_l[m_nol - 1]);
+    fcnn::internal::eval_sp(m_pk, &m_af[0], &m_af_p[0],
+                            r, input.ref(), res.ptr());
+
+    return res;
+}
+
+
+
+
 template <typename T>
 T
 MLPNet<T>::mse(const Matrix<T> &input, const Matrix<T> &output) const
+{
+    return mse(MatrixView<T>(input), MatrixView<T>(output));
+}
+
+
+
+template <typename T>
+T
+MLPNet<T>::mse(const MatrixView<T> &input, const MatrixView<T> &output) const
+{
+    check_inout(input.rows(), input.cols(), output.rows(), output.cols());
+
+    int r = input.rows();
+    return fcnn::internal::mse(m_pk, &m_af[0], &m_af_p[0],
+                               r, input.ref(), output.ref());
+}
+
+
+
+template <typename T>
+T
+MLPNet<T>::mse(const Dataset<T> &dat) const
+{
+    const Matrix<T> &input = dat.get_input(), &output = dat.get_output();
+    check_inout(input.rows(), input.cols(), output.rows(), output.cols());
+
+    int r = input.rows();
+    const T *rw = dat.weighted() ? &dat.get_record_weights()[0] : 0;
+    return fcnn::internal::mse(m_pk, &m_af[0], &m_af_p[0],
+                               r, MatrixView<T>(input).ref(),
+                               MatrixView<T>(output).ref(), rw);
+}
+
+
+
+
+template <typename T>
+T
+MLPNet<T>::mse(const SparseMatrix<T> &input, const Matrix<T> &output) const
 {
     check_inout(input.rows(), input.cols(), output.rows(), output.cols());
 
     int r = input.rows();
-    return fcnn::internal::mse(&m_l[0], m_l.size(), &m_n_p[0],
-                               &m_w_val[0], &m_af[0], &m_af_p[0],
-                               r, input.ptr(), output.ptr());
+    return fcnn::internal::mse_sp(m_pk, &m_af[0], &m_af_p[0],
+                                  r, input.ref(), MatrixView<T>(output).ref());
+}
+
+
+
+
+template <typename T>
+T
+MLPNet<T>::mse(DataSource<T> &src) const
+{
+    check_inout(src.no_records(), src.no_inputs(),
+                src.no_records(), src.no_outputs());
+
+    double se = 0.;
+    int n = 0;
+    fcnn::internal::stream_blocks<T>(src,
+        [&](const Matrix<T> &in, const Matrix<T> &out) {
+            se += (double) mse(in, out) * in.rows();
+            n += in.rows();
+            return true;
+        });
+    if (!n) error("data source is empty");
+    return (T) (se / n);
+}
+
+
+
+
+template <typename T>
+bool
+MLPNet<T>::mse_below(const Matrix<T> &input, const Matrix<T> &output,
+                     T tol, T confidence) const
+{
+    check_inout(input.rows(), input.cols(), output.rows(), output.cols());
+    if ((confidence <= T()) || (confidence >= (T)1))
+        error("confidence level should be between 0 and 1");
+
+    // block size: 1/32 of data, but no less than 32 records
+    int r = input.rows(), bs = r / 32;
+    if (bs < 32) bs = 32;
+    if (bs >= r) return mse(input, output) < tol;
+
+    // record order from a generator of its own (caller's rand() stream
+    // is left intact), seeded by FNV-1a hash of weights: reproducible
+    // for given network, but varying as the network changes
+    unsigned seed = 2166136261u;
+    const unsigned char *wb = reinterpret_cast<const unsigned char*>(&m_w_val[0]);
+    for (size_t i = 0; i < m_w_val.size() * sizeof(T); ++i) {
+        seed ^= wb[i];
+        seed *= 16777619u;
+    }
+    std::vector<int> idx = permute_int(r, seed);
+    for (int i = 0; i < r; ++i) --idx[i];
+    std::vector<T> se(bs);
+    double z = qnorm(.5 + .5 * (double) confidence),
+           den = 2. * (double) m_l[m_nol - 1],
+           sum = 0., sumsq = 0.;
+    int n = 0;
+
+    while (n < r) {
+        int m = std::min(bs, r - n);
+        fcnn::internal::sqerr(m_pk, &m_af[0], &m_af_p[0],
+                              r, m, &idx[n], input.ptr(), output.ptr(), &se[0]);
+        for (int k = 0; k < m; ++k) {
+            double e = (double) se[k] / den;
+            sum += e;
+            sumsq += e * e;
+        }
+        n += m;
+        if (n == r) break;
+        // confidence interval with finite population correction
+        double mean = sum / n, var = (sumsq - n * mean * mean) / (n - 1);
+        if (var < 0.) var = 0.;
+        double hw = z * sqrt(var / n * (1. - (double) n / (double) r));
+        if (mean + hw < (double) tol) return true;
+        if (mean - hw > (double) tol) return false;
+    }
+
+    return sum / r < (double) tol;
+}
+
+
+
+
+template <typename T>
+Matrix<T>
+MLPNet<T>::neuron_stats(const Matrix<T> &input) const
+{
+    check_in(input.rows(), input.cols());
+
+    int r = input.rows(), nn = m_n_p[m_nol];
+    Matrix<T> res(nn, 2);
+    fcnn::internal::nstat(&m_l[0], m_l.size(), &m_n_p[0],
+                          &m_w_val[0], &m_af[0], &m_af_p[0],
+                          r, input.ptr(), res.ptr(), res.ptr() + nn);
+    for (int i = 1; i <= nn; ++i) {
+        T m = res.elem(i, 1) / (T)r;
+        T v = res.elem(i, 2) / (T)r - m * m;
+        res.elem(i, 1) = m;
+        res.elem(i, 2) = (v > T()) ? v : T();
+    }
+
+    return res;
 }
 
 
@@ -760,19 +1152,111 @@ template <typename T>
 std::pair<Matrix<T>, T>
 MLPNet<T>::grad(const Matrix<T> &input, const Matrix<T> &output) const
 {
+    return grad(MatrixView<T>(input), MatrixView<T>(output));
+}
+
+
+
+template <typename T>
+std::pair<Matrix<T>, T>
+MLPNet<T>::grad(const MatrixView<T> &input, const MatrixView<T> &output) const
+{
+    return grad(input, output, std::vector<T>());
+}
+
+
+
+template <typename T>
+std::pair<Matrix<T>, T>
+MLPNet<T>::grad(const MatrixView<T> &input, const MatrixView<T> &output,
+                const std::vector<T> &rw) const
+{
+    check_inout(input.rows(), input.cols(), output.rows(), output.cols());
+    if (!rw.empty()) {
+        if ((int) rw.size() != input.rows()) {
+            message mes;
+            mes << "no. of records (" << input.rows()
+                << ") and record weights (" << (int) rw.size() << ") disagree";
+            error(mes);
+        }
+        T sw = T();
+        for (std::size_t i = 0; i < rw.size(); ++i) sw += rw[i];
+        if (!(sw > T())) error("sum of record weights should be positive");
+    }
+
+    Matrix<T> gradient(m_w_on, 1);
+    T se;
+    se = fcnn::internal::grad(m_pk, &m_w_fl[0], &m_af[0], &m_af_p[0],
+                              input.rows(), input.ref(), output.ref(), gradient.ptr(),
+                              rw.empty() ? 0 : &rw[0]);
+    if (hashed()) gradient = hash_reduce(gradient);
+    return std::pair<Matrix<T>, T>(gradient, se);
+}
+
+
+
+template <typename T>
+std::pair<Matrix<T>, T>
+MLPNet<T>::grad(const Dataset<T> &dat) const
+{
+    const Matrix<T> &input = dat.get_input(), &output = dat.get_output();
     check_inout(input.rows(), input.cols(), output.rows(), output.cols());
 
     Matrix<T> gradient(m_w_on, 1);
     T se;
-    se = fcnn::internal::grad(&m_l[0], m_l.size(), &m_n_p[0],
-                              &m_w_p[0], &m_w_fl[0], &m_w_val[0],
-                              &m_af[0], &m_af_p[0],
-                              input.rows(), input.ptr(), output.ptr(), gradient.ptr());
+    const T *rw = dat.weighted() ? &dat.get_record_weights()[0] : 0;
+    se = fcnn::internal::grad(m_pk, &m_w_fl[0], &m_af[0], &m_af_p[0],
+                              input.rows(), MatrixView<T>(input).ref(),
+                              MatrixView<T>(output).ref(), gradient.ptr(), rw);
+    if (hashed()) gradient = hash_reduce(gradient);
     return std::pair<Matrix<T>, T>(gradient, se);
 }
 
 
 
+template <typename T>
+std::pair<Matrix<T>, T>
+MLPNet<T>::grad(const SparseMatrix<T> &input, const Matrix<T> &output) const
+{
+    check_inout(input.rows(), input.cols(), output.rows(), output.cols());
+
+    Matrix<T> gradient(m_w_on, 1);
+    T se;
+    se = fcnn::internal::grad_sp(m_pk, &m_w_fl[0], &m_af[0], &m_af_p[0],
+                                 input.rows(), input.ref(), MatrixView<T>(output).ref(),
+                                 gradient.ptr());
+    if (hashed()) gradient = hash_reduce(gradient);
+    return std::pair<Matrix<T>, T>(gradient, se);
+}
+
+
+
+template <typename T>
+std::pair<Matrix<T>, T>
+MLPNet<T>::grad(DataSource<T> &src) const
+{
+    check_inout(src.no_records(), src.no_inputs(),
+                src.no_records(), src.no_outputs());
+
+    Matrix<T> gradient(no_params(), 1, T());
+    double se = 0.;
+    int n = 0;
+    // blocks are weighted by the no. of records
+    fcnn::internal::stream_blocks<T>(src,
+        [&](const Matrix<T> &in, const Matrix<T> &out) {
+            std::pair<Matrix<T>, T> gm = grad(in, out);
+            gradient = gradient + (T) in.rows() * gm.first;
+            se += (double) gm.second * in.rows();
+            n += in.rows();
+            return true;
+        });
+    if (!n) error("data source is empty");
+    gradient = gradient / (T) n;
+    return std::pair<Matrix<T>, T>(gradient, (T) (se / n));
+}
+
+
+
 template <typename T>
 Matrix<T>
 MLPNet<T>::gradi(const Matrix<T> &input, const Matrix<T> &output, int i) const
@@ -786,10 +1270,9 @@ MLPNet<T>::gradi(const Matrix<T> &input, const Matrix<T> &output, int i) const
     }
 
     Matrix<T> gradient(m_w_on, 1);
-    fcnn::internal::gradi(&m_l[0], m_l.size(), &m_n_p[0],
-                          &m_w_p[0], &m_w_fl[0], &m_w_val[0],
-                          &m_af[0], &m_af_p[0],
+    fcnn::internal::gradi(m_pk, &m_w_fl[0], &m_af[0], &m_af_p[0],
                           input.rows(), i - 1, input.ptr(), output.ptr(), gradient.ptr());
+    if (hashed()) gradient = hash_reduce(gradient);
     return gradient;
 }
 
@@ -809,10 +1292,9 @@ MLPNet<T>::gradij(const Matrix<T> &input, int i) const
     }
 
     Matrix<T> gradients(m_w_on, m_l[m_nol - 1]);
-    fcnn::internal::gradij(&m_l[0], m_l.size(), &m_n_p[0],
-                           &m_w_p[0], &m_w_fl[0], &m_w_val[0], m_w_on,
-                           &m_af[0], &m_af_p[0],
+    fcnn::internal::gradij(m_pk, &m_w_fl[0], m_w_on, &m_af[0], &m_af_p[0],
                            input.rows(), i - 1, input.ptr(), gradients.ptr());
+    if (hashed()) gradients = hash_reduce(gradients);
     return gradients;
 }
 
@@ -832,9 +1314,7 @@ MLPNet<T>::jacob(const Matrix<T> &input, int i) const
     }
 
     Matrix<T> jac(m_l[0], m_l[m_nol - 1]);
-    fcnn::internal::jacob(&m_l[0], m_l.size(), &m_n_p[0],
-                          &m_w_p[0], &m_w_fl[0], &m_w_val[0], m_w_on,
-                          &m_af[0], &m_af_p[0],
+    fcnn::internal::jacob(m_pk, &m_af[0], &m_af_p[0],
                           input.rows(), i - 1, input.ptr(), jac.ptr());
     return jac;
 }
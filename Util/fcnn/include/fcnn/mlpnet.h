@@ -32,8 +32,12 @@
 #include <vector>
 #include <map>
 #include <fcnn/mat.h>
+#include <fcnn/matview.h>
 #include <fcnn/dataset.h>
+#include <fcnn/datasource.h>
+#include <fcnn/sparse.h>
 #include <fcnn/activation.h>
+#include <fcnn/packed.h>
 
 
 namespace fcnn {
@@ -76,6 +80,11 @@ class MLPNet {
     /// Remove inactive (i.e. not connected to previous or next layer) neurons
     /// in the hidden layers. Returns no. of neurons and associated weights removed.
     std::pair<int, int> rm_neurons(bool report = false);
+    /// Remove inactive (i.e. not connected to previous or next layer) neurons
+    /// in the hidden layers. Returns no. of neurons and associated weights removed.
+    /// Sets w_idx to the (1-based) indices the remaining weights had before
+    /// removal.
+    std::pair<int, int> rm_neurons(std::vector<int> &w_idx, bool report = false);
     /// Remove inactive (i.e. not connected to the next layer) input neurons.
     /// Returns (1-based) indices of neurons that where not removed.
     std::vector<int> rm_input_neurons(bool report = false);
@@ -103,6 +112,10 @@ class MLPNet {
     /// Set activation function (and its parameter) for layer l. When parameter
     /// is 0, the default parameter value for given activation is set.
     void set_act_f(int l, int af, T param = 0);
+    /// Get activation function of layer l.
+    int get_act_f(int l) const;
+    /// Get activation function parameter of layer l.
+    T get_act_f_param(int l) const;
 
     /// Set network name.
     void set_name(const std::string &name) { m_name = name; }
@@ -148,41 +161,130 @@ class MLPNet {
     /// (0 for npl means bias).
     void get_ln_idx(int i, int &l, int &n, int &npl) const;
 
+    /// Turn hashed weight sharing on in layer l. Weights of connections
+    /// (but not biases) are mapped by a hash function (with given seed)
+    /// to given no. of shared buckets (with random signs). Initial bucket
+    /// values are averages of weights mapped to them. All connections
+    /// in the layer have to be active and stay active. Setting no. of buckets
+    /// to 0 turns sharing off (weights are kept).
+    void set_hashed(int l, int buckets, unsigned seed = 0);
+    /// Get no. of buckets in layer l (0 if weights are not shared).
+    int hashed(int l) const;
+    /// Does network have hashed layers?
+    inline bool hashed() const { return !m_hval.empty(); }
+    /// Return no. of free parameters, i.e. active weights excluding
+    /// connections in hashed layers plus buckets (equal to active_w()
+    /// when there are no hashed layers).
+    int no_params() const;
+
     /// Draw random initial weights from \f$(-a, a)\f$.
     void rnd_weights(T a = (T)0.2);
-    /// Get vector of weights of active connections as column vector.
+    /// Get vector of free parameters (weights of active connections,
+    /// followed by buckets if there are hashed layers) as column vector.
     Matrix<T> get_weights() const;
-    /// Set vector of weights of active connections. Admits column vector.
+    /// Set vector of free parameters (weights of active connections,
+    /// followed by buckets if there are hashed layers). Admits column vector.
     /// If mk_zeros_inactive is true, sets the weights corresponding
-    /// to zeros off.
+    /// to zeros off (buckets are never turned off).
     void set_weights(const Matrix<T>&, bool mk_zeros_inactive = false);
 
     /// Evaluate output given input.
     Matrix<T> eval(const Matrix<T> &input) const;
+    /// Evaluate output given input view (rows are read in place).
+    Matrix<T> eval(const MatrixView<T> &input) const;
+    /// Evaluate output given sparse input (only weights of the first hidden
+    /// layer connected to non-zero inputs are used).
+    Matrix<T> eval(const SparseMatrix<T> &input) const;
     /// Compute MSE for \f$N\f$ data records and \f$O\f$ outputs given by
     /// \f$\frac{1}{2 N O} \sum_{n=1}^N \sum_{o=1}^O {e_o^n}^2\f$.
     T mse(const Matrix<T> &input, const Matrix<T> &output) const;
+    /// Compute MSE given input and output views.
+    T mse(const MatrixView<T> &input, const MatrixView<T> &output) const;
     /// Compute MSE for \f$N\f$ data records and \f$O\f$ outputs given by
     /// \f$\frac{1}{2 N O} \sum_{n=1}^N \sum_{o=1}^O {e_o^n}^2\f$.
-    T mse(const Dataset<T> &dat) const
+    /// If records are weighted (see Dataset::weighted), MSE is given by
+    /// \f$\frac{1}{2 W O} \sum_{n=1}^N w_n \sum_{o=1}^O {e_o^n}^2\f$, where
+    /// \f$W = \sum_{n=1}^N w_n\f$.
+    T mse(const Dataset<T> &dat) const;
+    /// Compute MSE given sparse input.
+    T mse(const SparseMatrix<T> &input, const Matrix<T> &output) const;
+    /// Compute MSE given dataset with sparse inputs.
+    T mse(const SparseDataset<T> &dat) const
     {
         return mse(dat.get_input(), dat.get_output());
     }
+    /// Compute MSE over all blocks of data read from source
+    /// (see DataSource).
+    T mse(DataSource<T> &src) const;
+    /// Check if MSE is below given tolerance level. Records are evaluated
+    /// in randomised blocks and evaluation stops as soon as the confidence
+    /// interval for MSE (at given confidence level) lies entirely above
+    /// or below the tolerance level. If all records have to be evaluated,
+    /// the exact MSE is compared with the tolerance level.
+    /// Order of records is pseudo-random, determined by the weights
+    /// (the global generator used by rand() is not touched).
+    bool mse_below(const Matrix<T> &input, const Matrix<T> &output,
+                   T tol, T confidence = (T)0.99) const;
+    /// Check if MSE is below given tolerance level. Records are evaluated
+    /// in randomised blocks and evaluation stops as soon as the confidence
+    /// interval for MSE (at given confidence level) lies entirely above
+    /// or below the tolerance level. If all records have to be evaluated,
+    /// the exact MSE is compared with the tolerance level.
+    /// For weighted records the exact MSE is always compared.
+    bool mse_below(const Dataset<T> &dat, T tol, T confidence = (T)0.99) const
+    {
+        if (dat.weighted()) return mse(dat) < tol;
+        return mse_below(dat.get_input(), dat.get_output(), tol, confidence);
+    }
+
+    /// Compute means (1st column) and variances (2nd column) of the states
+    /// of all neurons given input. Rows correspond to neurons ordered
+    /// by layers.
+    Matrix<T> neuron_stats(const Matrix<T> &input) const;
+    /// Compute means (1st column) and variances (2nd column) of the states
+    /// of all neurons given input. Rows correspond to neurons ordered
+    /// by layers.
+    Matrix<T> neuron_stats(const Dataset<T> &dat) const
+    {
+        return neuron_stats(dat.get_input());
+    }
 
     /// Compute gradient (column vector) of MSE (derivatives w.r.t. active weights)
     /// given input and expected output. Returns MSE as second element
     /// in the pair. This function is useful when implementing batch teaching
-    /// algorithms.
+    /// algorithms. In networks with hashed layers this and the following
+    /// functions return derivatives w.r.t. free parameters (see get_weights).
     std::pair<Matrix<T>, T> grad(const Matrix<T> &input,
                                  const Matrix<T> &output) const;
+    /// Compute gradient and MSE given input and output views
+    /// (e.g. a minibatch of rows selected without copying).
+    std::pair<Matrix<T>, T> grad(const MatrixView<T> &input,
+                                 const MatrixView<T> &output) const;
+    /// Compute gradient and MSE given input and output views and weights
+    /// of their rows (weighted as for Dataset, see mse; empty vector means
+    /// unit weights). Throws if the no. of weights differs from the no.
+    /// of rows or if their sum is not positive.
+    std::pair<Matrix<T>, T> grad(const MatrixView<T> &input,
+                                 const MatrixView<T> &output,
+                                 const std::vector<T> &rw) const;
     /// Compute gradient (column vector) of MSE (derivatives w.r.t. active weights)
     /// given input and expected output. Returns MSE as second element
     /// in the pair. This function is useful when implementing batch teaching
-    /// algorithms.
-    std::pair<Matrix<T>, T> grad(const Dataset<T> &dat) const
+    /// algorithms. If records are weighted, so is MSE (see mse).
+    std::pair<Matrix<T>, T> grad(const Dataset<T> &dat) const;
+    /// Compute gradient and MSE given sparse input. For each record only
+    /// derivatives w.r.t. weights of the first hidden layer connected
+    /// to non-zero inputs are accumulated.
+    std::pair<Matrix<T>, T> grad(const SparseMatrix<T> &input,
+                                 const Matrix<T> &output) const;
+    /// Compute gradient and MSE given dataset with sparse inputs.
+    std::pair<Matrix<T>, T> grad(const SparseDataset<T> &dat) const
     {
         return grad(dat.get_input(), dat.get_output());
     }
+    /// Compute gradient and MSE over all blocks of data read from source
+    /// (see DataSource).
+    std::pair<Matrix<T>, T> grad(DataSource<T> &src) const;
     /// Compute gradient (column vector) of MSE (derivatives w.r.t. active weights)
     /// given input and expected output using ith row of data only. This is
     /// normalised by the number of outputs only, the average over all rows
@@ -254,7 +356,32 @@ class MLPNet {
     std::vector<int> m_af;
     /// Activation functions' parameters.
     std::vector<T> m_af_p;
-
+    /// Weights packed for feed forward (kept in sync with m_w_val).
+    internal::mlp_packed<T> m_pk;
+    /// No. of buckets in hashed layers (0 for ordinary layers).
+    std::vector<int> m_hb;
+    /// Seeds of hash functions in hashed layers.
+    std::vector<unsigned> m_hs;
+    /// Buckets of subsequent hashed layers.
+    std::vector<T> m_hval;
+
+    /// Rebuild packed weights.
+    void pack() { m_pk.build(m_l, m_w_p, m_w_val); }
+    /// Is weight with given (0-based) absolute index a connection
+    /// in a hashed layer?
+    inline bool hashed_w(int i) const {
+        if (m_hval.empty()) return false;
+        int l = 1;
+        while (m_w_p[l + 1] <= i) ++l;
+        return m_hb[l] && ((i - m_w_p[l]) % (m_l[l - 1] + 1));
+    }
+    /// Set weights of connections in hashed layers given buckets.
+    void hash_expand();
+    /// Map derivatives w.r.t. active weights (subsequent columns) to
+    /// derivatives w.r.t. free parameters.
+    Matrix<T> hash_reduce(const Matrix<T> &g) const;
+    /// Report error if network has hashed layers.
+    void check_not_hashed() const;
     /// Clear existing structure.
     void clear();
 
@@ -0,0 +1,221 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file mlpnet_distill.cpp
+ *  \brief Knowledge distillation for multilayer perceptron networks.
+ */
+
+
+#include <fcnn/mlpnet_distill.h>
+#include <fcnn/mlpnet_teach.h>
+#include <fcnn/mlpnet_prune.h>
+#include <fcnn/report.h>
+#include <fcnn/error.h>
+#include <fcnn/utils.h>
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <random>
+
+
+using namespace fcnn;
+using fcnn::internal::message;
+using fcnn::internal::report;
+
+
+
+namespace {
+
+
+// Data source yielding the original records with given teacher outputs
+// followed by no_jitter perturbed copies of them, which are generated
+// batch by batch. Noise is drawn from the same seed on each pass, so that
+// every pass sees the same records; the teacher labels them once (on the
+// first pass) and its outputs are cached.
+template <typename T>
+class jitter_source : public DataSource<T>
+{
+  public:
+    jitter_source(const MLPNet<T> &teacher, const Matrix<T> &in, const Matrix<T> &out,
+                  int no_jitter, T jitter, int batch_size)
+        : m_teacher(teacher), m_in(in), m_out(out), m_nj(no_jitter),
+          m_bs(batch_size), m_amp(in.cols()), m_seed((unsigned) ::rand()),
+          m_nlab(0)
+    {
+        if (no_jitter > INT_MAX / in.rows() - 1) {
+            message mes;
+            mes << "too many jittered copies; no. of records would exceed "
+                << INT_MAX;
+            error(mes);
+        }
+        // noise magnitude: jitter times standard deviation of input
+        int N = in.rows();
+        for (int j = 1, I = in.cols(); j <= I; ++j) {
+            T m = T(), s = T();
+            for (int i = 1; i <= N; ++i) m += in(i, j);
+            m /= N;
+            for (int i = 1; i <= N; ++i) s += (in(i, j) - m) * (in(i, j) - m);
+            m_amp[j - 1] = jitter * std::sqrt(s / N);
+        }
+        m_jout = Matrix<T>(in.rows() * no_jitter, out.cols());
+        rewind();
+    }
+
+    int no_records() const { return m_in.rows() * (m_nj + 1); }
+    int no_inputs() const { return m_in.cols(); }
+    int no_outputs() const { return m_out.cols(); }
+
+    void rewind() { m_copy = 0; m_pos = 0; m_rng.seed(m_seed); }
+    bool next(Matrix<T> &in, Matrix<T> &out);
+
+  private:
+    const MLPNet<T> &m_teacher;
+    const Matrix<T> &m_in, &m_out;
+    int m_nj, m_bs;
+    std::vector<T> m_amp;
+    unsigned m_seed;
+    std::mt19937 m_rng;
+    // current copy (0 for original records) and position in it
+    int m_copy, m_pos;
+    // teacher outputs for jittered records (first m_nlab rows labelled)
+    Matrix<T> m_jout;
+    int m_nlab;
+};
+
+
+template <typename T>
+bool
+jitter_source<T>::next(Matrix<T> &in, Matrix<T> &out)
+{
+    int N = m_in.rows();
+    if (m_pos == N) {
+        if (m_copy == m_nj) return false;
+        ++m_copy;
+        m_pos = 0;
+    }
+    int n = std::min(m_bs, N - m_pos);
+    std::vector<int> idx(n);
+    for (int i = 0; i < n; ++i) idx[i] = m_pos + i + 1;
+    m_pos += n;
+    in = m_in.get_rows(idx);
+    if (!m_copy) {
+        out = m_out.get_rows(idx);
+        return true;
+    }
+    std::uniform_real_distribution<double> u(-1., 1.);
+    for (int j = 1, I = in.cols(); j <= I; ++j)
+        for (int i = 1; i <= n; ++i) in(i, j) += m_amp[j - 1] * (T) u(m_rng);
+    // rows of the batch in cached outputs
+    int r0 = (m_copy - 1) * N + m_pos - n;
+    for (int i = 0; i < n; ++i) idx[i] = r0 + i + 1;
+    if (r0 + n > m_nlab) {
+        // passes are sequential, so the batch follows labelled records
+        out = m_teacher.eval(in);
+        for (int j = 1, O = out.cols(); j <= O; ++j)
+            for (int i = 1; i <= n; ++i) m_jout(r0 + i, j) = out(i, j);
+        m_nlab = r0 + n;
+    } else {
+        out = m_jout.get_rows(idx);
+    }
+    return true;
+}
+
+
+// Teacher outputs computed in batches.
+template <typename T>
+Matrix<T>
+teacher_outputs(const MLPNet<T> &teacher, const Matrix<T> &in, int batch_size)
+{
+    int N = in.rows(), O = teacher.no_neurons(teacher.no_layers());
+    Matrix<T> res(N, O);
+    std::vector<int> idx;
+    for (int b = 1; b <= N; b += batch_size) {
+        int e = std::min(b + batch_size - 1, N);
+        idx.resize(e - b + 1);
+        for (int i = b; i <= e; ++i) idx[i - b] = i;
+        Matrix<T> o = teacher.eval(MatrixView<T>(in, idx));
+        for (int j = 1; j <= O; ++j)
+            for (int i = b; i <= e; ++i) res(i, j) = o(i - b + 1, j);
+    }
+    return res;
+}
+
+
+} /* namespace */
+
+
+
+template <typename T>
+std::pair<T, double>
+fcnn::mlpnet_distill(const MLPNet<T> &teacher, MLPNet<T> &student, const Matrix<T> &in,
+                     T tol_level, int max_epochs, int no_jitter, T jitter,
+                     int batch_size, bool report)
+{
+    if (tol_level <= T()) error("tolerance level should be positive");
+    if (max_epochs < 1) error("maximum no. of epochs should be positive");
+    if (no_jitter < 0) error("no. of jittered copies should be nonnegative");
+    if (jitter < T()) error("jitter magnitude should be nonnegative");
+    if (batch_size < 1) error("batch size should be positive");
+    if (in.rows() < 1) error("input data must have at least one row");
+    if (!teacher.no_layers() || !student.no_layers())
+        error("teacher and student networks should be constructed");
+    if ((teacher.no_neurons(1) != in.cols()) || (student.no_neurons(1) != in.cols()))
+        error("inconsistent no. of inputs of networks and data");
+    if (teacher.no_neurons(teacher.no_layers()) != student.no_neurons(student.no_layers()))
+        error("teacher and student networks have different no. of outputs");
+
+    Matrix<T> out = teacher_outputs(teacher, in, batch_size);
+    if (no_jitter) {
+        // jittered records are streamed, targets of original ones reused
+        jitter_source<T> src(teacher, in, out, no_jitter, jitter, batch_size);
+        if (report) {
+            message mes;
+            mes << "teaching student on " << src.no_records() << " records ("
+                << no_jitter << " jittered copies)";
+            internal::report(mes);
+        }
+        mlpnet_teach_rprop(student, src, tol_level, max_epochs);
+    } else {
+        mlpnet_teach_rprop(student, in, out, tol_level, max_epochs);
+    }
+
+    T mse = student.mse(in, out);
+    double tt = mlpnet_eval_time(teacher, in, 1),
+           ts = mlpnet_eval_time(student, in, 1);
+    if (report) {
+        message mes;
+        mes << "student/teacher MSE " << mse << "; per-record evaluation time "
+            << tt << "s (teacher), " << ts << "s (student), speedup " << (tt / ts);
+        internal::report(mes);
+    }
+    return std::pair<T, double>(mse, tt / ts);
+}
+
+
+
+template std::pair<float, double>
+fcnn::mlpnet_distill(const MLPNet<float>&, MLPNet<float>&, const Matrix<float>&,
+                     float, int, int, float, int, bool);
+template std::pair<double, double>
+fcnn::mlpnet_distill(const MLPNet<double>&, MLPNet<double>&, const Matrix<double>&,
+                     double, int, int, double, int, bool);
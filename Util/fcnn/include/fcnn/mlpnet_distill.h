@@ -0,0 +1,79 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file mlpnet_distill.h
+ *  \brief Knowledge distillation for multilayer perceptron networks.
+ */
+
+
+#ifndef FCNN_MPLNET_DISTILL_H
+
+#define FCNN_MPLNET_DISTILL_H
+
+
+#include <fcnn/mlpnet.h>
+
+
+namespace fcnn {
+
+
+/// Knowledge distillation. Student network is taught (Rprop) to reproduce
+/// outputs of the teacher network on given inputs. Teacher targets are
+/// computed in batches of batch_size records. Optionally, inputs are
+/// augmented with no_jitter copies of each record perturbed by uniform noise
+/// of magnitude jitter times the standard deviation of a given input.
+/// Jittered inputs are not stored: they are generated (the same on each
+/// epoch) in batches as the student is taught. The teacher labels them
+/// once, on the first epoch, and its outputs are cached (no. of records
+/// times no_jitter times no. of outputs values).
+/// Returns MSE of the student w.r.t. the teacher on the original inputs and
+/// the speedup (teacher per-record evaluation time divided by student's).
+template <typename T>
+std::pair<T, double>
+mlpnet_distill(const MLPNet<T> &teacher, MLPNet<T> &student, const Matrix<T> &in,
+               T tol_level, int max_epochs, int no_jitter = 0, T jitter = (T)0.05,
+               int batch_size = 1000, bool report = false);
+
+/// Knowledge distillation. Student network is taught (Rprop) to reproduce
+/// outputs of the teacher network on inputs from the dataset (outputs are
+/// ignored). Teacher targets are computed in batches of batch_size records.
+/// Optionally, inputs are augmented with no_jitter copies of each record
+/// perturbed by uniform noise of magnitude jitter times the standard deviation
+/// of a given input (streamed, with teacher outputs cached, as above).
+/// Returns MSE of the student w.r.t. the teacher on the original inputs and
+/// the speedup (teacher per-record evaluation time divided by student's).
+/// Throws if records are weighted.
+template <typename T>
+inline
+std::pair<T, double>
+mlpnet_distill(const MLPNet<T> &teacher, MLPNet<T> &student, const Dataset<T> &dat,
+               T tol_level, int max_epochs, int no_jitter = 0, T jitter = (T)0.05,
+               int batch_size = 1000, bool report = false)
+{
+    if (dat.weighted()) error("distillation does not support record weights");
+    return mlpnet_distill(teacher, student, dat.get_input(), tol_level, max_epochs,
+                          no_jitter, jitter, batch_size, report);
+}
+
+
+} /* namespace fcnn */
+
+
+#endif /* FCNN_MPLNET_DISTILL_H */
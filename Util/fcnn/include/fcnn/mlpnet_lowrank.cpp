@@ -0,0 +1,302 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file mlpnet_lowrank.cpp
+ *  \brief Low-rank factorisation of layers of multilayer perceptron networks.
+ */
+
+
+#include <fcnn/mlpnet_lowrank.h>
+#include <fcnn/mlpnet_teach.h>
+#include <fcnn/activation.h>
+#include <fcnn/report.h>
+#include <fcnn/error.h>
+#include <fcnn/utils.h>
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+
+using namespace fcnn;
+using fcnn::internal::message;
+using fcnn::internal::report;
+
+
+
+namespace {
+
+
+// Eigenvalues (d, decreasing) and eigenvectors (columns of V) of symmetric
+// n x n matrix A (column major, destroyed) by cyclic Jacobi method.
+void
+eig_sym(int n, std::vector<double> &A, std::vector<double> &V,
+        std::vector<double> &d)
+{
+    V.assign(n * n, 0.);
+    for (int i = 0; i < n; ++i) V[i + i * n] = 1.;
+    double nrm = 0.;
+    for (int i = 0; i < n * n; ++i) nrm += A[i] * A[i];
+    for (int sweep = 0; sweep < 100; ++sweep) {
+        double off = 0.;
+        for (int q = 1; q < n; ++q)
+            for (int p = 0; p < q; ++p) off += A[p + q * n] * A[p + q * n];
+        if (off <= 1e-30 * nrm) break;
+        for (int q = 1; q < n; ++q) {
+            for (int p = 0; p < q; ++p) {
+                double apq = A[p + q * n];
+                if (apq == 0.) continue;
+                double theta = (A[q + q * n] - A[p + p * n]) / (2. * apq);
+                double t = 1. / (std::fabs(theta) + std::sqrt(theta * theta + 1.));
+                if (theta < 0.) t = -t;
+                double c = 1. / std::sqrt(t * t + 1.), s = t * c;
+                for (int k = 0; k < n; ++k) {
+                    double akp = A[k + p * n], akq = A[k + q * n];
+                    A[k + p * n] = c * akp - s * akq;
+                    A[k + q * n] = s * akp + c * akq;
+                }
+                for (int k = 0; k < n; ++k) {
+                    double apk = A[p + k * n], aqk = A[q + k * n];
+                    A[p + k * n] = c * apk - s * aqk;
+                    A[q + k * n] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < n; ++k) {
+                    double vkp = V[k + p * n], vkq = V[k + q * n];
+                    V[k + p * n] = c * vkp - s * vkq;
+                    V[k + q * n] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    // sort
+    std::vector<std::pair<double, int> > ev(n);
+    for (int i = 0; i < n; ++i) ev[i] = std::make_pair(-A[i + i * n], i);
+    std::sort(ev.begin(), ev.end());
+    std::vector<double> W(n * n);
+    d.resize(n);
+    for (int j = 0; j < n; ++j) {
+        d[j] = -ev[j].first;
+        std::copy(V.begin() + ev[j].second * n, V.begin() + (ev[j].second + 1) * n,
+                  W.begin() + j * n);
+    }
+    V.swap(W);
+}
+
+
+
+// Factorisation W = P Q (W is m x k, P is m x r, Q is r x k; column major)
+// of layer l weights truncated to given rank. Based on eigenvectors
+// of Gram matrix (of the smaller dimension).
+class lowrank_f {
+  public:
+    lowrank_f(int m, int k, const std::vector<double> &W);
+    void get(int r, std::vector<double> &P, std::vector<double> &Q) const;
+  private:
+    int m_m, m_k;
+    std::vector<double> m_W, m_V;
+};
+
+
+lowrank_f::lowrank_f(int m, int k, const std::vector<double> &W)
+    : m_m(m), m_k(k), m_W(W)
+{
+    int n = std::min(m, k);
+    std::vector<double> G(n * n, 0.), d;
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            double g = 0.;
+            if (k <= m) for (int a = 0; a < m; ++a) g += W[a + i * m] * W[a + j * m];
+            else for (int a = 0; a < k; ++a) g += W[i + a * m] * W[j + a * m];
+            G[i + j * n] = G[j + i * n] = g;
+        }
+    }
+    eig_sym(n, G, m_V, d);
+}
+
+
+void
+lowrank_f::get(int r, std::vector<double> &P, std::vector<double> &Q) const
+{
+    int m = m_m, k = m_k;
+    P.assign(m * r, 0.);
+    Q.assign(r * k, 0.);
+    if (k <= m) {
+        // W ~ (W V_r) V_r'
+        for (int j = 0; j < r; ++j) {
+            for (int a = 0; a < k; ++a) Q[j + a * r] = m_V[a + j * k];
+            for (int i = 0; i < m; ++i) {
+                double s = 0.;
+                for (int a = 0; a < k; ++a) s += m_W[i + a * m] * m_V[a + j * k];
+                P[i + j * m] = s;
+            }
+        }
+    } else {
+        // W ~ U_r (U_r' W)
+        for (int j = 0; j < r; ++j) {
+            for (int i = 0; i < m; ++i) P[i + j * m] = m_V[i + j * m];
+            for (int a = 0; a < k; ++a) {
+                double s = 0.;
+                for (int i = 0; i < m; ++i) s += m_V[i + j * m] * m_W[i + a * m];
+                Q[j + a * r] = s;
+            }
+        }
+    }
+}
+
+
+
+// Copy weights (and active flags) of layer l of net to layer ld of res.
+template <typename T>
+void
+copy_layer(const MLPNet<T> &net, int l, MLPNet<T> &res, int ld)
+{
+    res.set_act_f(ld, net.get_act_f(l), net.get_act_f_param(l));
+    for (int n = 1, nn = net.no_neurons(l); n <= nn; ++n) {
+        for (int npl = 0, npn = net.no_neurons(l - 1); npl <= npn; ++npl) {
+            if (net.is_active(l, n, npl)) res.set_w(ld, n, npl, net.get_w(l, n, npl));
+            else res.set_active(ld, n, npl, false);
+        }
+    }
+}
+
+
+
+// Network with linear bottleneck layer of r neurons inserted before layer l.
+template <typename T>
+MLPNet<T>
+mk_lowrank(const MLPNet<T> &net, int l, int r,
+           const std::vector<double> &P, const std::vector<double> &Q)
+{
+    int nol = net.no_layers(), m = net.no_neurons(l), k = net.no_neurons(l - 1);
+    std::vector<int> layers;
+    for (int j = 1; j < l; ++j) layers.push_back(net.no_neurons(j));
+    layers.push_back(r);
+    for (int j = l; j <= nol; ++j) layers.push_back(net.no_neurons(j));
+
+    MLPNet<T> res;
+    res.construct(layers);
+    res.set_name(net.get_name());
+    for (int j = 2; j < l; ++j) copy_layer(net, j, res, j);
+    // bottleneck (no biases)
+    res.set_act_f(l, linear, (T)1);
+    for (int n = 1; n <= r; ++n) {
+        res.set_active(l, n, 0, false);
+        for (int a = 1; a <= k; ++a)
+            res.set_w(l, n, a, (T) Q[(n - 1) + (a - 1) * r]);
+    }
+    // layer l
+    res.set_act_f(l + 1, net.get_act_f(l), net.get_act_f_param(l));
+    for (int n = 1; n <= m; ++n) {
+        if (net.is_active(l, n, 0)) res.set_w(l + 1, n, 0, net.get_w(l, n, 0));
+        else res.set_active(l + 1, n, 0, false);
+        for (int a = 1; a <= r; ++a)
+            res.set_w(l + 1, n, a, (T) P[(n - 1) + (a - 1) * m]);
+    }
+    for (int j = l + 1; j <= nol; ++j) copy_layer(net, j, res, j + 1);
+    return res;
+}
+
+
+} /* namespace */
+
+
+
+template <typename T>
+int
+fcnn::mlpnet_lowrank(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
+                     int l, T tol_level, bool report, int max_reteach_iter)
+{
+    if (tol_level <= T()) error("tolerance level should be positive");
+    if (net.hashed())
+        error("factorisation of networks with hashed layers is not supported");
+    if ((l < 2) || (l > net.no_layers())) error("invalid layer index");
+    T mse;
+    if ((mse = net.mse(in, out)) > tol_level) {
+        message mes;
+        mes << "network should be trained with MSE reduced to given tolerance "
+            << "level (" << tol_level << ") before factorisation; MSE is " << mse;
+        error(mes);
+    }
+
+    int m = net.no_neurons(l), k = net.no_neurons(l - 1),
+        rmax = (m * k - 1) / (m + k);
+    if (rmax < 1) {
+        if (report) {
+            message mes;
+            mes << "layer " << l << " is too small to be factorised";
+            internal::report(mes);
+        }
+        return 0;
+    }
+
+    // inactive (pruned) connections enter as zeros
+    std::vector<double> W(m * k), P, Q;
+    for (int n = 1; n <= m; ++n)
+        for (int a = 1; a <= k; ++a)
+            W[(n - 1) + (a - 1) * m] =
+                net.is_active(l, n, a) ? (double) net.get_w(l, n, a) : 0.;
+    lowrank_f f(m, k, W);
+
+    // bisection over ranks (assuming error is decreasing in rank)
+    MLPNet<T> best;
+    int lo = 1, hi = rmax, rank = 0;
+    while (lo <= hi) {
+        int r = (lo + hi) / 2;
+        f.get(r, P, Q);
+        MLPNet<T> res = mk_lowrank(net, l, r, P, Q);
+        // the randomised check may only reject early, acceptance is
+        // confirmed by exact MSE (reteaching returns exact MSE)
+        T e = T();
+        bool ok = res.mse_below(in, out, tol_level)
+                  && ((e = res.mse(in, out)) < tol_level);
+        if (!ok && (max_reteach_iter > 0)) {
+            MLPNetRprop<T> rprop;
+            std::pair<T, int> retres =
+                rprop.teach(res, in, out, tol_level, max_reteach_iter);
+            e = retres.first;
+            ok = e < tol_level;
+        }
+        if (report) {
+            message mes;
+            mes << "layer " << l << ", rank " << r << ": mse ";
+            if (ok || (max_reteach_iter > 0)) mes << e;
+            else mes << res.mse(in, out);
+            mes << (ok ? " (accepted)" : " (rejected)");
+            internal::report(mes);
+        }
+        if (ok) {
+            best = res;
+            rank = r;
+            hi = r - 1;
+        } else {
+            lo = r + 1;
+        }
+    }
+    if (rank) net = best;
+    return rank;
+}
+
+
+template int
+fcnn::mlpnet_lowrank(MLPNet<float>&, const Matrix<float>&, const Matrix<float>&,
+                     int, float, bool, int);
+template int
+fcnn::mlpnet_lowrank(MLPNet<double>&, const Matrix<double>&, const Matrix<double>&,
+                     int, double, bool, int);
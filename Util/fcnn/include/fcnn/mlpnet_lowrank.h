@@ -0,0 +1,76 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file mlpnet_lowrank.h
+ *  \brief Low-rank factorisation of layers of multilayer perceptron networks.
+ */
+
+
+#ifndef FCNN_MPLNET_LOWRANK_H
+
+#define FCNN_MPLNET_LOWRANK_H
+
+
+#include <fcnn/mlpnet.h>
+
+
+namespace fcnn {
+
+
+/// Low-rank factorisation of layer l. Weight matrix of layer l (\f$m \times k\f$)
+/// is replaced by the product of two thin matrices obtained by truncated SVD,
+/// i.e. a linear bottleneck layer of r neurons is inserted before layer l.
+/// The smallest rank for which MSE (after at most max_reteach_iter epochs
+/// of Rprop fine-tuning, if positive) does not exceed tol_level is chosen.
+/// Only ranks reducing the number of operations, i.e. \f$r(m+k) < mk\f$,
+/// are considered. Returns the rank or 0 if the layer was not factorised
+/// (network is left unchanged then).
+template <typename T>
+int
+mlpnet_lowrank(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
+               int l, T tol_level, bool report = false,
+               int max_reteach_iter = 50);
+
+
+/// Low-rank factorisation of layer l. Weight matrix of layer l (\f$m \times k\f$)
+/// is replaced by the product of two thin matrices obtained by truncated SVD,
+/// i.e. a linear bottleneck layer of r neurons is inserted before layer l.
+/// The smallest rank for which MSE (after at most max_reteach_iter epochs
+/// of Rprop fine-tuning, if positive) does not exceed tol_level is chosen.
+/// Only ranks reducing the number of operations, i.e. \f$r(m+k) < mk\f$,
+/// are considered. Returns the rank or 0 if the layer was not factorised
+/// (network is left unchanged then). Throws if records are weighted.
+template <typename T>
+inline
+int
+mlpnet_lowrank(MLPNet<T> &net, const Dataset<T> &dat,
+               int l, T tol_level, bool report = false,
+               int max_reteach_iter = 50)
+{
+    if (dat.weighted()) error("low-rank factorisation does not support record weights");
+    return mlpnet_lowrank(net, dat.get_input(), dat.get_output(),
+                          l, tol_level, report, max_reteach_iter);
+}
+
+
+} /* namespace fcnn */
+
+
+#endif /* FCNN_MPLNET_LOWRANK_H */
@@ -26,10 +26,12 @@
 #include <fcnn/mlpnet_prune.h>
 #include <fcnn/mlpnet_teach.h>
 #include <fcnn/matops.h>
+#include <fcnn/pool.h>
 #include <fcnn/utils.h>
 #include <fcnn/level3.h>
 #include <fcnn/report.h>
 #include <fcnn/error.h>
+#include <fcnn/timing.h>
 
 #include <cmath>
 
@@ -44,6 +46,80 @@ using fcnn::internal::message;
 using fcnn::internal::report;
 
 
+
+namespace {
+
+
+// Inverse of the approximate Hessian (w.r.t. active weights) used in OBS.
+template <typename T>
+Matrix<T>
+ihess(const MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out, T alpha)
+{
+    int P = in.rows(), N = out.cols(), W = net.active_w();
+    T NP = (T)P * (T)N;
+    Matrix<T> H = ((T)1. / alpha) * eye<T>(W), grads, X, HX;
+    for (int i = 1; i <= P; ++i) {
+        grads = net.gradij(in, i);
+#if defined(HAVE_BLAS)
+        internal::ihessupdate(H.rows(), N, NP, grads.ptr(), H.ptr());
+#else
+        for (int j = 1; j <= N; ++j) {
+            X = grads.get_col(j);
+            HX = H * X;
+            H = H - div(HX * t(HX), NP + t(X) * HX);
+        }
+#endif
+    }
+    return H;
+}
+
+
+// Solve A x = b for small symmetric positive definite A (Cholesky
+// decomposition, A is overwritten). Returns false if A is not positive
+// definite.
+template <typename T>
+bool
+chol_solve(int n, std::vector<T> &A, std::vector<T> &b)
+{
+    for (int j = 0; j < n; ++j) {
+        T d = A[j * n + j];
+        for (int k = 0; k < j; ++k) d -= A[j * n + k] * A[j * n + k];
+        if (d <= T()) return false;
+        d = std::sqrt(d);
+        A[j * n + j] = d;
+        for (int i = j + 1; i < n; ++i) {
+            T s = A[i * n + j];
+            for (int k = 0; k < j; ++k) s -= A[i * n + k] * A[j * n + k];
+            A[i * n + j] = s / d;
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        for (int k = 0; k < i; ++k) b[i] -= A[i * n + k] * b[k];
+        b[i] /= A[i * n + i];
+    }
+    for (int i = n - 1; i >= 0; --i) {
+        for (int k = i + 1; k < n; ++k) b[i] -= A[k * n + i] * b[k];
+        b[i] /= A[i * n + i];
+    }
+    return true;
+}
+
+
+// Is MSE within tolerance level? The randomised check may only reject
+// early (a false reject is corrected by reteaching, which returns exact MSE),
+// acceptance is confirmed by exact MSE.
+template <typename T>
+bool
+within_tol(const MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out, T tol_level)
+{
+    return net.mse_below(in, out, tol_level) && !(net.mse(in, out) > tol_level);
+}
+
+
+} /* namespace */
+
+
+
 template <typename T>
 std::pair<int, int>
 fcnn::mlpnet_prune_mag(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
@@ -51,6 +127,9 @@ fcnn::mlpnet_prune_mag(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out
                        int max_reteach_iter)
 {
     if (tol_level <= T()) error("tolerance level should be positive");
+    if (net.hashed())
+        error("pruning networks with hashed layers is not supported");
+    MatrixPool pool;
     T mse;
     if ((mse = net.mse(in, out)) > tol_level) {
         message mes;
@@ -61,6 +140,8 @@ fcnn::mlpnet_prune_mag(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out
 
     int count = 0, countn = 0;
     bool stop = false;
+    MLPNetRprop<T> rprop;
+    std::vector<int> w_idx;
 
     while (!stop) {
         int W = net.active_w();
@@ -76,9 +157,9 @@ fcnn::mlpnet_prune_mag(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out
         net.set_active(wi, false);
         ++count;
 
-        if (net.mse(in, out) > tol_level) {
+        if (!within_tol(net, in, out, tol_level)) {
             std::pair<T, int> retres =
-                mlpnet_teach_rprop(net, in, out, tol_level, max_reteach_iter, 0);
+                rprop.teach(net, in, out, tol_level, max_reteach_iter, 0);
             if (retres.first > tol_level) {
                 stop = true;
                 --count;
@@ -103,7 +184,8 @@ fcnn::mlpnet_prune_mag(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out
             }
         }
 
-        std::pair<int, int> rmres = net.rm_neurons(report);
+        std::pair<int, int> rmres = net.rm_neurons(w_idx, report);
+        if (rmres.first) rprop.remap(w_idx);
         countn += rmres.first;
         count += rmres.second;
     }
@@ -135,6 +217,9 @@ fcnn::mlpnet_prune_obs(MLPNet<T> &net, const Matrix<T> &in,
                        int max_reteach_iter, T alpha)
 {
     if (tol_level <= T()) error("tolerance level should be positive");
+    if (net.hashed())
+        error("pruning networks with hashed layers is not supported");
+    MatrixPool pool;
     T mse;
     if ((mse = net.mse(in, out)) > tol_level) {
         message mes;
@@ -143,26 +228,14 @@ fcnn::mlpnet_prune_obs(MLPNet<T> &net, const Matrix<T> &in,
         error(mes);
     }
 
-    int P = in.rows(), N = out.cols();
-    T NP = (T)P * (T)N;
     int count = 0, countn = 0;
     bool stop = false;
+    MLPNetRprop<T> rprop;
+    std::vector<int> w_idx;
 
     while (!stop) {
         int W = net.active_w();
-        Matrix<T> H = ((T)1. / alpha) * eye<T>(W), grads, X, HX;
-        for (int i = 1; i <= P; ++i) {
-            grads = net.gradij(in, i);
-#if defined(HAVE_BLAS)
-            internal::ihessupdate(H.rows(), N, NP, grads.ptr(), H.ptr());
-#else
-            for (int j = 1; j <= N; ++j) {
-                X = grads.get_col(j);
-                HX = H * X;
-                H = H - div(HX * t(HX), NP + t(X) * HX);
-            }
-#endif
-        }
+        Matrix<T> H = ihess(net, in, out, alpha);
 
         Matrix<T> weights = net.get_weights();
         T L, minL = (T).5 * std::pow(weights.elem(1), (T)2.) / H.elem(1, 1);
@@ -178,9 +251,9 @@ fcnn::mlpnet_prune_obs(MLPNet<T> &net, const Matrix<T> &in,
         net.set_active(wi, false);
         ++count;
 
-        if (net.mse(in, out) > tol_level) {
+        if (!within_tol(net, in, out, tol_level)) {
             std::pair<T, int> retres =
-                mlpnet_teach_rprop(net, in, out, tol_level, max_reteach_iter, 0);
+                rprop.teach(net, in, out, tol_level, max_reteach_iter, 0);
             if (retres.first > tol_level) {
                 stop = true;
                 --count;
@@ -205,7 +278,8 @@ fcnn::mlpnet_prune_obs(MLPNet<T> &net, const Matrix<T> &in,
             }
         }
 
-        std::pair<int, int> rmres = net.rm_neurons(report);
+        std::pair<int, int> rmres = net.rm_neurons(w_idx, report);
+        if (rmres.first) rprop.remap(w_idx);
         countn += rmres.first;
         count += rmres.second;
     }
@@ -234,3 +308,290 @@ fcnn::mlpnet_prune_obs(MLPNet<double>&,
 
 
 
+
+
+
+namespace {
+
+
+// Remove one hidden neuron with the lowest saliency (structured pruning),
+// reteach network if needed. Returns false if no neuron could be removed
+// (network is left unchanged). With variance based saliencies the neuron's
+// mean state is moved to the next layer's biases if compensate is set.
+template <typename T>
+bool
+prune_neuron(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
+             T tol_level, int saliency, bool report,
+             int max_reteach_iter, T alpha, bool compensate,
+             MLPNetRprop<T> &rprop, std::vector<int> &w_idx)
+{
+    int nol = net.no_layers();
+    // saliencies of hidden neurons (layers with one neuron are skipped)
+    int minl = 0, minn = 0;
+    T minL = T(), L;
+    Matrix<T> stats, H, weights = net.get_weights();
+    // active indices of neurons' outgoing connections (OBS)
+    std::vector<std::vector<std::vector<int> > > out_w;
+    if (saliency == neuron_obs) {
+        H = ihess(net, in, out, alpha);
+        out_w.resize(nol);
+        for (int l = 2; l < nol; ++l)
+            out_w[l - 1].resize(net.no_neurons(l));
+        for (int i = 1, j = 0, n = net.total_w(); i <= n; ++i) {
+            if (!net.is_active(i)) continue;
+            ++j;
+            int l, nn, npl;
+            net.get_ln_idx(i, l, nn, npl);
+            if ((l > 2) && npl) out_w[l - 2][npl - 1].push_back(j);
+        }
+    } else {
+        stats = net.neuron_stats(in);
+    }
+    for (int l = 2, ni = net.no_neurons(1); l < nol; ni += net.no_neurons(l), ++l) {
+        int nl = net.no_neurons(l);
+        if (nl == 1) continue;
+        for (int n = 1; n <= nl; ++n) {
+            if (saliency == neuron_obs) {
+                const std::vector<int> &g = out_w[l - 1][n - 1];
+                int ng = g.size();
+                if (!ng) continue;
+                std::vector<T> A(ng * ng), x(ng);
+                for (int a = 0; a < ng; ++a) {
+                    x[a] = weights.elem(g[a]);
+                    for (int b = 0; b < ng; ++b)
+                        A[a * ng + b] = H.elem(g[a], g[b]);
+                }
+                if (!chol_solve(ng, A, x)) continue;
+                L = T();
+                for (int a = 0; a < ng; ++a) L += weights.elem(g[a]) * x[a];
+                L *= (T).5;
+            } else {
+                L = stats.elem(ni + n, 2);
+                if (saliency == neuron_contribution) {
+                    T sw = T();
+                    for (int k = 1, nk = net.no_neurons(l + 1); k <= nk; ++k)
+                        if (net.is_active(l + 1, k, n)) sw += std::pow(net.get_w(l + 1, k, n), (T)2.);
+                    L *= sw;
+                }
+            }
+            if (!minl || (L < minL)) { minl = l; minn = n; minL = L; }
+        }
+    }
+    if (!minl) {
+        if (report) internal::report("no more neurons to remove, pruning stopped");
+        return false;
+    }
+
+    // disconnect neuron from the next layer
+    MLPNet<T> backup = net;
+    if (saliency == neuron_obs) {
+        const std::vector<int> &g = out_w[minl - 1][minn - 1];
+        int ng = g.size();
+        std::vector<T> A(ng * ng), x(ng);
+        for (int a = 0; a < ng; ++a) {
+            x[a] = weights.elem(g[a]);
+            for (int b = 0; b < ng; ++b)
+                A[a * ng + b] = H.elem(g[a], g[b]);
+        }
+        chol_solve(ng, A, x);
+        Matrix<T> dw(weights.rows(), 1, T());
+        for (int a = 0; a < ng; ++a)
+            dw = dw + x[a] * H.get_col(g[a]);
+        net.set_weights(weights - dw);
+        for (int k = 1, nk = net.no_neurons(minl + 1); k <= nk; ++k)
+            if (net.is_active(minl + 1, k, minn))
+                net.set_active(minl + 1, k, minn, false);
+    } else {
+        int ni = minn;
+        for (int l = 1; l < minl; ++l) ni += net.no_neurons(l);
+        T m = stats.elem(ni, 1);
+        for (int k = 1, nk = net.no_neurons(minl + 1); k <= nk; ++k) {
+            if (!net.is_active(minl + 1, k, minn)) continue;
+            if (compensate) {
+                T b = m * net.get_w(minl + 1, k, minn);
+                if (net.is_active(minl + 1, k, 0)) {
+                    b += net.get_w(minl + 1, k, 0);
+                } else {
+                    net.set_active(minl + 1, k, 0, true);
+                }
+                net.set_w(minl + 1, k, 0, b);
+            }
+            net.set_active(minl + 1, k, minn, false);
+        }
+    }
+
+    if (!within_tol(net, in, out, tol_level)) {
+        std::pair<T, int> retres =
+            rprop.teach(net, in, out, tol_level, max_reteach_iter, 0);
+        if (retres.first > tol_level) {
+            net = backup;
+            if (report) internal::report("pruning stopped");
+            return false;
+        }
+    }
+    std::pair<int, int> rmres = net.rm_neurons(w_idx, report);
+    if (rmres.first) rprop.remap(w_idx);
+    return true;
+}
+
+
+} /* namespace */
+
+
+
+
+template <typename T>
+std::pair<int, int>
+fcnn::mlpnet_prune_neurons(MLPNet<T> &net, const Matrix<T> &in,
+                           const Matrix<T> &out,
+                           T tol_level, int saliency,
+                           bool report,
+                           int max_reteach_iter, T alpha, bool compensate)
+{
+    if (tol_level <= T()) error("tolerance level should be positive");
+    if (net.hashed())
+        error("pruning networks with hashed layers is not supported");
+    if ((saliency != neuron_variance) && (saliency != neuron_contribution)
+        && (saliency != neuron_obs))
+        error("invalid neuron saliency measure");
+    MatrixPool pool;
+    T mse;
+    if ((mse = net.mse(in, out)) > tol_level) {
+        message mes;
+        mes << "network should be trained with MSE reduced to given tolerance "
+            << "level (" << tol_level << ") before pruning; MSE is " << mse;
+        error(mes);
+    }
+
+    int W0 = net.active_w(), N0 = 0, nol = net.no_layers();
+    for (int l = 2; l < nol; ++l) N0 += net.no_neurons(l);
+    MLPNetRprop<T> rprop;
+    std::vector<int> w_idx;
+
+    while (prune_neuron(net, in, out, tol_level, saliency, report,
+                        max_reteach_iter, alpha, compensate, rprop, w_idx));
+
+    int N1 = 0;
+    for (int l = 2; l < nol; ++l) N1 += net.no_neurons(l);
+    return std::pair<int, int>(W0 - net.active_w(), N0 - N1);
+}
+
+
+
+template std::pair<int, int>
+fcnn::mlpnet_prune_neurons(MLPNet<float>&, const Matrix<float>&,
+                           const Matrix<float>&,
+                           float, int,
+                           bool,
+                           int,
+                           float, bool);
+template std::pair<int, int>
+fcnn::mlpnet_prune_neurons(MLPNet<double>&,
+                           const Matrix<double>&, const Matrix<double>&,
+                           double, int,
+                           bool,
+                           int,
+                           double, bool);
+
+
+
+template <typename T>
+double
+fcnn::mlpnet_eval_time(const MLPNet<T> &net, const Matrix<T> &in,
+                       int batch_size, double min_time)
+{
+    if (batch_size < 1) error("batch size should be positive");
+    if (in.rows() < 1) error("input data must have at least one row");
+    std::vector<int> idx(batch_size);
+    for (int i = 0; i < batch_size; ++i) idx[i] = i % in.rows() + 1;
+    Matrix<T> batch = in.get_rows(idx);
+
+    // warm up
+    net.eval(batch);
+    int reps = 0;
+    double t0 = wtime(), t;
+    do {
+        net.eval(batch);
+        ++reps;
+        t = wtime() - t0;
+    } while ((t < min_time) || (reps < 3));
+    return t / reps;
+}
+
+
+
+template double
+fcnn::mlpnet_eval_time(const MLPNet<float>&, const Matrix<float>&,
+                       int, double);
+template double
+fcnn::mlpnet_eval_time(const MLPNet<double>&, const Matrix<double>&,
+                       int, double);
+
+
+
+template <typename T>
+double
+fcnn::mlpnet_prune_latency(MLPNet<T> &net, const Matrix<T> &in,
+                           const Matrix<T> &out,
+                           T tol_level, double max_time, int batch_size,
+                           int saliency, bool report,
+                           int max_reteach_iter, T alpha, bool compensate)
+{
+    if (tol_level <= T()) error("tolerance level should be positive");
+    if (net.hashed())
+        error("pruning networks with hashed layers is not supported");
+    if (max_time <= 0.) error("target evaluation time should be positive");
+    if ((saliency != neuron_variance) && (saliency != neuron_contribution)
+        && (saliency != neuron_obs))
+        error("invalid neuron saliency measure");
+    MatrixPool pool;
+    T mse;
+    if ((mse = net.mse(in, out)) > tol_level) {
+        message mes;
+        mes << "network should be trained with MSE reduced to given tolerance "
+            << "level (" << tol_level << ") before pruning; MSE is " << mse;
+        error(mes);
+    }
+
+    MLPNetRprop<T> rprop;
+    std::vector<int> w_idx;
+    double t0 = mlpnet_eval_time(net, in, batch_size), t = t0;
+
+    while (t > max_time) {
+        if (!prune_neuron(net, in, out, tol_level, saliency, report,
+                          max_reteach_iter, alpha, compensate,
+                          rprop, w_idx)) break;
+        t = mlpnet_eval_time(net, in, batch_size);
+        if (report) {
+            message mes;
+            mes << "evaluation time " << t << "s (target: " << max_time << "s)";
+            internal::report(mes);
+        }
+    }
+
+    if (report) {
+        message mes;
+        mes << "evaluation time reduced from " << t0 << "s to " << t
+            << "s (speedup " << (t0 / t) << "); target "
+            << ((t <= max_time) ? "met" : "not met");
+        internal::report(mes);
+    }
+    return t0 / t;
+}
+
+
+
+template double
+fcnn::mlpnet_prune_latency(MLPNet<float>&, const Matrix<float>&,
+                           const Matrix<float>&,
+                           float, double, int,
+                           int, bool,
+                           int,
+                           float, bool);
+template double
+fcnn::mlpnet_prune_latency(MLPNet<double>&,
+                           const Matrix<double>&, const Matrix<double>&,
+                           double, double, int,
+                           int, bool,
+                           int,
+                           double, bool);
@@ -49,6 +49,7 @@ mlpnet_prune_mag(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
 /// Parameter max_reteach_iter determines maximum no. of iterations while
 /// reteaching network. When this number is reached and tol_level
 /// is not achieved, pruning stops and last turned off weight is turned back on.
+/// Throws if records are weighted.
 template <typename T>
 inline
 std::pair<int, int>
@@ -56,6 +57,7 @@ mlpnet_prune_mag(MLPNet<T> &net, const Dataset<T> &dat,
                  T tol_level, bool report = false,
                  int max_reteach_iter = 50)
 {
+    if (dat.weighted()) error("pruning does not support record weights");
     return mlpnet_prune_mag(net, dat.get_input(), dat.get_output(),
                             tol_level, report,
                             max_reteach_iter);
@@ -79,7 +81,8 @@ mlpnet_prune_obs(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
 /// this should be between 1e-8 and 1e-4. Parameter max_reteach_iter
 /// determines maximum no. of iterations while reteaching network. When
 /// this number is reached and tol_level is not achieved, pruning stops
-/// and last turned off weight is turned back on.
+/// and last turned off weight is turned back on. Throws if records
+/// are weighted.
 template <typename T>
 inline
 std::pair<int, int>
@@ -87,6 +90,7 @@ mlpnet_prune_obs(MLPNet<T> &net, const Dataset<T> &dat,
                  T tol_level, bool report = false,
                  int max_reteach_iter = 10, T alpha = (T)1e-5)
 {
+    if (dat.weighted()) error("pruning does not support record weights");
     return mlpnet_prune_obs(net, dat.get_input(), dat.get_output(),
                             tol_level, report,
                             max_reteach_iter, alpha);
@@ -94,6 +98,110 @@ mlpnet_prune_obs(MLPNet<T> &net, const Dataset<T> &dat,
 
 
 
+/// Neuron saliency measures used in structured (neuron) pruning.
+enum mlp_neuron_saliency {
+
+    neuron_variance = 1, ///< Variance of neuron's state.
+    neuron_contribution, ///< Variance of neuron's contribution to the next layer.
+    neuron_obs ///< Optimal Brain Surgeon saliency of neuron's outgoing connections.
+
+}; /* enum mlp_neuron_saliency */
+
+
+/// Structured pruning removing whole hidden neurons. Returns no. of deleted
+/// weights and neurons. Neurons with the lowest saliency are removed one
+/// at a time. With variance based saliency measures the removed neuron's mean
+/// state is moved to the next layer's biases (unless compensate is false),
+/// with OBS saliency remaining weights are adjusted. Parameter alpha is used
+/// in Hessian approximation (OBS only). Parameter max_reteach_iter determines
+/// maximum no. of iterations while reteaching network. When this number
+/// is reached and tol_level is not achieved, pruning stops and last removed
+/// neuron is restored.
+template <typename T>
+std::pair<int, int>
+mlpnet_prune_neurons(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
+                     T tol_level, int saliency = neuron_contribution,
+                     bool report = false,
+                     int max_reteach_iter = 50, T alpha = (T)1e-5,
+                     bool compensate = true);
+
+/// Structured pruning removing whole hidden neurons. Returns no. of deleted
+/// weights and neurons. Neurons with the lowest saliency are removed one
+/// at a time. With variance based saliency measures the removed neuron's mean
+/// state is moved to the next layer's biases (unless compensate is false),
+/// with OBS saliency remaining weights are adjusted. Parameter alpha is used
+/// in Hessian approximation (OBS only). Parameter max_reteach_iter determines
+/// maximum no. of iterations while reteaching network. When this number
+/// is reached and tol_level is not achieved, pruning stops and last removed
+/// neuron is restored. Throws if records are weighted.
+template <typename T>
+inline
+std::pair<int, int>
+mlpnet_prune_neurons(MLPNet<T> &net, const Dataset<T> &dat,
+                     T tol_level, int saliency = neuron_contribution,
+                     bool report = false,
+                     int max_reteach_iter = 50, T alpha = (T)1e-5,
+                     bool compensate = true)
+{
+    if (dat.weighted()) error("pruning does not support record weights");
+    return mlpnet_prune_neurons(net, dat.get_input(), dat.get_output(),
+                                tol_level, saliency, report,
+                                max_reteach_iter, alpha, compensate);
+}
+
+
+
+/// Measure network evaluation time (in seconds) for a batch of given size.
+/// The batch is made of the first records of input (repeated if there are
+/// too few). Evaluation is repeated for at least min_time seconds and
+/// the average time is returned.
+template <typename T>
+double
+mlpnet_eval_time(const MLPNet<T> &net, const Matrix<T> &in,
+                 int batch_size = 1, double min_time = 0.1);
+
+
+/// Latency driven pruning. Hidden neurons are removed (lowest saliency
+/// first, as in mlpnet_prune_neurons, including bias compensation unless
+/// compensate is false) until the measured evaluation time for a batch
+/// of given size (see mlpnet_eval_time) drops to max_time seconds,
+/// or until tol_level cannot be achieved. Removing single connections
+/// does not make dense layers faster, hence only whole neurons are removed.
+/// Returns the achieved speedup (initial divided by final evaluation time).
+template <typename T>
+double
+mlpnet_prune_latency(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
+                     T tol_level, double max_time, int batch_size = 1,
+                     int saliency = neuron_contribution, bool report = false,
+                     int max_reteach_iter = 50, T alpha = (T)1e-5,
+                     bool compensate = true);
+
+/// Latency driven pruning. Hidden neurons are removed (lowest saliency
+/// first, as in mlpnet_prune_neurons, including bias compensation unless
+/// compensate is false) until the measured evaluation time for a batch
+/// of given size (see mlpnet_eval_time) drops to max_time seconds,
+/// or until tol_level cannot be achieved. Removing single connections
+/// does not make dense layers faster, hence only whole neurons are removed.
+/// Returns the achieved speedup (initial divided by final evaluation time).
+/// Throws if records are weighted.
+template <typename T>
+inline
+double
+mlpnet_prune_latency(MLPNet<T> &net, const Dataset<T> &dat,
+                     T tol_level, double max_time, int batch_size = 1,
+                     int saliency = neuron_contribution, bool report = false,
+                     int max_reteach_iter = 50, T alpha = (T)1e-5,
+                     bool compensate = true)
+{
+    if (dat.weighted()) error("pruning does not support record weights");
+    return mlpnet_prune_latency(net, dat.get_input(), dat.get_output(),
+                                tol_level, max_time, batch_size,
+                                saliency, report,
+                                max_reteach_iter, alpha, compensate);
+}
+
+
+
 } /* namespace fcnn */
 
 
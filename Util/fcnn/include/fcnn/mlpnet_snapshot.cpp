@@ -0,0 +1,269 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file mlpnet_snapshot.cpp
+ *  \brief Publishing snapshots of multilayer perceptron networks
+ *         for concurrent training and evaluation.
+ */
+
+
+#include <fcnn/mlpnet_snapshot.h>
+#include <fcnn/mlpnet_teach.h>
+#include <fcnn/error.h>
+
+#include <algorithm>
+#include <thread>
+
+
+using namespace fcnn;
+
+
+
+// Readers register in a slot and then re-check the current slot, the trainer
+// makes another slot current and then checks registered readers. All these
+// accesses are sequentially consistent, so either the trainer sees
+// the reader registered or the reader sees that the slot is no longer
+// current (and withdraws). Releasing a slot synchronises with the trainer's
+// check, reader's accesses to the network happen before it is overwritten.
+
+
+
+template <typename T>
+MLPNetPublisher<T>::Snapshot::Snapshot(const Snapshot &s)
+    : m_pub(s.m_pub), m_slot(s.m_slot)
+{
+    // slot is held by s, so it cannot be reused
+    if (m_pub) m_pub->m_readers[m_slot].fetch_add(1);
+}
+
+
+
+template <typename T>
+typename MLPNetPublisher<T>::Snapshot&
+MLPNetPublisher<T>::Snapshot::operator=(const Snapshot &s)
+{
+    if (this == &s) return *this;
+    if (s.m_pub) s.m_pub->m_readers[s.m_slot].fetch_add(1);
+    release();
+    m_pub = s.m_pub;
+    m_slot = s.m_slot;
+    return *this;
+}
+
+
+
+template <typename T>
+void
+MLPNetPublisher<T>::Snapshot::release()
+{
+    if (m_pub) m_pub->m_readers[m_slot].fetch_sub(1);
+    m_pub = 0;
+}
+
+
+
+template <typename T>
+MLPNetPublisher<T>::MLPNetPublisher(int no_slots)
+    : m_front(-1), m_ver(0)
+{
+    init(no_slots);
+}
+
+
+
+template <typename T>
+MLPNetPublisher<T>::MLPNetPublisher(const MLPNet<T> &net, int no_slots)
+    : m_front(-1), m_ver(0)
+{
+    init(no_slots);
+    publish(net);
+}
+
+
+
+template <typename T>
+void
+MLPNetPublisher<T>::init(int no_slots)
+{
+    if (no_slots < 2) error("no. of snapshot slots should be at least 2");
+    m_net.resize(no_slots);
+    std::vector<std::atomic<int> > readers(no_slots);
+    m_readers.swap(readers);
+    for (int k = 0; k < no_slots; ++k) m_readers[k].store(0);
+}
+
+
+
+template <typename T>
+void
+MLPNetPublisher<T>::publish(const MLPNet<T> &net)
+{
+    // free slot: not current, no registered readers (wait for one if needed)
+    int front = m_front.load(std::memory_order_relaxed), n = m_net.size(), s;
+    for (;;) {
+        for (s = 0; s < n; ++s)
+            if ((s != front) && !m_readers[s].load()) break;
+        if (s < n) break;
+        std::this_thread::yield();
+    }
+    m_net[s] = net;
+    m_front.store(s);
+    ++m_ver;
+}
+
+
+
+template <typename T>
+typename MLPNetPublisher<T>::snapshot_type
+MLPNetPublisher<T>::snapshot() const
+{
+    for (;;) {
+        int s = m_front.load();
+        if (s < 0) return Snapshot();
+        m_readers[s].fetch_add(1);
+        if (m_front.load() == s) return Snapshot(this, s);
+        // slot replaced in the meantime, try the current one
+        m_readers[s].fetch_sub(1);
+    }
+}
+
+
+
+template <typename T>
+Matrix<T>
+MLPNetPublisher<T>::eval(const Matrix<T> &input) const
+{
+    snapshot_type s = snapshot();
+    if (!s) error("no network snapshot has been published");
+    return s->eval(input);
+}
+
+
+
+template class fcnn::MLPNetPublisher<float>;
+template class fcnn::MLPNetPublisher<double>;
+
+
+
+namespace {
+
+
+// Rprop publishing snapshots, data of type D (matrices or dataset)
+template <typename T, typename D>
+std::pair<T, int>
+teach_rprop_publish(MLPNet<T> &net, const D &data, T tol_level, int max_epochs,
+                    MLPNetPublisher<T> &pub, int publish_freq, int report_freq,
+                    T l2reg, T u, T d, T gmax, T gmin)
+{
+    if (publish_freq < 1) error("publishing frequency should be positive");
+    MLPNetRprop<T> rprop(u, d, gmax, gmin);
+    std::pair<T, int> res(T(), 0);
+    // Rprop state is kept between chunks, teaching continues as in a single run
+    while (res.second < max_epochs) {
+        int n = std::min(publish_freq, max_epochs - res.second);
+        std::pair<T, int> r = data.teach(rprop, net, tol_level, n, report_freq, l2reg);
+        res.first = r.first;
+        res.second += r.second;
+        pub.publish(net);
+        if ((r.first < tol_level) || (r.second < n)) break;
+    }
+    if (!max_epochs) {
+        res.first = data.mse(net);
+        pub.publish(net);
+    }
+    return res;
+}
+
+
+// Data given as matrices
+template <typename T>
+struct matrix_data {
+    const Matrix<T> &in, &out;
+    std::pair<T, int> teach(MLPNetRprop<T> &rprop, MLPNet<T> &net, T tol_level,
+                            int n, int report_freq, T l2reg) const {
+        return rprop.teach(net, in, out, tol_level, n, report_freq, l2reg);
+    }
+    T mse(const MLPNet<T> &net) const { return net.mse(in, out); }
+};
+
+
+// Data given as dataset (records may be weighted)
+template <typename T>
+struct dataset_data {
+    const Dataset<T> &dat;
+    std::pair<T, int> teach(MLPNetRprop<T> &rprop, MLPNet<T> &net, T tol_level,
+                            int n, int report_freq, T l2reg) const {
+        return rprop.teach(net, dat, tol_level, n, report_freq, l2reg);
+    }
+    T mse(const MLPNet<T> &net) const { return net.mse(dat); }
+};
+
+
+} /* namespace */
+
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_rprop_publish(MLPNet<T> &net,
+                                 const Matrix<T> &in, const Matrix<T> &out,
+                                 T tol_level, int max_epochs, MLPNetPublisher<T> &pub,
+                                 int publish_freq, int report_freq, T l2reg,
+                                 T u, T d, T gmax, T gmin)
+{
+    matrix_data<T> data = { in, out };
+    return teach_rprop_publish(net, data, tol_level, max_epochs, pub, publish_freq,
+                               report_freq, l2reg, u, d, gmax, gmin);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_rprop_publish(MLPNet<T> &net, const Dataset<T> &dat,
+                                 T tol_level, int max_epochs, MLPNetPublisher<T> &pub,
+                                 int publish_freq, int report_freq, T l2reg,
+                                 T u, T d, T gmax, T gmin)
+{
+    dataset_data<T> data = { dat };
+    return teach_rprop_publish(net, data, tol_level, max_epochs, pub, publish_freq,
+                               report_freq, l2reg, u, d, gmax, gmin);
+}
+
+
+
+template std::pair<float, int>
+fcnn::mlpnet_teach_rprop_publish(MLPNet<float>&, const Matrix<float>&,
+                                 const Matrix<float>&, float, int,
+                                 MLPNetPublisher<float>&, int, int, float,
+                                 float, float, float, float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_rprop_publish(MLPNet<double>&, const Matrix<double>&,
+                                 const Matrix<double>&, double, int,
+                                 MLPNetPublisher<double>&, int, int, double,
+                                 double, double, double, double);
+template std::pair<float, int>
+fcnn::mlpnet_teach_rprop_publish(MLPNet<float>&, const Dataset<float>&,
+                                 float, int, MLPNetPublisher<float>&, int, int, float,
+                                 float, float, float, float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_rprop_publish(MLPNet<double>&, const Dataset<double>&,
+                                 double, int, MLPNetPublisher<double>&, int, int, double,
+                                 double, double, double, double);
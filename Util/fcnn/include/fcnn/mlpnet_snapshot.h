@@ -0,0 +1,150 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file mlpnet_snapshot.h
+ *  \brief Publishing snapshots of multilayer perceptron networks
+ *         for concurrent training and evaluation.
+ */
+
+
+#ifndef FCNN_MPLNET_SNAPSHOT_H
+
+#define FCNN_MPLNET_SNAPSHOT_H
+
+
+#include <fcnn/mlpnet.h>
+#include <atomic>
+#include <vector>
+
+
+namespace fcnn {
+
+
+/// Publisher of immutable network snapshots. Trainer copies the network
+/// into a free slot of a small ring and publishes it by atomically setting
+/// the index of the current slot; readers (possibly in other threads)
+/// evaluate the current snapshot without locks and never see partially
+/// updated weights. A reader registers in the slot (atomic counter)
+/// and re-checks that it is still current, the trainer reuses only slots
+/// which are not current and have no registered readers. A snapshot stays
+/// valid as long as a reader holds it (and the publisher exists). If all
+/// slots but the current one are held, publish() waits for a reader
+/// to release one, so snapshots should be held briefly or the ring
+/// should have more slots than the no. of snapshots held at a time.
+template <typename T>
+class MLPNetPublisher {
+  public:
+    /// Snapshot - handle to a published network.
+    class Snapshot {
+      public:
+        /// Constructor (empty snapshot).
+        Snapshot() : m_pub(0), m_slot(0) { ; }
+        /// Copy constructor.
+        Snapshot(const Snapshot&);
+        /// Destructor (releases the slot).
+        ~Snapshot() { release(); }
+        /// Assignment.
+        Snapshot& operator=(const Snapshot&);
+
+        /// Is snapshot non-empty?
+        explicit operator bool() const { return m_pub != 0; }
+        /// Published network.
+        const MLPNet<T>& operator*() const { return m_pub->m_net[m_slot]; }
+        /// Published network.
+        const MLPNet<T>* operator->() const { return &m_pub->m_net[m_slot]; }
+
+      private:
+        friend class MLPNetPublisher<T>;
+        /// Publisher (null for empty snapshot).
+        const MLPNetPublisher<T> *m_pub;
+        /// Slot.
+        int m_slot;
+
+        Snapshot(const MLPNetPublisher<T> *pub, int slot) : m_pub(pub), m_slot(slot) { ; }
+        void release();
+    };
+
+    /// Snapshot type.
+    typedef Snapshot snapshot_type;
+
+    /// Constructor (nothing published), ring of given no. of slots
+    /// (at least 2).
+    explicit MLPNetPublisher(int no_slots = 4);
+    /// Constructor, publishes a copy of the network, ring of given no.
+    /// of slots (at least 2).
+    explicit MLPNetPublisher(const MLPNet<T> &net, int no_slots = 4);
+
+    /// Publish a copy of the network (trainer side, single writer).
+    void publish(const MLPNet<T> &net);
+    /// Current snapshot (empty if nothing has been published).
+    snapshot_type snapshot() const;
+    /// No. of snapshots published so far (trainer side).
+    unsigned long version() const { return m_ver; }
+
+    /// Evaluate current snapshot (error if nothing has been published).
+    Matrix<T> eval(const Matrix<T> &input) const;
+
+  private:
+    /// Ring of networks.
+    std::vector<MLPNet<T> > m_net;
+    /// No. of readers registered in each slot.
+    mutable std::vector<std::atomic<int> > m_readers;
+    /// Current slot (-1 if nothing has been published).
+    std::atomic<int> m_front;
+    /// Version.
+    unsigned long m_ver;
+
+    void init(int no_slots);
+
+    MLPNetPublisher(const MLPNetPublisher&);
+    MLPNetPublisher& operator=(const MLPNetPublisher&);
+
+}; /* class template MLPNetPublisher */
+
+
+
+/// Rprop algorithm (batch) publishing a snapshot of the network every
+/// publish_freq epochs and after the last one. Returns the final MSE and
+/// the number of iterations. Safe choices of parameters are: u = 1.2,
+/// d = 0.5, gmax = 50. and gmin = 1e-6.
+template <typename T>
+std::pair<T, int>
+mlpnet_teach_rprop_publish(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
+                           T tol_level, int max_epochs, MLPNetPublisher<T> &pub,
+                           int publish_freq, int report_freq = 0, T l2reg = T(),
+                           T u = (T)1.2, T d = (T)0.5, T gmax = (T)50., T gmin = 1e-6);
+
+/// Rprop algorithm (batch) publishing a snapshot of the network every
+/// publish_freq epochs and after the last one (records may be weighted).
+/// Returns the final MSE and the number of iterations. Safe choices
+/// of parameters are: u = 1.2, d = 0.5, gmax = 50. and gmin = 1e-6.
+template <typename T>
+std::pair<T, int>
+mlpnet_teach_rprop_publish(MLPNet<T> &net, const Dataset<T> &dat,
+                           T tol_level, int max_epochs, MLPNetPublisher<T> &pub,
+                           int publish_freq, int report_freq = 0, T l2reg = T(),
+                           T u = (T)1.2, T d = (T)0.5, T gmax = (T)50., T gmin = 1e-6);
+
+
+
+} /* namespace fcnn */
+
+
+#endif /* FCNN_MPLNET_SNAPSHOT_H */
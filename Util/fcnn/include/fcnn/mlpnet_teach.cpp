@@ -25,32 +25,81 @@
 
 #include <fcnn/mlpnet_teach.h>
 #include <fcnn/matops.h>
+#include <fcnn/pool.h>
 #include <fcnn/utils.h>
 #include <fcnn/report.h>
 #include <fcnn/error.h>
+#include <algorithm>
 
 
 using namespace fcnn;
 using fcnn::internal::message;
 using fcnn::internal::report;
 using fcnn::internal::sample_int;
+using fcnn::internal::permute_int;
 
 
+
+namespace {
+
+
+// Gradient over all data given as matrices
+template <typename T>
+struct matrix_grad {
+    const Matrix<T> &in, &out;
+    std::pair<Matrix<T>, T> operator()(const MLPNet<T> &net) const {
+        return net.grad(in, out);
+    }
+};
+
+
+// Gradient over all data read from source
+template <typename T>
+struct source_grad {
+    DataSource<T> &src;
+    std::pair<Matrix<T>, T> operator()(const MLPNet<T> &net) const {
+        return net.grad(src);
+    }
+};
+
+
+// Gradient over all data (records may be weighted)
 template <typename T>
+struct dataset_grad {
+    const Dataset<T> &dat;
+    std::pair<Matrix<T>, T> operator()(const MLPNet<T> &net) const {
+        return net.grad(dat);
+    }
+};
+
+
+// Gradient over all data with sparse inputs
+template <typename T>
+struct sparse_grad {
+    const SparseMatrix<T> &in;
+    const Matrix<T> &out;
+    std::pair<Matrix<T>, T> operator()(const MLPNet<T> &net) const {
+        return net.grad(in, out);
+    }
+};
+
+
+// Batch backpropagation given gradient over all data
+template <typename T, typename G>
 std::pair<T, int>
-fcnn::mlpnet_teach_bp(MLPNet<T> &net,
-                      const Matrix<T> &in, const Matrix<T> &out,
-                      T tol_level, int max_epochs, T learn_rate, int report_freq,
-                      T l2reg)
+teach_bp(MLPNet<T> &net, const G &grad,
+         T tol_level, int max_epochs, T learn_rate, int report_freq,
+         T l2reg)
 {
     if (tol_level <= T()) error("tolerance level should be positive");
     if (learn_rate <= T()) error("learning rate should be positive");
     if (l2reg < T()) error("L2 regularization parameter should be nonnegative");
     int i = 0;
+    MatrixPool pool;
     T mse;
     Matrix<T> w0, w1, g;
-    std::pair<Matrix<T>, T> gm = net.grad(in, out);
-    g = gm.first;
+    std::pair<Matrix<T>, T> gm = grad(net);
+    g = std::move(gm.first);
     mse = gm.second;
     if (mse < tol_level) return std::pair<T, int>(mse, i);
     w0 = net.get_weights();
@@ -61,8 +110,8 @@ fcnn::mlpnet_teach_bp(MLPNet<T> &net,
         w1 = w0 - learn_rate * g;
         net.set_weights(w1);
         // gradient, mse
-        gm = net.grad(in, out);
-        g = gm.first;
+        gm = grad(net);
+        g = std::move(gm.first);
         mse = gm.second;
         if (report_freq) {
             if (i && !(i % report_freq)) {
@@ -80,6 +129,165 @@ fcnn::mlpnet_teach_bp(MLPNet<T> &net,
 }
 
 
+// Change of weights in stochastic gradient descent (epoch i)
+template <typename T>
+Matrix<T>
+sgd_step(const Matrix<T> &g, int i, T learn_rate, T lambda, T gamma, T momentum,
+         Matrix<T> &ms, Matrix<T> &mm)
+{
+    Matrix<T> dw = -learn_rate * g;
+    if (lambda != T()) {
+        dw = div(dw, pow(ms, (T).5));
+        ms = (1 - lambda) * ms + lambda * pow(g, (T)2);
+    }
+    if (gamma != T()) dw = dw / (1 + gamma * (i - 1));
+    if (momentum != T()) {
+        dw = momentum * mm + dw;
+        mm = dw;
+    }
+    return dw;
+}
+
+
+// Stochastic gradient descent; if weighted dataset is given, minibatches
+// are drawn from records of positive weight and their gradients are
+// weighted (normalised by the sum of weights in the minibatch)
+template <typename T>
+std::pair<T, int>
+teach_sgd(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out, const Dataset<T> *wdat,
+          T tol_level, int max_epochs, T learn_rate, int report_freq, T l2reg,
+          int minibatchsz, T lambda, T gamma, T momentum)
+{
+    if (tol_level <= T()) error("tolerance level should be positive");
+    if (learn_rate <= T()) error("learning rate should be positive");
+    if (l2reg < T()) error("L2 regularization parameter should be nonnegative");
+    int i = 0, N = in.rows(), M = minibatchsz, W = net.no_params();
+    MatrixPool pool;
+    T mse;
+    Matrix<T> w0, w1, dw, ms, mm, g;
+    std::pair<Matrix<T>, T> gm;
+    std::vector<int> idx, recs;
+    std::vector<T> bw;
+    if (wdat) {
+        const std::vector<T> &rw = wdat->get_record_weights();
+        for (int k = 0; k < N; ++k) {
+            if (rw[k] > T()) recs.push_back(k + 1);
+        }
+        N = recs.size();
+    }
+    // minibatch of records (weighted if wdat is given)
+    auto minibatch = [&]() {
+        idx = sample_int(N, M);
+        if (!wdat) return net.grad(MatrixView<T>(in, idx), MatrixView<T>(out, idx));
+        bw.resize(M);
+        for (int k = 0; k < M; ++k) {
+            idx[k] = recs[idx[k] - 1];
+            bw[k] = wdat->get_record_weights()[idx[k] - 1];
+        }
+        return net.grad(MatrixView<T>(in, idx), MatrixView<T>(out, idx), bw);
+    };
+    // convergence is confirmed by exact MSE for weighted records
+    auto below = [&]() {
+        return wdat ? net.mse_below(*wdat, tol_level) : net.mse_below(in, out, tol_level);
+    };
+
+    if ((M < 1) || (M >= N)) {
+        error(wdat ? "minibatch size should be at least 1 and less than the number "
+                     "of records of positive weight"
+                   : "minibatch size should be at least 1 and less than the number of records");
+    }
+    if (lambda != T()) {
+        ms = Matrix<T>(W, 1, (T)1);
+    }
+    if (momentum != T()) {
+        mm = Matrix<T>(W, 1, T());
+    }
+    gm = minibatch();
+    g = std::move(gm.first);
+    w0 = net.get_weights();
+    if (l2reg != T()) g = g + l2reg * w0;
+    mse = gm.second;
+    if ((mse < tol_level) && below()) {
+        return std::pair<T, int>(wdat ? net.mse(*wdat) : net.mse(in, out), i);
+    }
+
+    for (++i; i <= max_epochs; ++i) {
+        dw = sgd_step(g, i, learn_rate, lambda, gamma, momentum, ms, mm);
+        w1 = w0 + dw;
+        net.set_weights(w1);
+        gm = minibatch();
+        g = std::move(gm.first);
+        if (l2reg != T()) g = g + l2reg * w1;
+        mse = gm.second;
+        if (report_freq) {
+            if (i && !(i % report_freq)) {
+                message mes;
+                mes << "stochastic gradient descent; epoch " << i << ", mse: "
+                    << mse << " (desired: " << tol_level << ")";
+                report(mes);
+            }
+        }
+        if ((mse < tol_level) && below()) break;
+        w0 = w1;
+    }
+    mse = wdat ? net.mse(*wdat) : net.mse(in, out);
+
+    if (i > max_epochs) --i;
+    return std::pair<T, int>(mse, i);
+}
+
+
+} /* namespace */
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_bp(MLPNet<T> &net,
+                      const Matrix<T> &in, const Matrix<T> &out,
+                      T tol_level, int max_epochs, T learn_rate, int report_freq,
+                      T l2reg)
+{
+    matrix_grad<T> grad = { in, out };
+    return teach_bp(net, grad, tol_level, max_epochs, learn_rate, report_freq, l2reg);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_bp(MLPNet<T> &net, DataSource<T> &src,
+                      T tol_level, int max_epochs, T learn_rate, int report_freq,
+                      T l2reg)
+{
+    source_grad<T> grad = { src };
+    return teach_bp(net, grad, tol_level, max_epochs, learn_rate, report_freq, l2reg);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_bp(MLPNet<T> &net, const Dataset<T> &dat,
+                      T tol_level, int max_epochs, T learn_rate, int report_freq,
+                      T l2reg)
+{
+    dataset_grad<T> grad = { dat };
+    return teach_bp(net, grad, tol_level, max_epochs, learn_rate, report_freq, l2reg);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_bp(MLPNet<T> &net, const SparseDataset<T> &dat,
+                      T tol_level, int max_epochs, T learn_rate, int report_freq,
+                      T l2reg)
+{
+    sparse_grad<T> grad = { dat.get_input(), dat.get_output() };
+    return teach_bp(net, grad, tol_level, max_epochs, learn_rate, report_freq, l2reg);
+}
+
+
 
 template std::pair<float, int>
 fcnn::mlpnet_teach_bp(MLPNet<float>&,
@@ -91,6 +299,30 @@ fcnn::mlpnet_teach_bp(MLPNet<double>&,
                       const Matrix<double>&, const Matrix<double>&,
                       double, int, double, int,
                       double);
+template std::pair<float, int>
+fcnn::mlpnet_teach_bp(MLPNet<float>&, const Dataset<float>&,
+                      float, int, float, int,
+                      float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_bp(MLPNet<double>&, const Dataset<double>&,
+                      double, int, double, int,
+                      double);
+template std::pair<float, int>
+fcnn::mlpnet_teach_bp(MLPNet<float>&, DataSource<float>&,
+                      float, int, float, int,
+                      float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_bp(MLPNet<double>&, DataSource<double>&,
+                      double, int, double, int,
+                      double);
+template std::pair<float, int>
+fcnn::mlpnet_teach_bp(MLPNet<float>&, const SparseDataset<float>&,
+                      float, int, float, int,
+                      float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_bp(MLPNet<double>&, const SparseDataset<double>&,
+                      double, int, double, int,
+                      double);
 
 
 
@@ -103,43 +335,206 @@ fcnn::mlpnet_teach_rprop(MLPNet<T> &net,
                          const Matrix<T> &in, const Matrix<T> &out,
                          T tol_level, int max_epochs, int report_freq, T l2reg,
                          T u, T d, T gmax, T gmin)
+{
+    MLPNetRprop<T> rprop(u, d, gmax, gmin);
+    return rprop.teach(net, in, out, tol_level, max_epochs, report_freq, l2reg);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_rprop(MLPNet<T> &net, DataSource<T> &src,
+                         T tol_level, int max_epochs, int report_freq, T l2reg,
+                         T u, T d, T gmax, T gmin)
+{
+    MLPNetRprop<T> rprop(u, d, gmax, gmin);
+    return rprop.teach(net, src, tol_level, max_epochs, report_freq, l2reg);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_rprop(MLPNet<T> &net, const Dataset<T> &dat,
+                         T tol_level, int max_epochs, int report_freq, T l2reg,
+                         T u, T d, T gmax, T gmin)
+{
+    MLPNetRprop<T> rprop(u, d, gmax, gmin);
+    return rprop.teach(net, dat, tol_level, max_epochs, report_freq, l2reg);
+}
+
+
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_rprop(MLPNet<T> &net, const SparseDataset<T> &dat,
+                         T tol_level, int max_epochs, int report_freq, T l2reg,
+                         T u, T d, T gmax, T gmin)
+{
+    MLPNetRprop<T> rprop(u, d, gmax, gmin);
+    return rprop.teach(net, dat, tol_level, max_epochs, report_freq, l2reg);
+}
+
+
+
+
+template std::pair<float, int>
+fcnn::mlpnet_teach_rprop(MLPNet<float>&,
+                         const Matrix<float>&, const Matrix<float>&,
+                         float, int, int,
+                         float, float, float, float, float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_rprop(MLPNet<double>&,
+                         const Matrix<double>&, const Matrix<double>&,
+                         double, int, int,
+                         double, double, double, double, double);
+template std::pair<float, int>
+fcnn::mlpnet_teach_rprop(MLPNet<float>&, const Dataset<float>&,
+                         float, int, int,
+                         float, float, float, float, float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_rprop(MLPNet<double>&, const Dataset<double>&,
+                         double, int, int,
+                         double, double, double, double, double);
+template std::pair<float, int>
+fcnn::mlpnet_teach_rprop(MLPNet<float>&, DataSource<float>&,
+                         float, int, int,
+                         float, float, float, float, float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_rprop(MLPNet<double>&, DataSource<double>&,
+                         double, int, int,
+                         double, double, double, double, double);
+template std::pair<float, int>
+fcnn::mlpnet_teach_rprop(MLPNet<float>&, const SparseDataset<float>&,
+                         float, int, int,
+                         float, float, float, float, float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_rprop(MLPNet<double>&, const SparseDataset<double>&,
+                         double, int, int,
+                         double, double, double, double, double);
+
+
+
+
+
+
+template <typename T>
+MLPNetRprop<T>::MLPNetRprop(T u, T d, T gmax, T gmin)
+    : m_u(u), m_d(d), m_gmax(gmax), m_gmin(gmin)
+{
+    ;
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+MLPNetRprop<T>::teach(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
+                      T tol_level, int max_epochs, int report_freq, T l2reg)
+{
+    matrix_grad<T> grad = { in, out };
+    return teach_impl(net, grad, tol_level, max_epochs, report_freq, l2reg);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+MLPNetRprop<T>::teach(MLPNet<T> &net, const Dataset<T> &dat,
+                      T tol_level, int max_epochs, int report_freq, T l2reg)
+{
+    dataset_grad<T> grad = { dat };
+    return teach_impl(net, grad, tol_level, max_epochs, report_freq, l2reg);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+MLPNetRprop<T>::teach(MLPNet<T> &net, DataSource<T> &src,
+                      T tol_level, int max_epochs, int report_freq, T l2reg)
+{
+    source_grad<T> grad = { src };
+    return teach_impl(net, grad, tol_level, max_epochs, report_freq, l2reg);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+MLPNetRprop<T>::teach(MLPNet<T> &net, const SparseDataset<T> &dat,
+                      T tol_level, int max_epochs, int report_freq, T l2reg)
+{
+    sparse_grad<T> grad = { dat.get_input(), dat.get_output() };
+    return teach_impl(net, grad, tol_level, max_epochs, report_freq, l2reg);
+}
+
+
+
+template <typename T>
+template <typename G>
+std::pair<T, int>
+MLPNetRprop<T>::teach_impl(MLPNet<T> &net, const G &grad,
+                           T tol_level, int max_epochs, int report_freq, T l2reg)
 {
     if (tol_level <= T()) error("tolerance level should be positive");
     if (l2reg < T()) error("L2 regularization parameter should be nonnegative");
-    int i = 0;
+    int i = 0, N;
+    MatrixPool pool;
     T mse;
     Matrix<T> w0, w1, g0, g1, gamma, dw;
+    std::pair<Matrix<T>, T> gm;
 
-    // init
-    std::pair<Matrix<T>, T> gm = net.grad(in, out);
-    g0 = gm.first;
-    mse = gm.second;
-    if (mse < tol_level) return std::pair<T, int>(mse, i);
-    w0 = net.get_weights();
-    if (l2reg != T()) g0 = g0 + l2reg * w0;
-    w1 = w0 - (T)0.7 * g0;
-    net.set_weights(w1);
-    w0 = w1;
-
-    // init (2nd gradient)
-    ++i;
-    gm = net.grad(in, out);
-    g1 = gm.first;
-    mse = gm.second;
-    if (report_freq) {
-        if (!(i % report_freq)) {
-            message mes;
-            mes << "Rprop; epoch " << i << ", mse: " << mse << " (desired: "
-                << tol_level << ")";
-            report(mes);
+    if (!net.hashed() && ((int) m_gamma.size() == net.total_w())) {
+        // warm start: step sizes and previous gradient from last run
+        w0 = net.get_weights();
+        N = w0.rows();
+        gamma = Matrix<T>(N, 1);
+        g0 = Matrix<T>(N, 1);
+        for (int k = 0, j = 1, n = net.total_w(); k < n; ++k) {
+            if (net.is_active(k + 1)) {
+                gamma.elem(j) = m_gamma[k];
+                g0.elem(j++) = m_g[k];
+            }
         }
-    }
-    if (mse < tol_level) return std::pair<T, int>(mse, i);
+        gm = grad(net);
+        g1 = std::move(gm.first);
+        if (l2reg != T()) g1 = g1 + l2reg * w0;
+        mse = gm.second;
+        if (mse < tol_level) return std::pair<T, int>(mse, i);
+    } else {
+        // init
+        gm = grad(net);
+        g0 = std::move(gm.first);
+        mse = gm.second;
+        if (mse < tol_level) return std::pair<T, int>(mse, i);
+        w0 = net.get_weights();
+        if (l2reg != T()) g0 = g0 + l2reg * w0;
+        w1 = w0 - (T)0.7 * g0;
+        net.set_weights(w1);
+        w0 = w1;
 
-    // init gamma and dw (step) vectors
-    int N = w0.rows();
-    gamma = Matrix<T>(N, 1, (T)(gmin > 1e-1) ?
-                            gmin : ((gmax > 1e-1) ? 1e-1 : gmax));
+        // init (2nd gradient)
+        ++i;
+        gm = grad(net);
+        g1 = std::move(gm.first);
+        mse = gm.second;
+        if (report_freq) {
+            if (!(i % report_freq)) {
+                message mes;
+                mes << "Rprop; epoch " << i << ", mse: " << mse << " (desired: "
+                    << tol_level << ")";
+                report(mes);
+            }
+        }
+        if (mse < tol_level) return std::pair<T, int>(mse, i);
+
+        // init gamma vector
+        N = w0.rows();
+        gamma = Matrix<T>(N, 1, gamma0());
+    }
     dw = Matrix<T>(N, 1, (T)0);
 
     for (++i; i <= max_epochs; ++i) {
@@ -148,10 +543,10 @@ fcnn::mlpnet_teach_rprop(MLPNet<T> &net,
             if (g0.elem(n) * g1.elem(n) > 0) {
                 if (g1.elem(n) > 0) dw.elem(n) = -gamma.elem(n);
                 else dw.elem(n) = gamma.elem(n);
-                gamma.elem(n) = std::min(u * gamma.elem(n), gmax);
+                gamma.elem(n) = std::min(m_u * gamma.elem(n), m_gmax);
             } else if (g0.elem(n) * g1.elem(n) < 0) {
                 dw.elem(n) = 0;
-                gamma.elem(n) = std::max(d * gamma.elem(n), gmin);
+                gamma.elem(n) = std::max(m_d * gamma.elem(n), m_gmin);
             } else {
                 if (g1.elem(n) > 0) dw.elem(n) = -gamma.elem(n);
                 else if (g1.elem(n) < 0) dw.elem(n) = gamma.elem(n);
@@ -163,8 +558,8 @@ fcnn::mlpnet_teach_rprop(MLPNet<T> &net,
         net.set_weights(w1);
         // next gradients
         g0 = g1;
-        gm = net.grad(in, out);
-        g1 = gm.first;
+        gm = grad(net);
+        g1 = std::move(gm.first);
         if (l2reg != T()) g1 = g1 + l2reg * w1;
         mse = gm.second;
         if (report_freq) {
@@ -180,22 +575,57 @@ fcnn::mlpnet_teach_rprop(MLPNet<T> &net,
         w0 = w1;
     }
     if (i > max_epochs) --i;
+    // gradient at the current weights is recomputed by the next run,
+    // the previous one decides its first step
+    store(net, gamma, g0);
     return std::pair<T, int>(mse, i);
 }
 
 
 
+template <typename T>
+void
+MLPNetRprop<T>::store(const MLPNet<T> &net, const Matrix<T> &gamma, const Matrix<T> &g)
+{
+    if (net.hashed()) {
+        // state of buckets is not kept between runs
+        reset();
+        return;
+    }
+    int n = net.total_w();
+    m_gamma.assign(n, gamma0());
+    m_g.assign(n, T());
+    for (int k = 0, j = 1; k < n; ++k) {
+        if (net.is_active(k + 1)) {
+            m_gamma[k] = gamma.elem(j);
+            m_g[k] = g.elem(j++);
+        }
+    }
+}
 
-template std::pair<float, int>
-fcnn::mlpnet_teach_rprop(MLPNet<float>&,
-                         const Matrix<float>&, const Matrix<float>&,
-                         float, int, int,
-                         float, float, float, float, float);
-template std::pair<double, int>
-fcnn::mlpnet_teach_rprop(MLPNet<double>&,
-                         const Matrix<double>&, const Matrix<double>&,
-                         double, int, int,
-                         double, double, double, double, double);
+
+
+template <typename T>
+void
+MLPNetRprop<T>::remap(const std::vector<int> &w_idx)
+{
+    if (m_gamma.empty()) return;
+    std::vector<T> gamma(w_idx.size()), g(w_idx.size());
+    for (int k = 0, n = w_idx.size(); k < n; ++k) {
+        int j = w_idx[k] - 1;
+        if ((j < 0) || (j >= (int) m_gamma.size()))
+            error("invalid weight index while remapping Rprop state");
+        gamma[k] = m_gamma[j];
+        g[k] = m_g[j];
+    }
+    m_gamma.swap(gamma);
+    m_g.swap(g);
+}
+
+
+
+template class fcnn::MLPNetRprop<float>;
+template class fcnn::MLPNetRprop<double>;
 
 
 
@@ -207,17 +637,29 @@ std::pair<T, int>
 fcnn::mlpnet_teach_sgd(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
                        T tol_level, int max_epochs, T learn_rate, int report_freq, T l2reg,
                        int minibatchsz, T lambda, T gamma, T momentum)
+{
+    return teach_sgd(net, in, out, (const Dataset<T>*) 0,
+                     tol_level, max_epochs, learn_rate, report_freq, l2reg,
+                     minibatchsz, lambda, gamma, momentum);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_sgd(MLPNet<T> &net, DataSource<T> &src,
+                       T tol_level, int max_epochs, T learn_rate, int report_freq, T l2reg,
+                       int minibatchsz, T lambda, T gamma, T momentum)
 {
     if (tol_level <= T()) error("tolerance level should be positive");
     if (learn_rate <= T()) error("learning rate should be positive");
     if (l2reg < T()) error("L2 regularization parameter should be nonnegative");
-    int i = 0, N = in.rows(), M = minibatchsz, W = net.active_w();
+    int i = 0, M = minibatchsz, W = net.no_params();
+    MatrixPool pool;
     T mse;
-    Matrix<T> w0, w1, dw, ms, mm, g;
-    std::pair<Matrix<T>, T> gm;
-    std::vector<int> idx;
+    Matrix<T> w0, ms, mm, g;
 
-    if ((M < 1) || (M >= N)) {
+    if ((M < 1) || (M >= src.no_records())) {
         error("minibatch size should be at least 1 and less than the number of records");
     }
     if (lambda != T()) {
@@ -226,58 +668,80 @@ fcnn::mlpnet_teach_sgd(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out
     if (momentum != T()) {
         mm = Matrix<T>(W, 1, T());
     }
-    idx = sample_int(N, M);
-    gm = net.grad(in.get_rows(idx), out.get_rows(idx));
-    g = gm.first;
     w0 = net.get_weights();
-    if (l2reg != T()) g = g + l2reg * w0;
-    mse = gm.second;
-    if (mse < tol_level) {
-        mse = net.mse(in, out);
-        if (mse < tol_level) {
-            return std::pair<T, int>(mse, i);
-        }
-    }
 
-    bool mseall = false;
-    for (++i; i <= max_epochs; ++i) {
-        dw = -learn_rate * g;
-        if (lambda != T()) {
-            dw = div(dw, pow(ms, (T).5));
-            ms = (1 - lambda) * ms + lambda * pow(g, (T)2);
-        }
-        if (gamma != T()) dw = dw / (1 + gamma * (i - 1));
-        if (momentum != T()) {
-            dw = momentum * mm + dw;
-            mm = dw;
-        }
-        w1 = w0 + dw;
-        net.set_weights(w1);
-        idx = sample_int(N, M);
-        gm = net.grad(in.get_rows(idx), out.get_rows(idx));
-        g = gm.first;
-        if (l2reg != T()) g = g + l2reg * w1;
-        mse = gm.second;
-        mseall = false;
-        if (report_freq) {
-            if (i && !(i % report_freq)) {
-                message mes;
-                mes << "stochastic gradient descent; epoch " << i << ", mse: "
-                    << mse << " (desired: " << tol_level << ")";
-                report(mes);
+    // minibatches are taken from blocks (each record once per pass),
+    // the last one of a block may be smaller
+    int nb;
+    bool conv;
+    double err, cnt;
+    auto block = [&](const Matrix<T> &in, const Matrix<T> &out) {
+        int N = in.rows(), m = std::min(M, N);
+        std::vector<int> perm = permute_int(N), idx;
+        for (int k = 0; k < N; k += m) {
+            ++nb;
+            if (g.rows()) {
+                // update with gradient from the previous minibatch
+                if (++i > max_epochs) return false;
+                w0 = w0 + sgd_step(g, i, learn_rate, lambda, gamma, momentum, ms, mm);
+                net.set_weights(w0);
+            }
+            int b = std::min(m, N - k);
+            idx.assign(perm.begin() + k, perm.begin() + k + b);
+            std::pair<Matrix<T>, T> gm = net.grad(MatrixView<T>(in, idx),
+                                                  MatrixView<T>(out, idx));
+            g = std::move(gm.first);
+            if (l2reg != T()) g = g + l2reg * w0;
+            mse = gm.second;
+            err += (double) mse * b;
+            cnt += b;
+            if (report_freq) {
+                if (i && !(i % report_freq)) {
+                    message mes;
+                    mes << "stochastic gradient descent; epoch " << i << ", mse: "
+                        << mse << " (desired: " << tol_level << ")";
+                    report(mes);
+                }
+            }
+            // convergence is checked on the block first
+            if ((mse < tol_level) && net.mse_below(in, out, tol_level)) {
+                conv = true;
+                return false;
             }
         }
-        if (mse < tol_level) {
-            mse = net.mse(in, out);
-            mseall = true;
-            if (mse < tol_level) break;
+        return true;
+    };
+
+    for (;;) {
+        nb = 0;
+        conv = false;
+        err = cnt = 0.;
+        internal::stream_blocks<T>(src, block);
+        if (i > max_epochs) break;
+        if (!nb) error("data source is empty");
+        // error accumulated over the pass (weights changing), MSE over all
+        // data is computed only to confirm convergence
+        if (conv || ((T) (err / cnt) < tol_level)) {
+            mse = net.mse(src);
+            if (mse < tol_level) return std::pair<T, int>(mse, i);
         }
-        w0 = w1;
     }
-    if (!mseall) mse = net.mse(in, out);
+    mse = net.mse(src);
 
-    if (i > max_epochs) --i;
-    return std::pair<T, int>(mse, i);
+    return std::pair<T, int>(mse, max_epochs);
+}
+
+
+
+template <typename T>
+std::pair<T, int>
+fcnn::mlpnet_teach_sgd(MLPNet<T> &net, const Dataset<T> &dat,
+                       T tol_level, int max_epochs, T learn_rate, int report_freq, T l2reg,
+                       int minibatchsz, T lambda, T gamma, T momentum)
+{
+    return teach_sgd(net, dat.get_input(), dat.get_output(), dat.weighted() ? &dat : 0,
+                     tol_level, max_epochs, learn_rate, report_freq, l2reg,
+                     minibatchsz, lambda, gamma, momentum);
 }
 
 
@@ -290,6 +754,22 @@ template std::pair<double, int>
 fcnn::mlpnet_teach_sgd(MLPNet<double>&, const Matrix<double>&, const Matrix<double>&,
                        double, int, double, int, double,
                        int, double, double, double);
+template std::pair<float, int>
+fcnn::mlpnet_teach_sgd(MLPNet<float>&, const Dataset<float>&,
+                       float, int, float, int, float,
+                       int, float, float, float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_sgd(MLPNet<double>&, const Dataset<double>&,
+                       double, int, double, int, double,
+                       int, double, double, double);
+template std::pair<float, int>
+fcnn::mlpnet_teach_sgd(MLPNet<float>&, DataSource<float>&,
+                       float, int, float, int, float,
+                       int, float, float, float);
+template std::pair<double, int>
+fcnn::mlpnet_teach_sgd(MLPNet<double>&, DataSource<double>&,
+                       double, int, double, int, double,
+                       int, double, double, double);
 
 
 
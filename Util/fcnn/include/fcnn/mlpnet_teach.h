@@ -42,17 +42,31 @@ mlpnet_teach_bp(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
                 T tol_level, int max_epochs, T learn_rate, int report_freq = 0,
                 T l2reg = T());
 /// Standard batch backpropagation algorithm. Returns the final MSE and the number
-/// of iterations. Safe choice of learning rate is 0.7.
+/// of iterations. Safe choice of learning rate is 0.7. Weighted records
+/// contribute to MSE and gradient in proportion to their weights.
 template <typename T>
-inline
 std::pair<T, int>
 mlpnet_teach_bp(MLPNet<T> &net, const Dataset<T> &dat,
                 T tol_level, int max_epochs, T learn_rate, int report_freq = 0,
-                T l2reg = T())
-{
-    return mlpnet_teach_bp(net, dat.get_input(), dat.get_output(),
-                           tol_level, max_epochs, learn_rate, report_freq, l2reg);
-}
+                T l2reg = T());
+
+/// Standard batch backpropagation algorithm with gradient accumulated over
+/// all blocks of data read from source (see DataSource). Returns the final
+/// MSE and the number of iterations. Safe choice of learning rate is 0.7.
+template <typename T>
+std::pair<T, int>
+mlpnet_teach_bp(MLPNet<T> &net, DataSource<T> &src,
+                T tol_level, int max_epochs, T learn_rate, int report_freq = 0,
+                T l2reg = T());
+
+
+/// Standard batch backpropagation algorithm given data with sparse inputs.
+/// Returns the final MSE and the number of iterations.
+template <typename T>
+std::pair<T, int>
+mlpnet_teach_bp(MLPNet<T> &net, const SparseDataset<T> &dat,
+                T tol_level, int max_epochs, T learn_rate, int report_freq = 0,
+                T l2reg = T());
 
 
 
@@ -67,18 +81,100 @@ mlpnet_teach_rprop(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
 
 /// Rprop algorithm (batch). Returns the final MSE and the number
 /// of iterations. Safe choices of parameters are: u = 1.2, d = 0.5,
-/// gmax = 50. and gmin = 1e-6.
+/// gmax = 50. and gmin = 1e-6. Weighted records contribute to MSE
+/// and gradient in proportion to their weights.
 template <typename T>
-inline
 std::pair<T, int>
 mlpnet_teach_rprop(MLPNet<T> &net, const Dataset<T> &dat,
                    T tol_level, int max_epochs, int report_freq = 0, T l2reg = T(),
-                   T u = (T)1.2, T d = (T)0.5, T gmax = (T)50., T gmin = 1e-6)
-{
-    return mlpnet_teach_rprop(net, dat.get_input(), dat.get_output(),
-                              tol_level, max_epochs, report_freq, l2reg,
-                              u, d, gmax, gmin);
-}
+                   T u = (T)1.2, T d = (T)0.5, T gmax = (T)50., T gmin = 1e-6);
+
+/// Rprop algorithm (batch) with gradient accumulated over all blocks
+/// of data read from source (see DataSource). Returns the final MSE
+/// and the number of iterations. Safe choices of parameters are: u = 1.2,
+/// d = 0.5, gmax = 50. and gmin = 1e-6.
+template <typename T>
+std::pair<T, int>
+mlpnet_teach_rprop(MLPNet<T> &net, DataSource<T> &src,
+                   T tol_level, int max_epochs, int report_freq = 0, T l2reg = T(),
+                   T u = (T)1.2, T d = (T)0.5, T gmax = (T)50., T gmin = 1e-6);
+
+
+/// Rprop algorithm (batch) given data with sparse inputs. Returns the final
+/// MSE and the number of iterations.
+template <typename T>
+std::pair<T, int>
+mlpnet_teach_rprop(MLPNet<T> &net, const SparseDataset<T> &dat,
+                   T tol_level, int max_epochs, int report_freq = 0, T l2reg = T(),
+                   T u = (T)1.2, T d = (T)0.5, T gmax = (T)50., T gmin = 1e-6);
+
+
+/// Rprop algorithm (batch) keeping its state (step sizes and the last
+/// gradient) between calls, so that a network which has been slightly
+/// modified (e.g. pruned) can be retaught without relearning step sizes.
+/// State of weights turned off is dropped. Safe choices of parameters are:
+/// u = 1.2, d = 0.5, gmax = 50. and gmin = 1e-6.
+template <typename T>
+class MLPNetRprop {
+  public:
+    /// Constructor.
+    explicit MLPNetRprop(T u = (T)1.2, T d = (T)0.5,
+                         T gmax = (T)50., T gmin = 1e-6);
+
+    /// Teach network. Returns the final MSE and the number of iterations.
+    /// State from the previous call is reused if the network has
+    /// the same total no. of weights.
+    std::pair<T, int> teach(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
+                            T tol_level, int max_epochs, int report_freq = 0,
+                            T l2reg = T());
+    /// Teach network. Returns the final MSE and the number of iterations.
+    /// State from the previous call is reused if the network has
+    /// the same total no. of weights. Weighted records contribute
+    /// to MSE and gradient in proportion to their weights.
+    std::pair<T, int> teach(MLPNet<T> &net, const Dataset<T> &dat,
+                            T tol_level, int max_epochs, int report_freq = 0,
+                            T l2reg = T());
+    /// Teach network with gradient accumulated over all blocks of data
+    /// read from source (see DataSource). Returns the final MSE
+    /// and the number of iterations.
+    std::pair<T, int> teach(MLPNet<T> &net, DataSource<T> &src,
+                            T tol_level, int max_epochs, int report_freq = 0,
+                            T l2reg = T());
+    /// Teach network given data with sparse inputs. Returns the final MSE
+    /// and the number of iterations.
+    std::pair<T, int> teach(MLPNet<T> &net, const SparseDataset<T> &dat,
+                            T tol_level, int max_epochs, int report_freq = 0,
+                            T l2reg = T());
+
+    /// Update state after neurons have been removed from the network.
+    /// Requires the (1-based) indices the remaining weights had before
+    /// removal, as returned by MLPNet::rm_neurons.
+    void remap(const std::vector<int> &w_idx);
+    /// Discard state.
+    void reset() { m_gamma.clear(); m_g.clear(); }
+
+  private:
+    /// Parameters.
+    T m_u, m_d, m_gmax, m_gmin;
+    /// Step sizes (for all weights, including inactive).
+    std::vector<T> m_gamma;
+    /// Gradient at the weights preceding the current ones (for all weights,
+    /// including inactive).
+    std::vector<T> m_g;
+
+    /// Initial step size.
+    T gamma0() const {
+        return (m_gmin > 1e-1) ? m_gmin : ((m_gmax > 1e-1) ? (T)1e-1 : m_gmax);
+    }
+    /// Teach network given gradient over all data.
+    template <typename G>
+    std::pair<T, int> teach_impl(MLPNet<T> &net, const G &grad,
+                                 T tol_level, int max_epochs, int report_freq,
+                                 T l2reg);
+    /// Store state of active weights.
+    void store(const MLPNet<T> &net, const Matrix<T> &gamma, const Matrix<T> &g);
+
+}; /* class template MLPNetRprop */
 
 
 
@@ -97,17 +193,26 @@ mlpnet_teach_sgd(MLPNet<T> &net, const Matrix<T> &in, const Matrix<T> &out,
 /// decay, and momentum. Safe choices of parameters are: minibatch size = 100,
 /// lambda = 0.1 (rmsprop parameter controlling the update of mean squared gradient),
 /// gamma (weight decay parameter) = 0, momentum (momentum parameter) = 0.5.
+/// If records are weighted, minibatches are drawn uniformly from records
+/// of positive weight and their gradients are weighted (normalised
+/// by the sum of weights in the minibatch).
 template <typename T>
-inline
 std::pair<T, int>
 mlpnet_teach_sgd(MLPNet<T> &net, const Dataset<T> &dat,
                  T tol_level, int max_epochs, T learn_rate, int report_freq = 0, T l2reg = T(),
-                 int minibatchsz = 100, T lambda = 0.1, T gamma = 0, T momentum = 0.5)
-{
-    return mlpnet_teach_sgd(net, dat.get_input(), dat.get_output(),
-                            tol_level, max_epochs, learn_rate, report_freq, l2reg,
-                            minibatchsz, lambda, gamma, momentum);
-}
+                 int minibatchsz = 100, T lambda = 0.1, T gamma = 0, T momentum = 0.5);
+
+/// Stochastic gradient descent over data read from source in blocks
+/// (see DataSource). Minibatches are drawn from the current block so that
+/// each record is used once per pass (the last minibatch of a block may be
+/// smaller). Convergence is checked on the current block and on the error
+/// accumulated over the pass, and then confirmed by MSE over all data.
+/// Parameters as above.
+template <typename T>
+std::pair<T, int>
+mlpnet_teach_sgd(MLPNet<T> &net, DataSource<T> &src,
+                 T tol_level, int max_epochs, T learn_rate, int report_freq = 0, T l2reg = T(),
+                 int minibatchsz = 100, T lambda = 0.1, T gamma = 0, T momentum = 0.5);
 
 
 
@@ -0,0 +1,129 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file packed.cpp
+ *  \brief Packed (per layer, padded and aligned) weights used in feed forward.
+ */
+
+
+#include <fcnn/packed.h>
+#include <fcnn/level1.h>
+
+
+using namespace fcnn::internal;
+
+
+
+template <typename T>
+mlp_packed<T>::mlp_packed(const mlp_packed<T> &pk)
+{
+    *this = pk;
+}
+
+
+
+template <typename T>
+mlp_packed<T>&
+mlp_packed<T>::operator=(const mlp_packed<T> &pk)
+{
+    if (this == &pk) return *this;
+    m_l = pk.m_l;
+    m_w_p = pk.m_w_p;
+    m_ld = pk.m_ld;
+    m_w_off = pk.m_w_off;
+    m_b_off = pk.m_b_off;
+    m_st_off = pk.m_st_off;
+    m_size = pk.m_size;
+    // aligned data may start at different offset in the new buffer
+    m_buf.assign(pk.m_buf.size(), T());
+    if (m_size) copy(m_size, pk.base(), 1, base(), 1);
+    return *this;
+}
+
+
+
+template <typename T>
+void
+mlp_packed<T>::build(const std::vector<int> &layers, const std::vector<int> &w_p,
+                     const std::vector<T> &w_val)
+{
+    int nol = layers.size();
+    m_l = layers;
+    m_w_p = w_p;
+    m_ld.resize(nol);
+    m_st_off.assign(nol + 1, 0);
+    for (int l = 0; l < nol; ++l) {
+        m_ld[l] = (layers[l] + pad - 1) / pad * pad;
+        m_st_off[l + 1] = m_st_off[l] + m_ld[l];
+    }
+    m_w_off.assign(nol, 0);
+    m_b_off.assign(nol, 0);
+    m_size = 0;
+    for (int l = 1; l < nol; ++l) {
+        m_w_off[l] = m_size;
+        m_size += layers[l] * m_ld[l - 1];
+        m_b_off[l] = m_size;
+        m_size += m_ld[l];
+    }
+    m_buf.assign(m_size + pad, T());
+    T *p = base();
+    for (int l = 1, wi = 0; l < nol; ++l) {
+        T *W = p + m_w_off[l], *B = p + m_b_off[l];
+        for (int n = 0; n < layers[l]; ++n, wi += layers[l - 1]) {
+            B[n] = w_val[wi++];
+            copy(layers[l - 1], &w_val[wi], 1, W + n * m_ld[l - 1], 1);
+        }
+    }
+}
+
+
+
+template <typename T>
+void
+mlp_packed<T>::set_w(int i, T w)
+{
+    int l = 1;
+    while (m_w_p[l + 1] <= i) ++l;
+    int r = i - m_w_p[l], n = r / (m_l[l - 1] + 1), npl = r % (m_l[l - 1] + 1);
+    if (npl) base()[m_w_off[l] + n * m_ld[l - 1] + npl - 1] = w;
+    else base()[m_b_off[l] + n] = w;
+}
+
+
+
+template <typename T>
+void
+mlp_packed<T>::unpack(const T *p, const int *w_fl, T a, T *x) const
+{
+    for (int l = 1, nol = m_l.size(), wi = 0; l < nol; ++l) {
+        const T *W = p + m_w_off[l], *B = p + m_b_off[l];
+        for (int n = 0; n < m_l[l]; ++n, W += m_ld[l - 1]) {
+            if (w_fl[wi++]) *x++ = a * B[n];
+            for (int j = 0; j < m_l[l - 1]; ++j)
+                if (w_fl[wi++]) *x++ = a * W[j];
+        }
+    }
+}
+
+
+
+// Instantiations
+template class fcnn::internal::mlp_packed<float>;
+template class fcnn::internal::mlp_packed<double>;
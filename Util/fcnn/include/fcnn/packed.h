@@ -0,0 +1,130 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file packed.h
+ *  \brief Packed (per layer, padded and aligned) weights used in feed forward.
+ */
+
+
+#ifndef FCNN_PACKED_H
+
+#define FCNN_PACKED_H
+
+
+#include <cstddef>
+#include <vector>
+
+
+namespace fcnn {
+namespace internal {
+
+
+/// Alignment (in bytes) of packed weights and neuron states.
+const int mlp_pk_align = 32;
+
+
+/// Return pointer aligned to mlp_pk_align bytes (memory must have been
+/// allocated with at least mlp_pk_align bytes of slack).
+template <typename T>
+inline T*
+mlp_pk_aligned(T *p)
+{
+    return (T*) (((std::size_t) p + mlp_pk_align - 1) & ~((std::size_t) mlp_pk_align - 1));
+}
+
+
+/// Network weights stored layer by layer as aligned matrices (one row per
+/// neuron) with rows padded with zeros to a multiple of SIMD width, biases
+/// are kept in separate vectors. Neuron states of each layer have to be
+/// padded in the same way (see st_off and st_size). Derivatives w.r.t.
+/// weights are accumulated in the same layout (see size, w_off, b_off
+/// and unpack).
+template <typename T>
+class mlp_packed {
+  public:
+    /// Row length granularity (no. of elements).
+    static const int pad = mlp_pk_align / sizeof(T);
+
+    /// Constructor.
+    mlp_packed() : m_size(0) { ; }
+    /// Copy constructor.
+    mlp_packed(const mlp_packed<T>&);
+    /// Assignment.
+    mlp_packed<T>& operator=(const mlp_packed<T>&);
+
+    /// Build from network representation (layers, weight pointers and weights).
+    void build(const std::vector<int> &layers, const std::vector<int> &w_p,
+               const std::vector<T> &w_val);
+    /// Update weight given its (0-based) absolute index.
+    void set_w(int i, T w);
+    /// Copy values given in packed layout (p, e.g. derivatives w.r.t.
+    /// weights) of weights with nonzero flags w_fl (network representation
+    /// order) to x scaling them by a.
+    void unpack(const T *p, const int *w_fl, T a, T *x) const;
+
+    /// No. of layers.
+    inline int no_layers() const { return m_l.size(); }
+    /// No. of neurons in (0-based) layer l.
+    inline int no_neurons(int l) const { return m_l[l]; }
+    /// Padded no. of neurons in (0-based) layer l.
+    inline int ld(int l) const { return m_ld[l]; }
+    /// Weights of (0-based) layer l, l > 0.
+    inline const T* w(int l) const { return base() + m_w_off[l]; }
+    /// Biases of (0-based) layer l, l > 0.
+    inline const T* b(int l) const { return base() + m_b_off[l]; }
+    /// Offset of weights of (0-based) layer l, l > 0, in packed layout.
+    inline int w_off(int l) const { return m_w_off[l]; }
+    /// Offset of biases of (0-based) layer l, l > 0, in packed layout.
+    inline int b_off(int l) const { return m_b_off[l]; }
+    /// Size of packed layout (weights and biases of all layers).
+    inline int size() const { return m_size; }
+    /// Offset of (0-based) layer l in padded neuron states vector.
+    inline int st_off(int l) const { return m_st_off[l]; }
+    /// Size of padded neuron states vector.
+    inline int st_size() const { return m_st_off.back(); }
+
+  private:
+    /// Layers.
+    std::vector<int> m_l;
+    /// Weight 'pointers' (as in network representation).
+    std::vector<int> m_w_p;
+    /// Padded layer sizes.
+    std::vector<int> m_ld;
+    /// Offsets of weights, biases and neuron states.
+    std::vector<int> m_w_off, m_b_off, m_st_off;
+    /// Memory (with slack for alignment).
+    std::vector<T> m_buf;
+    /// Size of aligned data.
+    int m_size;
+
+    /// Aligned data.
+    inline T* base() { return mlp_pk_aligned(&m_buf[0]); }
+    /// Aligned data (const version).
+    inline const T* base() const { return mlp_pk_aligned(&m_buf[0]); }
+
+}; /* class template mlp_packed */
+
+
+
+} /* namespace internal */
+} /* namespace fcnn */
+
+
+#endif /* FCNN_PACKED_H */
@@ -0,0 +1,412 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file pool.cpp
+ *  \brief Memory pool and placement policy for matrices.
+ */
+
+
+#include <fcnn/pool.h>
+#include <fcnn/error.h>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <fstream>
+#include <string>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define FCNN_MMAP_FILES
+#endif
+
+
+using namespace fcnn;
+using namespace fcnn::internal;
+
+
+
+namespace {
+
+
+// Alignment of data (cache line, widest SIMD registers), also the size
+// of the header in front of it
+const std::size_t data_align = 64;
+
+// No. of size classes (class k holds blocks of 2^k bytes)
+const int no_classes = (sizeof(std::size_t) > 4) ? 48 : 31;
+// Smallest size class
+const int min_class = 6;
+
+
+// Blocks mapped directly under memory policy (at least huge page size)
+const std::size_t map_min = (std::size_t) 2 << 20;
+// Size class of mapped blocks
+const int map_class = -2;
+// Size class of blocks mapped from files
+const int file_class = -3;
+
+
+// Header of memory block
+struct mem_hdr {
+    std::atomic<int> rc;
+    // size class, -1 if not pooled, map_class or file_class if mapped
+    int cls;
+    // start and length of mapping (mapped blocks)
+    void *map;
+    std::size_t len;
+    // pool of the allocating thread (pooled blocks)
+    const void *owner;
+};
+
+
+void*
+aligned_malloc(std::size_t n)
+{
+#if defined(_WIN32)
+    return _aligned_malloc(n, data_align);
+#else
+    void *p;
+    if (posix_memalign(&p, data_align, n)) return 0;
+    return p;
+#endif
+}
+
+
+void
+aligned_free(void *p)
+{
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+
+// Pool (per thread)
+struct pool_state {
+    int active;
+    std::vector<void*> blocks[no_classes];
+    std::size_t cached;
+    unsigned long long hits, misses;
+
+    pool_state() : active(0), cached(0), hits(0), misses(0) { ; }
+    ~pool_state() { release(); }
+
+    void release() {
+        for (int k = 0; k < no_classes; ++k) {
+            for (std::size_t i = 0; i < blocks[k].size(); ++i)
+                aligned_free(blocks[k][i]);
+            blocks[k].clear();
+            blocks[k].shrink_to_fit();
+        }
+        cached = 0;
+    }
+};
+
+
+thread_local pool_state pool;
+
+
+// Memory policy (per thread)
+struct policy_state {
+    int active, placement;
+    bool huge_pages;
+    policy_state() : active(0), placement(mem_first_touch), huge_pages(false) { ; }
+};
+
+
+thread_local policy_state policy;
+
+
+
+#if defined(__linux__)
+
+// Mask of online NUMA nodes (empty if it cannot be determined)
+std::vector<unsigned long>
+numa_nodes()
+{
+    std::vector<unsigned long> mask;
+    std::ifstream is("/sys/devices/system/node/online");
+    std::string str;
+    if (!(is >> str)) return mask;
+    const int bits = 8 * sizeof(unsigned long);
+    std::size_t p = 0;
+    while (p < str.size()) {
+        std::size_t q = str.find(',', p);
+        if (q == std::string::npos) q = str.size();
+        std::string r = str.substr(p, q - p);
+        std::size_t d = r.find('-');
+        int a = std::atoi(r.c_str()),
+            b = (d == std::string::npos) ? a : std::atoi(r.c_str() + d + 1);
+        for (int n = a; n <= b; ++n) {
+            if ((int) mask.size() <= n / bits) mask.resize(n / bits + 1, 0);
+            mask[n / bits] |= 1UL << (n % bits);
+        }
+        p = q + 1;
+    }
+    return mask;
+}
+
+
+// Map n bytes (aligned to huge page size) according to the policy
+void*
+map_block(std::size_t n, void *&map, std::size_t &len)
+{
+    len = (n + map_min - 1) / map_min * map_min + map_min;
+    void *m = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) return 0;
+    // trim to huge page boundaries
+    std::size_t head = (map_min - (std::size_t) m % map_min) % map_min,
+                tail = len - head - (n + map_min - 1) / map_min * map_min;
+    if (head) munmap(m, head);
+    if (tail) munmap((char*) m + len - tail, tail);
+    map = (char*) m + head;
+    len -= head + tail;
+#if defined(MADV_HUGEPAGE)
+    if (policy.huge_pages) madvise(map, len, MADV_HUGEPAGE);
+#endif
+    if (policy.placement == mem_interleave) {
+        static const std::vector<unsigned long> nodes = numa_nodes();
+        // MPOL_INTERLEAVE; failure is not an error (placement is a hint)
+        if (nodes.size()) {
+            syscall(SYS_mbind, map, len, 3, &nodes[0],
+                    (unsigned long) (8 * sizeof(unsigned long) * nodes.size() + 1), 0);
+        }
+    }
+    return map;
+}
+
+
+void
+unmap_block(void *map, std::size_t len)
+{
+    munmap(map, len);
+}
+
+#endif /* defined(__linux__) */
+
+
+inline
+int
+size_class(std::size_t n)
+{
+    int k = min_class;
+    while ((k < no_classes) && (((std::size_t) 1 << k) < n)) ++k;
+    return k;
+}
+
+
+} /* namespace */
+
+
+
+void*
+fcnn::internal::mem_alloc(std::size_t n)
+{
+    std::size_t tot = n + data_align;
+    if (tot < n) return 0;
+    void *p = 0, *map = 0;
+    std::size_t len = 0;
+    int cls = -1;
+#if defined(__linux__)
+    if (policy.active && (tot >= map_min)) {
+        p = map_block(tot, map, len);
+        if (!p) return 0;
+        cls = map_class;
+    } else
+#endif /* defined(__linux__) */
+    if (pool.active) {
+        cls = size_class(tot);
+        if (cls < no_classes) {
+            if (!pool.blocks[cls].empty()) {
+                p = pool.blocks[cls].back();
+                pool.blocks[cls].pop_back();
+                pool.cached -= (std::size_t) 1 << cls;
+                ++pool.hits;
+            } else {
+                ++pool.misses;
+                p = aligned_malloc((std::size_t) 1 << cls);
+            }
+        } else {
+            cls = -1;
+        }
+    }
+    if (cls == -1) p = aligned_malloc(tot);
+    if (!p) return 0;
+    mem_hdr *h = new (p) mem_hdr;
+    h->rc.store(1, std::memory_order_relaxed);
+    h->cls = cls;
+    h->map = map;
+    h->len = len;
+    h->owner = &pool;
+    return (char*) p + data_align;
+}
+
+
+void
+fcnn::internal::mem_free(void *p)
+{
+    void *b = (char*) p - data_align;
+    int cls = ((mem_hdr*) b)->cls;
+#if defined(FCNN_MMAP_FILES)
+    if (cls == file_class) {
+        munmap(((mem_hdr*) b)->map, ((mem_hdr*) b)->len);
+        return;
+    }
+#endif /* defined(FCNN_MMAP_FILES) */
+#if defined(__linux__)
+    if (cls == map_class) {
+        unmap_block(((mem_hdr*) b)->map, ((mem_hdr*) b)->len);
+        return;
+    }
+#endif /* defined(__linux__) */
+    // blocks released by other threads go back to the system, so that
+    // a consumer thread does not accumulate producer's blocks
+    if ((cls >= 0) && pool.active && (((mem_hdr*) b)->owner == &pool)) {
+        pool.blocks[cls].push_back(b);
+        pool.cached += (std::size_t) 1 << cls;
+    } else {
+        aligned_free(b);
+    }
+}
+
+
+std::atomic<int>*
+fcnn::internal::mem_refcount(void *p)
+{
+    return &((mem_hdr*) ((char*) p - data_align))->rc;
+}
+
+
+
+void*
+fcnn::internal::mem_map_fd(int fd, unsigned long long offset, std::size_t n)
+{
+    std::size_t tot = n + data_align;
+    if (tot < n) return 0;
+#if defined(FCNN_MMAP_FILES)
+    long pg = sysconf(_SC_PAGESIZE);
+    if ((pg <= 0) || (offset % (unsigned long long) pg)) return 0;
+    void *m = mmap(0, tot, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t) offset);
+    if (m == MAP_FAILED) return 0;
+    mem_hdr *h = new (m) mem_hdr;
+    h->rc.store(1, std::memory_order_relaxed);
+    h->cls = file_class;
+    h->map = m;
+    h->len = tot;
+    h->owner = 0;
+    return (char*) m + data_align;
+#else
+    return 0;
+#endif /* defined(FCNN_MMAP_FILES) */
+}
+
+
+void*
+fcnn::internal::mem_map_file(const char *fname, unsigned long long offset,
+                             std::size_t n)
+{
+    std::size_t tot = n + data_align;
+    if (tot < n) return 0;
+#if defined(FCNN_MMAP_FILES)
+    long pg = sysconf(_SC_PAGESIZE);
+    if ((pg > 0) && !(offset % (unsigned long long) pg)) {
+        int fd = open(fname, O_RDONLY);
+        if (fd < 0) return 0;
+        void *p = mem_map_fd(fd, offset, n);
+        close(fd);
+        return p;
+    }
+#endif /* defined(FCNN_MMAP_FILES) */
+    std::ifstream is(fname, std::ios::binary);
+    if (!is) return 0;
+    is.seekg((std::streamoff) (offset + data_align));
+    void *p = mem_alloc(n);
+    if (!p) return 0;
+    if (!is.read((char*) p, (std::streamsize) n)) {
+        mem_free(p);
+        return 0;
+    }
+    return p;
+}
+
+
+
+MatrixPool::MatrixPool()
+    : m_hits(pool.hits), m_misses(pool.misses)
+{
+    ++pool.active;
+}
+
+
+MatrixPool::~MatrixPool()
+{
+    if (!--pool.active) pool.release();
+}
+
+
+unsigned long long
+MatrixPool::hits() const
+{
+    return pool.hits - m_hits;
+}
+
+
+unsigned long long
+MatrixPool::misses() const
+{
+    return pool.misses - m_misses;
+}
+
+
+std::size_t
+MatrixPool::cached()
+{
+    return pool.cached;
+}
+
+
+
+MemoryPolicy::MemoryPolicy(int placement, bool huge_pages)
+    : m_active(policy.active), m_placement(policy.placement),
+      m_huge_pages(policy.huge_pages)
+{
+    if ((placement != mem_first_touch) && (placement != mem_interleave))
+        error("invalid memory placement policy");
+    policy.active = 1;
+    policy.placement = placement;
+    policy.huge_pages = huge_pages;
+}
+
+
+MemoryPolicy::~MemoryPolicy()
+{
+    policy.active = m_active;
+    policy.placement = m_placement;
+    policy.huge_pages = m_huge_pages;
+}
@@ -0,0 +1,137 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/** \file pool.h
+ *  \brief Memory pool and placement policy for matrices.
+ */
+
+
+#ifndef FCNN_POOL_H
+
+#define FCNN_POOL_H
+
+
+#include <cstddef>
+#include <atomic>
+
+
+namespace fcnn {
+
+
+/// Scoped memory pool for matrix data. While an object of this class exists,
+/// memory of matrices allocated and released in the thread which created it
+/// is cached (in power of two size classes) and reused instead of being
+/// returned to the system. Pools can be nested; cached memory is released
+/// when the outermost pool in a thread is destroyed. Teaching and pruning
+/// functions create their own pools.
+class MatrixPool {
+  public:
+    /// Constructor (activates pooling in the current thread).
+    MatrixPool();
+    /// Destructor.
+    ~MatrixPool();
+
+    /// No. of allocations served from the cache since construction.
+    unsigned long long hits() const;
+    /// No. of allocations not served from the cache since construction.
+    unsigned long long misses() const;
+    /// Memory currently cached in this thread (bytes).
+    static std::size_t cached();
+
+  private:
+    /// Counters at construction.
+    unsigned long long m_hits, m_misses;
+
+    MatrixPool(const MatrixPool&);
+    MatrixPool& operator=(const MatrixPool&);
+
+}; /* class MatrixPool */
+
+
+/// Memory placement policies (see MemoryPolicy).
+enum mem_placement {
+    /// Pages are placed on the NUMA node of the thread which touches them first.
+    mem_first_touch = 0,
+    /// Pages are interleaved over all NUMA nodes (for data shared by threads).
+    mem_interleave = 1
+};
+
+
+/// Scoped memory policy for large matrices. While an object of this class
+/// exists, data of matrices of at least 2MB allocated in the current thread
+/// is mapped directly from the system (and never pooled), with transparent
+/// huge pages requested if huge_pages is true, and placed on NUMA nodes
+/// according to the placement policy (see mem_placement). Policies can be
+/// nested, the innermost one applies. Supported on Linux; elsewhere
+/// the policy has no effect. Datasets are loaded with interleaved pages.
+/// Teaching threads should be bound to cores (e.g. with OMP_PROC_BIND),
+/// so that their workspaces, placed by first touch, stay local.
+class MemoryPolicy {
+  public:
+    /// Constructor.
+    explicit MemoryPolicy(int placement, bool huge_pages = true);
+    /// Destructor (restores the previous policy).
+    ~MemoryPolicy();
+
+  private:
+    /// Previous policy.
+    int m_active, m_placement;
+    bool m_huge_pages;
+
+    MemoryPolicy(const MemoryPolicy&);
+    MemoryPolicy& operator=(const MemoryPolicy&);
+
+}; /* class MemoryPolicy */
+
+
+namespace internal {
+
+
+/// Allocate n bytes of memory aligned to 64 bytes, with a reference count
+/// (set to 1) stored in front of it. Returns 0 on failure.
+void* mem_alloc(std::size_t n);
+
+/// Release memory allocated with mem_alloc.
+void mem_free(void *p);
+
+/// Reference count of memory allocated with mem_alloc or mem_map_file.
+std::atomic<int>* mem_refcount(void *p);
+
+/// Alignment of file offsets passed to mem_map_file.
+const std::size_t mem_map_align = 65536;
+
+/// Map n bytes of data stored in file at given offset plus 64 bytes (the 64
+/// bytes at offset are reserved for the reference count). The offset should
+/// be a multiple of mem_map_align. Mapping is private: changes of the data
+/// are never written to the file. Where files cannot be mapped, data is read
+/// into memory from mem_alloc. Returns 0 on failure. Release with mem_free.
+void* mem_map_file(const char *fname, unsigned long long offset, std::size_t n);
+
+/// As mem_map_file, but maps open file descriptor (e.g. of shared memory
+/// object) and offset must be a multiple of page size. Returns 0 on failure
+/// and where files cannot be mapped.
+void* mem_map_fd(int fd, unsigned long long offset, std::size_t n);
+
+
+} /* namespace internal */
+} /* namespace fcnn */
+
+
+#endif /* FCNN_POOL_H */
@@ -26,6 +26,7 @@
 #include <fcnn/rcarr.h>
 #include <fcnn/error.h>
 #include <fcnn/utils.h>
+#include <fcnn/pool.h>
 #include <cstdlib>
 #include <cstring>
 
@@ -38,7 +39,7 @@ using namespace fcnn::internal;
 
 // Constructor
 template <typename T>
-rcarr<T>::rcarr(int n)
+rcarr<T>::rcarr(idx_t n)
 {
     alloc(n);
 }
@@ -46,7 +47,7 @@ rcarr<T>::rcarr(int n)
 
 // Constructor
 template <typename T>
-rcarr<T>::rcarr(T *ptr, int n)
+rcarr<T>::rcarr(T *ptr, idx_t n)
 {
     alloc(n);
     read_from(ptr);
@@ -61,14 +62,14 @@ rcarr<T>::rcarr(const rcarr<T> &a)
     m_rc = a.m_rc;
     m_size = a.m_size;
 
-    if (m_rc) (*m_rc)++;
+    if (m_rc) m_rc->fetch_add(1, memory_order_relaxed);
 }
 
 
 // Reset function
 template <typename T>
 rcarr<T>&
-rcarr<T>::reset(int n)
+rcarr<T>::reset(idx_t n)
 {
     dec_rc();
     alloc(n);
@@ -78,6 +79,19 @@ rcarr<T>::reset(int n)
 
 
 
+// Taking ownership of memory
+template <typename T>
+void
+rcarr<T>::adopt(T *mem, idx_t n)
+{
+    dec_rc();
+    m_ptr = mem - 1;
+    m_rc = mem_refcount(mem);
+    m_size = n;
+}
+
+
+
 // Destructor
 template <typename T>
 rcarr<T>::~rcarr()
@@ -99,7 +113,7 @@ rcarr<T>::operator=(const rcarr<T> &a)
     m_rc = a.m_rc;
     m_size = a.m_size;
 
-    if (m_rc) (*m_rc)++;
+    if (m_rc) m_rc->fetch_add(1, memory_order_relaxed);
 
     return *this;
 }
@@ -123,7 +137,7 @@ template <typename T>
 void
 rcarr<T>::mkunique()
 {
-    if ((m_rc) && (*m_rc > 1))
+    if ((m_rc) && (m_rc->load(memory_order_acquire) > 1))
         *this = copy();
 }
 
@@ -137,7 +151,7 @@ rcarr<T>::set_all_to(const T &val)
         memset(m_ptr + 1, 0, m_size * sizeof(T));
         return;
     }
-    for (int i = 1; i <= m_size; i++) m_ptr[i] = val;
+    for (idx_t i = 1; i <= m_size; i++) m_ptr[i] = val;
 }
 
 
@@ -146,22 +160,21 @@ rcarr<T>::set_all_to(const T &val)
 // Memory allocation
 template <typename T>
 void
-rcarr<T>::alloc(int n)
+rcarr<T>::alloc(idx_t n)
 {
     if (n < 0) error("negative array size");
     if (n)
     {
-        m_ptr = (T*) malloc(sizeof(T) * n);
+        m_ptr = (T*) mem_alloc(sizeof(T) * n);
         if (!m_ptr) {
             message mes;
-            mes << "failed to allocate " << ((int) sizeof(T) * n)
+            mes << "failed to allocate " << ((idx_t) sizeof(T) * n)
                 << "B of memory";
             error(mes);
         }
+        m_rc = mem_refcount(m_ptr);
         m_ptr--;
         m_size = n;
-        m_rc = (int*) malloc(sizeof(int));
-        *m_rc = 1;
     }
     else
     {
@@ -179,14 +192,11 @@ rcarr<T>::dec_rc()
 {
     if (m_rc)
     {
-        --(*m_rc);
-
-        if ((*m_rc) == 0)
+        if (m_rc->fetch_sub(1, memory_order_acq_rel) == 1)
         {
-            free(m_rc);
-            free(++m_ptr);
-            m_rc = 0;
+            mem_free(++m_ptr);
         }
+        m_rc = 0;
     }
 }
 
@@ -28,32 +28,58 @@
 #define FCNN_RCARR_H
 
 
+#include <atomic>
+
 
 namespace fcnn {
+
+
+/// Type used for element counts and offsets in arrays and matrices
+/// (64-bit, numbers of rows and columns are int).
+typedef long long idx_t;
+
+
 namespace internal {
 
 
 /// This is the base container class for Matrix class. It handles
 /// memory allocation, reference counting and provides inlined element access
-/// with 1-based indexing.
+/// with 1-based indexing. Reference count is atomic, so that arrays sharing
+/// memory can be copied and destroyed in different threads. Data is aligned
+/// to 64 bytes and allocated through the matrix memory pool (see pool.h),
+/// with reference count stored in front of it.
 template <typename T>
 class rcarr {
  public:
     /// Constructor (allocates memory).
-    explicit rcarr(int = 0);
+    explicit rcarr(idx_t = 0);
     /// Constructor from array.
-    rcarr(T*, int);
+    rcarr(T*, idx_t);
     /// Copy constructor.
     rcarr(const rcarr<T>&);
+    /// Move constructor.
+    rcarr(rcarr<T> &&a) noexcept : m_ptr(a.m_ptr), m_rc(a.m_rc), m_size(a.m_size) {
+        a.m_ptr = 0;
+        a.m_rc = 0;
+        a.m_size = 0;
+    }
 
     /// Reset member function allocates new memory.
-    rcarr<T>& reset(int = 0);
+    rcarr<T>& reset(idx_t = 0);
 
     /// Destructor.
     ~rcarr();
 
+    /// Take ownership of n elements of memory from mem_alloc
+    /// or mem_map_file (see pool.h) with reference count 1.
+    void adopt(T*, idx_t);
+
     /// Make this data unique.
     void mkunique();
+    /// Check if memory is not shared with other objects.
+    inline bool unique() const {
+        return m_rc && (m_rc->load(std::memory_order_acquire) == 1);
+    }
 
     /// Returns pointer to data.
     inline T* ptr() { return m_ptr + 1; }
@@ -61,15 +87,27 @@ class rcarr {
     inline T const* ptr() const { return m_ptr + 1; }
 
     /// Element access, no index checking.
-    inline T& operator[](int i) { return m_ptr[i]; }
+    inline T& operator[](idx_t i) { return m_ptr[i]; }
     /// Element access (const version), no index checking.
-    inline T const& operator[](int i) const { return m_ptr[i]; }
+    inline T const& operator[](idx_t i) const { return m_ptr[i]; }
 
     /// Returns size (number of elements).
-    inline int size() const { return m_size; }
+    inline idx_t size() const { return m_size; }
 
     /// Assignment.
     rcarr<T>& operator=(const rcarr<T>&);
+    /// Move assignment.
+    rcarr<T>& operator=(rcarr<T> &&a) noexcept {
+        if (this == &a) return *this;
+        dec_rc();
+        m_ptr = a.m_ptr;
+        m_rc = a.m_rc;
+        m_size = a.m_size;
+        a.m_ptr = 0;
+        a.m_rc = 0;
+        a.m_size = 0;
+        return *this;
+    }
 
     /// Return verbatim copy of data (new memory is allocated).
     rcarr<T> copy() const;
@@ -84,12 +122,12 @@ class rcarr {
     /// Pointer to data.
     T *m_ptr;
     /// Pointer to the reference count.
-    int *m_rc;
+    std::atomic<int> *m_rc;
     /// Size.
-    int m_size;
+    idx_t m_size;
 
     /// Memory allocation.
-    void alloc(int);
+    void alloc(idx_t);
     /// Decrement refcount (called by destructor).
     void dec_rc();
 
@@ -0,0 +1,232 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file shard.cpp
+ *  \brief Manifest of sharded dataset.
+ */
+
+
+#include <fcnn/shard.h>
+#include <fcnn/utils.h>
+#include <fcnn/error.h>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+
+using namespace fcnn;
+using namespace fcnn::internal;
+
+
+
+namespace {
+
+
+// Manifest header
+const char shard_magic[] = "FCNNSHARDS";
+const int shard_version = 1;
+
+
+} /* namespace */
+
+
+
+bool
+ShardManifest::load(const std::string &fname)
+{
+    m_rows = m_in = m_out = 0;
+    m_info.clear();
+    m_shards.clear();
+    std::size_t sep = fname.find_last_of("/\\");
+    m_dir = (sep == std::string::npos) ? std::string() : fname.substr(0, sep + 1);
+
+    std::ifstream is;
+    is.open(fname.c_str());
+    if (is.fail()) return false;
+    std::string magic;
+    int ver, n;
+    if (!(is >> magic) || (magic != shard_magic)) return false;
+    if (!read(is, ver) || (ver != shard_version)) return false;
+    skip_blank(is);
+    if (is.peek() == '#') {
+        if (!read_comment(is, m_info)) goto err;
+    }
+    if (!read(is, m_rows) || !read(is, m_in) || !read(is, m_out) || !read(is, n))
+        goto err;
+    if ((m_rows < 1) || (m_in < 1) || (m_out < 1) || (n < 1) || (n > m_rows))
+        goto err;
+
+    m_shards.resize(n);
+    for (int k = 0, first = 0; k < n; ++k) {
+        shard &s = m_shards[k];
+        skip_all(is);
+        if (!std::getline(is, s.file)) goto err;
+        if (!s.file.empty() && (s.file[s.file.size() - 1] == '\r'))
+            s.file.erase(s.file.size() - 1);
+        if (s.file.empty()) goto err;
+        if (!read(is, s.first) || !read(is, s.rows)) goto err;
+        // first record is 1-based in the file
+        if ((--s.first != first) || (s.rows < 1) || (s.rows > m_rows - first)) goto err;
+        first += s.rows;
+        if ((k == n - 1) && (first != m_rows)) goto err;
+        int c = m_in + m_out;
+        s.stats = Matrix<double>(c, 4);
+        for (int j = 1; j <= 4; ++j) {
+            for (int i = 1; i <= c; ++i) {
+                if (!read(is, s.stats.elem(i, j))) goto err;
+            }
+        }
+    }
+    return true;
+
+err:
+    m_rows = m_in = m_out = 0;
+    m_info.clear();
+    m_shards.clear();
+    return false;
+}
+
+
+
+bool
+ShardManifest::save(const std::string &fname) const
+{
+    std::ofstream os;
+    os.open(fname.c_str());
+    if (os.fail()) return false;
+    os << shard_magic << ' ' << shard_version << '\n';
+    if (!m_info.empty()) {
+        if (!write_comment(os, m_info)) return false;
+    }
+    os << m_rows << ' ' << m_in << ' ' << m_out << ' ' << m_shards.size() << '\n';
+
+    os << std::setprecision(precision<double>::val);
+    int c = m_in + m_out;
+    for (std::size_t k = 0; k < m_shards.size(); ++k) {
+        const shard &s = m_shards[k];
+        if (!write_comment(os, "shard " + num2str((int) k + 1))) return false;
+        os << s.file << '\n' << s.first + 1 << ' ' << s.rows << '\n';
+        for (int j = 1; j <= 4; ++j) {
+            for (int i = 1; i < c; ++i) os << s.stats.elem(i, j) << ' ';
+            os << s.stats.elem(c, j) << '\n';
+        }
+        if (os.fail()) return false;
+    }
+    os.close();
+    if (os.fail()) return false;
+    return true;
+}
+
+
+
+void
+ShardManifest::check(int k) const
+{
+    if ((k < 1) || (k > (int) m_shards.size())) {
+        message mes;
+        mes << "invalid shard index: " << k;
+        error(mes);
+    }
+}
+
+
+std::string
+ShardManifest::shard_file(int k) const
+{
+    check(k);
+    const std::string &f = m_shards[k - 1].file;
+    if ((f[0] == '/') || (f[0] == '\\')) return f;
+    return m_dir + f;
+}
+
+
+int
+ShardManifest::first_record(int k) const
+{
+    check(k);
+    return m_shards[k - 1].first + 1;
+}
+
+
+int
+ShardManifest::no_records(int k) const
+{
+    check(k);
+    return m_shards[k - 1].rows;
+}
+
+
+const Matrix<double>&
+ShardManifest::shard_stats(int k) const
+{
+    check(k);
+    return m_shards[k - 1].stats;
+}
+
+
+
+Matrix<double>
+ShardManifest::stats() const
+{
+    int c = m_in + m_out, n = m_shards.size();
+    Matrix<double> res(c, 4);
+    if (!n) return res;
+    for (int i = 1; i <= c; ++i) {
+        double m = 0, v = 0, mn = m_shards[0].stats.elem(i, 3),
+               mx = m_shards[0].stats.elem(i, 4);
+        for (int k = 0; k < n; ++k)
+            m += m_shards[k].rows * m_shards[k].stats.elem(i, 1);
+        m /= m_rows;
+        for (int k = 0; k < n; ++k) {
+            const Matrix<double> &s = m_shards[k].stats;
+            double d = s.elem(i, 1) - m;
+            v += m_shards[k].rows * (s.elem(i, 2) + d * d);
+            mn = std::min(mn, s.elem(i, 3));
+            mx = std::max(mx, s.elem(i, 4));
+        }
+        res.elem(i, 1) = m;
+        res.elem(i, 2) = v / m_rows;
+        res.elem(i, 3) = mn;
+        res.elem(i, 4) = mx;
+    }
+    return res;
+}
+
+
+
+void
+ShardManifest::worker_shards(int k, int n, int &first, int &last) const
+{
+    int s = m_shards.size();
+    if ((n < 1) || (n > s)) {
+        message mes;
+        mes << "no. of workers (" << n << ") must be between 1 and no. of shards ("
+            << s << ")";
+        error(mes);
+    }
+    if ((k < 1) || (k > n)) {
+        message mes;
+        mes << "invalid worker index: " << k;
+        error(mes);
+    }
+    first = (int) ((long long) (k - 1) * s / n) + 1;
+    last = (int) ((long long) k * s / n);
+}
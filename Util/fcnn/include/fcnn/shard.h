@@ -0,0 +1,120 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file shard.h
+ *  \brief Manifest of sharded dataset.
+ */
+
+
+#ifndef FCNN_SHARD_H
+
+#define FCNN_SHARD_H
+
+
+#include <fcnn/mat.h>
+#include <string>
+#include <vector>
+
+
+namespace fcnn {
+
+
+template <typename T> class Dataset;
+
+
+/// Manifest of dataset split into shards (see Dataset::save_shards),
+/// i.e. binary dataset files holding consecutive ranges of records.
+/// Manifest is a text file listing the shards (file names relative
+/// to the manifest, record ranges) with statistics of their columns.
+/// Shards are numbered from 1.
+class ShardManifest
+{
+  public:
+    /// Default constructor
+    ShardManifest() : m_rows(0), m_in(0), m_out(0) { ; }
+
+    /// Load manifest from file, returns true on success.
+    bool load(const std::string &fname);
+    /// Save manifest to file, returns true on success.
+    bool save(const std::string &fname) const;
+
+    /// Get no. of records (all shards).
+    int no_records() const { return m_rows; }
+    /// Get no. of inputs.
+    int no_inputs() const { return m_in; }
+    /// Get no. of outputs.
+    int no_outputs() const { return m_out; }
+    /// Get no. of shards.
+    int no_shards() const { return m_shards.size(); }
+    /// Retrieve data information.
+    std::string get_info() const { return m_info; }
+
+    /// Get path of k-th shard's file.
+    std::string shard_file(int k) const;
+    /// Get index of the first record of k-th shard (records are numbered
+    /// from 1 as in the whole dataset).
+    int first_record(int k) const;
+    /// Get no. of records in k-th shard.
+    int no_records(int k) const;
+    /// Get statistics of k-th shard: means (1st column), variances
+    /// (2nd column), minima (3rd column) and maxima (4th column)
+    /// of inputs followed by outputs (rows).
+    const Matrix<double>& shard_stats(int k) const;
+    /// Get statistics (as shard_stats) of the whole dataset.
+    Matrix<double> stats() const;
+
+    /// Get range of shards [first, last] assigned to worker k of n
+    /// (as equal as possible, consecutive). Throws if n is larger
+    /// than the no. of shards.
+    void worker_shards(int k, int n, int &first, int &last) const;
+
+  private:
+    /// Shard.
+    struct shard {
+        /// File name (relative to manifest).
+        std::string file;
+        /// First record (0-based) and no. of records.
+        int first, rows;
+        /// Statistics.
+        Matrix<double> stats;
+    };
+
+    /// No. of records, inputs and outputs.
+    int m_rows, m_in, m_out;
+    /// Dataset description.
+    std::string m_info;
+    /// Directory of manifest (empty or ending with separator).
+    std::string m_dir;
+    /// Shards.
+    std::vector<shard> m_shards;
+
+    /// Check shard index (throws).
+    void check(int k) const;
+
+    template <typename T> friend class Dataset;
+
+}; /* class ShardManifest */
+
+
+} /* namespace fcnn */
+
+
+#endif /* FCNN_SHARD_H */
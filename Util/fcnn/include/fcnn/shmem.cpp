@@ -0,0 +1,255 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file shmem.cpp
+ *  \brief Named shared memory segments holding datasets (internal).
+ */
+
+
+#include <fcnn/shmem.h>
+#include <fcnn/pool.h>
+#include <atomic>
+#include <new>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#define FCNN_SHM
+#endif
+
+
+using namespace fcnn::internal;
+
+
+
+namespace {
+
+
+// Control page
+struct shm_ctl {
+    // no. of attached processes
+    std::atomic<int> users;
+    // 1 when image is ready, -1 if creator failed
+    std::atomic<int> state;
+    // creator's process id
+    std::atomic<long> pid;
+};
+
+
+// Size of control page and offset of image
+const std::size_t ctl_size = mem_map_align;
+
+// Waiting for creator (microseconds between checks, max. wait for size)
+const int wait_step = 10000;
+const int wait_size = 1000;
+
+
+} /* namespace */
+
+
+
+shm_segment::shm_segment()
+    : m_fd(-1), m_ctl(0), m_img(0), m_size(0)
+{
+    ;
+}
+
+
+shm_segment::~shm_segment()
+{
+#if defined(FCNN_SHM)
+    if (m_ctl) {
+        shm_ctl *ctl = (shm_ctl*) m_ctl;
+        if (ctl->users.fetch_sub(1) == 1) unlink();
+    }
+#endif /* defined(FCNN_SHM) */
+    close();
+}
+
+
+void
+shm_segment::unlink()
+{
+#if defined(FCNN_SHM)
+    // remove unless the name has been reused for a new segment
+    struct stat a, b;
+    int fd = shm_open(m_name.c_str(), O_RDONLY, 0);
+    if (fd >= 0) {
+        if (!fstat(fd, &a) && !fstat(m_fd, &b) && (a.st_ino == b.st_ino))
+            shm_unlink(m_name.c_str());
+        ::close(fd);
+    }
+#endif /* defined(FCNN_SHM) */
+}
+
+
+void
+shm_segment::close()
+{
+#if defined(FCNN_SHM)
+    if (m_img) munmap(m_img, m_size);
+    if (m_ctl) munmap(m_ctl, ctl_size);
+    if (m_fd >= 0) ::close(m_fd);
+#endif /* defined(FCNN_SHM) */
+    m_img = 0;
+    m_ctl = 0;
+    m_fd = -1;
+    m_size = 0;
+}
+
+
+bool
+shm_segment::supported()
+{
+#if defined(FCNN_SHM)
+    return true;
+#else
+    return false;
+#endif /* defined(FCNN_SHM) */
+}
+
+
+bool
+shm_segment::remove(const std::string &name)
+{
+#if defined(FCNN_SHM)
+    return !shm_unlink(name.c_str());
+#else
+    return false;
+#endif /* defined(FCNN_SHM) */
+}
+
+
+std::size_t
+shm_segment::base()
+{
+    return ctl_size;
+}
+
+
+bool
+shm_segment::attach(const std::string &name)
+{
+    close();
+#if defined(FCNN_SHM)
+    m_name = name;
+    m_fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (m_fd < 0) return false;
+    // wait until creator sets size (it does so right after creating
+    // the segment, so a segment left without size is stale)
+    struct stat st;
+    for (int k = 0; ; ++k) {
+        if (fstat(m_fd, &st)) { close(); return false; }
+        if ((std::size_t) st.st_size > ctl_size) break;
+        if (k == wait_size) {
+            unlink();
+            close();
+            return false;
+        }
+        usleep(wait_step);
+    }
+    void *m = mmap(0, ctl_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (m == MAP_FAILED) { close(); return false; }
+    m_ctl = m;
+    shm_ctl *ctl = (shm_ctl*) m_ctl;
+    ctl->users.fetch_add(1);
+    // wait until image is ready (as long as creator is alive)
+    for (;;) {
+        int s = ctl->state.load();
+        if (s == 1) break;
+        long pid = ctl->pid.load();
+        if ((s < 0) || (pid && kill((pid_t) pid, 0) && (errno == ESRCH))) {
+            // creator failed or died, remove stale segment so that
+            // it can be created again
+            ctl->users.fetch_sub(1);
+            unlink();
+            close();
+            return false;
+        }
+        usleep(wait_step);
+    }
+    m_size = (std::size_t) st.st_size - ctl_size;
+    m = mmap(0, m_size, PROT_READ, MAP_SHARED, m_fd, ctl_size);
+    if (m == MAP_FAILED) {
+        ctl->users.fetch_sub(1);
+        close();
+        return false;
+    }
+    m_img = (char*) m;
+    return true;
+#else
+    return false;
+#endif /* defined(FCNN_SHM) */
+}
+
+
+bool
+shm_segment::create(const std::string &name, std::size_t n)
+{
+    close();
+#if defined(FCNN_SHM)
+    m_name = name;
+    m_fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (m_fd < 0) return false;
+    void *m;
+    if (ftruncate(m_fd, (off_t) (ctl_size + n))
+        || ((m = mmap(0, ctl_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0))
+            == MAP_FAILED)) {
+        shm_unlink(name.c_str());
+        close();
+        return false;
+    }
+    m_ctl = m;
+    shm_ctl *ctl = new (m_ctl) shm_ctl;
+    ctl->pid.store((long) getpid());
+    ctl->state.store(0);
+    ctl->users.fetch_add(1);
+    m_size = n;
+    m = mmap(0, n, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, ctl_size);
+    if (m == MAP_FAILED) {
+        ctl->state.store(-1);
+        shm_unlink(name.c_str());
+        ctl->users.fetch_sub(1);
+        m_size = 0;
+        close();
+        return false;
+    }
+    m_img = (char*) m;
+    return true;
+#else
+    return false;
+#endif /* defined(FCNN_SHM) */
+}
+
+
+void
+shm_segment::ready()
+{
+#if defined(FCNN_SHM)
+    if (!m_ctl) return;
+    // image is only read from now on
+    mprotect(m_img, m_size, PROT_READ);
+    ((shm_ctl*) m_ctl)->state.store(1);
+#endif /* defined(FCNN_SHM) */
+}
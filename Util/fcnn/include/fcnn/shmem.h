@@ -0,0 +1,105 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file shmem.h
+ *  \brief Named shared memory segments holding datasets (internal).
+ */
+
+
+#ifndef FCNN_SHMEM_H
+
+#define FCNN_SHMEM_H
+
+
+#include <cstddef>
+#include <string>
+
+
+namespace fcnn {
+namespace internal {
+
+
+/// Named shared memory segment used by processes sharing a dataset
+/// (see Dataset::load_shared). The segment starts with a control page
+/// (no. of attached processes, creator's pid, ready flag) followed by
+/// the data image at offset base(). The last process to detach removes
+/// the segment. Supported where POSIX shared memory is available.
+class shm_segment {
+  public:
+    /// Constructor.
+    shm_segment();
+    /// Destructor (detaches).
+    ~shm_segment();
+
+    /// Is POSIX shared memory supported?
+    static bool supported();
+    /// Remove segment with given name, returns true on success.
+    static bool remove(const std::string &name);
+
+    /// Attach to existing segment, waiting until its creator marks it ready.
+    /// Returns false if there is no such segment or its creator failed
+    /// or died (such stale segment is removed, so that create can succeed).
+    bool attach(const std::string &name);
+    /// Create new segment with image of n bytes (mapped for writing
+    /// until ready is called). Returns false if it exists or on failure.
+    bool create(const std::string &name, std::size_t n);
+    /// Mark image as ready (creator).
+    void ready();
+
+    /// Image (read only for processes which attached).
+    const char* image() const { return m_img; }
+    /// Image (creator, until ready is called).
+    char* image() { return m_img; }
+    /// Size of image.
+    std::size_t size() const { return m_size; }
+    /// File descriptor of the segment.
+    int fd() const { return m_fd; }
+    /// Offset of the image in the segment (multiple of page size).
+    static std::size_t base();
+
+  private:
+    /// Name.
+    std::string m_name;
+    /// File descriptor.
+    int m_fd;
+    /// Control page.
+    void *m_ctl;
+    /// Image.
+    char *m_img;
+    /// Size of image.
+    std::size_t m_size;
+
+    /// Unmap and close.
+    void close();
+    /// Remove segment's name unless it has been reused for a new segment.
+    void unlink();
+
+    shm_segment(const shm_segment&);
+    shm_segment& operator=(const shm_segment&);
+
+}; /* class shm_segment */
+
+
+} /* namespace internal */
+} /* namespace fcnn */
+
+
+#endif /* FCNN_SHMEM_H */
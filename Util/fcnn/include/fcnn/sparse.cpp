@@ -0,0 +1,356 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file sparse.cpp
+ *  \brief Sparse (compressed row) matrices and datasets with sparse inputs.
+ */
+
+
+#include <fcnn/sparse.h>
+#include <fcnn/utils.h>
+#include <fcnn/error.h>
+#include <fcnn/textio.h>
+#include <fstream>
+#include <iomanip>
+
+
+using namespace fcnn;
+using namespace fcnn::internal;
+
+
+
+namespace {
+
+
+// Strip carriage return
+inline
+void
+strip_cr(std::string &line)
+{
+    if (!line.empty() && (line[line.size() - 1] == '\r')) line.erase(line.size() - 1);
+}
+
+
+// Parse line of index:value pairs (1-based indices not larger than n)
+template <typename T>
+bool
+parse_pairs(const std::string &line, int n, std::vector<int> &idx, std::vector<T> &val)
+{
+    const char *p = line.data(), *e = p + line.size();
+    for (p = skip_sp(p, e); p < e; p = skip_sp(p, e)) {
+        long j = 0;
+        const char *q = p;
+        for (; (q < e) && (*q >= '0') && (*q <= '9') && (j <= n); ++q)
+            j = 10 * j + (*q - '0');
+        if ((q == p) || (q == e) || (*q != ':') || (j < 1) || (j > n)) return false;
+        T x;
+        p = scan_num(q + 1, e, x);
+        if (!p) return false;
+        if ((p < e) && (*p != ' ') && (*p != '\t')) return false;
+        idx.push_back((int) j - 1);
+        val.push_back(x);
+    }
+    return true;
+}
+
+
+// Parse line of n numbers
+template <typename T>
+bool
+parse_dense(const std::string &line, int n, T *x, idx_t ld)
+{
+    const char *p = line.data(), *e = p + line.size();
+    for (int j = 0; j < n; ++j) {
+        p = skip_sp(p, e);
+        if (p == e) return false;
+        p = scan_num(p, e, x[j * ld]);
+        if (!p) return false;
+        if ((p < e) && (*p != ' ') && (*p != '\t')) return false;
+    }
+    return skip_sp(p, e) == e;
+}
+
+
+} /* namespace */
+
+
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(int rows, int cols, const std::vector<idx_t> &row_ptr,
+                              const std::vector<int> &col_idx, const std::vector<T> &val)
+    : m_rows(rows), m_cols(cols), m_ptr(row_ptr), m_idx(col_idx), m_val(val)
+{
+    if ((rows < 0) || (cols < 0)) error("invalid dimensions of sparse matrix");
+    if ((m_ptr.size() != (std::size_t) rows + 1) || m_ptr[0]
+        || (m_ptr[rows] != (idx_t) m_idx.size()) || (m_idx.size() != m_val.size()))
+        error("invalid row pointers of sparse matrix");
+    for (int i = 0; i < rows; ++i) {
+        if (m_ptr[i + 1] < m_ptr[i]) error("invalid row pointers of sparse matrix");
+    }
+    for (std::size_t k = 0; k < m_idx.size(); ++k) {
+        if ((m_idx[k] < 0) || (m_idx[k] >= cols))
+            error("invalid column index in sparse matrix");
+    }
+}
+
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(const Matrix<T> &m)
+    : m_rows(m.rows()), m_cols(m.cols()), m_ptr(m.rows() + 1, 0)
+{
+    for (int i = 1; i <= m_rows; ++i) {
+        for (int j = 1; j <= m_cols; ++j) {
+            T x = m.elem(i, j);
+            if (x == T()) continue;
+            m_idx.push_back(j - 1);
+            m_val.push_back(x);
+        }
+        m_ptr[i] = m_val.size();
+    }
+}
+
+
+
+template <typename T>
+T
+SparseMatrix<T>::operator()(int i, int j) const
+{
+    if ((i < 1) || (i > m_rows) || (j < 1) || (j > m_cols)) {
+        message mes;
+        mes << "invalid index (" << i << ", " << j << ") of sparse matrix";
+        error(mes);
+    }
+    for (idx_t k = m_ptr[i - 1]; k < m_ptr[i]; ++k) {
+        if (m_idx[k] == j - 1) return m_val[k];
+    }
+    return T();
+}
+
+
+template <typename T>
+Matrix<T>
+SparseMatrix<T>::dense() const
+{
+    Matrix<T> res(m_rows, m_cols, T());
+    T *p = res.ptr();
+    for (int i = 0; i < m_rows; ++i) {
+        for (idx_t k = m_ptr[i]; k < m_ptr[i + 1]; ++k)
+            p[(idx_t) m_idx[k] * m_rows + i] += m_val[k];
+    }
+    return res;
+}
+
+
+template <typename T>
+SparseMatrix<T>
+SparseMatrix<T>::get_rows(const std::vector<int> &is) const
+{
+    SparseMatrix<T> res;
+    int nr = is.size();
+    res.m_rows = nr;
+    res.m_cols = m_cols;
+    res.m_ptr.assign(nr + 1, 0);
+    for (int i = 0; i < nr; ++i) {
+        int ii = is[i];
+        if ((ii < 1) || (ii > m_rows)) {
+            message mes;
+            mes << "invalid row index: " << ii;
+            error(mes);
+        }
+        res.m_idx.insert(res.m_idx.end(), m_idx.begin() + m_ptr[ii - 1],
+                         m_idx.begin() + m_ptr[ii]);
+        res.m_val.insert(res.m_val.end(), m_val.begin() + m_ptr[ii - 1],
+                         m_val.begin() + m_ptr[ii]);
+        res.m_ptr[i + 1] = res.m_val.size();
+    }
+    return res;
+}
+
+
+template <typename T>
+internal::csr_rows<T>
+SparseMatrix<T>::ref() const
+{
+    internal::csr_rows<T> r = { &m_ptr[0], m_idx.empty() ? 0 : &m_idx[0],
+                                m_val.empty() ? 0 : &m_val[0] };
+    return r;
+}
+
+
+
+template <typename T>
+SparseDataset<T>::SparseDataset(const Dataset<T> &dat)
+{
+    if (dat.weighted()) error("sparse datasets do not support record weights");
+    std::vector<std::string> ri(dat.no_records());
+    for (int i = 0; i < dat.no_records(); ++i) ri[i] = dat.get_record_info(i + 1);
+    set(SparseMatrix<T>(dat.get_input()), dat.get_output(), dat.get_info(), ri);
+}
+
+
+template <typename T>
+void
+SparseDataset<T>::set(const SparseMatrix<T> &in, const Matrix<T> &out,
+                      const std::string &descr,
+                      const std::vector<std::string> &record_descr)
+{
+    int ri = in.rows(), ci = in.cols(), ro = out.rows(), co = out.cols();
+    if (ri != ro) {
+        message mes;
+        mes << "no. of records in input (" << ri << ") and output ("
+            << ro << ") disagree";
+        error(mes);
+    }
+    if (!ci) error("empty input");
+    if (!co) error("empty output");
+    int rd = record_descr.size();
+    if (rd && (ri != rd)) {
+        message mes;
+        mes << "no. of records (" << ri << ") and record descriptions ("
+            << rd << ") disagree";
+        error(mes);
+    }
+    m_in = in;
+    m_out = out;
+    m_info = descr;
+    if (rd) m_rec_info = record_descr;
+    else m_rec_info.assign(ri, "");
+}
+
+
+template <typename T>
+std::string
+SparseDataset<T>::get_record_info(int i) const
+{
+    int r = m_rec_info.size();
+    if ((i < 1) || (i > r)) {
+        message mes;
+        mes << "invalid record index: index " << i << ", no. of records "
+            << "in dataset: " << r;
+        error(mes);
+    }
+    return m_rec_info[i - 1];
+}
+
+
+
+template <typename T>
+bool
+SparseDataset<T>::load(const std::string &fname, bool read_info)
+{
+    std::ifstream is;
+    is.open(fname.c_str());
+    if (is.fail()) return false;
+
+    int r, ci, co;
+    std::string info, line;
+    skip_blank(is);
+    if (is.peek() == '#') {
+        if (!read_comment(is, info)) return false;
+    }
+    skip_all(is);
+    if (!read(is, r) || !read(is, ci) || !read(is, co)) return false;
+    if ((r < 1) || (ci < 1) || (co < 1)) return false;
+    if (!std::getline(is, line)) return false;
+    strip_cr(line);
+    if (skip_sp(line.data(), line.data() + line.size()) != line.data() + line.size())
+        return false;
+
+    std::vector<idx_t> ptr(r + 1, 0);
+    std::vector<int> idx;
+    std::vector<T> val;
+    Matrix<T> out(r, co);
+    std::vector<std::string> ri(r);
+    for (int i = 0; i < r; ++i) {
+        if (is.peek() == '#') {
+            if (!read_comment(is, ri[i])) return false;
+        }
+        if (!std::getline(is, line)) return false;
+        strip_cr(line);
+        if (!parse_pairs(line, ci, idx, val)) return false;
+        ptr[i + 1] = val.size();
+        if (!std::getline(is, line)) return false;
+        strip_cr(line);
+        if (!parse_dense(line, co, out.ptr() + i, r)) return false;
+    }
+
+    m_in = SparseMatrix<T>(r, ci, ptr, idx, val);
+    m_out = out;
+    if (read_info) {
+        m_info = info;
+        m_rec_info.swap(ri);
+    } else {
+        m_info.clear();
+        m_rec_info.assign(r, "");
+    }
+    return true;
+}
+
+
+
+template <typename T>
+bool
+SparseDataset<T>::save(const std::string &fname, bool write_info) const
+{
+    std::ofstream os;
+    os.open(fname.c_str());
+    if (os.fail()) return false;
+    int r = m_in.rows(), ci = m_in.cols(), co = m_out.cols();
+    if (write_info) {
+        std::string info = m_info;
+        if (info == "") info = "untitled dataset";
+        if (!write_comment(os, info)) return false;
+    }
+
+    os << r << ' ' << ci << ' ' << co << '\n';
+
+    os << std::setprecision(precision<T>::val);
+    const std::vector<idx_t> &ptr = m_in.row_ptr();
+    const std::vector<int> &idx = m_in.col_idx();
+    const std::vector<T> &val = m_in.values();
+    for (int i = 1; i <= r; ++i) {
+        if (write_info) {
+            std::string info = m_rec_info[i - 1];
+            if (info == "") info = num2str(i);
+            if (!write_comment(os, info)) return false;
+        }
+        for (idx_t k = ptr[i - 1]; k < ptr[i]; ++k) {
+            if (k > ptr[i - 1]) os << ' ';
+            os << idx[k] + 1 << ':' << val[k];
+        }
+        os << '\n';
+        int j;
+        for (j = 1; j < co; ++j) os << m_out.elem(i, j) << ' ';
+        os << m_out.elem(i, j) << '\n';
+        if (os.fail()) return false;
+    }
+    os.close();
+    if (os.fail()) return false;
+    return true;
+}
+
+
+
+// Instantiations
+template class fcnn::SparseMatrix<double>;
+template class fcnn::SparseMatrix<float>;
+template class fcnn::SparseDataset<double>;
+template class fcnn::SparseDataset<float>;
@@ -0,0 +1,168 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file sparse.h
+ *  \brief Sparse (compressed row) matrices and datasets with sparse inputs.
+ */
+
+
+#ifndef FCNN_SPARSE_H
+
+#define FCNN_SPARSE_H
+
+
+#include <fcnn/mat.h>
+#include <fcnn/dataset.h>
+#include <string>
+#include <vector>
+
+
+namespace fcnn {
+
+
+namespace internal {
+
+/// Access to rows of a sparse matrix used by level 3 routines: non-zero
+/// elements of row i (0-based) are val[k] in columns idx[k] (0-based),
+/// k = ptr[i], ..., ptr[i + 1] - 1.
+template <typename T>
+struct csr_rows {
+    const idx_t *ptr;
+    const int *idx;
+    const T *val;
+};
+
+} /* namespace internal */
+
+
+/// Sparse matrix in compressed sparse row format, used for inputs
+/// with few non-zero elements (e.g. one-hot or bag-of-words features).
+template <typename T>
+class SparseMatrix
+{
+ public:
+    /// Constructor (0x0 matrix).
+    SparseMatrix() : m_rows(0), m_cols(0), m_ptr(1, 0) { ; }
+    /// Constructor from compressed sparse row representation: row pointers
+    /// (rows + 1 offsets of rows in column indices and values), 0-based
+    /// column indices and values. Throws if the representation is invalid.
+    SparseMatrix(int rows, int cols, const std::vector<idx_t> &row_ptr,
+                 const std::vector<int> &col_idx, const std::vector<T> &val);
+    /// Constructor from dense matrix (zeros are dropped).
+    explicit SparseMatrix(const Matrix<T> &m);
+
+    /// Returns number of rows.
+    inline int rows() const { return m_rows; }
+    /// Returns number of columns.
+    inline int cols() const { return m_cols; }
+    /// Returns number of non-zero elements.
+    inline idx_t nnz() const { return m_val.size(); }
+
+    /// Element access (1-based indices).
+    T operator()(int i, int j) const;
+    /// Return dense matrix.
+    Matrix<T> dense() const;
+    /// Return sparse matrix created by selecting given rows (1-based).
+    SparseMatrix<T> get_rows(const std::vector<int> &is) const;
+
+    /// Row pointers.
+    inline const std::vector<idx_t>& row_ptr() const { return m_ptr; }
+    /// Column indices (0-based).
+    inline const std::vector<int>& col_idx() const { return m_idx; }
+    /// Values.
+    inline const std::vector<T>& values() const { return m_val; }
+
+    /// Row access for level 3 routines.
+    internal::csr_rows<T> ref() const;
+
+ private:
+    /// No. of rows and columns.
+    int m_rows, m_cols;
+    /// Row pointers.
+    std::vector<idx_t> m_ptr;
+    /// Column indices.
+    std::vector<int> m_idx;
+    /// Values.
+    std::vector<T> m_val;
+
+}; /* class template SparseMatrix */
+
+
+/// Teaching and testing data with sparse inputs. The text format is as for
+/// Dataset (see Dataset::load) except that input line of each record lists
+/// non-zero inputs only as index:value pairs (1-based indices), the line
+/// is empty if all inputs are zero.
+template <typename T>
+class SparseDataset
+{
+  public:
+    /// Default constructor
+    SparseDataset() { ; }
+    /// Constructor from dataset with dense inputs (zeros are dropped).
+    /// Throws if records are weighted.
+    explicit SparseDataset(const Dataset<T> &dat);
+
+    /// Set new matrices and optionally descriptions (throws on error).
+    void set(const SparseMatrix<T> &in, const Matrix<T> &out,
+             const std::string &descr = "",
+             const std::vector<std::string> &record_descr =
+             std::vector<std::string>());
+
+    /// Load data from file, returns true on success.
+    bool load(const std::string &fname, bool read_info = true);
+    /// Save data to file, returns true on success.
+    bool save(const std::string &fname, bool write_info = true) const;
+
+    /// Retrieve input matrix.
+    const SparseMatrix<T>& get_input() const { return m_in; }
+    /// Retrieve output matrix.
+    const Matrix<T>& get_output() const { return m_out; }
+
+    /// Get no. of records.
+    inline int no_records() const { return m_in.rows(); }
+    /// Get no. of inputs.
+    inline int no_inputs() const { return m_in.cols(); }
+    /// Get no. of outputs.
+    inline int no_outputs() const { return m_out.cols(); }
+
+    /// Retrieve data information.
+    inline std::string get_info() const { return m_info; }
+    /// Set data information.
+    inline void set_info(const std::string &info) { m_info = info; }
+    /// Get record information.
+    std::string get_record_info(int i) const;
+
+  private:
+    /// Data.
+    SparseMatrix<T> m_in;
+    Matrix<T> m_out;
+    /// Dataset description.
+    std::string m_info;
+    /// Record descriptions.
+    std::vector<std::string> m_rec_info;
+
+}; /* SparseDataset class template */
+
+
+} /* namespace fcnn */
+
+
+#endif /* FCNN_SPARSE_H */
@@ -24,7 +24,9 @@
 
 
 #include <fcnn/struct.h>
+#include <fcnn/rcarr.h>
 #include <fcnn/activation.h>
+#include <fcnn/level2.h>
 #include <fcnn/error.h>
 #include <fcnn/utils.h>
 #include <fcnn/report.h>
@@ -32,12 +34,53 @@
 #include <fstream>
 #include <iomanip>
 #include <cctype>
+#include <climits>
 
 
 using namespace fcnn;
 using namespace fcnn::internal;
 
 
+
+namespace {
+
+
+// Weight 'pointers' given layers; total no. of weights is checked against
+// the range of weight indices (int).
+void
+mlp_w_pts(const std::vector<int> &layers, std::vector<int> &w_p)
+{
+    int nol = layers.size();
+    std::vector<idx_t> wp(nol + 1, 0);
+    for (int i = 1; i < nol; ++i)
+        wp[i + 1] = wp[i] + (idx_t) layers[i] * (layers[i - 1] + 1);
+    if (wp[nol] > (idx_t) INT_MAX)
+        throw exception("too many weights in network (" + num2str(wp[nol])
+                        + ")");
+    w_p.assign(wp.begin(), wp.end());
+}
+
+
+
+// Mark connections (but not biases) in hashed layers.
+std::vector<int>
+mlp_hash_mask(const std::vector<int> &layers, const std::vector<int> &hb)
+{
+    std::vector<int> hm;
+    for (int l = 1, nol = layers.size(); l < nol; ++l) {
+        int h = (l < (int) hb.size()) && hb[l];
+        for (int n = 0; n < layers[l]; ++n) {
+            hm.push_back(0);
+            hm.insert(hm.end(), layers[l - 1], h);
+        }
+    }
+    return hm;
+}
+
+
+} /* namespace */
+
+
 template <typename T>
 void
 fcnn::internal::mlp_construct(const std::vector<int> &layers,
@@ -79,9 +122,7 @@ one hidden, and output)");
     }
 
     // weights
-    w_p.assign(nol + 1, 0);
-    for (int i = 1; i < nol; ++i)
-        w_p[i + 1] = w_p[i] + layers[i] * (layers[i - 1] + 1);
+    mlp_w_pts(layers, w_p);
     w_on = w_p[nol];
     w_val.assign(w_p[nol], (T)0.);
     w_fl.assign(w_p[nol], (int) true);
@@ -118,9 +159,7 @@ one hidden, and output)");
     }
 
     // weights
-    w_p.assign(nol + 1, 0);
-    for (int i = 1; i < nol; ++i)
-        w_p[i + 1] = w_p[i] + layers[i] * (layers[i - 1] + 1);
+    mlp_w_pts(layers, w_p);
     if (w_p[nol] != (int)w_fl.size()) {
         message mes;
         mes << "no. of weights in given topology (" << w_p[nol]
@@ -239,7 +278,7 @@ smaller than the number of inputs in the initial network");
             w_val.insert(w_val.begin() + wp, ninp, T());
             w_fl.insert(w_fl.begin() + wp, ninp, 0);
         }
-        for (int ll = 2; ll <= nol; ++ll) w_p[ll] += layers[1] * ninp;
+        mlp_w_pts(layers, w_p);
     }
     // Temporary vectors
     std::vector<int> nnext(n_p[1]);
@@ -306,7 +345,8 @@ fcnn::internal::mlp_rm_neurons(std::vector<int> &layers,
                                int &w_on,
                                std::vector<int> & af,
                                std::vector<T> &af_p,
-                               bool report)
+                               bool report,
+                               std::vector<int> *w_idx)
 {
     int count = 0, nol = layers.size();
 start:
@@ -341,6 +381,7 @@ start:
             for (int nn = 0; nn < layers[l + 1]; ++nn, wi += layers[l]) {
                 w_val.erase(w_val.begin() + wi);
                 w_fl.erase(w_fl.begin() + wi);
+                if (w_idx) w_idx->erase(w_idx->begin() + wi);
             }
             for (int ll = l + 2; ll <= nol; ++ll) w_p[ll] -= layers[l + 1];
             // remove this neuron's connections
@@ -362,6 +403,7 @@ start:
             wie = w_p[l] + (ni + 1) * (layers[l - 1] + 1);
             w_val.erase(w_val.begin() + wis, w_val.begin() + wie);
             w_fl.erase(w_fl.begin() + wis, w_fl.begin() + wie);
+            if (w_idx) w_idx->erase(w_idx->begin() + wis, w_idx->begin() + wie);
             for (int ll = l + 1; ll <= nol; ++ll)
                 w_p[ll] -= (layers[l - 1] + 1);
             // remove neuron
@@ -396,14 +438,14 @@ template int fcnn::internal::mlp_rm_neurons(std::vector<int>&, std::vector<int>&
                                             std::vector<int>&, std::vector<float>&,
                                             std::vector<int>&, int&,
                                             std::vector<int>&, std::vector<float>&,
-                                            bool);
+                                            bool, std::vector<int>*);
 #endif /* FCNN_DOUBLE_ONLY */
 template int fcnn::internal::mlp_rm_neurons(std::vector<int>&, std::vector<int>&,
                                             std::vector<int>&, std::vector<int>&,
                                             std::vector<int>&, std::vector<double>&,
                                             std::vector<int>&, int&,
                                             std::vector<int>&, std::vector<double>&,
-                                            bool);
+                                            bool, std::vector<int>*);
 
 
 template <typename T>
@@ -512,9 +554,7 @@ fcnn::internal::mlp_merge(const std::vector<int> &Alayers,
     }
 
     // weights
-    w_p.assign(nol + 1, 0);
-    for (int i = 1; i < nol; ++i)
-        w_p[i + 1] = w_p[i] + layers[i] * (layers[i - 1] + 1);
+    mlp_w_pts(layers, w_p);
     w_val.assign(w_p[nol], 0.);
     w_fl.assign(w_p[nol], 0);
 
@@ -660,9 +700,7 @@ fcnn::internal::mlp_stack(const std::vector<int> &Alayers, const std::vector<int
     for (int i = 0; i < nol; ++i) n_p[i + 1] = n_p[i] + layers[i];
 
     // weights
-    w_p = Aw_p;
-    w_p.insert(w_p.end(), Bw_p.begin() + 2, Bw_p.end());
-    for (int i = Alayers.size() + 1; i <= nol; ++i) w_p[i] += Aw_p.back();
+    mlp_w_pts(layers, w_p);
     w_val = Aw_val;
     w_val.insert(w_val.end(), Bw_val.begin(), Bw_val.end());
     w_fl = Aw_fl;
@@ -737,7 +775,10 @@ fcnn::internal::mlp_save_txt(const std::string &fname,
                              const std::vector<T> &w_val,
                              const std::vector<int> &w_fl,
                              const std::vector<int> &af,
-                             const std::vector<T> &af_p)
+                             const std::vector<T> &af_p,
+                             const std::vector<int> &hb,
+                             const std::vector<unsigned> &hs,
+                             const std::vector<T> &hval)
 {
     std::ofstream file(fname.c_str());
     if (!file.good()) return false;
@@ -752,11 +793,18 @@ fcnn::internal::mlp_save_txt(const std::string &fname,
         if (i) file << ' ';
         file << layers[i];
     }
-    file << "\n\n# flags (" << num2str((unsigned)w_fl.size()) << ")\n";
+    // connections in hashed layers are not saved (they are always active
+    // and their weights are given by buckets)
+    std::vector<int> hm = mlp_hash_mask(layers, hb);
+    int fcount = 0;
+    for (int i = 0, n = w_fl.size(); i < n; ++i) if (!hm[i]) ++fcount;
+    file << "\n\n# flags (" << num2str(fcount) << ")\n";
     int awcount = 0;
-    for (int i = 0, n = w_fl.size(); i < n; ++i) {
-        if (i % 40) file << ' '; else if (i) file << '\n';
+    for (int i = 0, k = 0, n = w_fl.size(); i < n; ++i) {
+        if (hm[i]) continue;
+        if (k % 40) file << ' '; else if (k) file << '\n';
         if (w_fl[i]) { file << '1'; ++awcount; } else file << '0';
+        ++k;
     }
     file << "\n\n# weights (" << num2str(awcount) << ")\n";
     file << std::setprecision(precision<T>::val);
@@ -764,7 +812,7 @@ fcnn::internal::mlp_save_txt(const std::string &fname,
     if (types_eq<T, float>::val) noinrow = 8;
     if (types_eq<T, double>::val) noinrow = 4;
     for (int i = 0, k = 0, n = w_fl.size(); i < n; ++i) {
-        if (w_fl[i]) {
+        if (w_fl[i] && !hm[i]) {
             if (k % noinrow) file << ' '; else if (k) file << '\n';
             file << w_val[i];
             ++k;
@@ -782,6 +830,18 @@ fcnn::internal::mlp_save_txt(const std::string &fname,
     for (int i = 1; i < (int)layers.size(); ++i) {
         file << af[i] << ' ' << af_p[i] << '\n';
     }
+    if (!hval.empty()) {
+        file << "\n# hashed layers (layer, buckets, seed)\n";
+        for (int i = 1; i < (int)layers.size(); ++i) {
+            if (hb[i]) file << (i + 1) << ' ' << hb[i] << ' ' << hs[i] << '\n';
+        }
+        file << "\n# buckets (" << num2str((unsigned)hval.size()) << ")\n";
+        for (int k = 0, n = hval.size(); k < n; ++k) {
+            if (k % noinrow) file << ' '; else if (k) file << '\n';
+            file << hval[k];
+        }
+        file << '\n';
+    }
     if (file.good()) {
         file.close();
         return true;
@@ -806,7 +866,10 @@ fcnn::internal::mlp_load_txt(const std::string &fname,
                              std::vector<int> &w_fl,
                              int &w_on,
                              std::vector<int> &af,
-                             std::vector<T> &af_p)
+                             std::vector<T> &af_p,
+                             std::vector<int> &hb,
+                             std::vector<unsigned> &hs,
+                             std::vector<T> &hval)
 {
     std::ifstream file(fname.c_str());
     if (!file.good()) return false;
@@ -845,13 +908,6 @@ fcnn::internal::mlp_load_txt(const std::string &fname,
     }
     if (file.fail()) return false;
 
-    try {
-        mlp_construct(layers, n_p, n_prev, n_next,
-                      w_p, vals, w_val, w_fl, w_on);
-    } catch (exception &e) {
-        return false;
-    }
-
     skip_all(file);
     if (file.eof()) return false;
     af.push_back(0);
@@ -866,7 +922,62 @@ fcnn::internal::mlp_load_txt(const std::string &fname,
     }
     if (af.size() != layers.size()) return false;
     skip_all(file);
-    if (!file.eof()) return false;
+
+    // hashed layers (optional)
+    int nol = layers.size(), nb = 0;
+    hb.assign(nol, 0);
+    hs.assign(nol, 0);
+    if (!file.eof()) {
+        while (!file.fail() && !is_deol(file)) {
+            int l, b;
+            unsigned seed;
+            if (!read(file, l) || !read(file, b) || !read(file, seed))
+                return false;
+            if ((l < 2) || (l > nol) || (b < 1) || hb[l - 1]) return false;
+            hb[l - 1] = b;
+            hs[l - 1] = seed;
+            nb += b;
+        }
+        skip_all(file);
+        while (!file.fail() && !is_deol(file)) {
+            T val;
+            if (read(file, val)) hval.push_back(val);
+            else break;
+        }
+        if ((int) hval.size() != nb) return false;
+        skip_all(file);
+        if (!file.eof()) return false;
+    }
+
+    // insert (active) connections in hashed layers
+    if (nb) {
+        std::vector<int> hm = mlp_hash_mask(layers, hb), fl;
+        std::vector<T> v;
+        for (int i = 0, j = 0, k = 0, n = hm.size(); i < n; ++i) {
+            if (hm[i]) {
+                fl.push_back(1);
+                v.push_back(T());
+            } else {
+                if (j >= (int) w_fl.size()) return false;
+                fl.push_back(w_fl[j]);
+                if (w_fl[j++]) {
+                    if (k >= (int) vals.size()) return false;
+                    v.push_back(vals[k++]);
+                }
+            }
+        }
+        w_fl.swap(fl);
+        vals.swap(v);
+    }
+
+    try {
+        mlp_construct(layers, n_p, n_prev, n_next,
+                      w_p, vals, w_val, w_fl, w_on);
+    } catch (exception &e) {
+        return false;
+    }
+    if (nb) hash_expand(&layers[0], nol, &w_p[0], &hb[0], &hs[0],
+                        &hval[0], &w_val[0]);
 
     return true;
 }
@@ -881,6 +992,9 @@ template bool fcnn::internal::mlp_save_txt(const std::string&,
                                            const std::vector<float>&,
                                            const std::vector<int>&,
                                            const std::vector<int>&,
+                                           const std::vector<float>&,
+                                           const std::vector<int>&,
+                                           const std::vector<unsigned>&,
                                            const std::vector<float>&);
 template bool fcnn::internal::mlp_load_txt(const std::string&,
                                            std::string&,
@@ -889,6 +1003,9 @@ template bool fcnn::internal::mlp_load_txt(const std::string&,
                                            std::vector<int>&, std::vector<float>&,
                                            std::vector<int>&, int&,
                                            std::vector<int>&,
+                                           std::vector<float>&,
+                                           std::vector<int>&,
+                                           std::vector<unsigned>&,
                                            std::vector<float>&);
 #endif /* FCNN_DOUBLE_ONLY */
 template bool fcnn::internal::mlp_save_txt(const std::string&,
@@ -897,6 +1014,9 @@ template bool fcnn::internal::mlp_save_txt(const std::string&,
                                            const std::vector<double>&,
                                            const std::vector<int>&,
                                            const std::vector<int>&,
+                                           const std::vector<double>&,
+                                           const std::vector<int>&,
+                                           const std::vector<unsigned>&,
                                            const std::vector<double>&);
 template bool fcnn::internal::mlp_load_txt(const std::string&,
                                            std::string&,
@@ -905,6 +1025,9 @@ template bool fcnn::internal::mlp_load_txt(const std::string&,
                                            std::vector<int>&, std::vector<double>&,
                                            std::vector<int>&, int&,
                                            std::vector<int>&,
+                                           std::vector<double>&,
+                                           std::vector<int>&,
+                                           std::vector<unsigned>&,
                                            std::vector<double>&);
 
 
@@ -77,7 +77,8 @@ void mlp_expand_reorder_inputs(std::vector<int> &layers,
                                int newnoinp, const std::map<int, int> &m);
 
 
-/// Reconstruct network by removing redundant neurons.
+/// Reconstruct network by removing redundant neurons. If w_idx is not null,
+/// its entries are removed along with the weights.
 template <typename T>
 int mlp_rm_neurons(std::vector<int> &layers,
                    std::vector<int> &n_p,
@@ -89,7 +90,8 @@ int mlp_rm_neurons(std::vector<int> &layers,
                    int &w_on,
                    std::vector<int> & af,
                    std::vector<T> &af_p,
-                   bool report);
+                   bool report,
+                   std::vector<int> *w_idx = 0);
 
 
 /// Reconstruct network by removing redundant input neurons.
@@ -140,7 +142,10 @@ bool mlp_save_txt(const std::string &fname,
                   const std::vector<T> &w_val,
                   const std::vector<int> &w_fl,
                   const std::vector<int> &af,
-                  const std::vector<T> &af_p);
+                  const std::vector<T> &af_p,
+                  const std::vector<int> &hb,
+                  const std::vector<unsigned> &hs,
+                  const std::vector<T> &hval);
 
 
 /// Load network in a text file.
@@ -156,7 +161,10 @@ bool mlp_load_txt(const std::string &fname,
                   std::vector<int> &w_fl,
                   int &w_on,
                   std::vector<int> &af,
-                  std::vector<T> &af_p);
+                  std::vector<T> &af_p,
+                  std::vector<int> &hb,
+                  std::vector<unsigned> &hs,
+                  std::vector<T> &hval);
 
 
 /// Get absolute neuron index given layer and neuron index within this layer.
@@ -0,0 +1,114 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file textio.cpp
+ *  \brief Fast parsing of numeric text files (internal).
+ */
+
+
+#include <fcnn/textio.h>
+#include <fstream>
+#include <iterator>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define FCNN_MMAP_FILES
+#endif
+
+
+using namespace fcnn::internal;
+
+
+
+const double fcnn::internal::pow10d[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const float fcnn::internal::pow10f[11] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+
+
+text_file::~text_file()
+{
+#if defined(FCNN_MMAP_FILES)
+    if (m_map) munmap((void*) m_ptr, m_len);
+#endif /* defined(FCNN_MMAP_FILES) */
+}
+
+
+bool
+text_file::open(const std::string &fname)
+{
+#if defined(FCNN_MMAP_FILES)
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) || (st.st_size < 0)) { close(fd); return false; }
+    m_len = (std::size_t) st.st_size;
+    if (m_len) {
+        void *m = mmap(0, m_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            m_ptr = (const char*) m;
+            m_map = true;
+#if defined(MADV_SEQUENTIAL)
+            madvise(m, m_len, MADV_SEQUENTIAL);
+#endif
+        }
+    }
+    close(fd);
+    if (m_map || !m_len) return true;
+#endif /* defined(FCNN_MMAP_FILES) */
+    std::ifstream is(fname.c_str(), std::ios::binary);
+    if (!is) return false;
+    m_buf.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    m_ptr = m_buf.empty() ? 0 : &m_buf[0];
+    m_len = m_buf.size();
+    return true;
+}
+
+
+
+std::vector<text_chunk>
+fcnn::internal::split_text(const char *b, const char *e, bool comments)
+{
+    const std::ptrdiff_t chsz = 1 << 22;
+    std::vector<text_chunk> chunks;
+    const char *p = b;
+    while (p < e) {
+        text_chunk ch;
+        ch.b = p;
+        p = (e - p > chsz) ? line_end(p + chsz, e) + 1 : e;
+        if (comments) {
+            while ((p < e) && (*p == '#')) p = line_end(p, e) + 1;
+            if (p < e) p = line_end(p, e) + 1;
+        }
+        if (p > e) p = e;
+        ch.e = p;
+        ch.lines = ch.first = 0;
+        chunks.push_back(ch);
+    }
+    return chunks;
+}
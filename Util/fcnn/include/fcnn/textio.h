@@ -0,0 +1,212 @@
+/*
+ *  This file is a part of Fast Compressed Neural Networks.
+ *
+ *  Copyright (c) Grzegorz Klima 2012-2016
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/** \file textio.h
+ *  \brief Fast parsing of numeric text files (internal).
+ */
+
+
+#ifndef FCNN_TEXTIO_H
+
+#define FCNN_TEXTIO_H
+
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+
+namespace fcnn {
+namespace internal {
+
+
+/// Contents of text file (mapped read only where supported,
+/// read into memory otherwise).
+class text_file {
+  public:
+    /// Constructor.
+    text_file() : m_ptr(0), m_len(0), m_map(false) { ; }
+    /// Destructor.
+    ~text_file();
+
+    /// Open file, returns true on success.
+    bool open(const std::string &fname);
+
+    /// Beginning of contents.
+    const char* begin() const { return m_ptr; }
+    /// End of contents.
+    const char* end() const { return m_ptr + m_len; }
+
+  private:
+    const char *m_ptr;
+    std::size_t m_len;
+    bool m_map;
+    std::vector<char> m_buf;
+
+    text_file(const text_file&);
+    text_file& operator=(const text_file&);
+
+}; /* class text_file */
+
+
+/// Chunk of text [b, e) (whole lines) with no. of data lines in it
+/// and the index of the first one.
+struct text_chunk {
+    const char *b, *e;
+    int lines, first;
+};
+
+/// Split text into chunks of about 4MB ending at line ends. If comments
+/// is true, chunks end after lines which are not comments (do not begin
+/// with '#'), so that comments stay with the line following them.
+std::vector<text_chunk> split_text(const char *b, const char *e, bool comments);
+
+
+/// Powers of 10 exactly representable in double.
+extern const double pow10d[23];
+/// Powers of 10 exactly representable in float.
+extern const float pow10f[11];
+
+
+/// Exact conversion if mantissa and power of 10 are exactly representable
+/// (otherwise returns false).
+inline
+bool
+fast_conv(unsigned long long m, int e, double &x)
+{
+    if ((m > (1ULL << 53)) || (e < -22) || (e > 22)) return false;
+    x = (e < 0) ? (double) m / pow10d[-e] : (double) m * pow10d[e];
+    return true;
+}
+
+/// Exact conversion if mantissa and power of 10 are exactly representable
+/// (otherwise returns false).
+inline
+bool
+fast_conv(unsigned long long m, int e, float &x)
+{
+    if ((m > (1ULL << 24)) || (e < -10) || (e > 10)) return false;
+    x = (e < 0) ? (float) m / pow10f[-e] : (float) m * pow10f[e];
+    return true;
+}
+
+/// Correctly rounded conversion of C string.
+inline double str2num(const char *s, char **e, double) { return strtod(s, e); }
+/// Correctly rounded conversion of C string.
+inline float str2num(const char *s, char **e, float) { return strtof(s, e); }
+
+
+/// Scan number in [p, e) written as [+-]digits[.digits][(e|E)[+-]digits],
+/// returns pointer past it or 0 on failure. Result is correctly rounded
+/// (as with stream input); overflow is an error.
+template <typename T>
+const char*
+scan_num(const char *p, const char *e, T &x)
+{
+    const char *s = p;
+    bool neg = false, any = false, exact = true;
+    unsigned long long m = 0;
+    int nd = 0, ex = 0;
+    if ((p < e) && ((*p == '+') || (*p == '-'))) neg = (*p++ == '-');
+    for (; (p < e) && (*p >= '0') && (*p <= '9'); ++p) {
+        any = true;
+        if (!m && (*p == '0')) continue;
+        if (nd < 19) { m = 10 * m + (*p - '0'); ++nd; }
+        else { ++ex; if (*p != '0') exact = false; }
+    }
+    if ((p < e) && (*p == '.')) {
+        for (++p; (p < e) && (*p >= '0') && (*p <= '9'); ++p) {
+            any = true;
+            if (!m && (*p == '0')) { --ex; continue; }
+            if (nd < 19) { m = 10 * m + (*p - '0'); ++nd; --ex; }
+            else if (*p != '0') exact = false;
+        }
+    }
+    if (!any) return 0;
+    if ((p < e) && ((*p == 'e') || (*p == 'E'))) {
+        ++p;
+        bool eneg = false;
+        if ((p < e) && ((*p == '+') || (*p == '-'))) eneg = (*p++ == '-');
+        if ((p >= e) || (*p < '0') || (*p > '9')) return 0;
+        int n = 0;
+        for (; (p < e) && (*p >= '0') && (*p <= '9'); ++p) {
+            if (n < 100000) n = 10 * n + (*p - '0');
+        }
+        ex += eneg ? -n : n;
+    }
+    if (!m) {
+        x = neg ? -T() : T();
+        return p;
+    }
+    if (exact && fast_conv(m, ex, x)) {
+        if (neg) x = -x;
+        return p;
+    }
+    // correctly rounded conversion of the whole token
+    char buf[64];
+    std::string str;
+    const char *c;
+    if (p - s < (std::ptrdiff_t) sizeof(buf)) {
+        memcpy(buf, s, p - s);
+        buf[p - s] = '\0';
+        c = buf;
+    } else {
+        str.assign(s, p);
+        c = str.c_str();
+    }
+    errno = 0;
+    x = str2num(c, 0, T());
+    if ((errno == ERANGE) && (std::fabs(x) > std::numeric_limits<T>::max()))
+        return 0;
+    return p;
+}
+
+
+/// End of line at p (line ends with '\n' or at the end of buffer).
+inline
+const char*
+line_end(const char *p, const char *e)
+{
+    const char *q = (const char*) memchr(p, '\n', e - p);
+    return q ? q : e;
+}
+
+
+/// Skip blanks (spaces and tabs).
+inline
+const char*
+skip_sp(const char *p, const char *e)
+{
+    while ((p < e) && ((*p == ' ') || (*p == '\t'))) ++p;
+    return p;
+}
+
+
+} /* namespace internal */
+} /* namespace fcnn */
+
+
+#endif /* FCNN_TEXTIO_H */
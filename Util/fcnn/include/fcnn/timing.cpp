@@ -25,6 +25,7 @@
 
 #include <fcnn/timing.h>
 #include <fcnn/fcnncfg.h>
+#include <chrono>
 
 
 
@@ -104,3 +105,11 @@ fcnn::toc(void)
 
 
 
+double
+fcnn::wtime(void)
+{
+    // monotonic wall clock (clock() would give CPU time of all threads)
+    std::chrono::duration<double> t =
+        std::chrono::steady_clock::now().time_since_epoch();
+    return t.count();
+}
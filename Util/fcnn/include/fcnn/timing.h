@@ -39,6 +39,10 @@ void tic(void);
 /// Stop the timer, return time elapsed.
 double toc(void);
 
+/// Return wall time (in seconds, monotonic) elapsed since an arbitrary
+/// point in the past. Unlike tic & toc, it does not affect the timer.
+double wtime(void);
+
 
 } /* namespace fcnn */
 
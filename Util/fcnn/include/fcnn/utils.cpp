@@ -28,6 +28,9 @@
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <random>
 
 
 
@@ -78,6 +81,15 @@ message::operator<<(int n)
 
 
 
+message&
+message::operator<<(long long n)
+{
+    m_mes += num2str(n);
+    return *this;
+}
+
+
+
 message&
 message::operator<<(float n)
 {
@@ -123,6 +135,15 @@ fcnn::internal::num2str(int n)
 }
 
 
+string
+fcnn::internal::num2str(long long n)
+{
+    char buf[25];
+    sprintf(buf, "%lld", n);
+    return string(buf);
+}
+
+
 string
 fcnn::internal::num2str(unsigned n)
 {
@@ -173,7 +194,7 @@ fcnn::internal::read(istream &is, T &n)
             return true;
         }
         c = is.peek();
-        if ((c == ' ') || (c == '\t') || (c == '\n')) {
+        if ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n')) {
             n = x;
             return true;
         }
@@ -222,7 +243,7 @@ start_line:
     if (is.eof()) return true;
     if (is.fail()) return false;
     while ((is) && (c != '\n')) {
-        s += c;
+        if (c != '\r') s += c;
         is.get(c);
     }
     if (is.eof()) return true;
@@ -260,7 +281,7 @@ fcnn::internal::skip_blank(istream &is)
     char c;
     while (is.good() && !is.eof()) {
         is.get(c);
-        if ((c != ' ') && (c != '\t') && (c != '\n') && (c != '\0')) {
+        if ((c != ' ') && (c != '\t') && (c != '\r') && (c != '\n') && (c != '\0')) {
             is.putback(c);
             break;
         }
@@ -274,7 +295,7 @@ fcnn::internal::skip_all(istream &is)
     char c;
     while (is.good() && !is.eof()) {
         is.get(c);
-        if ((c != ' ') && (c != '\t') && (c != '\n') && (c != '\0')) {
+        if ((c != ' ') && (c != '\t') && (c != '\r') && (c != '\n') && (c != '\0')) {
             is.putback(c);
             if (c == '#') {
                 skip_comment(is);
@@ -293,7 +314,7 @@ fcnn::internal::is_eol(istream &is)
     char c;
     while (is.good() && !is.eof()) {
         is.get(c);
-        if ((c != ' ') && (c != '\t')) {
+        if ((c != ' ') && (c != '\t') && (c != '\r')) {
             if (c == '\n') return true;
             else {
                 is.putback(c);
@@ -326,7 +347,7 @@ fcnn::internal::is_eoleof(istream &is)
     while (is) {
         if (is.eof()) return true;
         is.get(c);
-        if ((c != ' ') && (c != '\t')) {
+        if ((c != ' ') && (c != '\t') && (c != '\r')) {
             if ((c == '\n') || (c == '\0')) return true;
             else {
                 is.putback(c);
@@ -362,3 +383,71 @@ fcnn::internal::sample_int(int N, int M)
 #endif /* R_SHAREDLIB */
 
 
+
+std::vector<int>
+fcnn::internal::permute_int(int N)
+{
+    std::vector<int> res(N);
+    for (int i = 0; i < N; ++i) res[i] = i + 1;
+    for (int i = N - 1; i > 0; --i) {
+        int j = (int)((double) ::rand() / ((double) RAND_MAX + 1.) * (double)(i + 1));
+        std::swap(res[i], res[j]);
+    }
+    return res;
+}
+
+
+
+// Used by MLPNet::mse_below, so it is needed under R as well
+std::vector<int>
+fcnn::internal::permute_int(int N, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<int> res(N);
+    for (int i = 0; i < N; ++i) res[i] = i + 1;
+    for (int i = N - 1; i > 0; --i) {
+        int j = (int)((double) rng() / 4294967296. * (double)(i + 1));
+        std::swap(res[i], res[j]);
+    }
+    return res;
+}
+
+
+
+// Rational approximation by P. J. Acklam (relative error below 1.15e-9).
+double
+fcnn::internal::qnorm(double p)
+{
+    static const double a[] = { -3.969683028665376e+01,  2.209460984245205e+02,
+                                -2.759285104469687e+02,  1.383577518672690e+02,
+                                -3.066479806614716e+01,  2.506628277459239e+00 };
+    static const double b[] = { -5.447609879822406e+01,  1.615858368580409e+02,
+                                -1.556989798598866e+02,  6.680131188771972e+01,
+                                -1.328068155288572e+01 };
+    static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01,
+                                -2.400758277161838e+00, -2.549732539343734e+00,
+                                 4.374664141464968e+00,  2.938163982698783e+00 };
+    static const double d[] = {  7.784695709041462e-03,  3.224671290700398e-01,
+                                 2.445134137142996e+00,  3.754408661907416e+00 };
+    const double plow = 0.02425, phigh = 1. - plow;
+    double q, r;
+
+    if (p <= 0.) return -HUGE_VAL;
+    if (p >= 1.) return HUGE_VAL;
+    if (p < plow) {
+        q = sqrt(-2. * log(p));
+        return (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5])
+               / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.);
+    }
+    if (p > phigh) {
+        q = sqrt(-2. * log(1. - p));
+        return -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5])
+               / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.);
+    }
+    q = p - .5;
+    r = q * q;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q
+           / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.);
+}
+
+
@@ -58,6 +58,8 @@ public:
     message& operator<<(unsigned);
     /// Append integer.
     message& operator<<(int);
+    /// Append (64-bit) integer.
+    message& operator<<(long long);
     /// Append float.
     message& operator<<(float);
     /// Append double.
@@ -74,6 +76,8 @@ std::string num2str(unsigned n);
 /// Convert number to std::string.
 std::string num2str(int n);
 /// Convert number to std::string.
+std::string num2str(long long n);
+/// Convert number to std::string.
 std::string num2str(float n);
 /// Convert number to std::string.
 std::string num2str(double n);
@@ -116,13 +120,13 @@ bool read_comment(std::istream &is, std::string &s);
 /// Skip input until the end of comment.
 void skip_comment(std::istream &is);
 
-/// Skip whitespace and newlines.
+/// Skip whitespace and newlines (LF or CRLF).
 void skip_blank(std::istream &is);
 
 /// Skip whitespace, newlines and comments.
 void skip_all(std::istream &is);
 
-/// Are we at the end of line (whitespace ignored)?
+/// Are we at the end of line (whitespace ignored, also '\r' of CRLF)?
 bool is_eol(std::istream &is);
 
 /// Are we at the end of line (whitespace ignored) followed by another eol
@@ -135,6 +139,16 @@ bool is_eoleof(std::istream &is);
 /// Draw a random sample of size M of integers from 1 to N.
 std::vector<int> sample_int(int N, int M);
 
+/// Draw a random permutation of integers from 1 to N.
+std::vector<int> permute_int(int N);
+
+/// Pseudo-random permutation of integers from 1 to N determined by seed
+/// (generator of its own, rand() is neither used nor advanced).
+std::vector<int> permute_int(int N, unsigned seed);
+
+/// Quantile function of the standard normal distribution.
+double qnorm(double p);
+
 
 } /* namespace internal */
 } /* namespace fcnn */